@@ -1,89 +1,160 @@
-#include <Stepper.h>
-#include <Multiplexer.h>
-#include <DcMotor.h>
 #include "proto/AutomaticTurntable.h"
 #include "proto/Constants.h"
 #include "enums/ArduinoPin.h"
 #include "enums/MultiplexerInput.h"
 #include "enums/MovementResult.h"
 #include "enums/AutoManualSwitchPosition.h"
+#include "TurntableHal.h"
+#include "TurntableSpeedMonitor.h"
+#include "TurntableSpeedRegulator.h"
+#include "QuadratureEncoder.h"
+#include "LeadOutDetector.h"
 #include "TonearmMovementController.h"
-
-// Though this is one stepper motor declaration, this object actually handles both the vertical and horizontal
-// stepper motors. Which one is currently active is determined by the ArduinoPin::MotorAxisSelector.
-Stepper tonearmMotor = Stepper(
-  STEPS_PER_REVOLUTION, 
-  ArduinoPin::StepperPin4,
-  ArduinoPin::StepperPin2, 
-  ArduinoPin::StepperPin3, 
-  ArduinoPin::StepperPin1
-);
-
-// The multiplexer monitors most input values that we read to determine the statuses of various sensors.
-Multiplexer mux = Multiplexer(
-  ArduinoPin::MuxOutput, 
-  ArduinoPin::MuxSelectorA, 
-  ArduinoPin::MuxSelectorB, 
-  ArduinoPin::MuxSelectorC
-);
-
-// The tonearmClutch allows us to engage or disengage the horizontal gearing to either allow for automatic
-// movement (engaged), or manual movement (disengaged).
-DcMotor horizontalClutch = DcMotor(
-  ArduinoPin::HorizontalClutchMotorDir1,
-  ArduinoPin::HorizontalClutchMotorDir2
-);
+#include "RoutineExecutor.h"
+#include "SerialProtocol.h"
+#include "CalibrationStore.h"
+#include "EventTrace.h"
+#include "SensorCapture.h"
+#include "EventLoop.h"
+#include "SevenSegmentDisplay.h"
+#include "enums/SerialFrameType.h"
+#include "enums/SerialStatusFlag.h"
+#include "enums/RecordSize.h"
 
 // The tonearmController is in charge of automatically moving the tonearm vertically or horizontally.
-TonearmMovementController tonearmController = TonearmMovementController(
-  mux,
-  tonearmMotor,
-  ArduinoPin::MotorAxisSelector,
-  horizontalClutch,
-  MultiplexerInput::VerticalLowerLimit,
-  MultiplexerInput::VerticalUpperLimit
-);
-
-// All of these fields are used to calculate the speed that the turntable is spinning.
-volatile unsigned long currMillisSpeed = millis();
-volatile unsigned long lastMillisSpeed = currMillisSpeed;
-volatile double currSpeed;
-
-// Used for the pickup sensor
-uint8_t consecutivePickupSensorChanges = 0;
-bool lastPickupSensorStatus = false;
-unsigned long lastMillisPickup = __LONG_MAX__;
+TurntableTonearmController tonearmController = TurntableTonearmController(STEPS_PER_REVOLUTION);
+
+// Measures the speed that the turntable is spinning, from the timestamps of the speed sensor pulses.
+TurntableSpeedMonitor speedMonitor = TurntableSpeedMonitor();
+
+// Holds the platter at the speed selected by the speed switches, using the measured speed.
+TurntableSpeedRegulator speedRegulator = TurntableSpeedRegulator(speedMonitor);
+
+// Runs the multi-movement routines, moving the clutch at the same time as the tonearm wherever it can.
+RoutineExecutor routineExecutor = RoutineExecutor(tonearmController);
+
+// How long, in milliseconds, each routine took the last time it ran.
+unsigned long homeRoutineMs = 0;
+unsigned long playRoutineMs = 0;
+unsigned long repeatRoutineMs = 0;
+
+// The calibration value shown on the display after it was last changed, and until when it is shown there.
+CalibrationValue displayedCalibrationValue = (CalibrationValue)0;
+unsigned long calibrationDisplayUntilMillis = 0;
+
+// When the platter was last started, for timing out the wait for it to be stable.
+unsigned long turntableMotorStartMillis = 0;
+
+// The size of the record on the platter, as worked out from where the play routine last found the record edge.
+RecordSize recordSize = RecordSize::UnknownRecordSize;
+
+// Keeps track of the horizontal position of the tonearm, from the pickup encoder.
+QuadratureEncoder pickupEncoder = QuadratureEncoder();
+
+// Watches the inward travel of the tonearm on each revolution to tell when the record has finished.
+LeadOutDetector leadOutDetector = LeadOutDetector(pickupEncoder);
+
+// Receives remote commands, and sends status and speed telemetry, over the serial port.
+SerialProtocol serialProtocol = SerialProtocol();
+
+// Keeps the calibration values in the EEPROM.
+CalibrationStore calibrationStore = CalibrationStore(CALIBRATION_EEPROM_ADDRESS);
+
+// The calibration values used until a calibration has been saved, in the order of CalibrationValue.
+const uint16_t calibrationDefaults[CALIBRATION_VALUE_COUNT] = {
+  RECORD_EDGE_STEPS_7_INCH,
+  RECORD_EDGE_STEPS_10_INCH,
+  RECORD_EDGE_STEPS_12_INCH,
+  CLUTCH_ENGAGEMENT_MS,
+  VERTICAL_MOVEMENT_TIMEOUT_STEPS,
+  TONEARM_PICKUP_INWARD_DIRECTION < 0,
+  TONEARM_PICKUP_LEADOUT_COUNTS_PER_REVOLUTION,
+  TONEARM_PICKUP_CONSECUTIVE_REVOLUTIONS,
+  HORIZONTAL_STALL_STEPS,
+  HORIZONTAL_BACKLASH_STEPS
+};
+
+// How often, in milliseconds, telemetry is sent (0 is never), and when it was last sent.
+uint16_t telemetryIntervalMs = TELEMETRY_INTERVAL_MS;
+unsigned long lastTelemetryMillis = 0;
+
+// Streams raw sensor edges over the serial port, to tune the lead-out detection against whole record sides.
+SensorCapture sensorCapture = SensorCapture();
+
+// The next trace event to send, while the trace is being sent over the serial port, or -1.
+int16_t traceDumpIndex = -1;
 
 bool paused = false;
 
-void setup() { //Serial.begin(SERIAL_SPEED);
+// Used to detect a fresh press of the pause button while the tonearm is moving.
+bool lastPauseButtonStatus = false;
+
+// Set when the pause button stops a routine, so the press still pauses once the routine has finished stopping, even if
+// the button was let go in the meantime (i.e. while the clutch disengages).
+bool pausePressPending = false;
+
+// Used to count how many times per second the main loop runs.
+unsigned long loopIterations = 0;
+unsigned long loopRateWindowStartMillis = 0;
+unsigned long loopIterationsPerSecond = 0;
+unsigned long lastLoopMicros = 0;
+
+void setup() {
   // Set pins
-  pinMode(ArduinoPin::MovementStatusLed, OUTPUT);
-  pinMode(ArduinoPin::PauseStatusLed, OUTPUT);
-  pinMode(ArduinoPin::SpeedSensor, INPUT);
-  attachInterrupt(digitalPinToInterrupt(ArduinoPin::SpeedSensor), calculateTurntableSpeed, RISING);
+  TurntableHal::begin();
+  serialProtocol.begin(SERIAL_SPEED);
+  TurntableHal::beginSpeedCapture(calculateTurntableSpeed);
+  pickupEncoder.begin(TurntableHal::readPickupEncoderState());
+  TurntableHal::beginPickupEncoderCapture(decodePickupEncoder);
 
-  // Set calibration values
-  tonearmController.setClutchEngagementMs(CLUTCH_ENGAGEMENT_MS);
-  tonearmController.setTopMotorSpeed(MOVEMENT_RPM_TOP_SPEED);
-  tonearmController.setVerticalTimeout(VERTICAL_MOVEMENT_TIMEOUT_STEPS);
-  mux.setDelayMicroseconds(MULTIPLEXER_DELAY_MICROS);
+  // The tick has to be running before anything can wait on it, i.e. the error state after a failed startup movement.
+  EventLoop::begin();
+  SevenSegmentDisplay::begin();
+
+  // Set calibration values. The ones that can be tuned without reflashing are loaded from the EEPROM.
+  calibrationStore.setSaveDelayMs(CALIBRATION_SAVE_DELAY_MS);
+  calibrationStore.begin(calibrationDefaults);
+  applyCalibration();
 
-  // Engage the horizontal clutch. This will be setting it to the "starting" point for where we know it is engaged
-  horizontalClutch.immediateStart(HorizontalClutchPosition::Engage);
+  tonearmController.setTopMotorSpeed(MOVEMENT_RPM_TOP_SPEED);
+  tonearmController.setHorizontalTimeout(HORIZONTAL_MOVEMENT_TIMEOUT_STEPS);
+  tonearmController.setHorizontalEncoder(pickupEncoder);
+  tonearmController.setMotionProfile(MotorAxis::Vertical, MotionProfile::SCurve, VERTICAL_RAMP_STEPS);
+  tonearmController.setMotionProfile(MotorAxis::Horizontal, MotionProfile::Trapezoidal, HORIZONTAL_RAMP_STEPS);
+
+  // Half steps give the tonearm the smoothest possible descent onto the record.
+  tonearmController.setStepSequence(MotorAxis::Vertical, StepSequence::HalfStep);
+  tonearmController.setStepSequence(MotorAxis::Horizontal, StepSequence::FullStep);
+  tonearmController.setStepHoldMicros(STEPPER_HOLD_MICROS);
+  tonearmController.setAudioMuteTiming(AUDIO_MUTE_LEAD_MS, AUDIO_MUTE_LAG_MS);
+  tonearmController.setCarefulDescentSteps(VERTICAL_CAREFUL_DESCENT_STEPS);
+  tonearmController.setStylusClearanceSteps(VERTICAL_STYLUS_CLEARANCE_STEPS);
+  tonearmController.setLeadInSteps(RECORD_LEAD_IN_STEPS);
+  tonearmController.setMovementIdleHandler(monitorDuringMovement);
+  routineExecutor.setIdleHandler(monitorDuringMovement);
+  speedMonitor.setStoppedTimeoutMs(TURNTABLE_STOPPED_MS);
+  speedRegulator.setGains(SPEED_REGULATOR_KP, SPEED_REGULATOR_KI, SPEED_REGULATOR_KD);
+  speedRegulator.setBaseOutput(SPEED_REGULATOR_BASE_OUTPUT);
+  speedRegulator.setToleranceBasisPoints(SPEED_REGULATOR_TOLERANCE_BASIS_POINTS);
+  speedRegulator.setSpinUpThresholdBasisPoints(SPEED_REGULATOR_SPIN_UP_BASIS_POINTS);
+  speedRegulator.setStableRevolutions(SPEED_REGULATOR_STABLE_REVOLUTIONS);
+
+  // Engage the horizontal clutch. This will be setting it to the "starting" point for where we know it is engaged.
+  // This runs in the background while the light show and the initial movement happen.
+  tonearmController.beginClutchPosition(HorizontalClutchPosition::Engage, CLUTCH_STARTUP_MS);
 
   // Begin startup light show
-  delay(100);
-  digitalWrite(ArduinoPin::PauseStatusLed, LOW);
-  digitalWrite(ArduinoPin::MovementStatusLed, HIGH);
-  delay(100);
-  digitalWrite(ArduinoPin::MovementStatusLed, LOW);
-  digitalWrite(ArduinoPin::PauseStatusLed, HIGH);
-  delay(100);
-  digitalWrite(ArduinoPin::MovementStatusLed, HIGH);
-  digitalWrite(ArduinoPin::PauseStatusLed, LOW);
-  delay(100);
-  digitalWrite(ArduinoPin::MovementStatusLed, LOW);
+  TurntableHal::waitMs(100);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
+  TurntableHal::setMovementStatusLed(HIGH);
+  TurntableHal::waitMs(100);
+  TurntableHal::setMovementStatusLed(LOW);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(HIGH);
+  TurntableHal::waitMs(100);
+  TurntableHal::setMovementStatusLed(HIGH);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
+  TurntableHal::waitMs(100);
+  TurntableHal::setMovementStatusLed(LOW);
   // End startup light show
 
   // Check sensors, and perform an initial movement if necessary.
@@ -92,14 +163,14 @@ void setup() { //Serial.begin(SERIAL_SPEED);
   bool homeExecuted = false;
 
   // If the turntable is turned on to "automatic," then home the whole tonearm if it is not already home.
-  if(mux.readDigitalValue(MultiplexerInput::AutoManualSwitch) == AutoManualSwitchPosition::Automatic && 
-    digitalRead(ArduinoPin::HorizontalHomeOrPlayOpticalSensor)) {
-    MovementResult currentMovementStatus = homeRoutine();
+  if(TurntableHal::readMuxInput(MultiplexerInput::AutoManualSwitch) == AutoManualSwitchPosition::Automatic && 
+    TurntableHal::readPin<ArduinoPin::HorizontalHomeOrPlayOpticalSensor>()) {
+    currentMovementStatus = homeRoutine();
     homeExecuted = true;
   }
 
   // Otherwise, we only want to home the vertical axis if it is not already homed, which will drop the tonearm in its current location.
-  else if(!mux.readDigitalValue(MultiplexerInput::VerticalLowerLimit)) {
+  else if(!TurntableHal::readMuxInput(MultiplexerInput::VerticalLowerLimit)) {
       currentMovementStatus = pauseOrUnpause();
   }
 
@@ -108,192 +179,609 @@ void setup() { //Serial.begin(SERIAL_SPEED);
     setErrorState(currentMovementStatus);
   }
 
-  // If the homing routine was not executed, then the horizontal clutch is still engaged, and we need to disengage it
+  // If the homing routine was not executed, then the horizontal clutch is still engaged, and we need to disengage it.
+  // This waits for the startup engagement to finish first, so the clutch can home the whole way.
   if(!homeExecuted) {
-    delay(500); // Wait 500ms so the clutch can home the whole way before we disengage it
     tonearmController.setClutchPosition(HorizontalClutchPosition::Disengage);
   }
 }
 
+// The main loop sleeps until an interrupt posts an event. A new revolution only needs the speed and the pickup sensor
+// checked right away; everything else waits for the next tick.
 void loop() {
-  monitorCommandButtons();
-  monitorPickupSensor();
+  uint8_t events = EventLoop::waitForEvents();
+
+  countLoopIteration();
+
+  if(events & (LoopEvent::TickEvent | LoopEvent::SpeedPulseEvent)) {
+    speedMonitor.update();
+    speedRegulator.update();
+    monitorPickupSensor();
+  }
+
+  if(events & LoopEvent::TickEvent) {
+    tonearmController.pollClutch();
+    updateDisplay();
+    monitorCommandButtons();
+    monitorSerial(false);
+    calibrationStore.update();
+  }
+}
+
+// Count this iteration of the main loop, and once a second, store how many iterations there were in that second.
+// The time each iteration takes also goes into the trace's loop time histogram.
+void countLoopIteration() {
+  unsigned long currMillis = TurntableHal::currentMillis();
+  unsigned long currMicros = TurntableHal::currentMicros();
+  loopIterations++;
+
+  EventTrace::recordLoopTime(currMicros - lastLoopMicros);
+  lastLoopMicros = currMicros;
+
+  if(currMillis - loopRateWindowStartMillis >= 1000) {
+    loopIterationsPerSecond = loopIterations;
+    loopIterations = 0;
+    loopRateWindowStartMillis = currMillis;
+  }
 }
 
 // When a command button is pressed (i.e. Home/Play, or Pause/Unpause), then its respective command will be executed.
 void monitorCommandButtons() {
   MovementResult currentMovementStatus = MovementResult::None;
 
-  if(mux.readDigitalValue(MultiplexerInput::PauseButton)) {
+  lastPauseButtonStatus = TurntableHal::readMuxInput(MultiplexerInput::PauseButton);
+
+  if(lastPauseButtonStatus || pausePressPending) {
+    pausePressPending = false;
     currentMovementStatus = pauseOrUnpause();
   }
   
   // If the play/home button is pressed, the command executes
-  else if(mux.readDigitalValue(MultiplexerInput::PlayHomeButton)) {
+  else if(TurntableHal::readMuxInput(MultiplexerInput::PlayHomeButton)) {
 
     // If the tonearm is past the location of the home sensor, then this button will home it. Otherwise, it will execute
     // the play routine.
-    if(!digitalRead(ArduinoPin::HorizontalHomeOrPlayOpticalSensor)) 
+    if(!TurntableHal::readPin<ArduinoPin::HorizontalHomeOrPlayOpticalSensor>()) 
       currentMovementStatus = playRoutine();
     else 
       currentMovementStatus = homeRoutine();
   }
 
-  // If the movement was anything other than success/none, then it failed, and we must set the error state.
-  if(currentMovementStatus != MovementResult::Success && currentMovementStatus != MovementResult::None) {
-    setErrorState(currentMovementStatus);
+  finishCommand(currentMovementStatus);
+}
+
+// Clean up after a command from the buttons or the serial port has executed its routine.
+void finishCommand(MovementResult movementStatus) {
+  // The tonearm was moved by the routine, so its travel says nothing about the record.
+  if(movementStatus != MovementResult::None) {
+    leadOutDetector.reset();
+  }
+
+  // A cancelled routine leaves the tonearm wherever it stopped, so the movement status no longer applies.
+  if(movementStatus == MovementResult::Cancelled) {
+    TurntableHal::setMovementStatusLed(LOW);
+  }
+
+  // If the movement was anything other than success/none/cancelled, then it failed, and we must set the error state.
+  else if(movementStatus != MovementResult::Success && movementStatus != MovementResult::None) {
+    setErrorState(movementStatus);
+  }
+}
+
+// Execute any commands received on the serial port, and send telemetry when it is due. While a routine is already
+// moving the tonearm, the pause command cancels it (like the pause button does), and other routines are refused.
+void monitorSerial(bool movementInProgress) {
+  SerialFrame frame;
+
+  while(serialProtocol.receive(frame)) {
+    MovementResult commandResult = MovementResult::None;
+
+    switch(frame.type) {
+      case SerialFrameType::PlayCommand:
+        if(!movementInProgress) commandResult = playRoutine();
+        break;
+
+      case SerialFrameType::HomeCommand:
+        if(!movementInProgress) commandResult = homeRoutine();
+        break;
+
+      case SerialFrameType::PauseCommand:
+        if(movementInProgress) {
+          if(cancelMovementInProgress()) commandResult = MovementResult::Cancelled;
+        }
+        else commandResult = pauseOrUnpause();
+        break;
+
+      case SerialFrameType::SetTelemetryInterval:
+        if(frame.length >= 2) telemetryIntervalMs = SerialProtocol::readUint16(frame.payload);
+        continue;
+
+      case SerialFrameType::StatusRequest:
+        sendStatus();
+        continue;
+
+      case SerialFrameType::TraceRequest:
+        EventTrace::freeze();
+        traceDumpIndex = 0;
+        continue;
+
+      case SerialFrameType::StartCapture:
+        sensorCapture.start();
+        continue;
+
+      case SerialFrameType::StopCapture:
+        sensorCapture.stop();
+        continue;
+
+      case SerialFrameType::CalibrationRequest:
+        sendCalibration();
+        continue;
+
+      case SerialFrameType::LoopStatsRequest:
+        sendLoopStats();
+        EventLoop::resetMaxLatency();
+        continue;
+
+      case SerialFrameType::SetCalibration:
+        if(frame.length >= 3) {
+          calibrationStore.set((CalibrationValue)frame.payload[0], SerialProtocol::readUint16(frame.payload + 1));
+          applyCalibration();
+          showCalibrationValue((CalibrationValue)frame.payload[0]);
+        }
+        sendCalibration();
+        continue;
+
+      case SerialFrameType::AdjustCalibration:
+        if(frame.length >= 3) {
+          calibrationStore.adjust((CalibrationValue)frame.payload[0], (int16_t)SerialProtocol::readUint16(frame.payload + 1));
+          applyCalibration();
+          showCalibrationValue((CalibrationValue)frame.payload[0]);
+        }
+        sendCalibration();
+        continue;
+
+      default:
+        continue;
+    }
+
+    uint8_t payload[2] = { frame.type, commandResult };
+    serialProtocol.send(SerialFrameType::CommandResult, payload, sizeof(payload));
+
+    if(!movementInProgress) finishCommand(commandResult);
+  }
+
+  if(traceDumpIndex >= 0) continueTraceDump();
+  sendCapturedEdges();
+
+  unsigned long currMillis = TurntableHal::currentMillis();
+
+  if(telemetryIntervalMs > 0 && currMillis - lastTelemetryMillis >= telemetryIntervalMs) {
+    lastTelemetryMillis = currMillis;
+    sendStatus();
+    sendSpeedTelemetry();
+  }
+}
+
+// Send the same statuses as the COM port outputs, along with how long the last routines took, and the record size.
+void sendStatus() {
+  uint8_t flags = 0;
+
+  if(paused) flags |= SerialStatusFlag::PausedFlag;
+  if(tonearmController.isMoving()) flags |= SerialStatusFlag::MovingFlag;
+  if(TurntableHal::readMuxInput(MultiplexerInput::AutoManualSwitch) == AutoManualSwitchPosition::Automatic) flags |= SerialStatusFlag::AutomaticFlag;
+  if(TurntableHal::readPin<ArduinoPin::RepeatAfterAutoReturn>()) flags |= SerialStatusFlag::RepeatFlag;
+  if(!TurntableHal::readPin<ArduinoPin::HorizontalHomeOrPlayOpticalSensor>()) flags |= SerialStatusFlag::HomeFlag;
+  if(speedRegulator.isRunning()) flags |= SerialStatusFlag::MotorRunningFlag;
+
+  uint8_t payload[14];
+  payload[0] = flags;
+  SerialProtocol::writeUint32(payload + 1, homeRoutineMs);
+  SerialProtocol::writeUint32(payload + 5, playRoutineMs);
+  SerialProtocol::writeUint32(payload + 9, repeatRoutineMs);
+  payload[13] = recordSize;
+
+  serialProtocol.send(SerialFrameType::Status, payload, sizeof(payload));
+}
+
+// Send how busy the main loop is, and how quickly it picks up events.
+void sendLoopStats() {
+  uint8_t payload[14];
+  SerialProtocol::writeUint16(payload, EventLoop::getAwakePermille());
+  SerialProtocol::writeUint16(payload + 2, EventLoop::getLastLatencyMicros());
+  SerialProtocol::writeUint16(payload + 4, EventLoop::getMaxLatencyMicros());
+  SerialProtocol::writeUint32(payload + 6, EventLoop::getWakeCount());
+  SerialProtocol::writeUint32(payload + 10, loopIterationsPerSecond);
+
+  serialProtocol.send(SerialFrameType::LoopStats, payload, sizeof(payload));
+}
+
+// Send as much of the trace as there is room for in the serial transmit buffer. The rest is sent on later calls.
+void continueTraceDump() {
+  uint8_t eventCount = EventTrace::getEventCount();
+
+  while(traceDumpIndex < eventCount) {
+    uint8_t payload[16];
+    uint8_t length = 0;
+
+    for(uint8_t i = 0; i < 2 && traceDumpIndex + i < eventCount; i++) {
+      TraceEvent event = EventTrace::getEvent(traceDumpIndex + i);
+      SerialProtocol::writeUint32(payload + length, event.timestampMicros);
+      payload[length + 4] = event.type;
+      payload[length + 5] = event.detail;
+      SerialProtocol::writeUint16(payload + length + 6, event.value);
+      length += 8;
+    }
+
+    if(!serialProtocol.send(SerialFrameType::TraceEvents, payload, length)) return;
+    traceDumpIndex += length / 8;
+  }
+
+  uint8_t payload[EVENT_TRACE_LOOP_TIME_BUCKETS * 2];
+
+  for(uint8_t i = 0; i < EVENT_TRACE_LOOP_TIME_BUCKETS; i++) {
+    SerialProtocol::writeUint16(payload + i * 2, EventTrace::getLoopTimeCount(i));
+  }
+
+  if(!serialProtocol.send(SerialFrameType::TraceLoopTimes, payload, sizeof(payload))) return;
+
+  traceDumpIndex = -1;
+  EventTrace::unfreeze();
+}
+
+// Send the captured sensor edges, three to a frame, for as long as there is room in the serial transmit buffer.
+void sendCapturedEdges() {
+  while(sensorCapture.getWaitingCount() > 0 && serialProtocol.canSend(16)) {
+    uint8_t payload[16];
+    uint8_t length = 1;
+    SensorEdge edge;
+
+    payload[0] = sensorCapture.takeDroppedCount();
+
+    while(length < sizeof(payload) && sensorCapture.read(edge)) {
+      SerialProtocol::writeUint32(payload + length, edge.timestampMicros);
+      payload[length + 4] = edge.source;
+      length += 5;
+    }
+
+    serialProtocol.send(SerialFrameType::CaptureEdges, payload, length);
+  }
+}
+
+// Send every calibration value.
+void sendCalibration() {
+  uint8_t payload[CALIBRATION_VALUE_COUNT * 2];
+
+  for(uint8_t i = 0; i < CALIBRATION_VALUE_COUNT; i++) {
+    SerialProtocol::writeUint16(payload + i * 2, calibrationStore.get((CalibrationValue)i));
   }
+
+  serialProtocol.send(SerialFrameType::Calibration, payload, sizeof(payload));
+}
+
+// Show a calibration value on the display for CALIBRATION_DISPLAY_MS, i.e. after it has been changed.
+void showCalibrationValue(CalibrationValue value) {
+  if(value >= CALIBRATION_VALUE_COUNT) return;
+
+  displayedCalibrationValue = value;
+  calibrationDisplayUntilMillis = TurntableHal::currentMillis() + CALIBRATION_DISPLAY_MS;
+}
+
+// Show the measured platter speed, in RPM to two decimal places, or a recently changed calibration value. The display
+// is blank while the platter is stopped.
+void updateDisplay() {
+  if((long)(calibrationDisplayUntilMillis - TurntableHal::currentMillis()) > 0) {
+    SevenSegmentDisplay::showNumber(calibrationStore.get(displayedCalibrationValue), 0);
+  }
+  else if(speedMonitor.isStopped()) {
+    SevenSegmentDisplay::clear();
+  }
+  else {
+    SevenSegmentDisplay::showNumber(speedMonitor.getMeanCentiRpm(), 2);
+  }
+}
+
+// Pass the calibration values from the store to everything that uses them.
+void applyCalibration() {
+  tonearmController.setClutchEngagementMs(calibrationStore.get(CalibrationValue::ClutchEngagementMs));
+  tonearmController.setVerticalTimeout(calibrationStore.get(CalibrationValue::VerticalTimeoutSteps));
+  tonearmController.setHorizontalStallSteps(calibrationStore.get(CalibrationValue::HorizontalStallSteps));
+  tonearmController.setHorizontalBacklashSteps(calibrationStore.get(CalibrationValue::HorizontalBacklashSteps));
+  leadOutDetector.setInwardDirection(calibrationStore.get(CalibrationValue::PickupEncoderReversed) ? -1 : 1);
+  leadOutDetector.setLeadOutTravelPerRevolution(calibrationStore.get(CalibrationValue::PickupLeadOutCountsPerRevolution));
+  leadOutDetector.setConsecutiveRevolutions(calibrationStore.get(CalibrationValue::PickupConsecutiveRevolutions));
+}
+
+// Send the measured and target platter speed. Speeds are sent as hundredths of an RPM.
+void sendSpeedTelemetry() {
+  uint8_t payload[10];
+  payload[0] = speedRegulator.getTargetSpeed();
+  SerialProtocol::writeUint16(payload + 1, speedMonitor.getCurrentCentiRpm());
+  SerialProtocol::writeUint16(payload + 3, speedMonitor.getMeanCentiRpm());
+  SerialProtocol::writeUint16(payload + 5, speedRegulator.getTargetCentiRpm());
+  SerialProtocol::writeUint16(payload + 7, speedMonitor.getWowAndFlutterBasisPoints());
+  payload[9] = speedRegulator.getOutput();
+
+  serialProtocol.send(SerialFrameType::SpeedTelemetry, payload, sizeof(payload));
 }
 
-// Monitor the pickup sensor. If this sensor detects that the tonearm is traveling over the end deadwax of a record, it
+// This is called by the tonearmController over and over while the tonearm is moving, so the platter speed is still
+// regulated during long movements. A fresh press of the pause button stops the current routine where it is;
+// monitorCommandButtons() then handles the press like any other pause, whether or not the button is still held.
+void monitorDuringMovement() {
+  speedMonitor.update();
+  speedRegulator.update();
+  updateDisplay();
+  monitorSerial(true);
+
+  bool pauseButtonStatus = TurntableHal::readMuxInput(MultiplexerInput::PauseButton);
+
+  if(pauseButtonStatus && !lastPauseButtonStatus) {
+    pausePressPending = true;
+    cancelMovementInProgress();
+  }
+
+  lastPauseButtonStatus = pauseButtonStatus;
+}
+
+// Stop the routine or movement in progress where it is. A routine stops even if it is only waiting on the clutch or
+// for the platter, when nothing is moving. Returns false if there was nothing to stop.
+bool cancelMovementInProgress() {
+  bool cancelled = routineExecutor.cancel();
+
+  if(tonearmController.isMoving()) {
+    tonearmController.cancelMovement();
+    cancelled = true;
+  }
+
+  return cancelled;
+}
+
+// Monitor the pickup sensor. If the tonearm is traveling inward as fast as it does over the end deadwax of a record,
 // it will execute the homing routine. This will only occur if the auto/manual switch is set to Automatic.
 //
-// TODO: This method is not very accurate, and results in a lot of misfires (or no-fires). In the future, a smaller
-// sensor will need to be used, the interrupter's resolution will need to be increased, and an additional sensor will
-// need to be added so that we can determine the direction the tonearm is moving.
-//
-// Presently, no direction is being checked, so every sensor change is being taken into account, which is problematic 
-// because no record's grooves will sit perfectly in the center of a turntable. There will ALWAYS be some degree of 
-// wobble, which can happen back and forth over the falling/rising edge of the sensor/interrupter.
+// The pickup encoder is decoded in both directions, and only sampled once per revolution, so the wobble of an
+// off-center record over an edge of the encoder no longer counts towards the end of the record.
 void monitorPickupSensor() {
-  if(!paused && mux.readDigitalValue(MultiplexerInput::AutoManualSwitch) == AutoManualSwitchPosition::Automatic) {
-    bool currPickupSensorStatus = digitalRead(ArduinoPin::PickupEncoderA);
-    unsigned long currMillisPickup = millis();
-
-    if(currPickupSensorStatus != lastPickupSensorStatus) {
-
-      // The base values were found through trial on error, so this equation just translates the interval to whatever speed the
-      // turntable is currently spinning at.
-      double pickupInterval = (TONEARM_PICKUP_BASE_INTERVAL - (TONEARM_PICKUP_BASE_INTERVAL * currSpeed / TONEARM_PICKUP_BASE_SPEED)) + TONEARM_PICKUP_BASE_INTERVAL;
-
-      // Add to the consecutivePickupSensorChanges if we are within the pickup interval and debounce range. Otherwise, reset to 0.
-      if((currMillisPickup - lastMillisPickup) > TONEARM_PICKUP_DEBOUNCE_MS && (currMillisPickup - lastMillisPickup) < pickupInterval) {
-        consecutivePickupSensorChanges++;
-      }
-      else {
-        consecutivePickupSensorChanges = 0;
-      }
-
-      lastMillisPickup = currMillisPickup;
-      lastPickupSensorStatus = currPickupSensorStatus;
-    }
+  if(paused || TurntableHal::readMuxInput(MultiplexerInput::AutoManualSwitch) != AutoManualSwitchPosition::Automatic) {
+    leadOutDetector.reset();
+    return;
+  }
 
-    // After x consecutive sensor status changes between the debounce and pickup interval, run the homing routine.
-    if(consecutivePickupSensorChanges == TONEARM_PICKUP_CONSECUTIVE_SENSOR_CHANGES) {
-      MovementResult movementStatus = homeRoutine();
+  if(leadOutDetector.update()) {
+    EventTrace::record(TraceEventType::LeadOutDetected, 0, leadOutDetector.getLastInwardTravel());
 
-      // If the movement was anything other than success/none, then it failed, and we must set the error state.
-      if(movementStatus != MovementResult::Success && movementStatus != MovementResult::None) {
-        setErrorState(movementStatus);
-      }
+    // With repeat on, the record starts over instead of the tonearm going home.
+    MovementResult movementStatus = TurntableHal::readPin<ArduinoPin::RepeatAfterAutoReturn>() ? repeatRoutine() : homeRoutine();
 
-      consecutivePickupSensorChanges = 0;
+    // If the movement was anything other than success/none/cancelled, then it failed, and we must set the error state.
+    if(movementStatus != MovementResult::Success && movementStatus != MovementResult::None && movementStatus != MovementResult::Cancelled) {
+      setErrorState(movementStatus);
     }
+
+    leadOutDetector.reset();
   }
 }
 
-// Move the tonearm clockwise to the play sensor
+// Move the tonearm from home to the start of the record.
 // This is a multi-movement routine, meaning that multiple tonearm movements are executed. If one of those movements fails, the
-// whole routine is aborted.
+// whole routine is aborted. The platter starts right away, so it spins up while the tonearm is lowered at home (if it isn't
+// already), bumps into the record edge on its way clockwise, and is lifted over the lead-in groove. The tonearm is then
+// lowered to just above the record while the clutch disengages, held there until the platter is stable, and set down
+// carefully.
 MovementResult playRoutine() {
-  digitalWrite(ArduinoPin::MovementStatusLed, HIGH);
-  digitalWrite(ArduinoPin::PauseStatusLed, LOW);
+  static const RoutineStage stages[] = {
+    /* 0 */ { RoutineStageAction::MoveDown, MOVEMENT_RPM_DEFAULT, 0, 0, NULL, NULL },
+    /* 1 */ { RoutineStageAction::EngageClutch, 0, 0, 0, NULL, NULL },
+    /* 2 */ { RoutineStageAction::SeekRecordEdge, 0, 0, ROUTINE_STAGE(0) | ROUTINE_STAGE(1), NULL, NULL },
+    /* 3 */ { RoutineStageAction::MoveUp, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(2), NULL, NULL },
+    /* 4 */ { RoutineStageAction::MoveToLeadInAndHover, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(3), NULL, NULL },
+    /* 5 */ { RoutineStageAction::WaitUntil, 0, 0, 0, NULL, isPlatterReadyForSetDown },
+    /* 6 */ { RoutineStageAction::DisengageClutch, 0, 0, ROUTINE_STAGE(4), NULL, NULL },
+    /* 7 */ { RoutineStageAction::MoveDownCarefully, MOVEMENT_RPM_DEFAULT, MOVEMENT_RPM_CAREFUL, ROUTINE_STAGE(4) | ROUTINE_STAGE(5), NULL, NULL }
+  };
+
+  TurntableHal::setMovementStatusLed(HIGH);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
   paused = false;
 
-  MovementResult result = MovementResult::None;
+  startTurntableMotor();
 
-  // TODO: Rewrite this using the new play routine.
+  MovementResult result = routineExecutor.run(stages, sizeof(stages) / sizeof(stages[0]));
+  playRoutineMs = routineExecutor.getLastRunMs();
+
+  if(result != MovementResult::Success) return result;
+
+  learnRecordEdge();
+
+  TurntableHal::setMovementStatusLed(LOW);
+
+  return result;
+}
+
+// Move the tonearm from the end of the record back to the start of it, without going home. The platter keeps spinning,
+// and the tonearm turns around at the play sensor, so the home mount is never bumped. Until the play routine has found a
+// record edge, there is nowhere to return to, so this homes and plays instead.
+MovementResult repeatRoutine() {
+  static const RoutineStage stages[] = {
+    /* 0 */ { RoutineStageAction::MoveUp, MOVEMENT_RPM_DEFAULT, 0, 0, NULL, NULL },
+    /* 1 */ { RoutineStageAction::EngageClutch, 0, 0, 0, NULL, NULL },
+    /* 2 */ { RoutineStageAction::ReturnToRecordEdge, 0, 0, ROUTINE_STAGE(0) | ROUTINE_STAGE(1), NULL, NULL },
+    /* 3 */ { RoutineStageAction::DisengageClutch, 0, 0, ROUTINE_STAGE(2), NULL, NULL },
+    /* 4 */ { RoutineStageAction::MoveDownCarefully, MOVEMENT_RPM_DEFAULT, MOVEMENT_RPM_CAREFUL, ROUTINE_STAGE(2), NULL, NULL }
+  };
+
+  unsigned long startMillis = TurntableHal::currentMillis();
+  MovementResult result;
+
+  if(recordSize == RecordSize::UnknownRecordSize) {
+    result = homeRoutine();
+    if(result == MovementResult::Success) result = playRoutine();
+  }
+  else {
+    TurntableHal::setMovementStatusLed(HIGH);
+    TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
+    paused = false;
+
+    // It is the same record, so the tonearm goes back to where the play routine found its edge.
+    tonearmController.setRecordEdgeSteps(tonearmController.getMeasuredRecordEdgeSteps());
+    result = routineExecutor.run(stages, sizeof(stages) / sizeof(stages[0]));
+
+    if(result == MovementResult::Success) TurntableHal::setMovementStatusLed(LOW);
+  }
+
+  repeatRoutineMs = TurntableHal::currentMillis() - startMillis;
 
-  digitalWrite(ArduinoPin::MovementStatusLed, LOW);
-  
   return result;
 }
 
+// Work out the record size from where the play routine found the record edge: it is whichever size's record edge steps
+// are closest. Those steps are then moved part of the way towards the measurement, so they follow the records that are
+// played without one bad measurement throwing them off. A measurement inside the deadband, or one that would move them
+// less than a step, leaves them alone.
+void learnRecordEdge() {
+  uint16_t measuredSteps = tonearmController.getMeasuredRecordEdgeSteps();
+  uint16_t closestDistance = 0xFFFF;
+
+  for(uint8_t size = RecordSize::SevenInch; size <= RecordSize::TwelveInch; size++) {
+    uint16_t steps = calibrationStore.get((CalibrationValue)(CalibrationValue::RecordEdgeSteps7Inch + size));
+    uint16_t distance = steps > measuredSteps ? steps - measuredSteps : measuredSteps - steps;
+
+    if(distance < closestDistance) {
+      closestDistance = distance;
+      recordSize = (RecordSize)size;
+    }
+  }
+
+  CalibrationValue value = (CalibrationValue)(CalibrationValue::RecordEdgeSteps7Inch + recordSize);
+  int16_t difference = (int16_t)measuredSteps - (int16_t)calibrationStore.get(value);
+  int16_t correction = difference / RECORD_EDGE_LEARNING_DIVISOR;
+
+  if(correction == 0 || abs(difference) <= RECORD_EDGE_LEARNING_DEADBAND_STEPS) return;
+
+  calibrationStore.adjust(value, correction);
+}
+
 // Move the tonearm counterclockwise to the home sensor.
 // This is a multi-movement routine, meaning that multiple tonearm movements are executed. If one of those movements fails, the
-// whole routine is aborted.
+// whole routine is aborted. The clutch is engaged while the tonearm is lifted, and disengaged while it is lowered. The
+// tonearm starts moving home as soon as the stylus is clear of the record, while it is still being lifted.
 MovementResult homeRoutine() {
-  digitalWrite(ArduinoPin::MovementStatusLed, HIGH);
-  digitalWrite(ArduinoPin::PauseStatusLed, LOW);
+  static const RoutineStage stages[] = {
+    /* 0 */ { RoutineStageAction::EngageClutch, 0, 0, 0, NULL, NULL },
+    /* 1 */ { RoutineStageAction::LiftAndHome, MOVEMENT_RPM_DEFAULT, 0, 0, NULL, NULL },
+    /* 2 */ { RoutineStageAction::Call, 0, 0, ROUTINE_STAGE(1), stopTurntableMotor, NULL },
+    /* 3 */ { RoutineStageAction::DisengageClutch, 0, 0, ROUTINE_STAGE(1), NULL, NULL },
+    /* 4 */ { RoutineStageAction::MoveDown, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(1), NULL, NULL }
+  };
+
+  TurntableHal::setMovementStatusLed(HIGH);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
   paused = false;
 
-  MovementResult result = MovementResult::None;
+  MovementResult result = routineExecutor.run(stages, sizeof(stages) / sizeof(stages[0]));
+  homeRoutineMs = routineExecutor.getLastRunMs();
 
-  result = tonearmController.moveUp(MOVEMENT_RPM_DEFAULT);
   if(result != MovementResult::Success) return result;
 
-  // TODO: Shut turntable motor off here
+  TurntableHal::setMovementStatusLed(LOW);
 
-  result = tonearmController.horizontalHome();
-  if(result != MovementResult::Success) return result;
+  return result;
+}
 
-  result = tonearmController.moveDown(MOVEMENT_RPM_DEFAULT);
-  if(result != MovementResult::Success) return result;
+// Once the tonearm is lifted off the record, the platter can stop.
+void stopTurntableMotor() {
+  speedRegulator.stop();
+}
 
-  digitalWrite(ArduinoPin::MovementStatusLed, LOW);
+// Start the platter, unless it's already spinning, in which case it is left alone so it stays stable.
+void startTurntableMotor() {
+  if(speedRegulator.isRunning()) return;
 
-  return result;
+  speedRegulator.start();
+  turntableMotorStartMillis = TurntableHal::currentMillis();
+}
+
+// Whether the tonearm can be set down on the record. If the WaitUntilTargetSpeed switch is on, this waits for the platter
+// to be stable, but gives up after SPEED_STABLE_TIMEOUT_MS so a platter that can't hold its speed doesn't hang the routine.
+bool isPlatterReadyForSetDown() {
+  if(!TurntableHal::readMuxInput(MultiplexerInput::WaitUntilTargetSpeed)) return true;
+
+  return speedRegulator.isStable() || (TurntableHal::currentMillis() - turntableMotorStartMillis) >= SPEED_STABLE_TIMEOUT_MS;
 }
 
 // This is the pause routine that will lift up the tonearm from the record until the user "unpauses" by pressing the
 // pause button again
 MovementResult pauseOrUnpause() {
-  digitalWrite(ArduinoPin::MovementStatusLed, LOW);
-  digitalWrite(ArduinoPin::PauseStatusLed, HIGH);
+  TurntableHal::setMovementStatusLed(LOW);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(HIGH);
   paused = true;
 
   MovementResult result = MovementResult::None;
 
   // If the vertical lower limit is pressed (i.e., the tonearm is vertically homed), then move it up
-  if(mux.readDigitalValue(MultiplexerInput::VerticalLowerLimit)) {
+  if(TurntableHal::readMuxInput(MultiplexerInput::VerticalLowerLimit)) {
     result = tonearmController.moveUp(MOVEMENT_RPM_DEFAULT);
   }
 
   // Otherwise, just move it down and then shut off the LED
   else {
-    uint8_t tonearmSetRpm = 0;
-
     // If the tonearm is hovering over home position, then just go down at default speed
-    if(!digitalRead(ArduinoPin::HorizontalHomeOrPlayOpticalSensor)) {
-      tonearmSetRpm = MOVEMENT_RPM_DEFAULT;
+    if(!TurntableHal::readPin<ArduinoPin::HorizontalHomeOrPlayOpticalSensor>()) {
+      result = tonearmController.moveDown(MOVEMENT_RPM_DEFAULT);
     }
 
-    // Otherwise, set it down carefully
-    else tonearmSetRpm = MOVEMENT_RPM_CAREFUL;
+    // Otherwise, set it down carefully. Only the last part of the descent, just above the record, is slow.
+    else result = tonearmController.moveDownCarefully(MOVEMENT_RPM_DEFAULT, MOVEMENT_RPM_CAREFUL);
 
-    result = tonearmController.moveDown(tonearmSetRpm);
-
-    digitalWrite(ArduinoPin::PauseStatusLed, LOW);
+    TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
     paused = false;
   }
 
   return result;
 }
 
-// Each time the interrupt calls this function, the current milliseconds are polled, and compared against the last polling
-// to calculate the speed the turntable is spinning on each rotation. This calculation is always occurring, even if the speed
-// is not being displayed.
-// This is attached to an interrupt because it is a time-sensitive operation, and having to wait for other code to finish executing
-// would cause this to return inaccurate values.
-void calculateTurntableSpeed() {
-  currMillisSpeed = millis();
-  currSpeed = 60000 / (double)(currMillisSpeed - lastMillisSpeed);
-  lastMillisSpeed = currMillisSpeed;
+// Each time the speed sensor is tripped, the interrupt passes the exact time of the pulse to the speed monitor, and the
+// tonearm position is sampled for the lead-out detector. All of the math is done later from the main loop, so the
+// interrupt stays as short as possible. This is always occurring, even if the speed is not being displayed.
+void calculateTurntableSpeed(unsigned long timestampMicros) {
+  speedMonitor.recordPulse(timestampMicros);
+  leadOutDetector.recordRevolution();
+  sensorCapture.recordEdge(SENSOR_CAPTURE_SPEED_EDGE, timestampMicros);
+  EventLoop::post(LoopEvent::SpeedPulseEvent);
+}
+
+// Each time either pickup encoder channel changes, the interrupt passes the state of both channels to be decoded.
+void decodePickupEncoder(uint8_t state) {
+  pickupEncoder.onStateChange(state);
+  EventTrace::record(TraceEventType::PickupEdge, state, pickupEncoder.getPosition());
+  sensorCapture.recordEdge(state, TurntableHal::currentMicros());
+  EventLoop::post(LoopEvent::PickupEdgeEvent);
 }
 
 // This stops all movement and sets the turntable in an error state to prevent damage.
 // This will be called if a motor stall has been detected.
 // TODO: Re-implement error codes with LED flashes just like in the earliest revisions...
 void setErrorState(MovementResult movementResult) {
-  digitalWrite(ArduinoPin::PauseStatusLed, HIGH);
-  digitalWrite(ArduinoPin::MovementStatusLed, HIGH);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(HIGH);
+  TurntableHal::setMovementStatusLed(HIGH);
+
+  // Keep the events that led up to the error, so they can be read out over the serial port.
+  EventTrace::record(TraceEventType::Error, movementResult, 0);
+  EventTrace::freeze();
+
+  // Wait for the user to press the Play/Home or Pause/Unpause buttons to break out of the error state. The serial port
+  // is still monitored, but it can't start any routines. The MCU sleeps between ticks.
+  while(!TurntableHal::readMuxInput(MultiplexerInput::PlayHomeButton) && !TurntableHal::readMuxInput(MultiplexerInput::PauseButton)) {
+    monitorSerial(true);
+    while(!(EventLoop::waitForEvents() & LoopEvent::TickEvent));
+  }
 
-  // Wait for the user to press the Play/Home or Pause/Unpause buttons to break out of the error state
-  while(!mux.readDigitalValue(MultiplexerInput::PlayHomeButton) && !mux.readDigitalValue(MultiplexerInput::PauseButton)) { delay(1); }
+  // A trace dump that is still in progress unfreezes the trace once it is done.
+  if(traceDumpIndex < 0) EventTrace::unfreeze();
 
   // Clear all statuses. Even though technically the next routine should execute right away, there's that 1/10000 chance that the user can
   // release the button quickly enough to break out of the error state, but not yet execute the next command
-  digitalWrite(ArduinoPin::PauseStatusLed, LOW);
-  digitalWrite(ArduinoPin::MovementStatusLed, LOW);
+  TurntableHal::writePin<ArduinoPin::PauseStatusLed>(LOW);
+  TurntableHal::setMovementStatusLed(LOW);
   paused = false;
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "CalibrationStore.h"
+#include "TurntableHal.h"
+#include "Crc8.h"
+
+CalibrationStore::CalibrationStore(uint16_t eepromAddress) {
+    this->eepromAddress = eepromAddress;
+
+    this->current.sequence = 0;
+    for(uint8_t i = 0; i < CALIBRATION_VALUE_COUNT; i++) this->current.values[i] = 0;
+    this->current.crc = 0;
+    this->current.committed = CALIBRATION_STORE_COMMITTED;
+    this->currentSlot = CALIBRATION_STORE_SLOTS - 1;
+
+    this->dirty = false;
+    this->lastChangeMillis = 0;
+    this->saveDelayMs = 0;
+    this->saveCount = 0;
+}
+
+void CalibrationStore::begin(const uint16_t defaults[CALIBRATION_VALUE_COUNT]) {
+  bool found = false;
+  CalibrationRecord record;
+
+  for(uint8_t slot = 0; slot < CALIBRATION_STORE_SLOTS; slot++) {
+    if(!this->readRecord(slot, record)) continue;
+
+    // The sequence wraps around, so the newer record is the one less than half the range ahead.
+    if(!found || (int16_t)(record.sequence - this->current.sequence) > 0) {
+      this->current = record;
+      this->currentSlot = slot;
+      found = true;
+    }
+  }
+
+  // Nothing was ever saved (or every record is corrupt), so start from the defaults. They aren't saved until
+  // something is changed.
+  if(!found) {
+    for(uint8_t i = 0; i < CALIBRATION_VALUE_COUNT; i++) this->current.values[i] = defaults[i];
+  }
+
+  this->dirty = false;
+}
+
+uint16_t CalibrationStore::get(CalibrationValue value) {
+  return this->current.values[value];
+}
+
+void CalibrationStore::set(CalibrationValue value, uint16_t newValue) {
+  if(value >= CALIBRATION_VALUE_COUNT || this->current.values[value] == newValue) return;
+
+  this->current.values[value] = newValue;
+  this->dirty = true;
+  this->lastChangeMillis = TurntableHal::currentMillis();
+}
+
+void CalibrationStore::adjust(CalibrationValue value, int16_t amount) {
+  if(value >= CALIBRATION_VALUE_COUNT) return;
+
+  long newValue = (long)this->current.values[value] + amount;
+
+  if(newValue < 0) newValue = 0;
+  else if(newValue > 0xFFFF) newValue = 0xFFFF;
+
+  this->set(value, (uint16_t)newValue);
+}
+
+void CalibrationStore::update() {
+  if(this->dirty && (TurntableHal::currentMillis() - this->lastChangeMillis) >= this->saveDelayMs) {
+    this->save();
+  }
+}
+
+void CalibrationStore::flush() {
+  if(this->dirty) this->save();
+}
+
+bool CalibrationStore::hasUnsavedChanges() {
+  return this->dirty;
+}
+
+uint16_t CalibrationStore::getSaveCount() {
+  return this->saveCount;
+}
+
+void CalibrationStore::setSaveDelayMs(uint16_t ms) {
+  this->saveDelayMs = ms;
+}
+
+bool CalibrationStore::readRecord(uint8_t slot, CalibrationRecord& record) {
+  uint16_t address = this->eepromAddress + (uint16_t)slot * sizeof(CalibrationRecord);
+  uint8_t* bytes = (uint8_t*)&record;
+
+  for(uint8_t i = 0; i < sizeof(CalibrationRecord); i++) {
+    bytes[i] = TurntableHal::readEeprom(address + i);
+  }
+
+  return record.committed == CALIBRATION_STORE_COMMITTED && record.crc == calculateCrc(record);
+}
+
+void CalibrationStore::save() {
+  this->current.sequence++;
+  this->current.crc = calculateCrc(this->current);
+  this->currentSlot = (this->currentSlot + 1) % CALIBRATION_STORE_SLOTS;
+
+  uint16_t address = this->eepromAddress + (uint16_t)this->currentSlot * sizeof(CalibrationRecord);
+  const uint8_t* bytes = (const uint8_t*)&this->current;
+
+  // Nothing in the slot can be trusted again until the commit byte is written back, after everything else.
+  TurntableHal::writeEeprom(address + offsetof(CalibrationRecord, committed), 0);
+
+  for(uint8_t i = 0; i < offsetof(CalibrationRecord, committed); i++) {
+    TurntableHal::writeEeprom(address + i, bytes[i]);
+  }
+
+  TurntableHal::writeEeprom(address + offsetof(CalibrationRecord, committed), CALIBRATION_STORE_COMMITTED);
+
+  this->dirty = false;
+  this->saveCount++;
+}
+
+uint8_t CalibrationStore::calculateCrc(const CalibrationRecord& record) {
+  const uint8_t* bytes = (const uint8_t*)&record;
+  uint8_t crc = CALIBRATION_STORE_VERSION;
+
+  for(uint8_t i = 0; i < offsetof(CalibrationRecord, crc); i++) {
+    crc = Crc8::update(crc, bytes[i]);
+  }
+
+  return crc;
+}
@@ -0,0 +1,97 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "enums/CalibrationValue.h"
+
+#ifndef CalibrationStore_h
+#define CalibrationStore_h
+
+// The number of slots that records rotate through. Each save goes to the next slot, which spreads the wear across
+// all of them.
+#define CALIBRATION_STORE_SLOTS 8
+
+// Bumped whenever the layout of a record changes, so that records saved by older firmware are ignored.
+#define CALIBRATION_STORE_VERSION 3
+
+// The value of a record's commit byte once the whole record has been written.
+#define CALIBRATION_STORE_COMMITTED 0x5A
+
+// One saved copy of every calibration value.
+struct CalibrationRecord {
+    // Counts up with each save, so the newest record can be found. It is compared with wraparound.
+    uint16_t sequence;
+
+    uint16_t values[CALIBRATION_VALUE_COUNT];
+
+    // CRC-8 of the sequence and values, seeded with the CALIBRATION_STORE_VERSION.
+    uint8_t crc;
+
+    // CALIBRATION_STORE_COMMITTED once the rest of the record has been written. It is cleared before a save starts.
+    uint8_t committed;
+};
+
+// Keeps the calibration values in the EEPROM, so they can be tuned without reflashing the firmware.
+//
+// Every save writes a complete record to the slot after the newest one. A save that is interrupted (i.e. by the power
+// being turned off) leaves a record without its commit byte, which is skipped, and the previous record is still intact
+// in its own slot. The CRC only has to catch records that were corrupted after they were written, since an 8-bit CRC
+// would let through one in every 256 half-written ones. Changes are held in memory until none have been made for the
+// save delay, so a burst of adjustments only costs a single write.
+class CalibrationStore {
+    public:
+
+        // Constructor
+        CalibrationStore(uint16_t eepromAddress);
+
+        // Load the newest valid record, scanning every slot once. If there is none, the given defaults are used.
+        void begin(const uint16_t defaults[CALIBRATION_VALUE_COUNT]);
+
+        // The current value.
+        uint16_t get(CalibrationValue value);
+
+        // Change a value. It is saved once no changes have been made for the save delay.
+        void set(CalibrationValue value, uint16_t newValue);
+
+        // Add to or subtract from a value, without going past 0 or 65535.
+        void adjust(CalibrationValue value, int16_t amount);
+
+        // Save the values if they have changed and the save delay has passed. Call this from the main loop.
+        void update();
+
+        // Save the values right away if they have changed.
+        void flush();
+
+        // Whether there are changes that haven't been saved yet.
+        bool hasUnsavedChanges();
+
+        // The number of records that have been written since the turntable was powered on.
+        uint16_t getSaveCount();
+
+        // Set how long, in milliseconds, after the last change the values are saved.
+        void setSaveDelayMs(uint16_t ms);
+
+    private:
+        // Read the record in the given slot. Returns false if it wasn't committed or its CRC doesn't match.
+        bool readRecord(uint8_t slot, CalibrationRecord& record);
+
+        // Write the current values to the next slot.
+        void save();
+
+        // The CRC of a record, not including its CRC byte.
+        static uint8_t calculateCrc(const CalibrationRecord& record);
+
+        // Where the first slot starts in the EEPROM.
+        uint16_t eepromAddress;
+
+        // The values in memory, and the slot and sequence that they were last saved to.
+        CalibrationRecord current;
+        uint8_t currentSlot;
+
+        bool dirty;
+        unsigned long lastChangeMillis;
+        uint16_t saveDelayMs;
+        uint16_t saveCount;
+};
+
+#endif
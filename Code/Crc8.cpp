@@ -0,0 +1,15 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "Crc8.h"
+
+uint8_t Crc8::update(uint8_t crc, uint8_t data) {
+  crc ^= data;
+
+  for(uint8_t bit = 0; bit < 8; bit++) {
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+
+  return crc;
+}
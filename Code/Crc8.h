@@ -0,0 +1,17 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef Crc8_h
+#define Crc8_h
+
+// CRC-8 with the polynomial 0x07, used to check frames on the serial port and records in the EEPROM.
+class Crc8 {
+    public:
+
+        // Add a byte to a running CRC.
+        static uint8_t update(uint8_t crc, uint8_t data);
+};
+
+#endif
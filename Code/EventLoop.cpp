@@ -0,0 +1,95 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "EventLoop.h"
+#include "TurntableHal.h"
+
+// The length of the window that the duty cycle is measured over.
+#define EVENT_LOOP_DUTY_WINDOW_MICROS 1000000UL
+
+static volatile uint8_t pendingEvents = 0;
+
+// When the oldest of the pending events was posted.
+static volatile unsigned long firstPostMicros = 0;
+
+static uint16_t lastLatencyMicros = 0;
+static uint16_t maxLatencyMicros = 0;
+static unsigned long wakeCount = 0;
+
+// Time spent asleep in the current duty cycle window, and the result of the last full window.
+static unsigned long dutyWindowStartMicros = 0;
+static unsigned long sleptMicros = 0;
+static uint16_t awakePermille = 1000;
+
+void EventLoop::begin() {
+  dutyWindowStartMicros = TurntableHal::currentMicros();
+  TurntableHal::beginTick(EventLoop::onTick);
+}
+
+void EventLoop::post(uint8_t events) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  if(pendingEvents == 0) firstPostMicros = TurntableHal::currentMicros();
+  pendingEvents |= events;
+
+  SREG = oldSREG;
+}
+
+uint8_t EventLoop::waitForEvents() {
+  // Interrupts that don't post anything (i.e. the millis() timer, or a received serial byte) wake the MCU, so it goes
+  // straight back to sleep after them.
+  while(pendingEvents == 0) {
+    unsigned long sleepStartMicros = TurntableHal::currentMicros();
+    TurntableHal::sleepUntilInterrupt(&pendingEvents);
+    sleptMicros += TurntableHal::currentMicros() - sleepStartMicros;
+  }
+
+  noInterrupts();
+  uint8_t events = pendingEvents;
+  unsigned long postMicros = firstPostMicros;
+  pendingEvents = 0;
+  interrupts();
+
+  unsigned long nowMicros = TurntableHal::currentMicros();
+  unsigned long latencyMicros = nowMicros - postMicros;
+
+  lastLatencyMicros = latencyMicros > 0xFFFF ? 0xFFFF : latencyMicros;
+  if(lastLatencyMicros > maxLatencyMicros) maxLatencyMicros = lastLatencyMicros;
+  wakeCount++;
+
+  unsigned long windowMicros = nowMicros - dutyWindowStartMicros;
+
+  if(windowMicros >= EVENT_LOOP_DUTY_WINDOW_MICROS) {
+    awakePermille = 1000 - (sleptMicros / (windowMicros / 1000));
+    sleptMicros = 0;
+    dutyWindowStartMicros = nowMicros;
+  }
+
+  return events;
+}
+
+uint16_t EventLoop::getAwakePermille() {
+  return awakePermille;
+}
+
+uint16_t EventLoop::getLastLatencyMicros() {
+  return lastLatencyMicros;
+}
+
+uint16_t EventLoop::getMaxLatencyMicros() {
+  return maxLatencyMicros;
+}
+
+void EventLoop::resetMaxLatency() {
+  maxLatencyMicros = 0;
+}
+
+unsigned long EventLoop::getWakeCount() {
+  return wakeCount;
+}
+
+void EventLoop::onTick() {
+  EventLoop::post(LoopEvent::TickEvent);
+}
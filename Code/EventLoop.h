@@ -0,0 +1,45 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "enums/LoopEvent.h"
+
+#ifndef EventLoop_h
+#define EventLoop_h
+
+// Lets the main loop sleep until there is something for it to do. Interrupts post LoopEvents, a periodic tick posts
+// the TickEvent, and the MCU idles in between. Any interrupt wakes the MCU, but the loop only goes back to work once an
+// event has been posted.
+//
+// It also measures itself: the wake-to-action latency (how long the oldest waiting event was posted before the loop
+// picked it up), and the duty cycle (how much of each second the MCU spent awake).
+class EventLoop {
+    public:
+
+        // Start the periodic tick.
+        static void begin();
+
+        // Post one or more LoopEvents. This may be called from an interrupt.
+        static void post(uint8_t events);
+
+        // Sleep until at least one event has been posted, then return every posted event, clearing them.
+        static uint8_t waitForEvents();
+
+        // How much of the last full second the MCU spent awake, in tenths of a percent.
+        static uint16_t getAwakePermille();
+
+        // The wake-to-action latency of the last waitForEvents(), and the highest since the last resetMaxLatency(), in
+        // microseconds.
+        static uint16_t getLastLatencyMicros();
+        static uint16_t getMaxLatencyMicros();
+        static void resetMaxLatency();
+
+        // The number of times the loop has been woken with an event since the turntable was powered on.
+        static unsigned long getWakeCount();
+
+    private:
+        // Called by the tick interrupt.
+        static void onTick();
+};
+
+#endif
@@ -0,0 +1,85 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "EventTrace.h"
+#include "TurntableHal.h"
+
+static TraceEvent events[EVENT_TRACE_SIZE];
+static volatile uint8_t eventHead = 0;
+static volatile uint8_t eventCount = 0;
+static volatile bool frozen = false;
+
+static uint16_t loopTimeCounts[EVENT_TRACE_LOOP_TIME_BUCKETS];
+
+void EventTrace::record(TraceEventType type, uint8_t detail, uint16_t value) {
+  if(frozen) return;
+
+  unsigned long timestampMicros = TurntableHal::currentMicros();
+
+  // Events are recorded from interrupts too, so the slot has to be claimed and filled without being interrupted.
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  TraceEvent& event = events[eventHead];
+  event.timestampMicros = timestampMicros;
+  event.type = type;
+  event.detail = detail;
+  event.value = value;
+
+  eventHead = (eventHead + 1) & (EVENT_TRACE_SIZE - 1);
+  if(eventCount < EVENT_TRACE_SIZE) eventCount++;
+
+  SREG = oldSREG;
+}
+
+void EventTrace::recordLoopTime(unsigned long loopMicros) {
+  if(frozen) return;
+
+  // Each bucket is twice as wide as the one before it, so the bucket is found by shifting rather than dividing.
+  uint8_t bucket = 0;
+  loopMicros >>= 7;
+
+  while(loopMicros > 0 && bucket < EVENT_TRACE_LOOP_TIME_BUCKETS - 1) {
+    loopMicros >>= 1;
+    bucket++;
+  }
+
+  if(loopTimeCounts[bucket] < 0xFFFF) loopTimeCounts[bucket]++;
+}
+
+uint8_t EventTrace::getEventCount() {
+  return eventCount;
+}
+
+TraceEvent EventTrace::getEvent(uint8_t index) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  TraceEvent event = events[(eventHead - eventCount + index) & (EVENT_TRACE_SIZE - 1)];
+
+  SREG = oldSREG;
+
+  return event;
+}
+
+uint16_t EventTrace::getLoopTimeCount(uint8_t bucket) {
+  return loopTimeCounts[bucket];
+}
+
+void EventTrace::freeze() {
+  frozen = true;
+}
+
+void EventTrace::unfreeze() {
+  frozen = false;
+}
+
+void EventTrace::clear() {
+  noInterrupts();
+  eventHead = 0;
+  eventCount = 0;
+  interrupts();
+
+  for(uint8_t i = 0; i < EVENT_TRACE_LOOP_TIME_BUCKETS; i++) loopTimeCounts[i] = 0;
+}
@@ -0,0 +1,60 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "enums/TraceEventType.h"
+
+#ifndef EventTrace_h
+#define EventTrace_h
+
+// The number of events kept. Once full, each new event replaces the oldest one. Must be a power of 2.
+#define EVENT_TRACE_SIZE 64
+
+// The number of buckets in the loop time histogram. Bucket 0 counts loops under 128us, and each bucket after that
+// doubles, up to the last bucket, which counts everything from 8ms up.
+#define EVENT_TRACE_LOOP_TIME_BUCKETS 8
+
+// A single recorded event (8 bytes).
+struct TraceEvent {
+    // When the event happened, in microseconds.
+    unsigned long timestampMicros;
+
+    // See TraceEventType.
+    uint8_t type;
+
+    // What the detail and value mean depends on the type.
+    uint8_t detail;
+    uint16_t value;
+};
+
+// A fixed-size ring buffer of the most recent events, so that there is a record of what led up to an error. Nothing
+// is allocated, and recording an event is only a timestamp and a few stores, so it can be done from interrupts and
+// from the middle of a movement. The trace can be frozen, i.e. while it is being read out or after an error, so that
+// new events don't replace the ones that matter.
+class EventTrace {
+    public:
+
+        // Record an event. This may be called from an interrupt.
+        static void record(TraceEventType type, uint8_t detail, uint16_t value);
+
+        // Count one main loop iteration that took the given number of microseconds in the loop time histogram.
+        static void recordLoopTime(unsigned long loopMicros);
+
+        // The number of events currently held.
+        static uint8_t getEventCount();
+
+        // The event at the given index, where 0 is the oldest event held.
+        static TraceEvent getEvent(uint8_t index);
+
+        // The number of loop iterations counted in the given histogram bucket.
+        static uint16_t getLoopTimeCount(uint8_t bucket);
+
+        // Stop recording new events until unfreeze() is called.
+        static void freeze();
+        static void unfreeze();
+
+        // Forget every event and reset the loop time histogram.
+        static void clear();
+};
+
+#endif
@@ -0,0 +1,53 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef FastPin_h
+#define FastPin_h
+
+// The number of digital pins on the Arduino Nano Every, including the analog pins A0 to A7.
+#define FAST_PIN_COUNT 22
+
+// The port of each Arduino Nano Every pin (PORTA is 0, PORTB is 1, and so on), and its bit in that port. This is the
+// same mapping as the core's pins_arduino.h, but usable at compile time.
+constexpr uint8_t fastPinPorts[FAST_PIN_COUNT] = {
+  2, 2, 0, 5, 2, 1, 5, 0, 4, 1, 1, 4, 4, 4, 3, 3, 3, 3, 5, 5, 3, 3
+};
+constexpr uint8_t fastPinBits[FAST_PIN_COUNT] = {
+  5, 4, 0, 5, 6, 2, 4, 1, 3, 0, 1, 0, 1, 2, 3, 2, 1, 0, 2, 3, 4, 5
+};
+
+// An Arduino pin that is known at compile time. Every access goes straight to the pin's VPORT register, which is in
+// the bottom of the I/O space, so reading, setting or clearing the pin is a single instruction, instead of the table
+// lookups that digitalRead() and digitalWrite() do every call.
+template<uint8_t pin>
+class FastPin {
+    static_assert(pin < FAST_PIN_COUNT, "Not a pin on the Arduino Nano Every");
+
+    public:
+
+        // Set the pin as an output, or an input.
+        static inline void setOutput() { port().DIR |= mask; }
+        static inline void setInput() { port().DIR &= ~mask; }
+
+        // Read the digital value of the pin.
+        static inline bool read() { return port().IN & mask; }
+
+        // Set the digital value of an output pin. Setting or clearing a single bit can't be interrupted halfway, so this
+        // is safe to use from interrupts on pins that share a port.
+        static inline void write(bool value) {
+          if(value) port().OUT |= mask;
+          else port().OUT &= ~mask;
+        }
+
+        // Invert an output pin. Writing a 1 to a bit of the IN register toggles that output.
+        static inline void toggle() { port().IN = mask; }
+
+    private:
+        static constexpr uint8_t mask = 1 << fastPinBits[pin];
+
+        static inline VPORT_t& port() { return (&VPORTA)[fastPinPorts[pin]]; }
+};
+
+#endif
@@ -0,0 +1,75 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "LeadOutDetector.h"
+
+LeadOutDetector::LeadOutDetector(QuadratureEncoder& pickupEncoder) : pickupEncoder(pickupEncoder) {
+    this->revolutionPosition = 0;
+    this->revolutionSequence = 0;
+
+    this->inwardDirection = 1;
+    this->leadOutTravelPerRevolution = 0;
+    this->consecutiveRevolutions = 0;
+
+    this->reset();
+}
+
+void LeadOutDetector::recordRevolution() {
+  this->revolutionPosition = this->pickupEncoder.getPosition();
+  this->revolutionSequence++;
+}
+
+bool LeadOutDetector::update() {
+  uint8_t revolutionSequence = this->revolutionSequence;
+  if(revolutionSequence == this->lastRevolutionSequence) return false;
+
+  noInterrupts();
+  long position = this->revolutionPosition;
+  interrupts();
+
+  // If more than one revolution was recorded since the last update, we only have the latest sample, so the travel
+  // is spread over every revolution that went by.
+  uint8_t revolutions = revolutionSequence - this->lastRevolutionSequence;
+  this->lastRevolutionSequence = revolutionSequence;
+
+  if(this->hasLastRevolution) {
+    this->lastInwardTravel = ((position - this->lastRevolutionPosition) * this->inwardDirection) / revolutions;
+
+    if(this->lastInwardTravel >= this->leadOutTravelPerRevolution) {
+      this->consecutiveLeadOutRevolutions += revolutions;
+    }
+    else {
+      this->consecutiveLeadOutRevolutions = 0;
+    }
+  }
+
+  this->lastRevolutionPosition = position;
+  this->hasLastRevolution = true;
+
+  return this->consecutiveLeadOutRevolutions >= this->consecutiveRevolutions;
+}
+
+void LeadOutDetector::reset() {
+  this->lastRevolutionSequence = this->revolutionSequence;
+  this->lastRevolutionPosition = 0;
+  this->hasLastRevolution = false;
+  this->lastInwardTravel = 0;
+  this->consecutiveLeadOutRevolutions = 0;
+}
+
+long LeadOutDetector::getLastInwardTravel() {
+  return this->lastInwardTravel;
+}
+
+void LeadOutDetector::setInwardDirection(int8_t direction) {
+  this->inwardDirection = direction;
+}
+
+void LeadOutDetector::setLeadOutTravelPerRevolution(uint8_t counts) {
+  this->leadOutTravelPerRevolution = counts;
+}
+
+void LeadOutDetector::setConsecutiveRevolutions(uint8_t revolutions) {
+  this->consecutiveRevolutions = revolutions;
+}
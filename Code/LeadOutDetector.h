@@ -0,0 +1,67 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "QuadratureEncoder.h"
+
+#ifndef LeadOutDetector_h
+#define LeadOutDetector_h
+
+// Detects when the stylus has reached the lead-out groove at the end of a record side.
+//
+// The tonearm position is sampled from the pickup encoder once per platter revolution, at the moment the speed sensor
+// is tripped. Sampling at the same point of every revolution cancels out the back-and-forth wobble of an off-center
+// record, which leaves only the inward travel of the tonearm per revolution. While playing, that is a fraction of a
+// millimeter; in the lead-out spiral it is several millimeters, so a few revolutions in a row at or above the lead-out
+// threshold mean the record is finished.
+class LeadOutDetector {
+    public:
+
+        // Constructor
+        LeadOutDetector(QuadratureEncoder& pickupEncoder);
+
+        // Sample the tonearm position for a revolution that just completed. This is meant to be called from the speed
+        // sensor interrupt, so the sample is taken at the same point of every revolution.
+        void recordRevolution();
+
+        // Process any revolutions recorded since the last call. Returns true once the lead-out groove is detected.
+        bool update();
+
+        // Forget all previous revolutions, i.e. after the tonearm has been moved by a routine.
+        void reset();
+
+        // The inward travel, in encoder counts, of the most recent revolution.
+        long getLastInwardTravel();
+
+        // Set which way the encoder counts (1 or -1) when the tonearm moves towards the center of the record.
+        void setInwardDirection(int8_t direction);
+
+        // Set the inward travel per revolution, in encoder counts, at or above which the stylus is in the lead-out groove.
+        void setLeadOutTravelPerRevolution(uint8_t counts);
+
+        // Set how many revolutions in a row must be at or above the lead-out travel before it is detected.
+        void setConsecutiveRevolutions(uint8_t revolutions);
+
+    private:
+        // Measures the tonearm position.
+        QuadratureEncoder& pickupEncoder;
+
+        // Written by recordRevolution().
+        volatile long revolutionPosition;
+        volatile uint8_t revolutionSequence;
+
+        // The revolution that update() last processed.
+        uint8_t lastRevolutionSequence;
+        long lastRevolutionPosition;
+        bool hasLastRevolution;
+
+        long lastInwardTravel;
+        uint8_t consecutiveLeadOutRevolutions;
+
+        // Calibration values.
+        int8_t inwardDirection;
+        uint8_t leadOutTravelPerRevolution;
+        uint8_t consecutiveRevolutions;
+};
+
+#endif
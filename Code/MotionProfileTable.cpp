@@ -0,0 +1,94 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include <avr/pgmspace.h>
+#include "MotionProfileTable.h"
+
+// The speed that every ramp starts from, as a fraction of the cruising speed (1/4, in 4.12 fixed point). Starting any
+// slower than this only wastes time, since the motor can start at this speed without missing steps.
+#define MOTION_PROFILE_START_SPEED 1024
+
+// One, in the 4.12 fixed point that the speeds are calculated in.
+#define MOTION_PROFILE_FULL_SPEED 4096
+
+// Integer square root, by binary search between low and high. Everything below is constexpr so that the tables are
+// calculated by the compiler, not the Arduino.
+static constexpr uint32_t squareRoot(uint32_t value, uint32_t low, uint32_t high) {
+  return low == high
+    ? low
+    : ((low + high + 1) / 2) * ((low + high + 1) / 2) <= value
+      ? squareRoot(value, (low + high + 1) / 2, high)
+      : squareRoot(value, low, (low + high + 1) / 2 - 1);
+}
+
+// The speed at the end of each entry of a ramp, as a fraction of the cruising speed (4.12 fixed point).
+static constexpr uint32_t rampPosition(uint8_t index) {
+  return ((uint32_t)index + 1) * MOTION_PROFILE_FULL_SPEED / MOTION_PROFILE_TABLE_LENGTH;
+}
+
+// Constant acceleration: the square of the speed grows in proportion to the distance travelled.
+static constexpr uint32_t trapezoidalSpeed(uint8_t index) {
+  return squareRoot(
+    (uint32_t)MOTION_PROFILE_START_SPEED * MOTION_PROFILE_START_SPEED
+      + ((uint32_t)MOTION_PROFILE_FULL_SPEED * MOTION_PROFILE_FULL_SPEED - (uint32_t)MOTION_PROFILE_START_SPEED * MOTION_PROFILE_START_SPEED)
+        / MOTION_PROFILE_FULL_SPEED * rampPosition(index),
+    0, MOTION_PROFILE_FULL_SPEED);
+}
+
+// Eased acceleration: the speed follows a smoothstep curve (3x^2 - 2x^3) from the start speed to the cruising speed.
+static constexpr uint32_t sCurveSpeed(uint8_t index) {
+  return MOTION_PROFILE_START_SPEED + (uint32_t)(
+    (uint64_t)(MOTION_PROFILE_FULL_SPEED - MOTION_PROFILE_START_SPEED)
+      * (3ULL * rampPosition(index) * rampPosition(index) * MOTION_PROFILE_FULL_SPEED
+        - 2ULL * rampPosition(index) * rampPosition(index) * rampPosition(index))
+    / ((uint64_t)MOTION_PROFILE_FULL_SPEED * MOTION_PROFILE_FULL_SPEED * MOTION_PROFILE_FULL_SPEED)
+  );
+}
+
+// The step interval is the inverse of the speed.
+static constexpr uint16_t intervalFactor(uint32_t speed) {
+  return (uint16_t)(((uint32_t)MOTION_PROFILE_CRUISE_FACTOR * MOTION_PROFILE_FULL_SPEED) / speed);
+}
+
+// C++11 has no std::index_sequence, so this expands to the list of table indices 0, 1, ... Length - 1.
+template<uint8_t... Indices> struct IndexList {};
+template<uint8_t Length, uint8_t... Indices> struct MakeIndexList : MakeIndexList<Length - 1, Length - 1, Indices...> {};
+template<uint8_t... Indices> struct MakeIndexList<0, Indices...> { typedef IndexList<Indices...> type; };
+
+template<typename List> struct RampTables;
+template<uint8_t... Indices> struct RampTables<IndexList<Indices...> > {
+  static const uint16_t trapezoidal[MOTION_PROFILE_TABLE_LENGTH];
+  static const uint16_t sCurve[MOTION_PROFILE_TABLE_LENGTH];
+};
+
+template<uint8_t... Indices>
+const uint16_t RampTables<IndexList<Indices...> >::trapezoidal[MOTION_PROFILE_TABLE_LENGTH] PROGMEM = { intervalFactor(trapezoidalSpeed(Indices))... };
+
+template<uint8_t... Indices>
+const uint16_t RampTables<IndexList<Indices...> >::sCurve[MOTION_PROFILE_TABLE_LENGTH] PROGMEM = { intervalFactor(sCurveSpeed(Indices))... };
+
+typedef RampTables<MakeIndexList<MOTION_PROFILE_TABLE_LENGTH>::type> Ramps;
+
+// The ramps have to end at the cruising speed, or every movement would jump in speed after speeding up.
+static_assert(intervalFactor(trapezoidalSpeed(MOTION_PROFILE_TABLE_LENGTH - 1)) == MOTION_PROFILE_CRUISE_FACTOR, "Trapezoidal ramp must end at cruising speed");
+static_assert(intervalFactor(sCurveSpeed(MOTION_PROFILE_TABLE_LENGTH - 1)) == MOTION_PROFILE_CRUISE_FACTOR, "S-curve ramp must end at cruising speed");
+
+uint16_t MotionProfileTable::getIntervalFactor(MotionProfile profile, uint8_t index) {
+  switch(profile) {
+    case MotionProfile::Trapezoidal:
+      return pgm_read_word(&Ramps::trapezoidal[index]);
+
+    case MotionProfile::SCurve:
+      return pgm_read_word(&Ramps::sCurve[index]);
+
+    default:
+      return MOTION_PROFILE_CRUISE_FACTOR;
+  }
+}
+
+uint16_t MotionProfileTable::scaleInterval(uint16_t cruiseIntervalTicks, uint16_t factor) {
+  unsigned long ticks = ((unsigned long)cruiseIntervalTicks * factor) >> 8;
+
+  return ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks;
+}
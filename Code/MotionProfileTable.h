@@ -0,0 +1,30 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "enums/MotionProfile.h"
+
+#ifndef MotionProfileTable_h
+#define MotionProfileTable_h
+
+// The number of entries in each motion profile table. However many steps a ramp is, it is spread across these entries.
+#define MOTION_PROFILE_TABLE_LENGTH 64
+
+// The step interval factor for the cruising speed of a movement, as an 8.8 fixed-point number (1.0).
+#define MOTION_PROFILE_CRUISE_FACTOR 256
+
+// Per-step interval factors for speeding up from a standstill to the cruising speed of a movement. The tables are
+// generated at compile time and stored in flash. Each entry is an 8.8 fixed-point multiple of the cruising step
+// interval, so the step interrupt only has to multiply and shift.
+class MotionProfileTable {
+    public:
+
+        // The step interval factor for the given entry of a ramp, where entry 0 is the first step from a standstill.
+        // The Constant profile always returns MOTION_PROFILE_CRUISE_FACTOR.
+        static uint16_t getIntervalFactor(MotionProfile profile, uint8_t index);
+
+        // Scale a cruising step interval by an interval factor, clamped to the slowest interval the step timer can do.
+        static uint16_t scaleInterval(uint16_t cruiseIntervalTicks, uint16_t factor);
+};
+
+#endif
@@ -0,0 +1,147 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "MultiplexerScanner.h"
+#include "TurntableHal.h"
+#include "EventTrace.h"
+#include "enums/ArduinoPin.h"
+
+// The order that the inputs are scanned in. Each input differs from the one before it by a single selector bit.
+static const uint8_t grayCodeOrder[MULTIPLEXER_INPUT_COUNT] = { 0, 1, 3, 2, 6, 7, 5, 4 };
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::MultiplexerScanner() {
+    this->selectedInput = 0;
+    this->snapshot = 0;
+    this->snapshotMicros = 0;
+    this->hasSnapshot = false;
+    this->scanCount = 0;
+
+    this->settleMicros = 0;
+    this->maxAgeMicros = 0;
+
+    this->debounceMask = 0;
+    this->debounceScans = 0;
+    for(uint8_t i = 0; i < MULTIPLEXER_INPUT_COUNT; i++) this->debounceCounts[i] = 0;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+void MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::begin() {
+  FastPin<outputPin>::setInput();
+
+  FastPin<selectorPinA>::setOutput();
+  FastPin<selectorPinB>::setOutput();
+  FastPin<selectorPinC>::setOutput();
+  TurntableHal::writePin<selectorPinA>(LOW);
+  TurntableHal::writePin<selectorPinB>(LOW);
+  TurntableHal::writePin<selectorPinC>(LOW);
+
+  this->selectedInput = 0;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+void MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::scan() {
+  uint8_t rawSnapshot = 0;
+
+  // Start from whichever input the selector pins already point at, so the first read needs no selector change at all.
+  uint8_t startPosition = 0;
+  while(grayCodeOrder[startPosition] != this->selectedInput) startPosition++;
+
+  for(uint8_t i = 0; i < MULTIPLEXER_INPUT_COUNT; i++) {
+    uint8_t input = grayCodeOrder[(startPosition + i) % MULTIPLEXER_INPUT_COUNT];
+
+    if(input != this->selectedInput) {
+      this->select(input);
+      TurntableHal::waitMicros(this->settleMicros);
+    }
+
+    if(TurntableHal::readPin<outputPin>()) rawSnapshot |= (1 << input);
+  }
+
+  // The first snapshot has nothing to debounce against, so it is taken as-is.
+  if(!this->hasSnapshot) {
+    this->snapshot = rawSnapshot;
+    this->hasSnapshot = true;
+  }
+  else {
+    uint8_t changed = (rawSnapshot ^ this->snapshot);
+    uint8_t newSnapshot = (this->snapshot & (~changed | this->debounceMask)) | (rawSnapshot & changed & ~this->debounceMask);
+
+    for(uint8_t input = 0; input < MULTIPLEXER_INPUT_COUNT; input++) {
+      uint8_t inputBit = (1 << input);
+      if(!(this->debounceMask & inputBit)) continue;
+
+      if(!(changed & inputBit)) {
+        this->debounceCounts[input] = 0;
+      }
+      else if(++this->debounceCounts[input] >= this->debounceScans) {
+        newSnapshot ^= inputBit;
+        this->debounceCounts[input] = 0;
+      }
+    }
+
+    if(newSnapshot != this->snapshot) {
+      EventTrace::record(TraceEventType::MuxChange, newSnapshot, newSnapshot ^ this->snapshot);
+    }
+
+    this->snapshot = newSnapshot;
+  }
+
+  this->snapshotMicros = TurntableHal::currentMicros();
+  this->scanCount++;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+bool MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::read(uint8_t input) {
+  if(!this->hasSnapshot || (TurntableHal::currentMicros() - this->snapshotMicros) > this->maxAgeMicros) {
+    this->scan();
+  }
+
+  return (this->snapshot >> input) & 1;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+uint8_t MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::getSnapshot() {
+  return this->snapshot;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+unsigned long MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::getSnapshotMicros() {
+  return this->snapshotMicros;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+unsigned long MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::getScanCount() {
+  return this->scanCount;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+void MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::setSettleMicros(uint16_t us) {
+  this->settleMicros = us;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+void MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::setMaxAgeMicros(uint16_t us) {
+  this->maxAgeMicros = us;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+void MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::setDebounce(uint8_t inputMask, uint8_t scans) {
+  this->debounceMask = inputMask;
+  this->debounceScans = scans;
+}
+
+template<uint8_t outputPin, uint8_t selectorPinA, uint8_t selectorPinB, uint8_t selectorPinC>
+void MultiplexerScanner<outputPin, selectorPinA, selectorPinB, selectorPinC>::select(uint8_t input) {
+  uint8_t changedBits = input ^ this->selectedInput;
+
+  if(changedBits & 0x1) TurntableHal::writePin<selectorPinA>(input & 0x1);
+  if(changedBits & 0x2) TurntableHal::writePin<selectorPinB>(input & 0x2);
+  if(changedBits & 0x4) TurntableHal::writePin<selectorPinC>(input & 0x4);
+
+  this->selectedInput = input;
+}
+
+// The turntable's multiplexer.
+template class MultiplexerScanner<ArduinoPin::MuxOutput, ArduinoPin::MuxSelectorA, ArduinoPin::MuxSelectorB, ArduinoPin::MuxSelectorC>;
@@ -0,0 +1,79 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef MultiplexerScanner_h
+#define MultiplexerScanner_h
+
+// The number of inputs on the 8-channel input multiplexer.
+#define MULTIPLEXER_INPUT_COUNT 8
+
+// Reads all eight multiplexer inputs in a single pass into a timestamped bitmask, and answers reads from that snapshot
+// until it is too old. The inputs are scanned in Gray code order, so only one selector pin changes between one input
+// and the next (including from the last input back around to the first).
+//
+// The pins are template parameters, so each selector write and output read is a single instruction. The scanner for
+// the turntable's own pins is instantiated in MultiplexerScanner.cpp.
+template<
+    uint8_t outputPin,    // arduino input pin
+    uint8_t selectorPinA, // arduino output pin, selector bit 0
+    uint8_t selectorPinB, // arduino output pin, selector bit 1
+    uint8_t selectorPinC  // arduino output pin, selector bit 2
+>
+class MultiplexerScanner {
+    public:
+
+        // Constructor
+        MultiplexerScanner();
+
+        // Set the selector pins as outputs. This must be called before the first scan.
+        void begin();
+
+        // Read every input into a new snapshot.
+        void scan();
+
+        // The value of the given input. If the snapshot is older than the max age, a new scan is taken first.
+        bool read(uint8_t input);
+
+        // Every input's value, one bit per input, from the latest snapshot (debounced inputs included).
+        uint8_t getSnapshot();
+
+        // The time, in microseconds, that the latest snapshot was taken.
+        unsigned long getSnapshotMicros();
+
+        // The number of scans taken since the turntable was powered on.
+        unsigned long getScanCount();
+
+        // Set how long, in microseconds, each input is given to settle after the selector pins change.
+        void setSettleMicros(uint16_t us);
+
+        // Set how old, in microseconds, a snapshot can be before read() takes a new one.
+        void setMaxAgeMicros(uint16_t us);
+
+        // Debounce the inputs in the given bitmask: their values only change once that many scans in a row agree on
+        // the new value. Inputs outside the mask always report the latest scan.
+        void setDebounce(uint8_t inputMask, uint8_t scans);
+
+    private:
+        // Change the selector pins to the given input, only writing the pins that actually changed.
+        void select(uint8_t input);
+
+        // The input that the selector pins currently point at.
+        uint8_t selectedInput;
+
+        uint8_t snapshot;
+        unsigned long snapshotMicros;
+        bool hasSnapshot;
+        unsigned long scanCount;
+
+        uint16_t settleMicros;
+        uint16_t maxAgeMicros;
+
+        // The number of scans in a row that each debounced input has disagreed with its reported value.
+        uint8_t debounceMask;
+        uint8_t debounceScans;
+        uint8_t debounceCounts[MULTIPLEXER_INPUT_COUNT];
+};
+
+#endif
@@ -0,0 +1,53 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "QuadratureEncoder.h"
+
+// The change in position for every (last state << 2) | new state. Transitions where both channels changed at once
+// are marked as 2, since there is no telling which way the encoder went.
+static const int8_t stateTransitions[16] = {
+   0, -1,  1,  2,
+   1,  0,  2, -1,
+  -1,  2,  0,  1,
+   2,  1, -1,  0
+};
+
+QuadratureEncoder::QuadratureEncoder() {
+    this->position = 0;
+    this->lastState = 0;
+    this->invalidTransitionCount = 0;
+}
+
+void QuadratureEncoder::begin(uint8_t state) {
+  this->lastState = state;
+}
+
+void QuadratureEncoder::onStateChange(uint8_t state) {
+  int8_t change = stateTransitions[(this->lastState << 2) | state];
+
+  if(change == 2) this->invalidTransitionCount++;
+  else this->position += change;
+
+  this->lastState = state;
+}
+
+long QuadratureEncoder::getPosition() {
+  // Restore the interrupt flag rather than blindly enabling interrupts, since this is also called from interrupts.
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  long currentPosition = this->position;
+  SREG = oldSREG;
+
+  return currentPosition;
+}
+
+void QuadratureEncoder::setPosition(long position) {
+  noInterrupts();
+  this->position = position;
+  interrupts();
+}
+
+uint16_t QuadratureEncoder::getInvalidTransitionCount() {
+  return this->invalidTransitionCount;
+}
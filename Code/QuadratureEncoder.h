@@ -0,0 +1,40 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef QuadratureEncoder_h
+#define QuadratureEncoder_h
+
+// Keeps a signed position count from the two channels of a quadrature encoder. Every edge of either channel is
+// decoded, so the count goes up or down depending on which way the encoder is turning, and back-and-forth movement
+// over a single edge cancels itself out.
+class QuadratureEncoder {
+    public:
+
+        // Constructor
+        QuadratureEncoder();
+
+        // Set the state that the first change is decoded from. Call this before the encoder interrupt is attached.
+        void begin(uint8_t state);
+
+        // Decode a change in the encoder state. The state is (channel A << 1) | channel B. This is the only method
+        // that may be called from the encoder interrupt.
+        void onStateChange(uint8_t state);
+
+        // The current position, in encoder counts. This may be called from an interrupt.
+        long getPosition();
+
+        // Set the position that the count continues from, i.e. zero when the tonearm is homed.
+        void setPosition(long position);
+
+        // The number of transitions that skipped a state (both channels changed at once), which means edges were missed.
+        uint16_t getInvalidTransitionCount();
+
+    private:
+        volatile long position;
+        volatile uint8_t lastState;
+        volatile uint16_t invalidTransitionCount;
+};
+
+#endif
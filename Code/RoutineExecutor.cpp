@@ -0,0 +1,202 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "RoutineExecutor.h"
+
+// Used in place of a stage index when no stage is using an actuator.
+#define NO_STAGE 0xFF
+
+RoutineExecutor::RoutineExecutor(TurntableTonearmController& tonearmController) : tonearmController(tonearmController) {
+    this->idleHandler = NULL;
+    this->running = false;
+    this->cancelRequested = false;
+    this->lastRunMs = 0;
+}
+
+MovementResult RoutineExecutor::run(const RoutineStage* stages, uint8_t stageCount) {
+  unsigned long startMillis = TurntableHal::currentMillis();
+
+  uint8_t allStages = (uint8_t)((1 << stageCount) - 1);
+  uint8_t startedStages = 0;
+  uint8_t finishedStages = 0;
+
+  // The stage currently using each actuator.
+  uint8_t stepperStage = NO_STAGE;
+  uint8_t clutchStage = NO_STAGE;
+  bool clutchEngaged = false;
+
+  // The WaitUntil stages whose conditions haven't come true yet.
+  uint8_t waitingStages = 0;
+
+  MovementResult result = MovementResult::None;
+
+  this->running = true;
+  this->cancelRequested = false;
+
+  while(result == MovementResult::None) {
+    this->tonearmController.pollClutch();
+
+    // A cancel has to stop the routine even when nothing is moving, i.e. while it waits on the clutch or a condition.
+    if(this->cancelRequested) {
+      result = MovementResult::Cancelled;
+      break;
+    }
+
+    if(clutchStage != NO_STAGE && !this->tonearmController.isClutchMoving()) {
+      finishedStages |= ROUTINE_STAGE(clutchStage);
+      clutchStage = NO_STAGE;
+    }
+
+    if(stepperStage != NO_STAGE) {
+      MovementResult stageResult = this->tonearmController.pollMovement();
+
+      if(stageResult != MovementResult::None) {
+        if(stages[stepperStage].action == RoutineStageAction::HorizontalHome || stages[stepperStage].action == RoutineStageAction::LiftAndHome) {
+          stageResult = this->tonearmController.finishHorizontalHome(stageResult);
+        }
+        else if(stages[stepperStage].action == RoutineStageAction::SeekRecordEdge) {
+          stageResult = this->tonearmController.finishSeekRecordEdge(stageResult);
+        }
+
+        if(stageResult == MovementResult::Success) finishedStages |= ROUTINE_STAGE(stepperStage);
+        else result = stageResult;
+
+        stepperStage = NO_STAGE;
+      }
+    }
+
+    for(uint8_t i = 0; i < stageCount && waitingStages != 0; i++) {
+      if((waitingStages & ROUTINE_STAGE(i)) && stages[i].condition()) {
+        waitingStages &= ~ROUTINE_STAGE(i);
+        finishedStages |= ROUTINE_STAGE(i);
+      }
+    }
+
+    // Start every stage whose dependencies are done and whose actuator is free.
+    bool stageStarted = false;
+
+    for(uint8_t i = 0; i < stageCount && result == MovementResult::None; i++) {
+      const RoutineStage& stage = stages[i];
+      bool usesClutch = stage.action == RoutineStageAction::EngageClutch || stage.action == RoutineStageAction::DisengageClutch;
+      bool usesStepper = !usesClutch && stage.action != RoutineStageAction::Call && stage.action != RoutineStageAction::WaitUntil;
+
+      if((startedStages & ROUTINE_STAGE(i)) || (finishedStages & stage.dependencies) != stage.dependencies) continue;
+      if((usesClutch && clutchStage != NO_STAGE) || (usesStepper && stepperStage != NO_STAGE)) continue;
+
+      MovementResult stageResult = this->startStage(stage);
+      startedStages |= ROUTINE_STAGE(i);
+      stageStarted = true;
+
+      if(stage.action == RoutineStageAction::EngageClutch) clutchEngaged = true;
+      else if(stage.action == RoutineStageAction::DisengageClutch) clutchEngaged = false;
+
+      if(stageResult == MovementResult::Success) finishedStages |= ROUTINE_STAGE(i);
+      else if(stageResult != MovementResult::None) result = stageResult;
+      else if(stage.action == RoutineStageAction::WaitUntil) waitingStages |= ROUTINE_STAGE(i);
+      else if(usesClutch) clutchStage = i;
+      else stepperStage = i;
+    }
+
+    if(result != MovementResult::None) break;
+
+    if(finishedStages == allStages) {
+      result = MovementResult::Success;
+      break;
+    }
+
+    // Nothing is running and nothing could start, so the remaining stages depend on something that never happens.
+    if(!stageStarted && stepperStage == NO_STAGE && clutchStage == NO_STAGE && waitingStages == 0) {
+      result = MovementResult::RoutineStalledError;
+      break;
+    }
+
+    if(this->idleHandler != NULL) this->idleHandler();
+  }
+
+  // Leave the tonearm where it is, but let the clutch finish whatever it was doing, and free it up again if the
+  // routine didn't get the chance to.
+  if(result != MovementResult::Success) {
+    this->tonearmController.cancelMovement();
+
+    if(clutchEngaged) this->tonearmController.setClutchPosition(HorizontalClutchPosition::Disengage);
+  }
+
+  while(this->tonearmController.isClutchMoving()) this->tonearmController.pollClutch();
+
+  this->running = false;
+  this->cancelRequested = false;
+  this->lastRunMs = TurntableHal::currentMillis() - startMillis;
+
+  return result;
+}
+
+MovementResult RoutineExecutor::startStage(const RoutineStage& stage) {
+  switch(stage.action) {
+    case RoutineStageAction::MoveUp:
+      return this->tonearmController.beginMoveUp(stage.speed) ? MovementResult::None : MovementResult::VerticalPositiveDirectionError;
+
+    case RoutineStageAction::MoveDown:
+      return this->tonearmController.beginMoveDown(stage.speed) ? MovementResult::None : MovementResult::VerticalNegativeDirectionError;
+
+    case RoutineStageAction::MoveDownCarefully:
+      return this->tonearmController.beginMoveDownCarefully(stage.speed, stage.carefulSpeed) ? MovementResult::None : MovementResult::VerticalNegativeDirectionError;
+
+    case RoutineStageAction::SeekRecordEdge:
+      return this->tonearmController.beginSeekRecordEdge();
+
+    case RoutineStageAction::HorizontalHome:
+      return this->tonearmController.beginHorizontalHome();
+
+    case RoutineStageAction::LiftAndHome:
+      return this->tonearmController.beginMoveUpAndHome(stage.speed);
+
+    case RoutineStageAction::MoveToLeadIn:
+      return this->tonearmController.beginMoveToLeadIn();
+
+    case RoutineStageAction::MoveToLeadInAndHover:
+      return this->tonearmController.beginMoveToLeadInAndHover(stage.speed);
+
+    case RoutineStageAction::ReturnToRecordEdge:
+      return this->tonearmController.beginReturnToRecordEdge();
+
+    case RoutineStageAction::EngageClutch:
+      this->tonearmController.beginClutchPosition(HorizontalClutchPosition::Engage);
+      return MovementResult::None;
+
+    case RoutineStageAction::DisengageClutch:
+      this->tonearmController.beginClutchPosition(HorizontalClutchPosition::Disengage);
+      return MovementResult::None;
+
+    case RoutineStageAction::Call:
+      if(stage.function != NULL) stage.function();
+      return MovementResult::Success;
+
+    case RoutineStageAction::WaitUntil:
+      return (stage.condition == NULL || stage.condition()) ? MovementResult::Success : MovementResult::None;
+
+    default:
+      return MovementResult::Success;
+  }
+}
+
+void RoutineExecutor::setIdleHandler(void (*handler)()) {
+  this->idleHandler = handler;
+}
+
+bool RoutineExecutor::cancel() {
+  if(!this->running) return false;
+
+  this->cancelRequested = true;
+  this->tonearmController.cancelMovement();
+
+  return true;
+}
+
+bool RoutineExecutor::isRunning() {
+  return this->running;
+}
+
+unsigned long RoutineExecutor::getLastRunMs() {
+  return this->lastRunMs;
+}
@@ -0,0 +1,87 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "TonearmMovementController.h"
+#include "enums/RoutineStageAction.h"
+#include "enums/MovementResult.h"
+
+#ifndef RoutineExecutor_h
+#define RoutineExecutor_h
+
+// The most stages that a single routine can have.
+#define ROUTINE_MAX_STAGES 8
+
+// The dependency bit for the stage at the given index of a routine.
+#define ROUTINE_STAGE(index) (1 << (index))
+
+// One stage of a routine.
+struct RoutineStage {
+    // What the stage does.
+    RoutineStageAction action;
+
+    // The speed, in RPM, of a movement stage. For MoveDownCarefully, this is the speed of the approach.
+    uint8_t speed;
+
+    // The speed, in RPM, of the last part of a MoveDownCarefully stage.
+    uint8_t carefulSpeed;
+
+    // The stages (as ROUTINE_STAGE bits) that must finish successfully before this one can start.
+    uint8_t dependencies;
+
+    // The function called by a Call stage.
+    void (*function)();
+
+    // The condition that a WaitUntil stage waits for. It is checked every time around the routine's loop.
+    bool (*condition)();
+};
+
+// Runs a routine, described as a list of stages and the stages each one depends on. Every stage starts as soon as its
+// dependencies have finished and the actuator it needs is free, so a clutch stage can run while the stepper is
+// moving the tonearm (i.e. engaging the clutch while lifting the tonearm). If any stage fails, the routine is aborted.
+class RoutineExecutor {
+    public:
+
+        // Constructor
+        RoutineExecutor(TurntableTonearmController& tonearmController);
+
+        // Run the routine, returning once every stage has finished, or as soon as one of them fails. If the routine gets
+        // stuck, with nothing running and none of the remaining stages able to start, it fails with
+        // MovementResult::RoutineStalledError. If the routine engaged the clutch and then failed, the clutch is
+        // disengaged so the tonearm can be moved by hand.
+        MovementResult run(const RoutineStage* stages, uint8_t stageCount);
+
+        // Set a function that is called repeatedly while the routine is running, i.e. to keep monitoring the command
+        // buttons. It may call cancel() to abort the routine.
+        void setIdleHandler(void (*handler)());
+
+        // Stop the routine that is running, from its idle handler. The tonearm is stopped where it is, and the routine
+        // returns MovementResult::Cancelled, even if it is only waiting on the clutch or a WaitUntil condition.
+        // Returns false if no routine is running.
+        bool cancel();
+
+        // Whether a routine is currently running.
+        bool isRunning();
+
+        // How long, in milliseconds, the last routine took from start to finish.
+        unsigned long getLastRunMs();
+
+    private:
+        // Start the given stage. Returns MovementResult::None if it started, Success if it already finished, or the
+        // error if it couldn't be started.
+        MovementResult startStage(const RoutineStage& stage);
+
+        // Moves the tonearm and the clutch.
+        TurntableTonearmController& tonearmController;
+
+        // Called repeatedly while a routine is running.
+        void (*idleHandler)();
+
+        // Whether a routine is running, and whether it has been asked to stop.
+        bool running;
+        bool cancelRequested;
+
+        unsigned long lastRunMs;
+};
+
+#endif
@@ -0,0 +1,76 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "SensorCapture.h"
+
+SensorCapture::SensorCapture() {
+    this->capturing = false;
+    this->edgeHead = 0;
+    this->edgeTail = 0;
+    this->droppedCount = 0;
+}
+
+void SensorCapture::start() {
+  noInterrupts();
+  this->edgeHead = 0;
+  this->edgeTail = 0;
+  this->droppedCount = 0;
+  this->capturing = true;
+  interrupts();
+}
+
+void SensorCapture::stop() {
+  this->capturing = false;
+}
+
+bool SensorCapture::isCapturing() {
+  return this->capturing;
+}
+
+// Both sensor interrupts record here, and either can interrupt the other's handler, so the slot is claimed with
+// interrupts held off.
+void SensorCapture::recordEdge(uint8_t source, unsigned long timestampMicros) {
+  if(!this->capturing) return;
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  uint8_t nextHead = (this->edgeHead + 1) & (SENSOR_CAPTURE_BUFFER_SIZE - 1);
+
+  if(nextHead == this->edgeTail) {
+    if(this->droppedCount < 0xFF) this->droppedCount++;
+  }
+  else {
+    this->edges[this->edgeHead].timestampMicros = timestampMicros;
+    this->edges[this->edgeHead].source = source;
+    this->edgeHead = nextHead;
+  }
+
+  SREG = oldSREG;
+}
+
+bool SensorCapture::read(SensorEdge& edge) {
+  if(this->edgeTail == this->edgeHead) return false;
+
+  noInterrupts();
+  edge = this->edges[this->edgeTail];
+  interrupts();
+
+  this->edgeTail = (this->edgeTail + 1) & (SENSOR_CAPTURE_BUFFER_SIZE - 1);
+
+  return true;
+}
+
+uint8_t SensorCapture::getWaitingCount() {
+  return (this->edgeHead - this->edgeTail) & (SENSOR_CAPTURE_BUFFER_SIZE - 1);
+}
+
+uint8_t SensorCapture::takeDroppedCount() {
+  noInterrupts();
+  uint8_t dropped = this->droppedCount;
+  this->droppedCount = 0;
+  interrupts();
+
+  return dropped;
+}
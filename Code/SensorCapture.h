@@ -0,0 +1,64 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef SensorCapture_h
+#define SensorCapture_h
+
+// The number of edges that can be waiting to be sent. Must be a power of 2.
+#define SENSOR_CAPTURE_BUFFER_SIZE 32
+
+// The source of a speed sensor edge. Anything below this is a pickup encoder edge, and is the new encoder state.
+#define SENSOR_CAPTURE_SPEED_EDGE 0x80
+
+// A single captured sensor edge.
+struct SensorEdge {
+    // When the edge happened, in microseconds.
+    unsigned long timestampMicros;
+
+    // SENSOR_CAPTURE_SPEED_EDGE, or the pickup encoder state, as (PickupEncoderA << 1) | PickupEncoderB.
+    uint8_t source;
+};
+
+// Records the raw edges of the pickup encoder and the speed sensor, with their timestamps, so that whole record sides
+// can be captured and the lead-out detection can be tuned against them later. The edges are recorded from the sensor
+// interrupts, and the main loop takes them out to be sent on. If the main loop falls behind, edges are dropped and
+// counted rather than blocking the interrupts.
+class SensorCapture {
+    public:
+
+        // Constructor
+        SensorCapture();
+
+        // Start capturing, from an empty buffer.
+        void start();
+
+        // Stop capturing. Edges already in the buffer can still be read.
+        void stop();
+
+        // Whether edges are being captured.
+        bool isCapturing();
+
+        // Record an edge. This is meant to be called from the sensor interrupts.
+        void recordEdge(uint8_t source, unsigned long timestampMicros);
+
+        // Take the oldest edge out of the buffer. Returns false if it is empty.
+        bool read(SensorEdge& edge);
+
+        // The number of edges waiting in the buffer.
+        uint8_t getWaitingCount();
+
+        // The number of edges dropped since the last call (up to 255), which resets the count.
+        uint8_t takeDroppedCount();
+
+    private:
+        volatile bool capturing;
+
+        SensorEdge edges[SENSOR_CAPTURE_BUFFER_SIZE];
+        volatile uint8_t edgeHead;
+        volatile uint8_t edgeTail;
+        volatile uint8_t droppedCount;
+};
+
+#endif
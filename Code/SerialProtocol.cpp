@@ -0,0 +1,123 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "SerialProtocol.h"
+#include "TurntableHal.h"
+#include "Crc8.h"
+
+SerialProtocol::SerialProtocol() {
+    this->receiveState = WaitingForSync;
+    this->receivingFrame.type = 0;
+    this->receivingFrame.length = 0;
+    this->payloadBytesReceived = 0;
+    this->receivingCrc = 0;
+
+    this->crcErrorCount = 0;
+    this->droppedFrameCount = 0;
+}
+
+void SerialProtocol::begin(unsigned long baud) {
+  TurntableHal::beginSerial(baud);
+}
+
+bool SerialProtocol::receive(SerialFrame& frame) {
+  int data;
+
+  while((data = TurntableHal::readSerial()) >= 0) {
+    switch(this->receiveState) {
+      case WaitingForSync:
+        if(data == SERIAL_FRAME_SYNC) this->receiveState = WaitingForLength;
+        break;
+
+      case WaitingForLength:
+        // A frame this long can't be ours, so this wasn't really a sync byte.
+        if(data > SERIAL_FRAME_MAX_PAYLOAD) {
+          this->receiveState = WaitingForSync;
+          break;
+        }
+
+        this->receivingFrame.length = data;
+        this->receivingCrc = Crc8::update(0, data);
+        this->receiveState = WaitingForType;
+        break;
+
+      case WaitingForType:
+        this->receivingFrame.type = data;
+        this->receivingCrc = Crc8::update(this->receivingCrc, data);
+        this->payloadBytesReceived = 0;
+        this->receiveState = this->receivingFrame.length > 0 ? WaitingForPayload : WaitingForCrc;
+        break;
+
+      case WaitingForPayload:
+        this->receivingFrame.payload[this->payloadBytesReceived++] = data;
+        this->receivingCrc = Crc8::update(this->receivingCrc, data);
+        if(this->payloadBytesReceived >= this->receivingFrame.length) this->receiveState = WaitingForCrc;
+        break;
+
+      case WaitingForCrc:
+        this->receiveState = WaitingForSync;
+
+        if(data != this->receivingCrc) {
+          this->crcErrorCount++;
+          break;
+        }
+
+        frame = this->receivingFrame;
+        return true;
+    }
+  }
+
+  return false;
+}
+
+bool SerialProtocol::canSend(uint8_t length) {
+  return length <= SERIAL_FRAME_MAX_PAYLOAD && TurntableHal::getSerialWriteSpace() >= length + SERIAL_FRAME_OVERHEAD;
+}
+
+bool SerialProtocol::send(uint8_t type, const uint8_t* payload, uint8_t length) {
+  if(!this->canSend(length)) {
+    this->droppedFrameCount++;
+    return false;
+  }
+
+  uint8_t frame[SERIAL_FRAME_MAX_PAYLOAD + SERIAL_FRAME_OVERHEAD];
+  uint8_t crc = Crc8::update(Crc8::update(0, length), type);
+
+  frame[0] = SERIAL_FRAME_SYNC;
+  frame[1] = length;
+  frame[2] = type;
+
+  for(uint8_t i = 0; i < length; i++) {
+    frame[3 + i] = payload[i];
+    crc = Crc8::update(crc, payload[i]);
+  }
+
+  frame[3 + length] = crc;
+
+  TurntableHal::writeSerial(frame, length + SERIAL_FRAME_OVERHEAD);
+
+  return true;
+}
+
+uint16_t SerialProtocol::getCrcErrorCount() {
+  return this->crcErrorCount;
+}
+
+uint16_t SerialProtocol::getDroppedFrameCount() {
+  return this->droppedFrameCount;
+}
+
+void SerialProtocol::writeUint16(uint8_t* buffer, uint16_t value) {
+  buffer[0] = value & 0xFF;
+  buffer[1] = value >> 8;
+}
+
+void SerialProtocol::writeUint32(uint8_t* buffer, unsigned long value) {
+  writeUint16(buffer, value & 0xFFFF);
+  writeUint16(buffer + 2, value >> 16);
+}
+
+uint16_t SerialProtocol::readUint16(const uint8_t* buffer) {
+  return buffer[0] | ((uint16_t)buffer[1] << 8);
+}
@@ -0,0 +1,84 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef SerialProtocol_h
+#define SerialProtocol_h
+
+// Every frame starts with this byte, so the receiver can find the start of the next frame after a corrupt one.
+#define SERIAL_FRAME_SYNC 0xA5
+
+// The largest payload that a single frame can carry. This is enough for every calibration value in one frame.
+#define SERIAL_FRAME_MAX_PAYLOAD 24
+
+// The bytes in a frame on top of its payload: sync, length, type, and CRC.
+#define SERIAL_FRAME_OVERHEAD 4
+
+// A single frame, without its sync byte and CRC.
+struct SerialFrame {
+    // See SerialFrameType.
+    uint8_t type;
+
+    uint8_t length;
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+};
+
+// A compact binary protocol over the serial port. Each frame is sent as:
+//
+//   sync (0xA5), payload length, type, payload..., CRC-8
+//
+// where the CRC-8 (polynomial 0x07) covers the length, type and payload. The serial port is fed by interrupts on both
+// sides, so receiving only takes the bytes that have already arrived, and sending only queues a frame if there is room
+// for all of it. Neither ever waits on the port.
+class SerialProtocol {
+    public:
+
+        // Constructor
+        SerialProtocol();
+
+        // Open the serial port at the given baud rate.
+        void begin(unsigned long baud);
+
+        // Process the bytes that have arrived since the last call. Returns true, with the frame filled in, as soon as
+        // a complete frame with a valid CRC is received; call it again to continue with any remaining bytes.
+        bool receive(SerialFrame& frame);
+
+        // Whether a frame with a payload of the given length can be queued right now without being dropped.
+        bool canSend(uint8_t length);
+
+        // Queue a frame to be sent. If the transmit buffer doesn't have room for the whole frame, it is dropped rather
+        // than waiting, and this returns false.
+        bool send(uint8_t type, const uint8_t* payload, uint8_t length);
+
+        // The number of received frames that were thrown away because their CRC didn't match.
+        uint16_t getCrcErrorCount();
+
+        // The number of frames that were dropped because the transmit buffer was full.
+        uint16_t getDroppedFrameCount();
+
+        // Little-endian helpers for building and reading payloads.
+        static void writeUint16(uint8_t* buffer, uint16_t value);
+        static void writeUint32(uint8_t* buffer, unsigned long value);
+        static uint16_t readUint16(const uint8_t* buffer);
+
+    private:
+        // Where the receiver is within the current frame.
+        enum ReceiveState : uint8_t {
+            WaitingForSync,
+            WaitingForLength,
+            WaitingForType,
+            WaitingForPayload,
+            WaitingForCrc
+        };
+
+        ReceiveState receiveState;
+        SerialFrame receivingFrame;
+        uint8_t payloadBytesReceived;
+        uint8_t receivingCrc;
+
+        uint16_t crcErrorCount;
+        uint16_t droppedFrameCount;
+};
+
+#endif
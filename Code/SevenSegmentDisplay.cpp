@@ -0,0 +1,93 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "SevenSegmentDisplay.h"
+#include "TurntableHal.h"
+
+// Used in place of the number of decimals when the display isn't showing a number.
+#define NOT_A_NUMBER 0xFF
+
+// The segments that make up each decimal digit.
+static const uint8_t digitSegments[10] = { 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F };
+
+// The place value of each digit, from left to right. Digits are worked out by subtracting these, since the AVR has no
+// divide instruction.
+static const uint16_t placeValues[SEVEN_SEGMENT_DIGIT_COUNT] = { 1000, 100, 10, 1 };
+
+// The front buffer is the one being shown; the other is written to.
+static uint8_t digitBuffers[2][SEVEN_SEGMENT_DIGIT_COUNT];
+static volatile uint8_t frontBuffer = 0;
+
+// The digit that the next refresh lights. This is only touched by the interrupt.
+static uint8_t refreshDigit = 0;
+
+// What is on the display, so showing it again can return straight away. When it isn't a number, the value is the
+// segments shown on every digit.
+static uint16_t shownValue = 0;
+static uint8_t shownDecimals = NOT_A_NUMBER;
+
+void SevenSegmentDisplay::begin() {
+  SevenSegmentDisplay::clear();
+  TurntableHal::beginDisplayRefresh(SevenSegmentDisplay::refresh);
+}
+
+void SevenSegmentDisplay::showNumber(uint16_t value, uint8_t decimals) {
+  if(decimals >= SEVEN_SEGMENT_DIGIT_COUNT) decimals = SEVEN_SEGMENT_DIGIT_COUNT - 1;
+  if(value == shownValue && decimals == shownDecimals) return;
+
+  if(value >= 10000) {
+    SevenSegmentDisplay::showDashes();
+    return;
+  }
+
+  shownValue = value;
+  shownDecimals = decimals;
+
+  uint8_t* digits = digitBuffers[frontBuffer ^ 1];
+  uint8_t pointDigit = SEVEN_SEGMENT_DIGIT_COUNT - 1 - decimals;
+  bool leadingZero = true;
+
+  for(uint8_t i = 0; i < SEVEN_SEGMENT_DIGIT_COUNT; i++) {
+    uint8_t digit = 0;
+
+    while(value >= placeValues[i]) {
+      value -= placeValues[i];
+      digit++;
+    }
+
+    if(digit != 0 || i >= pointDigit) leadingZero = false;
+
+    digits[i] = leadingZero ? 0 : digitSegments[digit];
+    if(decimals != 0 && i == pointDigit) digits[i] |= SEVEN_SEGMENT_DECIMAL_POINT;
+  }
+
+  frontBuffer ^= 1;
+}
+
+void SevenSegmentDisplay::showDashes() {
+  SevenSegmentDisplay::showAll(SEVEN_SEGMENT_DASH);
+}
+
+void SevenSegmentDisplay::clear() {
+  SevenSegmentDisplay::showAll(0);
+}
+
+void SevenSegmentDisplay::showAll(uint8_t segments) {
+  if(segments == shownValue && shownDecimals == NOT_A_NUMBER) return;
+
+  shownValue = segments;
+  shownDecimals = NOT_A_NUMBER;
+
+  uint8_t* digits = digitBuffers[frontBuffer ^ 1];
+
+  for(uint8_t i = 0; i < SEVEN_SEGMENT_DIGIT_COUNT; i++) digits[i] = segments;
+
+  frontBuffer ^= 1;
+}
+
+void SevenSegmentDisplay::refresh() {
+  TurntableHal::writeDisplayDigit(refreshDigit, digitBuffers[frontBuffer][refreshDigit]);
+
+  if(++refreshDigit == SEVEN_SEGMENT_DIGIT_COUNT) refreshDigit = 0;
+}
@@ -0,0 +1,48 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef SevenSegmentDisplay_h
+#define SevenSegmentDisplay_h
+
+// The number of digits on the display.
+#define SEVEN_SEGMENT_DIGIT_COUNT 4
+
+// The segment bits of a digit. Bit 0 is segment A, through to bit 6 for segment G, and bit 7 is the decimal point.
+#define SEVEN_SEGMENT_DECIMAL_POINT 0x80
+#define SEVEN_SEGMENT_DASH 0x40
+
+// The four digit seven-segment display, which shows the platter speed and calibration values. The digits are
+// multiplexed from the tick interrupt, one digit per tick, so the display never flickers while the main loop is busy
+// (i.e. during a long tonearm movement).
+//
+// The digits are double-buffered: a new value is formatted into the back buffer, which is then swapped in with a single
+// byte write, so the interrupt never shows a half-written value. Showing the value that is already on the display
+// returns straight away, so it can be called as often as you like.
+class SevenSegmentDisplay {
+    public:
+
+        // Start refreshing the display from the tick interrupt. The display starts out blank.
+        static void begin();
+
+        // Show a number of up to four digits, with the given number of digits (0-3) after the decimal point. For
+        // example, 3333 with 2 decimals shows "33.33". Leading zeros are blanked, apart from the one before the decimal
+        // point. Numbers too big to fit are shown as dashes.
+        static void showNumber(uint16_t value, uint8_t decimals);
+
+        // Show a dash on every digit.
+        static void showDashes();
+
+        // Turn every segment off.
+        static void clear();
+
+    private:
+        // Fill the back buffer with the same segments on every digit, and swap it in.
+        static void showAll(uint8_t segments);
+
+        // Called by the tick interrupt to light the next digit.
+        static void refresh();
+};
+
+#endif
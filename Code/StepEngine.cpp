@@ -0,0 +1,425 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "StepEngine.h"
+#include "EventTrace.h"
+
+// The step timer interval, in step timer ticks, while a movement is dwelling before its first step (1ms).
+#define STEP_ENGINE_DWELL_TICKS (1000 * STEP_TIMER_TICKS_PER_MICROSECOND)
+
+// The step timer interval, in step timer ticks, between the events of the two motors when both are due at once (20us).
+// This gives the demultiplexer time to switch over, and the coils time to discharge, before the other motor steps.
+#define STEP_ENGINE_AXIS_SWITCH_TICKS (20 * STEP_TIMER_TICKS_PER_MICROSECOND)
+
+StepEngine* StepEngine::timerEngine = NULL;
+
+StepEngine::StepEngine(uint16_t stepsPerRevolution) {
+    this->stepsPerRevolution = stepsPerRevolution;
+
+    for(uint8_t axis = 0; axis < 2; axis++) {
+      StepChannel& channel = this->channels[axis];
+      channel.stepsTaken = 0;
+      channel.busy = false;
+      channel.coilStepShift = 0;
+      channel.coilStepCount = 0;
+      channel.coilStepIntervalTicks = 0;
+      channel.ticksUntilEvent = 0;
+      channel.dwellRemainingMs = 0;
+      channel.releasePending = false;
+      channel.accelerationIndexIncrement = 0;
+      channel.decelerationIndexIncrement = 0;
+      channel.lastEncoderPosition = 0;
+      channel.stepsSinceEncoderChange = 0;
+    }
+
+    this->busy = false;
+    this->lastStartedAxis = MotorAxis::Vertical;
+    this->selectedAxis = MotorAxis::Vertical;
+    this->timerIntervalTicks = 0;
+    this->holdTicks = 0;
+    this->stallEncoder = NULL;
+    this->lastResult = MovementResult::None;
+    this->queueHead = 0;
+    this->queueCount = 0;
+}
+
+bool StepEngine::queueMove(StepCommand command) {
+  bool queued = true;
+
+  // Reading the stop input can take a multiplexer scan, so it is done before interrupts are disabled, and only when
+  // the movement might start right away.
+  bool idle = !this->busy;
+  bool stopInputReached = idle && this->isStopInputReached(command);
+
+  noInterrupts();
+
+  // The interrupt may have finished the last movement since we looked. Only the main loop starts movements, so the
+  // engine stays idle until we start this one, and the stop input can still be read with interrupts back on.
+  if(!idle && !this->busy) {
+    interrupts();
+    stopInputReached = this->isStopInputReached(command);
+    noInterrupts();
+  }
+
+  if(!this->busy) {
+    // Nothing is moving, so the movement starts right away.
+    if(stopInputReached) {
+      this->channels[command.axis].stepsTaken = 0;
+      this->lastStartedAxis = command.axis;
+      this->lastResult = MovementResult::Success;
+    }
+    else {
+      this->startCommand(command);
+    }
+  }
+
+  // Anything that can overlap the current movement is started by the next step interrupt, which knows how far into
+  // its interval the timer is.
+  else if(this->queueCount < STEP_ENGINE_QUEUE_SIZE) {
+    this->queue[(this->queueHead + this->queueCount) % STEP_ENGINE_QUEUE_SIZE] = command;
+    this->queueCount++;
+  }
+  else {
+    queued = false;
+  }
+
+  interrupts();
+
+  return queued;
+}
+
+uint16_t StepEngine::rpmToStepInterval(uint8_t rpm) {
+  if(rpm == 0) return 0xFFFF;
+
+  unsigned long ticks = (60000000UL / ((unsigned long)this->stepsPerRevolution * rpm)) * STEP_TIMER_TICKS_PER_MICROSECOND;
+
+  // Anything slower than the timer can count is clamped to the slowest speed it can do.
+  return ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks;
+}
+
+MovementResult StepEngine::poll() {
+  if(!this->busy) return this->lastResult;
+
+  for(uint8_t axis = 0; axis < 2; axis++) {
+    StepChannel& channel = this->channels[axis];
+    if(!channel.busy) continue;
+
+    uint8_t stopInput = channel.command.stopInput;
+    bool stopLevel = channel.command.stopLevel;
+
+    if(!this->isStopInputReached(channel.command)) continue;
+
+    noInterrupts();
+
+    // The interrupt may have moved on to another command (or gone idle) while we were reading the stop input.
+    if(channel.busy && channel.command.stopInput == stopInput && channel.command.stopLevel == stopLevel) {
+      EventTrace::record(TraceEventType::LimitHit, stopInput, channel.stepsTaken);
+
+      // Any queued movements to the same stop input are already there, so they are skipped rather than started.
+      while(this->queueCount > 0 && this->queue[this->queueHead].stopInput == stopInput && this->queue[this->queueHead].stopLevel == stopLevel) {
+        this->queueHead = (this->queueHead + 1) % STEP_ENGINE_QUEUE_SIZE;
+        this->queueCount--;
+      }
+
+      this->finishCommand((MotorAxis)axis, MovementResult::Success);
+    }
+
+    interrupts();
+  }
+
+  return this->busy ? MovementResult::None : this->lastResult;
+}
+
+bool StepEngine::isBusy() {
+  return this->busy;
+}
+
+void StepEngine::cancel() {
+  noInterrupts();
+
+  if(this->busy) {
+    this->queueCount = 0;
+    this->finishCommand(this->channels[MotorAxis::Vertical].busy ? MotorAxis::Vertical : MotorAxis::Horizontal, MovementResult::Cancelled);
+  }
+
+  interrupts();
+}
+
+uint16_t StepEngine::getStepsTaken() {
+  return this->getStepsTaken(this->lastStartedAxis);
+}
+
+uint16_t StepEngine::getStepsTaken(MotorAxis axis) {
+  noInterrupts();
+  uint16_t steps = this->channels[axis].stepsTaken;
+  interrupts();
+
+  return steps;
+}
+
+unsigned long StepEngine::getLastStepMicros(MotorAxis axis) {
+  noInterrupts();
+  unsigned long micros = this->channels[axis].lastStepMicros;
+  interrupts();
+
+  return micros;
+}
+
+void StepEngine::setHoldTicks(uint16_t ticks) {
+  this->holdTicks = ticks;
+}
+
+void StepEngine::setStallEncoder(QuadratureEncoder* encoder) {
+  this->stallEncoder = encoder;
+}
+
+void StepEngine::onStepTimer() {
+  if(!this->busy) return;
+
+  // Catch both motors up on the time since the last interrupt, then serve whichever one is due. If both are, the one
+  // already selected goes first, and the other follows after the demultiplexer has had a moment to switch over.
+  for(uint8_t axis = 0; axis < 2; axis++) {
+    StepChannel& channel = this->channels[axis];
+    if(!channel.busy) continue;
+
+    channel.ticksUntilEvent = channel.ticksUntilEvent > this->timerIntervalTicks ? channel.ticksUntilEvent - this->timerIntervalTicks : 0;
+  }
+
+  // A half-step motor that is between two full steps is only held there by its coils, so the demultiplexer stays on it
+  // until it is back on a full step, and the other motor waits for it.
+  StepChannel& selected = this->channels[this->selectedAxis];
+  bool holdingHalfStep = selected.busy && selected.coilStepCount != 0;
+
+  MotorAxis axis = this->selectedAxis;
+  if(!holdingHalfStep && (!selected.busy || selected.ticksUntilEvent > 0)) axis = (MotorAxis)(axis ^ 1);
+  if(this->channels[axis].busy && this->channels[axis].ticksUntilEvent == 0) this->serviceChannel(axis);
+
+  this->startQueuedCommands();
+  if(!this->busy) return;
+
+  uint16_t intervalTicks = 0xFFFF;
+  holdingHalfStep = selected.busy && selected.coilStepCount != 0;
+
+  for(uint8_t i = 0; i < 2; i++) {
+    if(holdingHalfStep && i != this->selectedAxis) continue;
+    if(this->channels[i].busy && this->channels[i].ticksUntilEvent < intervalTicks) intervalTicks = this->channels[i].ticksUntilEvent;
+  }
+
+  if(intervalTicks == 0) intervalTicks = STEP_ENGINE_AXIS_SWITCH_TICKS;
+
+  this->timerIntervalTicks = intervalTicks;
+  TurntableHal::setStepTimerInterval(intervalTicks);
+}
+
+void StepEngine::serviceChannel(MotorAxis axis) {
+  StepChannel& channel = this->channels[axis];
+
+  // Wait out the dwell before the first step. The last millisecond of it ends with the first step itself, so the step
+  // lands exactly dwellMs after the movement started, rather than a step interval later.
+  if(channel.dwellRemainingMs > 0 && --channel.dwellRemainingMs > 0) {
+    channel.ticksUntilEvent = STEP_ENGINE_DWELL_TICKS;
+    return;
+  }
+
+  // The coils have been on for the hold time since the last step, which is long enough for it to settle. If the other
+  // motor has stepped since, the coils were already switched off when the demultiplexer changed over.
+  if(channel.releasePending) {
+    channel.releasePending = false;
+    if(this->selectedAxis == axis) TurntableHal::releaseTonearmCoils();
+    channel.ticksUntilEvent = channel.coilStepIntervalTicks - this->holdTicks;
+    return;
+  }
+
+  // If every step was taken without reaching the stop input, the movement is over.
+  if(channel.stepsTaken >= channel.command.steps) {
+    this->finishCommand(axis, channel.command.timeoutResult);
+    return;
+  }
+
+  // Every step should move the encoder a little. If it hasn't moved for the last few steps, the motor is turning but
+  // whatever it drives is not, so we stop pushing right away.
+  if(channel.command.stallSteps > 0 && this->stallEncoder != NULL) {
+    long encoderPosition = this->stallEncoder->getPosition();
+
+    if(encoderPosition != channel.lastEncoderPosition) {
+      channel.lastEncoderPosition = encoderPosition;
+      channel.stepsSinceEncoderChange = 0;
+    }
+    else if(channel.stepsSinceEncoderChange >= channel.command.stallSteps) {
+      this->finishCommand(axis, channel.command.stallResult);
+      return;
+    }
+  }
+
+  // Switching the demultiplexer over switches the other motor off. The coil driver remembers where each motor was
+  // left in its sequence, so this one carries on from its own last coil pattern, and neither of them loses a step.
+  if(this->selectedAxis != axis) {
+    TurntableHal::selectMotorAxis(axis);
+    TurntableHal::setTonearmStepSequence(channel.command.sequence);
+    this->selectedAxis = axis;
+  }
+
+  TurntableHal::stepTonearmMotor(channel.command.direction);
+  if(channel.command.stopInput != STEP_COMMAND_NO_STOP_INPUT) channel.lastStepMicros = TurntableHal::currentMicros();
+
+  if(++channel.coilStepCount >= (1 << channel.coilStepShift)) {
+    channel.coilStepCount = 0;
+    channel.stepsTaken++;
+    channel.stepsSinceEncoderChange++;
+
+    if(channel.command.profile != MotionProfile::Constant) {
+      channel.coilStepIntervalTicks = this->profiledStepInterval(channel, channel.stepsTaken);
+    }
+
+    if(channel.stepsTaken >= channel.command.unmuteStep) {
+      channel.command.unmuteStep = STEP_COMMAND_NO_UNMUTE;
+      TurntableHal::unmuteAudioAfter(channel.command.unmuteLagMs);
+    }
+  }
+
+  // The coils are only switched off on a full step. Between two, in a half-step sequence, only one coil holds the
+  // rotor, and without it the rotor would fall to the nearest full step and lose the half step. That leaves the time
+  // from a full step to the next coil step, which is the coil step interval.
+  if(this->holdTicks > 0 && channel.coilStepCount == 0 && channel.coilStepIntervalTicks >= (unsigned long)this->holdTicks * 2) {
+    channel.releasePending = true;
+    channel.ticksUntilEvent = this->holdTicks;
+  }
+  else {
+    channel.ticksUntilEvent = channel.coilStepIntervalTicks;
+  }
+}
+
+void StepEngine::startCommand(StepCommand command) {
+  EventTrace::record(TraceEventType::MoveStart, command.axis | (command.direction < 0 ? 2 : 0), command.steps);
+
+  StepChannel& channel = this->channels[command.axis];
+  channel.command = command;
+  channel.stepsTaken = 0;
+  channel.busy = true;
+
+  channel.coilStepShift = command.sequence == StepSequence::HalfStep ? 1 : 0;
+  channel.coilStepCount = 0;
+  channel.releasePending = false;
+  if(command.stopInput != STEP_COMMAND_NO_STOP_INPUT) channel.lastStepMicros = TurntableHal::currentMicros();
+
+  if(this->stallEncoder != NULL) channel.lastEncoderPosition = this->stallEncoder->getPosition();
+  channel.stepsSinceEncoderChange = 0;
+
+  // Work out how fast to move through the ramp tables up front, which is the only division a movement needs.
+  channel.accelerationIndexIncrement = command.accelerationSteps > 0 ? ((uint16_t)MOTION_PROFILE_TABLE_LENGTH << 8) / command.accelerationSteps : 0;
+  channel.decelerationIndexIncrement = command.decelerationSteps > 0 ? ((uint16_t)MOTION_PROFILE_TABLE_LENGTH << 8) / command.decelerationSteps : 0;
+
+  channel.coilStepIntervalTicks = this->profiledStepInterval(channel, 0);
+  channel.dwellRemainingMs = command.dwellMs;
+  channel.ticksUntilEvent = command.dwellMs > 0 ? STEP_ENGINE_DWELL_TICKS : channel.coilStepIntervalTicks;
+
+  this->lastStartedAxis = command.axis;
+
+  // If the other motor is moving, the step timer is already running, and the interrupt that started this movement
+  // schedules its first event along with the other motor's.
+  if(this->busy) return;
+
+  this->busy = true;
+  timerEngine = this;
+
+  TurntableHal::selectMotorAxis(command.axis);
+  TurntableHal::setTonearmStepSequence(command.sequence);
+  this->selectedAxis = command.axis;
+
+  this->timerIntervalTicks = channel.ticksUntilEvent;
+  TurntableHal::startStepTimer(this->timerIntervalTicks, StepEngine::onStepTimerInterrupt);
+}
+
+void StepEngine::startQueuedCommands() {
+  while(this->queueCount > 0) {
+    const StepCommand& next = this->queue[this->queueHead];
+    const StepChannel& other = this->channels[next.axis ^ 1];
+
+    if(this->channels[next.axis].busy) return;
+    if(other.busy && (next.overlapSteps == STEP_COMMAND_NO_OVERLAP || other.stepsTaken < next.overlapSteps)) return;
+
+    StepCommand command = next;
+    this->queueHead = (this->queueHead + 1) % STEP_ENGINE_QUEUE_SIZE;
+    this->queueCount--;
+
+    this->startCommand(command);
+  }
+}
+
+uint16_t StepEngine::profiledStepInterval(const StepChannel& channel, uint16_t stepCount) {
+  const StepCommand& command = channel.command;
+
+  if(command.profile == MotionProfile::Constant) return command.stepIntervalTicks >> channel.coilStepShift;
+
+  uint16_t factor = MOTION_PROFILE_CRUISE_FACTOR;
+
+  if(stepCount < command.accelerationSteps) {
+    uint8_t index = ((unsigned long)stepCount * channel.accelerationIndexIncrement) >> 8;
+    factor = MotionProfileTable::getIntervalFactor(command.profile, index);
+  }
+
+  // The deceleration ramp is the acceleration ramp backwards, ending on its first entry at the last step. Where the
+  // ramps overlap, whichever is slower wins.
+  uint16_t stepsRemaining = command.steps - stepCount;
+
+  if(stepsRemaining > 0 && stepsRemaining <= command.decelerationSteps) {
+    uint8_t index = ((unsigned long)(stepsRemaining - 1) * channel.decelerationIndexIncrement) >> 8;
+    uint16_t decelerationFactor = MotionProfileTable::getIntervalFactor(command.profile, index);
+
+    if(decelerationFactor > factor) factor = decelerationFactor;
+  }
+
+  return MotionProfileTable::scaleInterval(command.stepIntervalTicks, factor) >> channel.coilStepShift;
+}
+
+void StepEngine::finishCommand(MotorAxis axis, MovementResult result) {
+  StepChannel& channel = this->channels[axis];
+  StepChannel& other = this->channels[axis ^ 1];
+
+  EventTrace::record(TraceEventType::MoveStop, result, channel.stepsTaken);
+  channel.busy = false;
+
+  // Anything other than success aborts the other motor's movement and the whole chain.
+  if(result != MovementResult::Success) {
+    if(other.busy) {
+      EventTrace::record(TraceEventType::MoveStop, MovementResult::Cancelled, other.stepsTaken);
+      other.busy = false;
+    }
+
+    this->queueCount = 0;
+    this->lastResult = result;
+    this->busy = false;
+    this->stopMotors();
+    return;
+  }
+
+  // While the other motor carries on, its step interrupt starts whatever is queued behind this movement.
+  if(other.busy) return;
+
+  // Otherwise, a successful movement hands off to the next one in the queue, which restarts the step timer.
+  this->lastResult = result;
+  this->busy = false;
+  this->startQueuedCommands();
+
+  if(!this->busy) this->stopMotors();
+}
+
+bool StepEngine::isStopInputReached(const StepCommand& command) {
+  if(command.stopInput == STEP_COMMAND_NO_STOP_INPUT) return false;
+
+  if(command.stopInput & STEP_COMMAND_PIN_INPUT) {
+    return TurntableHal::readPin(command.stopInput & ~STEP_COMMAND_PIN_INPUT) == command.stopLevel;
+  }
+
+  return TurntableHal::readMuxInput(command.stopInput) == command.stopLevel;
+}
+
+void StepEngine::stopMotors() {
+  TurntableHal::stopStepTimer();
+  TurntableHal::releaseTonearmMotor();
+}
+
+void StepEngine::onStepTimerInterrupt() {
+  if(timerEngine != NULL) timerEngine->onStepTimer();
+}
@@ -0,0 +1,246 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "TurntableHal.h"
+#include "QuadratureEncoder.h"
+#include "MotionProfileTable.h"
+#include "enums/MotionProfile.h"
+#include "enums/MotorAxis.h"
+#include "enums/StepSequence.h"
+#include "enums/MovementResult.h"
+
+#ifndef StepEngine_h
+#define StepEngine_h
+
+// Pass this as the stop input of a StepCommand if the movement should only end once all of its steps are taken.
+#define STEP_COMMAND_NO_STOP_INPUT 0xFF
+
+// Combine this with an Arduino pin number to use the pin as the stop input of a StepCommand, instead of a multiplexer
+// input.
+#define STEP_COMMAND_PIN_INPUT 0x80
+
+// Pass this as the overlap of a StepCommand if it should only start once the movement before it has finished.
+#define STEP_COMMAND_NO_OVERLAP 0xFFFF
+
+// Pass this as the unmute step of a StepCommand if the movement should leave the audio alone.
+#define STEP_COMMAND_NO_UNMUTE 0xFFFF
+
+// The number of movements that can be waiting behind the ones currently being executed.
+#define STEP_ENGINE_QUEUE_SIZE 4
+
+// A single movement of one of the tonearm motors.
+struct StepCommand {
+    // The motor that will be moving.
+    MotorAxis axis;
+
+    // The direction passed to the stepper for each step (1 or -1).
+    int8_t direction;
+
+    // The maximum number of steps that will be taken. If the stop input is never reached, the movement ends after this
+    // many steps with the timeoutResult.
+    uint16_t steps;
+
+    // The time between steps at cruising speed, in step timer ticks (see STEP_TIMER_TICKS_PER_MICROSECOND).
+    uint16_t stepIntervalTicks;
+
+    // The coil sequence that the motor is stepped with. Steps, and the intervals between them, are always counted in
+    // full steps; a half-step sequence takes two coil steps for each of them.
+    StepSequence sequence;
+
+    // How the motor speeds up to, and slows down from, the cruising speed.
+    MotionProfile profile;
+
+    // The number of steps spent speeding up at the start of the movement, and slowing down before its last step. A
+    // movement that is too short for both ramps never reaches cruising speed. Ignored by the Constant profile.
+    uint16_t accelerationSteps;
+    uint16_t decelerationSteps;
+
+    // Multiplexer input (or STEP_COMMAND_PIN_INPUT | Arduino pin) that ends the movement successfully once it reads the
+    // stopLevel, or STEP_COMMAND_NO_STOP_INPUT.
+    uint8_t stopInput;
+    bool stopLevel;
+
+    // The result of the movement if all steps are taken. For blind movements this is MovementResult::Success.
+    MovementResult timeoutResult;
+
+    // If the stall encoder doesn't change for this many steps in a row, the motor is pushing against something and the
+    // movement ends with the stallResult. Zero turns stall detection off for this movement.
+    uint8_t stallSteps;
+
+    // The result of the movement if it stalls. For movements that are meant to end against something, this is
+    // MovementResult::Success.
+    MovementResult stallResult;
+
+    // How long, in milliseconds, to wait after the movement starts before taking the first step. The wait is timed by
+    // the step timer, so the first step lands exactly this long after the movement started.
+    uint16_t dwellMs;
+
+    // If the other motor is still moving when this movement reaches the front of the queue, this movement starts
+    // alongside it once it has taken this many steps, rather than waiting for it to finish. Their steps are then
+    // interleaved, switching the axis demultiplexer over before each one. STEP_COMMAND_NO_OVERLAP always waits.
+    uint16_t overlapSteps;
+
+    // Once the movement has taken this many steps, the audio is unmuted unmuteLagMs later (see
+    // TurntableHal::unmuteAudioAfter). The unmute is scheduled from the step interrupt, so it is timed from the step
+    // itself, however slowly the motor is turning. STEP_COMMAND_NO_UNMUTE leaves the audio alone.
+    uint16_t unmuteStep;
+    uint16_t unmuteLagMs;
+};
+
+// The state of the movement being executed on one of the tonearm motors.
+struct StepChannel {
+    // The movement, and how far along it is.
+    StepCommand command;
+    volatile uint16_t stepsTaken;
+    volatile bool busy;
+
+    // How many coil steps the movement's sequence takes for each step (as a power of two), and how many of them have
+    // been taken towards the next step.
+    uint8_t coilStepShift;
+    uint8_t coilStepCount;
+
+    // The step timer interval between coil steps at the current point in the movement.
+    uint16_t coilStepIntervalTicks;
+
+    // Step timer ticks left until this motor's next step (or dwell tick, or coil release).
+    uint16_t ticksUntilEvent;
+
+    // How many milliseconds of the movement's dwell are left.
+    uint16_t dwellRemainingMs;
+
+    // When a release is pending, this motor's next event switches the coils off instead of stepping.
+    bool releasePending;
+
+    // How many table entries (8.8 fixed point) each step of the ramps moves through, so the step interrupt doesn't
+    // have to divide.
+    uint16_t accelerationIndexIncrement;
+    uint16_t decelerationIndexIncrement;
+
+    // Stall detection.
+    long lastEncoderPosition;
+    uint8_t stepsSinceEncoderChange;
+
+    // When the motor last took a coil step (or the movement started), in microseconds. This is only kept for movements
+    // that stop at an input, whose stop input is reached by one of these steps.
+    volatile unsigned long lastStepMicros;
+};
+
+// Steps the tonearm motors from a timer interrupt, so that the main loop is free to keep monitoring buttons and sensors
+// while a movement is in progress. Movements are queued and executed in order; if one of them fails or is cancelled,
+// everything queued behind it is discarded. A movement of one motor can be overlapped with one of the other (see
+// StepCommand::overlapSteps), in which case the single step timer serves whichever motor is due next.
+class StepEngine {
+    public:
+
+        // Constructor
+        StepEngine(uint16_t stepsPerRevolution);
+
+        // Add a movement to the queue, starting it right away if nothing else is moving. If the engine is idle and the
+        // stop input already reads the stop level, the movement succeeds without taking any steps.
+        // Returns false if the queue is full.
+        bool queueMove(StepCommand command);
+
+        // Convert a motor speed, in RPM, to the step interval used by a StepCommand.
+        uint16_t rpmToStepInterval(uint8_t rpm);
+
+        // Check the stop inputs of the current movements. This must be called regularly from the main loop while the
+        // engine is busy, because the stop inputs are never read from the interrupt.
+        // Returns MovementResult::None while a movement is in progress, otherwise the result of the last movement.
+        MovementResult poll();
+
+        // Whether a movement is currently in progress on either motor.
+        bool isBusy();
+
+        // Stop the current movements immediately and discard any queued movements. The result will be MovementResult::Cancelled.
+        void cancel();
+
+        // The number of steps taken by the current (or most recent) movement.
+        uint16_t getStepsTaken();
+
+        // The number of steps taken by the current (or most recent) movement of the given motor.
+        uint16_t getStepsTaken(MotorAxis axis);
+
+        // When the current (or most recent) movement of the given motor last took a coil step, or started if it
+        // hasn't taken one, in microseconds (see TurntableHal::currentMicros). Only kept for movements with a stop
+        // input, and since poll() checks the input far more often than a slow movement steps, once the input has been
+        // seen this is when it was reached.
+        unsigned long getLastStepMicros(MotorAxis axis);
+
+        // Set how long, in step timer ticks, the coils stay on after each step. Coil steps at least twice this far apart
+        // switch the coils off for the rest of the interval after each full step, which cuts the current drawn by slow
+        // movements, since the gearing holds the tonearm in place on its own. Half-step sequences keep the coils on
+        // between full steps. Zero keeps the coils on for the whole movement.
+        void setHoldTicks(uint16_t ticks);
+
+        // Set the encoder that is checked after every step of a movement with stall detection.
+        void setStallEncoder(QuadratureEncoder* encoder);
+
+        // Called by the step timer interrupt. Not to be called directly.
+        void onStepTimer();
+
+        // Forwards the step timer interrupt to the engine that started it.
+        static void onStepTimerInterrupt();
+
+    private:
+        // Begin executing the given command on its motor's channel, starting the step timer if nothing else is moving.
+        // Interrupts must be disabled when this is called, unless the engine is idle.
+        void startCommand(StepCommand command);
+
+        // Start as many queued commands as can run now: the one at the front of the queue starts once its motor is
+        // free, and the other motor has either finished or gone far enough for it to overlap.
+        // Interrupts must be disabled when this is called.
+        void startQueuedCommands();
+
+        // End the given motor's command with the given result. A success hands off to the queue; anything else stops
+        // both motors and discards the queue. Interrupts must be disabled when this is called.
+        void finishCommand(MotorAxis axis, MovementResult result);
+
+        // Take the next step (or dwell tick, or coil release) of the given motor's command, and work out when its
+        // next one is due.
+        void serviceChannel(MotorAxis axis);
+
+        // Whether the stop input of the given command reads its stop level.
+        bool isStopInputReached(const StepCommand& command);
+
+        // Stop the timer and release current from the motors.
+        void stopMotors();
+
+        // The step timer interval, in step timer ticks, for the coil steps of the given channel after the given number
+        // of steps have been taken.
+        uint16_t profiledStepInterval(const StepChannel& channel, uint16_t stepCount);
+
+        // The number of steps it takes for either stepper motor to make a full 360-degree rotation.
+        uint16_t stepsPerRevolution;
+
+        // The movement of each motor, indexed by MotorAxis.
+        StepChannel channels[2];
+        volatile bool busy;
+
+        // The motor that most recently started a movement, and the one the demultiplexer currently points at.
+        MotorAxis lastStartedAxis;
+        MotorAxis selectedAxis;
+
+        // The interval the step timer is currently running with, which is how much time has passed at its next
+        // interrupt.
+        uint16_t timerIntervalTicks;
+
+        // Holding current reduction. Steps at least twice the hold time apart release the coils after the hold time.
+        uint16_t holdTicks;
+
+        // The encoder checked by movements with stall detection.
+        QuadratureEncoder* stallEncoder;
+
+        // The result of the most recently finished movement.
+        volatile MovementResult lastResult;
+
+        // Movements waiting for the active ones to finish.
+        StepCommand queue[STEP_ENGINE_QUEUE_SIZE];
+        volatile uint8_t queueHead;
+        volatile uint8_t queueCount;
+
+        // The engine that the step timer interrupt is currently driving.
+        static StepEngine* timerEngine;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "StepperCoilDriver.h"
+
+// The coils that are on for each half-step phase, with coil A as bit 0. Full steps are the even phases (two coils on)
+// and wave drive is the odd phases (one coil on).
+static const uint8_t halfStepCoils[STEPPER_COIL_PHASE_COUNT] = {
+  0b0011, 0b0010, 0b0110, 0b0100, 0b1100, 0b1000, 0b1001, 0b0001
+};
+
+StepperCoilDriver::StepperCoilDriver(
+  uint8_t coilPinA,
+  uint8_t coilPinB,
+  uint8_t coilPinC,
+  uint8_t coilPinD
+  ) {
+    this->coilPins[0] = coilPinA;
+    this->coilPins[1] = coilPinB;
+    this->coilPins[2] = coilPinC;
+    this->coilPins[3] = coilPinD;
+
+    this->portCount = 0;
+    this->phases[MotorAxis::Vertical] = 0;
+    this->phases[MotorAxis::Horizontal] = 0;
+    this->axis = MotorAxis::Vertical;
+    this->sequence = StepSequence::FullStep;
+}
+
+void StepperCoilDriver::begin() {
+  uint8_t coilPorts[4];
+  uint8_t coilMasks[4];
+
+  this->portCount = 0;
+
+  for(uint8_t coil = 0; coil < 4; coil++) {
+    uint8_t pin = this->coilPins[coil];
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+
+    // Coil pins on the same port share a slot, so they change together.
+    volatile uint8_t* toggleRegister = &(&VPORTA)[digitalPinToPort(pin)].IN;
+    uint8_t slot = 0;
+    while(slot < this->portCount && this->portToggleRegisters[slot] != toggleRegister) slot++;
+
+    if(slot == this->portCount) {
+      this->portToggleRegisters[slot] = toggleRegister;
+      this->portOutputs[slot] = 0;
+      this->portCount++;
+    }
+
+    coilPorts[coil] = slot;
+    coilMasks[coil] = digitalPinToBitMask(pin);
+  }
+
+  for(uint8_t phase = 0; phase <= STEPPER_COIL_PHASE_COUNT; phase++) {
+    for(uint8_t slot = 0; slot < STEPPER_COIL_MAX_PORTS; slot++) this->phasePatterns[phase][slot] = 0;
+    if(phase == STEPPER_COIL_PHASE_COUNT) break;
+
+    for(uint8_t coil = 0; coil < 4; coil++) {
+      if(halfStepCoils[phase] & (1 << coil)) this->phasePatterns[phase][coilPorts[coil]] |= coilMasks[coil];
+    }
+  }
+}
+
+MotorAxis StepperCoilDriver::getAxis() {
+  return this->axis;
+}
+
+void StepperCoilDriver::selectAxis(MotorAxis axis) {
+  this->axis = axis;
+}
+
+void StepperCoilDriver::setSequence(StepSequence sequence) {
+  this->sequence = sequence;
+}
+
+void StepperCoilDriver::step(int8_t direction) {
+  uint8_t phase = this->phases[this->axis];
+  uint8_t phaseIncrement = 1;
+
+  // Full steps and wave drive skip every other phase. A motor that the other sequence left on the wrong phase takes a
+  // half step to get back onto its own.
+  if(this->sequence != StepSequence::HalfStep && (phase & 1) == (this->sequence == StepSequence::WaveDrive)) {
+    phaseIncrement = 2;
+  }
+
+  phase = (phase + (direction < 0 ? -phaseIncrement : phaseIncrement)) & (STEPPER_COIL_PHASE_COUNT - 1);
+
+  this->phases[this->axis] = phase;
+  this->writePhase(phase);
+}
+
+void StepperCoilDriver::release() {
+  this->writePhase(STEPPER_COIL_PHASE_COUNT);
+}
+
+void StepperCoilDriver::writePhase(uint8_t phase) {
+  const uint8_t* pattern = this->phasePatterns[phase];
+
+  // Toggling only the bits that change leaves the other pins on each port alone, without a read-modify-write that an
+  // interrupt could get in the middle of.
+  for(uint8_t slot = 0; slot < this->portCount; slot++) {
+    *this->portToggleRegisters[slot] = this->portOutputs[slot] ^ pattern[slot];
+    this->portOutputs[slot] = pattern[slot];
+  }
+}
@@ -0,0 +1,73 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "enums/MotorAxis.h"
+#include "enums/StepSequence.h"
+
+#ifndef StepperCoilDriver_h
+#define StepperCoilDriver_h
+
+// The number of coil patterns in a half-step sequence. Full steps and wave drive use every other one of them.
+#define STEPPER_COIL_PHASE_COUNT 8
+
+// The most I/O ports that the four coil pins can be spread across.
+#define STEPPER_COIL_MAX_PORTS 4
+
+// Drives the four coil pins of the tonearm stepper motors straight from the VPORT registers. The bits each port needs
+// for every coil pattern are worked out once in begin(), so a step is a single store per port, with no digitalWrite()
+// and no waiting. Both motors share the coil pins through the axis demultiplexer, so the driver remembers where in the
+// sequence each of them was left.
+class StepperCoilDriver {
+    public:
+
+        // Constructor
+        StepperCoilDriver(
+            uint8_t coilPinA, // arduino output pin, first coil to be energized when stepping forwards
+            uint8_t coilPinB, // arduino output pin
+            uint8_t coilPinC, // arduino output pin
+            uint8_t coilPinD  // arduino output pin
+        );
+
+        // Set the coil pins as LOW outputs and build the port patterns. This must be called before the first step.
+        void begin();
+
+        // The motor whose position in the sequence is being followed.
+        MotorAxis getAxis();
+
+        // Follow the given motor's position in the sequence from now on. This doesn't change the coil pins.
+        void selectAxis(MotorAxis axis);
+
+        // Set the sequence that the following steps use.
+        void setSequence(StepSequence sequence);
+
+        // Move the selected motor by one step of the current sequence in the given direction (1 or -1).
+        void step(int8_t direction);
+
+        // Set all coil pins LOW. The motor's position in the sequence is kept, so the next step carries on from it.
+        void release();
+
+    private:
+        // Change the coil pins to the given half-step phase, or to all LOW for STEPPER_COIL_PHASE_COUNT.
+        void writePhase(uint8_t phase);
+
+        uint8_t coilPins[4];
+
+        // The VPORT IN register of every port that a coil pin is on. Writing a 1 to a bit of it toggles that output.
+        volatile uint8_t* portToggleRegisters[STEPPER_COIL_MAX_PORTS];
+        uint8_t portCount;
+
+        // The coil bits of each port for every half-step phase. The extra last row is all coils off.
+        uint8_t phasePatterns[STEPPER_COIL_PHASE_COUNT + 1][STEPPER_COIL_MAX_PORTS];
+
+        // The coil bits currently being output on each port.
+        uint8_t portOutputs[STEPPER_COIL_MAX_PORTS];
+
+        // The half-step phase that each motor was last stepped to, indexed by MotorAxis.
+        uint8_t phases[2];
+
+        MotorAxis axis;
+        StepSequence sequence;
+};
+
+#endif
@@ -3,167 +3,571 @@
 // be investigated on an individual basis by whoever stumbles upon this code.
 
 #include "TonearmMovementController.h"
+#include "EventTrace.h"
 
-TonearmMovementController::TonearmMovementController(
-  Multiplexer inputMux, 
-  Stepper tonearmMotors, 
-  uint8_t motorSelectPin, 
-  DcMotor horizontalClutch, 
-  uint8_t verticalLowerLimit, 
-  uint8_t verticalUpperLimit
-  ):  inputMux(inputMux), 
-      tonearmMotors(tonearmMotors),
-      horizontalClutch(horizontalClutch)
-{
-    this->motorSelectPin = motorSelectPin;
-    pinMode(motorSelectPin, OUTPUT);
-
-    this->verticalLowerLimit = verticalLowerLimit;
-    this->verticalUpperLimit = verticalUpperLimit;
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::TonearmMovementController(uint16_t stepsPerRevolution) : stepEngine(stepsPerRevolution) {
+    this->horizontalEncoder = NULL;
 
     this->clutchEngagementMs = 0;
+    this->clutchMoving = false;
+    this->clutchTarget = HorizontalClutchPosition::Disengage;
+    this->clutchStartMillis = 0;
+    this->clutchDurationMs = 0;
     this->topMotorSpeed = 0;
     this->verticalTimeout = 0;
+    this->motionProfiles[MotorAxis::Vertical] = MotionProfile::Constant;
+    this->motionProfiles[MotorAxis::Horizontal] = MotionProfile::Constant;
+    this->stepSequences[MotorAxis::Vertical] = StepSequence::FullStep;
+    this->stepSequences[MotorAxis::Horizontal] = StepSequence::FullStep;
+    this->rampSteps[MotorAxis::Vertical] = 0;
+    this->rampSteps[MotorAxis::Horizontal] = 0;
+    this->carefulDescentSteps = 0;
+    this->verticalTravelSteps = 0;
+    this->measuringVerticalTravel = false;
+    this->stylusClearanceSteps = 0;
+    this->audioMuteLeadMs = 0;
+    this->audioMuteLagMs = 0;
+    this->unmutingAudio = false;
+    this->recordEdgeSteps = 0;
+    this->measuredRecordEdgeSteps = 0;
+    this->leadInSteps = 0;
+    this->horizontalStallSteps = 0;
+    this->horizontalBacklashSteps = 0;
+    this->horizontalTimeout = 0;
+    this->movementIdleHandler = NULL;
 }
 
-MovementResult TonearmMovementController::moveUp(uint8_t speed) {
-  this->verticalMove(VerticalMovementDirection::Up, speed);
-}
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::moveUp(uint8_t speed) {
+  if(!this->beginMoveUp(speed)) return MovementResult::VerticalPositiveDirectionError;
 
-MovementResult TonearmMovementController::moveDown(uint8_t speed) {
-  this->verticalMove(VerticalMovementDirection::Down, speed);
+  return this->waitForMovement();
 }
 
-MovementResult TonearmMovementController::seekRecordEdge() {
-  // TODO: Implement
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::moveDown(uint8_t speed) {
+  if(!this->beginMoveDown(speed)) return MovementResult::VerticalNegativeDirectionError;
+
+  return this->waitForMovement();
 }
 
-MovementResult TonearmMovementController::horizontalHome() {
-  // TODO: Implement
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::moveDownCarefully(uint8_t speed, uint8_t carefulSpeed) {
+  if(!this->beginMoveDownCarefully(speed, carefulSpeed)) return MovementResult::VerticalNegativeDirectionError;
+
+  return this->waitForMovement();
 }
 
-// Moves the tonearm to a specified destination.
-// TODO: Delete this method when we are ready to replace it with seekRecordEdge and horizontalHome
-MovementResult TonearmMovementController::moveTonearmHorizontally(uint8_t destinationSensor, unsigned int timeout, int calibration, uint8_t speed) {
-    // Select horizontal movement.
-    digitalWrite(this->motorSelectPin, MotorAxis::Horizontal);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+bool TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginMoveUp(uint8_t speed) {
+  // A full movement from one limit to the other tells us how far a careful descent has to go before slowing down.
+  this->measuringVerticalTravel = TurntableHal::readMuxInput(verticalLowerLimit);
 
-    // Set values needed for movement.
-    unsigned int movementStepCount = 0;
-    this->tonearmMotors.setSpeed(speed);
-    bool currentSensorStatus = digitalRead(destinationSensor); 
+  // Only a tonearm that is all the way down can have the stylus on the record, so only then is the audio muted, and
+  // the lift held back until the mute has taken effect. The unmute is scheduled by the step that takes the stylus clear
+  // of the record, which is over a second into the lift at the slower speeds.
+  if(this->measuringVerticalTravel) TurntableHal::setAudioMuted(true);
 
-    // Determine what direction we're moving.
-    HorizontalMovementDirection movementDirection = currentSensorStatus ? HorizontalMovementDirection::Counterclockwise : HorizontalMovementDirection::Clockwise;
+  this->unmutingAudio = this->measuringVerticalTravel;
 
-    // Engage clutch so gears can move the tonearm.
-    this->setClutchPosition(HorizontalClutchPosition::Engage);
+  StepCommand command = this->buildVerticalCommand(VerticalMovementDirection::Up, speed);
 
-    // Keep moving until the sensor is the opposite of what it started at.
-    while(digitalRead(destinationSensor) == currentSensorStatus) {
-      this->tonearmMotors.step(movementDirection);
+  if(this->measuringVerticalTravel) {
+    command.dwellMs = this->audioMuteLeadMs;
+    command.unmuteStep = this->stylusClearanceSteps;
+    command.unmuteLagMs = this->audioMuteLagMs;
+  }
 
-      // If the sensor isn't hit within the expected number of steps, the movement failed.
-      if(movementStepCount++ >= timeout) {
-        this->setClutchPosition(HorizontalClutchPosition::Disengage);
+  return this->stepEngine.queueMove(command);
+}
 
-        if(movementDirection == HorizontalMovementDirection::Clockwise)
-          return MovementResult::HorizontalClockwiseDirectionError;
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+bool TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginMoveDown(uint8_t speed) {
+  // The descent takes far longer than the lead time, so muting now is always early enough.
+  TurntableHal::setAudioMuted(true);
+  this->unmutingAudio = true;
 
-        else
-          return MovementResult::HorizontalCounterclockwiseDirectionError;
-      }
+  return this->stepEngine.queueMove(this->buildVerticalCommand(VerticalMovementDirection::Down, speed));
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+bool TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginMoveDownCarefully(uint8_t speed, uint8_t carefulSpeed) {
+  TurntableHal::setAudioMuted(true);
+  this->unmutingAudio = true;
+
+  // The last part of the way down is at the careful speed, with no ramp, until the limit is reached.
+  StepCommand setDown = this->buildCommand(MotorAxis::Vertical, VerticalMovementDirection::Down, this->verticalTimeout, carefulSpeed);
+  setDown.profile = MotionProfile::Constant;
+  setDown.stopInput = verticalLowerLimit;
+  setDown.timeoutResult = MovementResult::VerticalNegativeDirectionError;
+
+  // Without a known starting point, we can't tell how close the record is, so the whole way down is careful. This is
+  // also the case once the tonearm has been lowered to hover over the record (see beginMoveToLeadInAndHover).
+  if(this->verticalTravelSteps <= this->carefulDescentSteps || !TurntableHal::readMuxInput(verticalUpperLimit)) {
+    return this->stepEngine.queueMove(setDown);
+  }
+
+  // Otherwise, move most of the way down at full speed first, slowing down as we approach the careful part.
+  if(!this->stepEngine.queueMove(this->buildApproachCommand(speed))) return false;
+
+  return this->stepEngine.queueMove(setDown);
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+bool TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::isMoving() {
+  return this->stepEngine.isBusy();
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::pollMovement() {
+  MovementResult result = this->stepEngine.poll();
+
+  // The lower limit is checked here, so this is as soon as the firmware can know that the stylus is down. That can be
+  // up to a multiplexer snapshot after the step that reached it, so the lag is timed from that step instead. A lift off
+  // the record has already scheduled its unmute if it got as far as the stylus clearance. If it stopped short of it,
+  // the tonearm isn't moving any more either way, so the audio comes back after the same lag.
+  if(result != MovementResult::None && this->unmutingAudio) {
+    if(this->measuringVerticalTravel) {
+      if(this->stepEngine.getStepsTaken(MotorAxis::Vertical) < this->stylusClearanceSteps) TurntableHal::unmuteAudioAfter(this->audioMuteLagMs);
     }
+    else if(result == MovementResult::Success) {
+      unsigned long sinceLimitMs = (TurntableHal::currentMicros() - this->stepEngine.getLastStepMicros(MotorAxis::Vertical) + 500) / 1000;
+      TurntableHal::unmuteAudioAfter(sinceLimitMs < this->audioMuteLagMs ? this->audioMuteLagMs - sinceLimitMs : 0);
+    }
+
+    this->unmutingAudio = false;
+  }
 
-    this->horizontalRelativeMove(calibration, 14, movementDirection);
+  if(result != MovementResult::None && this->measuringVerticalTravel) {
+    if(result == MovementResult::Success) this->verticalTravelSteps = this->stepEngine.getStepsTaken(MotorAxis::Vertical);
+    this->measuringVerticalTravel = false;
+  }
 
-    delay(200);
+  return result;
+}
 
-    this->releaseCurrentFromMotors();
-    this->setClutchPosition(HorizontalClutchPosition::Disengage);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::waitForMovement() {
+  MovementResult result = this->pollMovement();
 
-    return MovementResult::Success;
+  while(result == MovementResult::None && this->stepEngine.isBusy()) {
+    this->pollClutch();
+    if(this->movementIdleHandler != NULL) this->movementIdleHandler();
+
+    result = this->pollMovement();
+  }
+
+  return result;
 }
 
-MovementResult TonearmMovementController::verticalMove(VerticalMovementDirection direction, uint8_t speed) {
-  // Determine the destination sensor based on the direction passed.
-  uint8_t destinationSensor = (direction == VerticalMovementDirection::Up) ? this->verticalUpperLimit : this->verticalLowerLimit;
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::cancelMovement() {
+  this->stepEngine.cancel();
+}
 
-  // Only perform the operation if the tonearm is not already at its destination.
-  if(!this->inputMux.readDigitalValue(destinationSensor)) {
-    // Select vertical movement.
-    digitalWrite(this->motorSelectPin, MotorAxis::Vertical);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+uint16_t TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::getMovementStepCount() {
+  return this->stepEngine.getStepsTaken();
+}
 
-    // Set values needed for movement.
-    unsigned int movementStepCount = 0;
-    this->tonearmMotors.setSpeed(speed);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setMovementIdleHandler(void (*handler)()) {
+  this->movementIdleHandler = handler;
+}
 
-    // Move the vertical axis until it reaches its destination.
-    while(!this->inputMux.readDigitalValue(destinationSensor)) {
-      this->tonearmMotors.step(direction);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::seekRecordEdge() {
+  return this->finishSeekRecordEdge(this->runHorizontalMove(&TonearmMovementController::beginSeekRecordEdge));
+}
 
-      // If the limit isn't hit within the expected number of steps, the movement failed.
-      if(movementStepCount++ >= this->verticalTimeout) {
-        this->releaseCurrentFromMotors();
-        if(direction == VerticalMovementDirection::Up)
-          return MovementResult::VerticalPositiveDirectionError;
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::horizontalHome() {
+  return this->finishHorizontalHome(this->runHorizontalMove(&TonearmMovementController::beginHorizontalHome));
+}
 
-        else
-          return MovementResult::VerticalNegativeDirectionError;
-      }
-    }
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginSeekRecordEdge() {
+  // The tonearm has to start from home, lowered below the surface of the record, so that it bumps into the record edge.
+  if(TurntableHal::readPin<horizontalHomeSensor>() || !TurntableHal::readMuxInput(verticalLowerLimit)) {
+    return MovementResult::HorizontalClockwiseDirectionError;
+  }
+
+  // The home sensor is also the play sensor, which is where the record edge is measured from. The slack in the gears is
+  // taken up on the way there, so the bump can be watched for as soon as the sensor is reached.
+  StepCommand toPlaySensor = this->buildPlaySensorCommand(HorizontalMovementDirection::Clockwise, MovementResult::HorizontalClockwiseDirectionError);
+
+  StepCommand traverse = this->buildCommand(MotorAxis::Horizontal, HorizontalMovementDirection::Clockwise, this->horizontalTimeout, this->topMotorSpeed);
+  traverse.timeoutResult = MovementResult::HorizontalClockwiseDirectionError;
+  traverse.stallSteps = this->horizontalStallSteps;
+
+  if(this->horizontalEncoder == NULL || this->horizontalStallSteps == 0 ||
+    !this->stepEngine.queueMove(toPlaySensor) || !this->stepEngine.queueMove(traverse)) {
+    this->stepEngine.cancel();
+    return MovementResult::HorizontalClockwiseDirectionError;
+  }
+
+  return MovementResult::None;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::finishSeekRecordEdge(MovementResult result) {
+  if(result != MovementResult::Success) return result;
+
+  // The last few steps were taken against the record edge, while the stall was being detected.
+  uint16_t steps = this->stepEngine.getStepsTaken(MotorAxis::Horizontal);
+  this->measuredRecordEdgeSteps = steps > this->horizontalStallSteps ? steps - this->horizontalStallSteps : 0;
+
+  return result;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+uint16_t TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::getMeasuredRecordEdgeSteps() {
+  return this->measuredRecordEdgeSteps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginMoveToLeadIn() {
+  if(!TurntableHal::readMuxInput(verticalUpperLimit)) return MovementResult::HorizontalClockwiseDirectionError;
+
+  StepCommand command = this->buildCommand(MotorAxis::Horizontal, HorizontalMovementDirection::Clockwise, this->leadInSteps, this->topMotorSpeed);
+  command.decelerationSteps = this->rampSteps[MotorAxis::Horizontal];
+
+  return this->stepEngine.queueMove(command) ? MovementResult::None : MovementResult::HorizontalClockwiseDirectionError;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginMoveToLeadInAndHover(uint8_t speed) {
+  MovementResult result = this->beginMoveToLeadIn();
+  if(result != MovementResult::None || this->verticalTravelSteps <= this->carefulDescentSteps) return result;
+
+  if(!this->stepEngine.queueMove(this->buildApproachCommand(speed))) {
+    this->stepEngine.cancel();
+    return MovementResult::VerticalNegativeDirectionError;
+  }
+
+  return MovementResult::None;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginReturnToRecordEdge() {
+  // The tonearm has to be raised, or it would drag across the record.
+  if(!TurntableHal::readMuxInput(verticalUpperLimit)) return MovementResult::HorizontalCounterclockwiseDirectionError;
+
+  StepCommand toPlaySensor = this->buildPlaySensorCommand(HorizontalMovementDirection::Counterclockwise, MovementResult::HorizontalCounterclockwiseDirectionError);
+
+  // Turning around means taking up the slack in the gears before the tonearm moves again.
+  uint16_t steps = this->horizontalBacklashSteps + this->recordEdgeSteps + this->leadInSteps;
+  StepCommand toLeadIn = this->buildCommand(MotorAxis::Horizontal, HorizontalMovementDirection::Clockwise, steps, this->topMotorSpeed);
+  toLeadIn.decelerationSteps = this->rampSteps[MotorAxis::Horizontal];
+
+  if(!this->stepEngine.queueMove(toPlaySensor) || !this->stepEngine.queueMove(toLeadIn)) {
+    this->stepEngine.cancel();
+    return MovementResult::HorizontalCounterclockwiseDirectionError;
+  }
+
+  return MovementResult::None;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setRecordEdgeSteps(uint16_t steps) {
+  this->recordEdgeSteps = steps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setLeadInSteps(uint16_t steps) {
+  this->leadInSteps = steps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginHorizontalHome() {
+  // The tonearm has to be raised, or it would drag across the record.
+  if(!TurntableHal::readMuxInput(verticalUpperLimit)) {
+    return MovementResult::HorizontalCounterclockwiseDirectionError;
+  }
+
+  return this->beginHorizontalMoveUntilStall(HorizontalMovementDirection::Counterclockwise, MovementResult::HorizontalCounterclockwiseDirectionError, STEP_COMMAND_NO_OVERLAP, 0);
+}
 
-    this->releaseCurrentFromMotors();
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginMoveUpAndHome(uint8_t speed) {
+  // Without the encoder, the homing could never end, so the tonearm isn't lifted either.
+  if(this->horizontalEncoder == NULL || this->horizontalStallSteps == 0) return MovementResult::HorizontalCounterclockwiseDirectionError;
+
+  // A tonearm that is already raised is clear of the record straight away. Anywhere lower, we don't know how far up the
+  // stylus is, so it has to go the full clearance.
+  uint16_t clearanceSteps = TurntableHal::readMuxInput(verticalUpperLimit) ? 0 : this->stylusClearanceSteps;
+
+  if(!this->beginMoveUp(speed)) return MovementResult::VerticalPositiveDirectionError;
+
+  // The dwell is counted from when the homing starts, so it is only ever longer than the clutch needs.
+  return this->beginHorizontalMoveUntilStall(HorizontalMovementDirection::Counterclockwise, MovementResult::HorizontalCounterclockwiseDirectionError, clearanceSteps, this->getClutchRemainingMs());
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::finishHorizontalHome(MovementResult result) {
+  if(result != MovementResult::Success) return result;
+
+  // We bumped into something, but if the home sensor isn't tripped, it wasn't the home mount.
+  if(TurntableHal::readPin<horizontalHomeSensor>()) return MovementResult::HorizontalCounterclockwiseDirectionError;
+
+  if(this->horizontalEncoder != NULL) this->horizontalEncoder->setPosition(0);
+
+  return result;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginHorizontalMoveUntilStall(HorizontalMovementDirection direction, MovementResult timeoutResult, uint16_t overlapSteps, uint16_t dwellMs) {
+  // Without the encoder, a bump can't be told apart from a movement, so the tonearm would push until it timed out.
+  if(this->horizontalEncoder == NULL || this->horizontalStallSteps == 0) return timeoutResult;
+
+  // The slack is taken up slowly, at the start of the ramp.
+  StepCommand backlash = this->buildCommand(MotorAxis::Horizontal, direction, this->horizontalBacklashSteps, this->topMotorSpeed);
+  backlash.profile = MotionProfile::Constant;
+  backlash.stepIntervalTicks = MotionProfileTable::scaleInterval(backlash.stepIntervalTicks, MotionProfileTable::getIntervalFactor(this->motionProfiles[MotorAxis::Horizontal], 0));
+  backlash.overlapSteps = overlapSteps;
+  backlash.dwellMs = dwellMs;
+
+  // A stall is what ends the movement successfully. If all steps are taken without one, the tonearm never reached
+  // whatever it was meant to bump into.
+  StepCommand traverse = this->buildCommand(MotorAxis::Horizontal, direction, this->horizontalTimeout, this->topMotorSpeed);
+  traverse.timeoutResult = timeoutResult;
+  traverse.stallSteps = this->horizontalStallSteps;
+
+  // Once the slack is taken up, the traverse follows straight on, even if the vertical movement is still going.
+  if(overlapSteps != STEP_COMMAND_NO_OVERLAP) traverse.overlapSteps = 0;
+
+  if(!this->stepEngine.queueMove(backlash) || !this->stepEngine.queueMove(traverse)) {
+    this->stepEngine.cancel();
+    return timeoutResult;
   }
 
-  return MovementResult::Success;
+  return MovementResult::None;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+MovementResult TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::runHorizontalMove(MovementResult (TonearmMovementController::*beginMove)()) {
+  // Engage clutch so gears can move the tonearm. It has to be fully engaged before the first step, or the motor would
+  // spin without moving the tonearm, which looks exactly like a stall.
+  this->setClutchPosition(HorizontalClutchPosition::Engage);
+
+  MovementResult result = (this->*beginMove)();
+  if(result == MovementResult::None) result = this->waitForMovement();
+
+  this->setClutchPosition(HorizontalClutchPosition::Disengage);
+
+  return result;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+StepCommand TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::buildPlaySensorCommand(HorizontalMovementDirection direction, MovementResult timeoutResult) {
+  StepCommand command = this->buildCommand(MotorAxis::Horizontal, direction, this->horizontalTimeout, this->topMotorSpeed);
+  command.stopInput = STEP_COMMAND_PIN_INPUT | horizontalHomeSensor;
+  command.stopLevel = direction == HorizontalMovementDirection::Clockwise ? HIGH : LOW;
+  command.timeoutResult = timeoutResult;
+
+  return command;
 }
 
-// This method assumes that the horizontal clutch has already been engaged.
-void TonearmMovementController::horizontalRelativeMove(uint16_t steps, uint8_t speed, HorizontalMovementDirection direction) {
-  // Select horizontal movement.
-  digitalWrite(this->motorSelectPin, MotorAxis::Horizontal);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+StepCommand TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::buildCommand(MotorAxis axis, int8_t direction, uint16_t steps, uint8_t speed) {
+  StepCommand command;
+  command.axis = axis;
+  command.direction = direction;
+  command.steps = steps;
+  command.stepIntervalTicks = this->stepEngine.rpmToStepInterval(speed);
+  command.sequence = this->stepSequences[axis];
+  command.profile = this->motionProfiles[axis];
+  command.accelerationSteps = this->rampSteps[axis];
+  command.decelerationSteps = 0;
+  command.stopInput = STEP_COMMAND_NO_STOP_INPUT;
+  command.stopLevel = HIGH;
+  command.timeoutResult = MovementResult::Success;
+  command.stallSteps = 0;
+  command.stallResult = MovementResult::Success;
+  command.dwellMs = 0;
+  command.overlapSteps = STEP_COMMAND_NO_OVERLAP;
+  command.unmuteStep = STEP_COMMAND_NO_UNMUTE;
+  command.unmuteLagMs = 0;
+
+  return command;
+}
 
-  // Set values needed for movement.
-  unsigned int movementStepCount = 0;
-  this->tonearmMotors.setSpeed(speed);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+StepCommand TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::buildVerticalCommand(VerticalMovementDirection direction, uint8_t speed) {
+  StepCommand command = this->buildCommand(MotorAxis::Vertical, direction, this->verticalTimeout, speed);
 
-  // Move the tonearm by the number of steps passed as an argument.
-  while(movementStepCount++ < steps) {
-    this->tonearmMotors.step(direction);
+  // The movement ends successfully when the destination limit switch is reached. If the limit isn't hit within the 
+  // expected number of steps, the movement failed.
+  if(direction == VerticalMovementDirection::Up) {
+    command.stopInput = verticalUpperLimit;
+    command.timeoutResult = MovementResult::VerticalPositiveDirectionError;
+  }
+  else {
+    command.stopInput = verticalLowerLimit;
+    command.timeoutResult = MovementResult::VerticalNegativeDirectionError;
   }
 
-  this->releaseCurrentFromMotors();
+  return command;
 }
 
-// This is used to release current from both motors so they aren't drawing power when not in use.
-void TonearmMovementController::releaseCurrentFromMotors() {
-    this->tonearmMotors.releaseMotorCurrent();
-    digitalWrite(this->motorSelectPin, LOW);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+StepCommand TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::buildApproachCommand(uint8_t speed) {
+  StepCommand command = this->buildCommand(MotorAxis::Vertical, VerticalMovementDirection::Down, this->verticalTravelSteps - this->carefulDescentSteps, speed);
+  command.decelerationSteps = this->rampSteps[MotorAxis::Vertical];
+  command.stopInput = verticalLowerLimit;
+  command.timeoutResult = MovementResult::Success;
+
+  return command;
 }
 
-void TonearmMovementController::setClutchPosition(HorizontalClutchPosition position) {
-    this->horizontalClutch.immediateStart(position);
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setClutchPosition(HorizontalClutchPosition position) {
+    this->beginClutchPosition(position);
 
+    while(this->isClutchMoving()) {
+      this->pollClutch();
+    }
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginClutchPosition(HorizontalClutchPosition position) {
     if(position == HorizontalClutchPosition::Disengage) {
-      delay(this->clutchEngagementMs);
+      this->beginClutchPosition(position, this->clutchEngagementMs);
     }
     else {
       // Give the clutch additional time to engage because it may not always land in the same spot when disengaging for x ms
-      delay(this->clutchEngagementMs + (this->clutchEngagementMs / 2));
+      this->beginClutchPosition(position, this->clutchEngagementMs + (this->clutchEngagementMs / 2));
     }
-    
-    this->horizontalClutch.immediateStop();
 }
 
-void TonearmMovementController::setClutchEngagementMs(uint16_t ms) {
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::beginClutchPosition(HorizontalClutchPosition position, uint16_t ms) {
+    unsigned long currentMillis = TurntableHal::currentMillis();
+
+    if(this->clutchMoving) {
+      // Already on its way there, so keep going for whichever is longer.
+      if(this->clutchTarget == position) {
+        unsigned long elapsedMs = currentMillis - this->clutchStartMillis;
+        if(elapsedMs < this->clutchDurationMs && ms <= this->clutchDurationMs - elapsedMs) return;
+      }
+
+      // The clutch can't change direction halfway, so the current movement is finished first.
+      else {
+        while(this->isClutchMoving()) this->pollClutch();
+        currentMillis = TurntableHal::currentMillis();
+      }
+    }
+
+    this->clutchMoving = true;
+    this->clutchTarget = position;
+    this->clutchStartMillis = currentMillis;
+    this->clutchDurationMs = ms;
+
+    EventTrace::record(TraceEventType::ClutchStart, position, ms);
+    TurntableHal::startClutch(position);
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::pollClutch() {
+    if(this->clutchMoving && (TurntableHal::currentMillis() - this->clutchStartMillis) >= this->clutchDurationMs) {
+      TurntableHal::stopClutch();
+      this->clutchMoving = false;
+
+      EventTrace::record(TraceEventType::ClutchStop, this->clutchTarget, 0);
+    }
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+bool TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::isClutchMoving() {
+    return this->clutchMoving;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+uint16_t TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::getClutchRemainingMs() {
+    if(!this->clutchMoving) return 0;
+
+    unsigned long elapsedMs = TurntableHal::currentMillis() - this->clutchStartMillis;
+
+    return elapsedMs >= this->clutchDurationMs ? 0 : this->clutchDurationMs - elapsedMs;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setClutchEngagementMs(uint16_t ms) {
   this->clutchEngagementMs = ms;
 }
 
-void TonearmMovementController::setTopMotorSpeed(uint8_t topSpeed) {
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setTopMotorSpeed(uint8_t topSpeed) {
   this->topMotorSpeed = topSpeed;
 }
 
-void TonearmMovementController::setVerticalTimeout(unsigned int timeout) {
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setVerticalTimeout(unsigned int timeout) {
   this->verticalTimeout = timeout;
-}
\ No newline at end of file
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setMotionProfile(MotorAxis axis, MotionProfile profile, uint16_t rampSteps) {
+  this->motionProfiles[axis] = profile;
+  this->rampSteps[axis] = rampSteps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setStepSequence(MotorAxis axis, StepSequence sequence) {
+  this->stepSequences[axis] = sequence;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setStepHoldMicros(uint16_t us) {
+  this->stepEngine.setHoldTicks(us * STEP_TIMER_TICKS_PER_MICROSECOND);
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setAudioMuteTiming(uint16_t leadMs, uint16_t lagMs) {
+  this->audioMuteLeadMs = leadMs;
+  this->audioMuteLagMs = lagMs;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setCarefulDescentSteps(uint16_t steps) {
+  this->carefulDescentSteps = steps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setStylusClearanceSteps(uint16_t steps) {
+  this->stylusClearanceSteps = steps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+uint16_t TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::getVerticalTravelSteps() {
+  return this->verticalTravelSteps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setHorizontalEncoder(QuadratureEncoder& encoder) {
+  this->horizontalEncoder = &encoder;
+  this->stepEngine.setStallEncoder(&encoder);
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setHorizontalStallSteps(uint8_t steps) {
+  this->horizontalStallSteps = steps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setHorizontalBacklashSteps(uint8_t steps) {
+  this->horizontalBacklashSteps = steps;
+}
+
+template<uint8_t verticalLowerLimit, uint8_t verticalUpperLimit, uint8_t horizontalHomeSensor>
+void TonearmMovementController<verticalLowerLimit, verticalUpperLimit, horizontalHomeSensor>::setHorizontalTimeout(unsigned int timeout) {
+  this->horizontalTimeout = timeout;
+}
+
+// The turntable's tonearm controller.
+template class TonearmMovementController<
+  MultiplexerInput::VerticalLowerLimit,
+  MultiplexerInput::VerticalUpperLimit,
+  ArduinoPin::HorizontalHomeOrPlayOpticalSensor
+>;
@@ -2,46 +2,35 @@
 // It may have other uses outside of the specific scenarios where it is used here, but that should
 // be investigated on an individual basis by whoever stumbles upon this code.
 #include "arduino.h"
-#include <Stepper.h>
-#include <Multiplexer.h>
-#include <DcMotor.h>
+#include "TurntableHal.h"
 #include "enums/MotorAxis.h"
 #include "enums/HorizontalMovementDirection.h"
 #include "enums/VerticalMovementDirection.h"
 #include "enums/MovementResult.h"
 #include "enums/HorizontalClutchPosition.h"
+#include "enums/MotionProfile.h"
+#include "enums/StepSequence.h"
+#include "StepEngine.h"
+#include "QuadratureEncoder.h"
+#include "enums/ArduinoPin.h"
+#include "enums/MultiplexerInput.h"
 
 #ifndef TonearmMovementController_h
 #define TonearmMovementController_h
 
+// The limit switches and the home sensor are template parameters rather than fields, so that we know which direction
+// the tonearm should move to reach a particular sensor without storing it, and reading the home sensor is a single
+// instruction. The controller for the turntable's own sensors is instantiated in TonearmMovementController.cpp.
+template<
+    uint8_t verticalLowerLimit,  // mux input pin
+    uint8_t verticalUpperLimit,  // mux input pin
+    uint8_t horizontalHomeSensor // arduino input pin, LOW while the tonearm is over the home position
+>
 class TonearmMovementController {
     public:
 
         // Constructor
-        TonearmMovementController(
-            Multiplexer inputMux,
-            Stepper tonearmMotors, 
-            uint8_t motorSelectPin, // arduino output pin
-            DcMotor horizontalClutch, 
-            uint8_t verticalLowerLimit, // mux input pin
-            uint8_t verticalUpperLimit  // mux input pin
-        );
-
-        // Move the tonearm horizontally until it reaches the destination sensor.
-        // destinationSensor - The sensor that the tonearm is traveling to. This sensor MUST be from the multiplexer passed through the constructor.
-        // timeout - The number of steps that should be taken before an error occurs.
-        // calibration - The number of steps that should be taken after the sensor is reached.
-        // speed - The speed, in RPM, that the motor moving the tonearm should spin.
-        // DEPRECATED. To be removed in future version.
-        MovementResult moveTonearmHorizontally(uint8_t destinationSensor, unsigned int timeout, int calibration, uint8_t speed);
-        
-        // Move the tonearm horizontally by the given step count. This is a blind movement, meaning there is no check 
-        // at the end that the tonearm successfully moved all steps.
-        // steps - The number of steps the tonearm should move.
-        // speed - The speed, in RPM, that the motor moving the tonearm should spin.
-        // direction - The direction the tonearm should be moving.
-        // DEPRECATED. To be removed in future version.
-        void horizontalRelativeMove(uint16_t steps, uint8_t speed, HorizontalMovementDirection direction);
+        TonearmMovementController(uint16_t stepsPerRevolution);
 
         // Move the tonearm up until it bumps the upper limit.
         MovementResult moveUp(uint8_t speed);
@@ -49,68 +38,282 @@ class TonearmMovementController {
         // Move the tonearm down until it bumps the lower limit.
         MovementResult moveDown(uint8_t speed);
 
+        // Move the tonearm down until it bumps the lower limit, slowing down to the careful speed for only the last
+        // steps before the limit (see setCarefulDescentSteps). If the tonearm isn't starting from the upper limit, or
+        // the length of the vertical travel hasn't been measured by an upward movement yet, the whole movement is careful.
+        MovementResult moveDownCarefully(uint8_t speed, uint8_t carefulSpeed);
+
+        // Start moving the tonearm up until it bumps the upper limit, returning as soon as the movement is queued.
+        // Returns false if the movement queue is full.
+        bool beginMoveUp(uint8_t speed);
+
+        // Start moving the tonearm down until it bumps the lower limit, returning as soon as the movement is queued.
+        // Returns false if the movement queue is full.
+        bool beginMoveDown(uint8_t speed);
+
+        // Start moving the tonearm down carefully (see moveDownCarefully), returning as soon as the movement is queued.
+        // Returns false if the movement queue is full.
+        bool beginMoveDownCarefully(uint8_t speed, uint8_t carefulSpeed);
+
+        // Whether the tonearm is currently moving, or has movements queued.
+        bool isMoving();
+
+        // Check on the movement in progress. This must be called regularly while the tonearm is moving, because it is
+        // what stops a vertical movement once its limit switch is reached.
+        // Returns MovementResult::None while still moving, otherwise the result of the last movement.
+        MovementResult pollMovement();
+
+        // Wait for all queued movements to finish, calling the movement idle handler while waiting.
+        MovementResult waitForMovement();
+
+        // Stop the tonearm where it is and discard any queued movements.
+        void cancelMovement();
+
+        // The number of steps taken by the current (or most recent) movement.
+        uint16_t getMovementStepCount();
+
+        // Set a function that is called repeatedly while a blocking movement is in progress, i.e. to keep monitoring
+        // the command buttons. It may call cancelMovement() to stop the movement early.
+        void setMovementIdleHandler(void (*handler)());
+
         // Move clockwise until we bump into the record edge, then stop. 
         // This method expects that the tonearm is horizontally homed and in the DOWN vertical position. If it is not, 
         // then it will return an error, because this situation should not occur.
+        // The bump is detected by the horizontal encoder no longer moving while the motor steps, so the whole traverse is
+        // made at the top motor speed. On the way, the play sensor is passed, and the number of steps from there to the
+        // record edge is measured (see getMeasuredRecordEdgeSteps).
         MovementResult seekRecordEdge();
 
         // Move counterclockwise until we bump into the home mount.
         // If we bump into something before the home sensor is tripped, throw an error, because we aren't home!
         // This method expects the tonearm to already be in the UP vertical position. If it isn't, it will return an error.
+        // Once home, the horizontal encoder position is set to zero.
         MovementResult horizontalHome();
 
+        // Start seeking the record edge (see seekRecordEdge), returning as soon as the movement is queued. The clutch
+        // must already be engaged, and is left engaged. Once the movement is done, its result must be passed through
+        // finishSeekRecordEdge().
+        // Returns MovementResult::None if the movement was queued, otherwise the error.
+        MovementResult beginSeekRecordEdge();
+
+        // Measure how far past the play sensor a successful seek found the record edge.
+        // Returns the final result of the seek.
+        MovementResult finishSeekRecordEdge(MovementResult result);
+
+        // The number of steps from the play sensor to the record edge, as measured by the last successful seek, or zero
+        // if there hasn't been one.
+        uint16_t getMeasuredRecordEdgeSteps();
+
+        // Start moving the tonearm clockwise by the lead-in steps, from just outside the record edge to over the lead-in
+        // groove, returning as soon as the movement is queued. The tonearm must be raised, and the clutch engaged.
+        // Returns MovementResult::None if the movement was queued, otherwise the error.
+        MovementResult beginMoveToLeadIn();
+
+        // Start moving the tonearm to over the lead-in groove (see beginMoveToLeadIn), and then down at the given speed
+        // to where a careful descent slows down, returning as soon as the movements are queued. The stylus is still clear
+        // of the record there, and a moveDownCarefully() from it is careful the whole way, so only the slow part of
+        // setting the tonearm down is left. If the vertical travel hasn't been measured yet, the tonearm is left raised.
+        // Returns MovementResult::None if the movements were queued, otherwise the error.
+        MovementResult beginMoveToLeadInAndHover(uint8_t speed);
+
+        // Start moving the tonearm back to the start of the record without going home, returning as soon as the movement
+        // is queued. It moves counterclockwise until it reaches the play sensor, then clockwise by the record edge steps
+        // and the lead-in steps. The tonearm must be raised, and the clutch engaged.
+        // Returns MovementResult::None if the movement was queued, otherwise the error.
+        MovementResult beginReturnToRecordEdge();
+
+        // Set the number of steps from the play sensor to the record edge that beginReturnToRecordEdge() moves.
+        void setRecordEdgeSteps(uint16_t steps);
+
+        // Set the number of steps from the record edge to over the lead-in groove.
+        void setLeadInSteps(uint16_t steps);
+
+        // Start homing the tonearm horizontally (see horizontalHome), returning as soon as the movement is queued. The
+        // clutch must already be engaged, and is left engaged. Once the movement is done, its result must be passed
+        // through finishHorizontalHome().
+        // Returns MovementResult::None if the movement was queued, otherwise the error.
+        MovementResult beginHorizontalHome();
+
+        // Start lifting the tonearm and homing it horizontally as one coordinated movement, returning as soon as it is
+        // queued. The homing starts as soon as the lift has taken the stylus clearance steps (see
+        // setStylusClearanceSteps), with the steps of both motors interleaved from then on, rather than once the upper
+        // limit is reached. The clutch must already be engaging; the first horizontal step waits for whatever is left of
+        // its movement. Once the movement is done, its result must be passed through finishHorizontalHome().
+        // Returns MovementResult::None if the movement was queued, otherwise the error.
+        MovementResult beginMoveUpAndHome(uint8_t speed);
+
+        // Check that a horizontal homing movement really ended at the home mount, and zero the encoder if it did.
+        // Returns the final result of the homing.
+        MovementResult finishHorizontalHome(MovementResult result);
+
+        // Set the encoder that measures the horizontal position of the tonearm, which is used to detect a bump during
+        // horizontal movements.
+        void setHorizontalEncoder(QuadratureEncoder& encoder);
+
+        // Set how many steps in a row the horizontal motor can take without the encoder changing before the tonearm is
+        // considered stalled. This should be a few more steps than it takes to move the tonearm by one encoder count.
+        void setHorizontalStallSteps(uint8_t steps);
+
+        // Set how many steps the horizontal motor takes at the start of a movement to take up the slack in the gears,
+        // before stall detection begins.
+        void setHorizontalBacklashSteps(uint8_t steps);
+
+        // Set the max number of steps that the tonearm can travel horizontally before being considered in error.
+        void setHorizontalTimeout(unsigned int timeout);
+
         // Set the value for how long it is expected that the clutch will take to engage or disengage from the horizontal gears.
         void setClutchEngagementMs(uint16_t ms);
 
         // Set the position of the horizontal clutch, while also accounting for the delay and shutting off the motor at the end of the movement.
+        // If the clutch is already moving, this waits for it to finish first.
         void setClutchPosition(HorizontalClutchPosition position);
 
-        // Set the top motor speed that the horizontal motor can travel. This is only used after the horizontal sensor has been found and
-        // we are applying the calibration relative move.
+        // Start moving the horizontal clutch, returning right away. The clutch motor is shut off by pollClutch() once
+        // the engagement time has passed. If the clutch is already moving towards the same position, it carries on
+        // with whichever movement ends later.
+        void beginClutchPosition(HorizontalClutchPosition position);
+
+        // Start moving the horizontal clutch for the given number of milliseconds, i.e. for a longer first movement
+        // from an unknown position at startup.
+        void beginClutchPosition(HorizontalClutchPosition position, uint16_t ms);
+
+        // Shut off the clutch motor once its movement time has passed. This is called while waiting for any movement,
+        // and must otherwise be called regularly from the main loop.
+        void pollClutch();
+
+        // Whether the clutch motor is currently running.
+        bool isClutchMoving();
+
+        // Set the top motor speed that the horizontal motor can travel. Movements that end by bumping into something are
+        // made at this speed, since the bump is caught within a few steps.
         void setTopMotorSpeed(uint8_t topSpeed);
 
         // Set the max number of steps that the tonearm can travel vertically before being considered in error.
         void setVerticalTimeout(unsigned int timeout);
 
+        // Set how the given motor speeds up at the start of a movement, and slows down at the end of it, and how many
+        // steps that takes.
+        void setMotionProfile(MotorAxis axis, MotionProfile profile, uint16_t rampSteps);
+
+        // Set the coil sequence that the given motor is stepped with. Step counts and speeds mean the same thing in every
+        // sequence, so this can be changed without recalibrating anything.
+        void setStepSequence(MotorAxis axis, StepSequence sequence);
+
+        // Set how long, in microseconds, the motor coils stay on after each step of a slow movement (see
+        // StepEngine::setHoldTicks). Zero keeps them on for the whole movement.
+        void setStepHoldMicros(uint16_t us);
+
+        // Set how the audio is muted around the stylus leaving and meeting the record. Lifting the tonearm off the
+        // lower limit mutes the audio leadMs before the first step, and unmutes it lagMs after the step that takes the
+        // stylus clear of the record (see setStylusClearanceSteps). Lowering it mutes the audio straight away, and once
+        // the lower limit is reached, unmutes it lagMs later. A descent that fails leaves the audio muted.
+        void setAudioMuteTiming(uint16_t leadMs, uint16_t lagMs);
+
+        // Set how many steps before the lower limit a careful descent slows down to the careful speed.
+        void setCarefulDescentSteps(uint16_t steps);
+
+        // Set how many steps up from the lower limit the stylus is clear of the record, after which a coordinated
+        // movement (see beginMoveUpAndHome) can start moving the tonearm horizontally.
+        void setStylusClearanceSteps(uint16_t steps);
+
+        // The number of steps between the lower and upper vertical limits, as measured by the last upward movement that
+        // started from the lower limit, or zero if it hasn't been measured yet.
+        uint16_t getVerticalTravelSteps();
+
     private:       
-        // Move the tonearm vertically until it reaches the destination limit switch.
-        // direction - The direction that the tonearm should be moving.
-        // speed - The speed, in RPM, that the motor moving the tonearm should spin.
-        MovementResult verticalMove(VerticalMovementDirection direction, uint8_t speed);
+        // A movement of the given motor at the given speed, using its motion profile to speed up. It has no stop input,
+        // no stall detection, and doesn't slow down at the end; the caller fills in whatever it needs on top of that.
+        StepCommand buildCommand(MotorAxis axis, int8_t direction, uint16_t steps, uint8_t speed);
 
-        // Set all pins that the motor is using to LOW, as well as the motor demultiplexer.
-        void releaseCurrentFromMotors();
+        // A horizontal movement at the top motor speed that ends once the tonearm reaches the play sensor. Moving
+        // clockwise, that is when the sensor goes HIGH, and counterclockwise, when it goes LOW.
+        StepCommand buildPlaySensorCommand(HorizontalMovementDirection direction, MovementResult timeoutResult);
 
-        // Multiplexer that we are reading all sensor values from
-        Multiplexer inputMux;
+        // A movement of the tonearm vertically that ends once it reaches the destination limit switch.
+        // direction - The direction that the tonearm should be moving.
+        // speed - The speed, in RPM, that the motor moving the tonearm should spin.
+        StepCommand buildVerticalCommand(VerticalMovementDirection direction, uint8_t speed);
 
-        // This represents either the vertical or horizontal stepper motor, denoted by the motorSelectPin.
-        Stepper tonearmMotors;
+        // A movement of the raised tonearm down at the given speed to where a careful descent slows down, which ends
+        // successfully whether it takes all of its steps or reaches the lower limit early.
+        StepCommand buildApproachCommand(uint8_t speed);
 
-        // This is the pin that we use to select the vertical or horizontal stepper motors for movement. Only one
-        // motor can be moving at a time.
-        uint8_t motorSelectPin;
+        // Queue a movement of the tonearm horizontally until it bumps into something. A movement that takes every step
+        // in the horizontal timeout without a bump fails with the timeoutResult.
+        // overlapSteps - How far a vertical movement still in progress has to get before this one starts alongside it
+        //                (see StepCommand::overlapSteps).
+        // dwellMs - How long, in milliseconds, to wait before the first step.
+        // Returns MovementResult::None if the movement was queued, otherwise the error.
+        MovementResult beginHorizontalMoveUntilStall(HorizontalMovementDirection direction, MovementResult timeoutResult, uint16_t overlapSteps, uint16_t dwellMs);
 
-        // This is the pin that the horizontal solenoid is attached to, which will engage the gears for movement.
-        uint8_t horizontalSolenoidPin;
+        // Engage the clutch, queue and wait for a horizontal movement using the given begin method, then disengage the clutch.
+        MovementResult runHorizontalMove(MovementResult (TonearmMovementController::*beginMove)());
 
-        // We need to know which mux pins are the upper and lower limit so we know which direction the tonearm should move
-        // when we want to go to a particular sensor.
-        uint8_t verticalLowerLimit;
-        uint8_t verticalUpperLimit;
+        // How many milliseconds are left of the clutch movement in progress, or zero if the clutch isn't moving.
+        uint16_t getClutchRemainingMs();
 
-        // This is used to engage and disengage the gears that drive the horizontal movement of the tonearm.
-        DcMotor horizontalClutch;
+        // Measures the horizontal position of the tonearm.
+        QuadratureEncoder* horizontalEncoder;
 
         // How long it is estimated that the clutch takes to engage or disengage.
         uint16_t clutchEngagementMs;
 
-        // The top motor speed that the horizontal motor can travel. This is only used after the horizontal sensor has been found and
-        // we are applying the calibration relative move.
+        // The clutch movement in progress, if any.
+        bool clutchMoving;
+        HorizontalClutchPosition clutchTarget;
+        unsigned long clutchStartMillis;
+        uint16_t clutchDurationMs;
+
+        // The top motor speed that the horizontal motor can travel.
         uint8_t topMotorSpeed;
 
         // If this step count is reached while making a vertical movement, the movement has failed and an error will be returned.
         unsigned int verticalTimeout;
+
+        // The motion profile of each motor, indexed by MotorAxis.
+        MotionProfile motionProfiles[2];
+        uint16_t rampSteps[2];
+
+        // The coil sequence of each motor, indexed by MotorAxis.
+        StepSequence stepSequences[2];
+
+        // Careful descents only slow down for this many steps before the lower limit.
+        uint16_t carefulDescentSteps;
+
+        // The measured number of steps between the vertical limits, and whether the movement in progress is measuring it.
+        uint16_t verticalTravelSteps;
+        bool measuringVerticalTravel;
+
+        // The steps up from the lower limit before the stylus is clear of the record.
+        uint16_t stylusClearanceSteps;
+
+        // Audio muting around vertical movements, and whether the movement in progress unmutes the audio when it succeeds.
+        uint16_t audioMuteLeadMs;
+        uint16_t audioMuteLagMs;
+        bool unmutingAudio;
+
+        // The steps from the play sensor to the record edge: as used when returning to it, and as last measured.
+        uint16_t recordEdgeSteps;
+        uint16_t measuredRecordEdgeSteps;
+        uint16_t leadInSteps;
+
+        // Calibration values for horizontal movements.
+        uint8_t horizontalStallSteps;
+        uint8_t horizontalBacklashSteps;
+        unsigned int horizontalTimeout;
+
+        // Steps the motors from a timer interrupt, so that movements do not block the main loop.
+        StepEngine stepEngine;
+
+        // Called repeatedly while waiting for a movement to finish.
+        void (*movementIdleHandler)();
 };
 
+// The tonearm controller for the turntable's own limit switches and home sensor.
+typedef TonearmMovementController<
+    MultiplexerInput::VerticalLowerLimit,
+    MultiplexerInput::VerticalUpperLimit,
+    ArduinoPin::HorizontalHomeOrPlayOpticalSensor
+> TurntableTonearmController;
+
 #endif
@@ -0,0 +1,420 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include <DcMotor.h>
+#include <EEPROM.h>
+#include <avr/sleep.h>
+#include "TurntableHal.h"
+#include "MultiplexerScanner.h"
+#include "StepperCoilDriver.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+#include "enums/MultiplexerInput.h"
+
+// Though this is one coil driver, it actually drives both the vertical and horizontal stepper motors. Which one is
+// currently active is determined by the ArduinoPin::MotorAxisSelector. The pins are in the order that the coils are
+// energized when stepping forwards.
+static StepperCoilDriver tonearmMotor = StepperCoilDriver(
+  ArduinoPin::StepperPin4,
+  ArduinoPin::StepperPin3,
+  ArduinoPin::StepperPin2,
+  ArduinoPin::StepperPin1
+);
+
+// The multiplexer monitors most input values that we read to determine the statuses of various sensors. All eight
+// inputs are scanned at once, and reads are answered from the latest snapshot.
+static MultiplexerScanner<
+  ArduinoPin::MuxOutput,
+  ArduinoPin::MuxSelectorA,
+  ArduinoPin::MuxSelectorB,
+  ArduinoPin::MuxSelectorC
+> mux;
+
+// The tonearmClutch allows us to engage or disengage the horizontal gearing to either allow for automatic
+// movement (engaged), or manual movement (disengaged).
+static DcMotor horizontalClutch = DcMotor(
+  ArduinoPin::HorizontalClutchMotorDir1,
+  ArduinoPin::HorizontalClutchMotorDir2
+);
+
+#ifdef TURNTABLE_MOTOR_TRIM_PIN
+// The period of the turntable motor trim PWM, in F_CPU / 2 ticks (2ms, or 500Hz).
+#define MOTOR_TRIM_PWM_PERIOD_TICKS 16000
+
+// How long each half of the turntable motor trim PWM period lasts, and which half we are in.
+static volatile uint16_t motorTrimOnTicks = 0;
+static volatile uint16_t motorTrimOffTicks = 0;
+static volatile bool motorTrimHigh = false;
+#endif
+
+// Set the AudioPassController's Audio off line, if AUDIO_MUTE_PIN is assigned. This is called from the RTC interrupt.
+static inline void writeAudioMuteOutput(bool muted) {
+#ifdef AUDIO_MUTE_PIN
+  FastPin<AUDIO_MUTE_PIN>::write(muted);
+#endif
+}
+
+// Called by the step timer interrupt.
+static void (*stepTimerHandler)() = NULL;
+
+// Called by the loop tick interrupt.
+static void (*tickHandler)() = NULL;
+
+// Called by the loop tick interrupt, before the tick handler, to multiplex the display.
+static void (*displayRefreshHandler)() = NULL;
+
+// Called by the speed sensor input capture interrupt.
+static void (*speedCaptureHandler)(unsigned long timestampMicros) = NULL;
+
+// Called by the pickup encoder pin change interrupts.
+static void (*pickupEncoderHandler)(uint8_t state) = NULL;
+
+// Both pickup encoder channels share one interrupt handler, since either edge needs both channels to be decoded.
+static void onPickupEncoderChange() {
+  if(pickupEncoderHandler != NULL) pickupEncoderHandler(TurntableHal::readPickupEncoderState());
+}
+
+void TurntableHal::begin() {
+  pinMode(ArduinoPin::MotorAxisSelector, OUTPUT);
+  pinMode(ArduinoPin::MovementStatusLed, OUTPUT);
+  pinMode(ArduinoPin::PauseStatusLed, OUTPUT);
+  pinMode(ArduinoPin::SpeedSensor, INPUT);
+  pinMode(ArduinoPin::TurntableMotorEnable, OUTPUT);
+
+#ifdef AUDIO_MUTE_PIN
+  pinMode(AUDIO_MUTE_PIN, OUTPUT);
+#endif
+#ifdef TURNTABLE_MOTOR_TRIM_PIN
+  pinMode(TURNTABLE_MOTOR_TRIM_PIN, OUTPUT);
+#endif
+#ifdef SPEED_SWITCH_OFF_PIN
+  pinMode(SPEED_SWITCH_OFF_PIN, INPUT);
+#endif
+
+  mux.setSettleMicros(MULTIPLEXER_DELAY_MICROS);
+  mux.setMaxAgeMicros(MULTIPLEXER_MAX_AGE_MICROS);
+
+  // The buttons and switches are debounced. The limit switches are not, since the first touch is what stops a movement.
+  mux.setDebounce(
+    (1 << MultiplexerInput::PlayHomeButton) | (1 << MultiplexerInput::PauseButton) | (1 << MultiplexerInput::AutoManualSwitch) |
+    (1 << MultiplexerInput::TargetSpeedA) | (1 << MultiplexerInput::TargetSpeedB) | (1 << MultiplexerInput::WaitUntilTargetSpeed),
+    MULTIPLEXER_DEBOUNCE_SCANS
+  );
+  mux.begin();
+  tonearmMotor.begin();
+}
+
+bool TurntableHal::readPin(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+void TurntableHal::writePin(uint8_t pin, bool value) {
+  digitalWrite(pin, value);
+}
+
+bool TurntableHal::readMuxInput(uint8_t input) {
+  return mux.read(input);
+}
+
+unsigned long TurntableHal::getMuxScanCount() {
+  return mux.getScanCount();
+}
+
+unsigned long TurntableHal::currentMillis() {
+  return millis();
+}
+
+unsigned long TurntableHal::currentMicros() {
+  return micros();
+}
+
+void TurntableHal::waitMs(unsigned long ms) {
+  delay(ms);
+}
+
+void TurntableHal::waitMicros(unsigned int us) {
+  delayMicroseconds(us);
+}
+
+void TurntableHal::selectMotorAxis(MotorAxis axis) {
+  // Both motors share the coil pins, so they are switched off while the demultiplexer changes over. Otherwise, the
+  // motor being switched to would briefly be given the other motor's coil pattern.
+  if(axis != tonearmMotor.getAxis()) tonearmMotor.release();
+
+  FastPin<ArduinoPin::MotorAxisSelector>::write(axis);
+  tonearmMotor.selectAxis(axis);
+}
+
+void TurntableHal::setTonearmStepSequence(StepSequence sequence) {
+  tonearmMotor.setSequence(sequence);
+}
+
+void TurntableHal::stepTonearmMotor(int8_t direction) {
+  tonearmMotor.step(direction);
+}
+
+void TurntableHal::releaseTonearmMotor() {
+  tonearmMotor.release();
+  FastPin<ArduinoPin::MotorAxisSelector>::write(LOW);
+}
+
+void TurntableHal::releaseTonearmCoils() {
+  tonearmMotor.release();
+}
+
+void TurntableHal::setMovementStatusLed(bool on) {
+  FastPin<ArduinoPin::MovementStatusLed>::write(on);
+}
+
+void TurntableHal::setAudioMuted(bool muted) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  RTC.INTCTRL &= ~RTC_CMP_bm;
+  writeAudioMuteOutput(muted);
+
+  SREG = oldSREG;
+}
+
+void TurntableHal::unmuteAudioAfter(uint16_t ms) {
+  if(ms == 0) {
+    TurntableHal::setAudioMuted(false);
+    return;
+  }
+
+  if(ms > 7999) ms = 7999;
+
+  // The RTC counts at 8.192kHz, so this is ms * 8.192, rounded.
+  uint16_t counts = ((unsigned long)ms * 1024 + 62) / 125;
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  while(RTC.STATUS & RTC_CMPBUSY_bm);
+  RTC.CMP = RTC.CNT + counts;
+  RTC.INTFLAGS = RTC_CMP_bm;
+  RTC.INTCTRL |= RTC_CMP_bm;
+
+  SREG = oldSREG;
+}
+
+void TurntableHal::startClutch(HorizontalClutchPosition position) {
+  horizontalClutch.immediateStart(position);
+}
+
+void TurntableHal::stopClutch() {
+  horizontalClutch.immediateStop();
+}
+
+void TurntableHal::setTurntableMotorEnabled(bool enabled) {
+  FastPin<ArduinoPin::TurntableMotorEnable>::write(enabled);
+}
+
+void TurntableHal::setTurntableMotorTrim(uint8_t duty) {
+#ifdef TURNTABLE_MOTOR_TRIM_PIN
+  // Fully off or fully on doesn't need the timer at all.
+  if(duty == 0 || duty == 255) {
+    TCB1.INTCTRL = 0;
+    TCB1.CTRLA = 0;
+    motorTrimHigh = duty == 255;
+    FastPin<TURNTABLE_MOTOR_TRIM_PIN>::write(motorTrimHigh);
+    return;
+  }
+
+  noInterrupts();
+  motorTrimOnTicks = ((unsigned long)MOTOR_TRIM_PWM_PERIOD_TICKS * duty) >> 8;
+  motorTrimOffTicks = MOTOR_TRIM_PWM_PERIOD_TICKS - motorTrimOnTicks;
+  interrupts();
+
+  // The trim pin may have no PWM hardware behind it, so TCB1 toggles it instead, with its period set to the length of
+  // whichever half of the PWM cycle is next. That is only two interrupts per cycle, whatever the duty. The core only
+  // uses TCB1 for PWM on pin 3, which we never call analogWrite() on.
+  if(!(TCB1.CTRLA & TCB_ENABLE_bm)) {
+    motorTrimHigh = true;
+    FastPin<TURNTABLE_MOTOR_TRIM_PIN>::write(HIGH);
+
+    TCB1.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB1.CNT = 0;
+    TCB1.CCMP = motorTrimOnTicks;
+    TCB1.INTFLAGS = TCB_CAPT_bm;
+    TCB1.INTCTRL = TCB_CAPT_bm;
+    TCB1.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+  }
+#endif
+}
+
+bool TurntableHal::isSpeedSwitchOff() {
+#ifdef SPEED_SWITCH_OFF_PIN
+  return FastPin<SPEED_SWITCH_OFF_PIN>::read();
+#else
+  return false;
+#endif
+}
+
+void TurntableHal::startStepTimer(uint16_t intervalTicks, void (*handler)()) {
+  stepTimerHandler = handler;
+
+  // TCB2 is not used by the Arduino core on the Nano Every, so it is free to be our step timer. It runs in periodic
+  // interrupt mode, firing once every step interval.
+  TCB2.CTRLA = 0;
+  TCB2.CTRLB = TCB_CNTMODE_INT_gc;
+  TCB2.CNT = 0;
+  TCB2.CCMP = intervalTicks;
+  TCB2.INTFLAGS = TCB_CAPT_bm;
+  TCB2.INTCTRL = TCB_CAPT_bm;
+  TCB2.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+// In periodic interrupt mode, the count has only just restarted when the step interrupt runs, so CCMP can be written
+// without the count having passed it.
+void TurntableHal::setStepTimerInterval(uint16_t intervalTicks) {
+  TCB2.CCMP = intervalTicks;
+}
+
+void TurntableHal::stopStepTimer() {
+  TCB2.INTCTRL = 0;
+  TCB2.CTRLA = 0;
+}
+
+void TurntableHal::beginSpeedCapture(void (*handler)(unsigned long timestampMicros)) {
+  speedCaptureHandler = handler;
+
+  // The speed sensor (A3) is PD0. Route it through event channel 2 (where PORT1 is PORTD) into TCB0. The core only
+  // uses TCB0 for PWM on pin 6, which we never call analogWrite() on.
+  EVSYS.CHANNEL2 = EVSYS_GENERATOR_PORT1_PIN0_gc;
+  EVSYS.USERTCB0 = EVSYS_CHANNEL_CHANNEL2_gc;
+
+  // TCB0 free-runs at F_CPU / 2 and latches its count into CCMP on every rising edge.
+  TCB0.CTRLA = 0;
+  TCB0.CTRLB = TCB_CNTMODE_CAPT_gc;
+  TCB0.EVCTRL = TCB_CAPTEI_bm;
+  TCB0.INTFLAGS = TCB_CAPT_bm;
+  TCB0.INTCTRL = TCB_CAPT_bm;
+  TCB0.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+uint8_t TurntableHal::readPickupEncoderState() {
+  return (FastPin<ArduinoPin::PickupEncoderA>::read() << 1) | FastPin<ArduinoPin::PickupEncoderB>::read();
+}
+
+void TurntableHal::beginPickupEncoderCapture(void (*handler)(uint8_t state)) {
+  pickupEncoderHandler = handler;
+
+  pinMode(ArduinoPin::PickupEncoderA, INPUT);
+  pinMode(ArduinoPin::PickupEncoderB, INPUT);
+  attachInterrupt(digitalPinToInterrupt(ArduinoPin::PickupEncoderA), onPickupEncoderChange, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(ArduinoPin::PickupEncoderB), onPickupEncoderChange, CHANGE);
+}
+
+// Serial1 is the hardware serial port on pins 0 and 1. (Serial is the USB port.)
+void TurntableHal::beginSerial(unsigned long baud) {
+  Serial1.begin(baud);
+}
+
+int TurntableHal::readSerial() {
+  return Serial1.read();
+}
+
+void TurntableHal::writeSerial(const uint8_t* data, uint8_t length) {
+  Serial1.write(data, length);
+}
+
+uint8_t TurntableHal::getSerialWriteSpace() {
+  int space = Serial1.availableForWrite();
+
+  return space > 0xFF ? 0xFF : space;
+}
+
+void TurntableHal::beginTick(void (*handler)()) {
+  tickHandler = handler;
+
+  // The RTC isn't used by the Arduino core. Its periodic interrupt runs from the internal 32.768kHz oscillator, which
+  // keeps running in every sleep mode.
+  while(RTC.STATUS > 0);
+  RTC.CLKSEL = RTC_CLKSEL_INT32K_gc;
+
+  while(RTC.PITSTATUS > 0);
+  RTC.PITINTCTRL = RTC_PI_bm;
+  RTC.PITCTRLA = RTC_PERIOD_CYC64_gc | RTC_PITEN_bm;
+
+  // The counter itself free-runs at 8.192kHz, and its compare match is used as a one-shot timer by unmuteAudioAfter().
+  while(RTC.STATUS > 0);
+  RTC.PER = 0xFFFF;
+  RTC.CTRLA = RTC_PRESCALER_DIV4_gc | RTC_RTCEN_bm;
+}
+
+void TurntableHal::beginDisplayRefresh(void (*handler)()) {
+  displayRefreshHandler = handler;
+}
+
+// The main board doesn't break out any pins for the display yet (every pin of the Nano Every is spoken for), so this does
+// nothing until the display is given pins or an I/O expander. A board with a display connector only needs this method
+// filled in.
+void TurntableHal::writeDisplayDigit(uint8_t digit, uint8_t segments) {
+}
+
+void TurntableHal::sleepUntilInterrupt(volatile uint8_t* wakeFlags) {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+
+  noInterrupts();
+
+  if(*wakeFlags == 0) {
+    sleep_enable();
+
+    // The instruction after interrupts() always runs before any pending interrupt, so the MCU is asleep before an
+    // interrupt can set a flag, and that interrupt is what wakes it.
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+  }
+
+  interrupts();
+}
+
+uint8_t TurntableHal::readEeprom(uint16_t address) {
+  return EEPROM.read(address);
+}
+
+void TurntableHal::writeEeprom(uint16_t address, uint8_t value) {
+  EEPROM.update(address, value);
+}
+
+// The 16-bit capture only spans ~8ms, so it can't time a whole revolution by itself. Instead, it tells us exactly how
+// long ago the edge happened, which we subtract from micros() to get a timestamp that doesn't include interrupt latency.
+ISR(TCB0_INT_vect) {
+  uint16_t ticksSinceEdge = TCB0.CNT - TCB0.CCMP; // Reading CCMP clears the interrupt flag.
+  unsigned long nowMicros = micros();
+
+  if(speedCaptureHandler != NULL) speedCaptureHandler(nowMicros - ticksSinceEdge / STEP_TIMER_TICKS_PER_MICROSECOND);
+}
+
+#ifdef TURNTABLE_MOTOR_TRIM_PIN
+ISR(TCB1_INT_vect) {
+  TCB1.INTFLAGS = TCB_CAPT_bm;
+
+  motorTrimHigh = !motorTrimHigh;
+  FastPin<TURNTABLE_MOTOR_TRIM_PIN>::write(motorTrimHigh);
+  TCB1.CCMP = motorTrimHigh ? motorTrimOnTicks : motorTrimOffTicks;
+}
+#endif
+
+ISR(RTC_PIT_vect) {
+  RTC.PITINTFLAGS = RTC_PI_bm;
+
+  if(displayRefreshHandler != NULL) displayRefreshHandler();
+  if(tickHandler != NULL) tickHandler();
+}
+
+ISR(RTC_CNT_vect) {
+  RTC.INTFLAGS = RTC_CMP_bm;
+  RTC.INTCTRL &= ~RTC_CMP_bm;
+
+  writeAudioMuteOutput(false);
+}
+
+ISR(TCB2_INT_vect) {
+  TCB2.INTFLAGS = TCB_CAPT_bm;
+
+  if(stepTimerHandler != NULL) stepTimerHandler();
+}
@@ -0,0 +1,167 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "enums/MotorAxis.h"
+#include "enums/HorizontalClutchPosition.h"
+#include "enums/StepSequence.h"
+#include "FastPin.h"
+
+#ifndef TurntableHal_h
+#define TurntableHal_h
+
+// The hardware abstraction layer. Every pin, sensor, motor, timer and clock that the firmware touches goes through
+// this class, so the routines never call the Arduino API or the Multiplexer/DcMotor libraries directly.
+// TurntableHal.cpp implements it for the Arduino Nano Every; running the firmware anywhere else only takes linking
+// against a different implementation of these methods.
+class TurntableHal {
+    public:
+
+        // Set up pin modes and the devices attached to them. This must be called at the start of setup().
+        static void begin();
+
+        // Read the digital value of an Arduino pin.
+        static bool readPin(uint8_t pin);
+
+        // Set the digital value of an Arduino output pin.
+        static void writePin(uint8_t pin, bool value);
+
+        // The same as readPin() and writePin(), for pins that are known at compile time, which compile down to a single
+        // instruction. These are inline, so they come from FastPin.h rather than the implementation of this class.
+        template<uint8_t pin> static inline bool readPin() { return FastPin<pin>::read(); }
+        template<uint8_t pin> static inline void writePin(bool value) { FastPin<pin>::write(value); }
+
+        // Read the digital value of one of the multiplexer inputs (see MultiplexerInput.h). This comes from a snapshot
+        // of all the inputs, which is only rescanned once it is older than MULTIPLEXER_MAX_AGE_MICROS.
+        static bool readMuxInput(uint8_t input);
+
+        // The number of times the multiplexer inputs have been scanned since the turntable was powered on.
+        static unsigned long getMuxScanCount();
+
+        // Milliseconds since the turntable was powered on.
+        static unsigned long currentMillis();
+
+        // Microseconds since the turntable was powered on.
+        static unsigned long currentMicros();
+
+        // Block for the given number of milliseconds.
+        static void waitMs(unsigned long ms);
+
+        // Block for the given number of microseconds.
+        static void waitMicros(unsigned int us);
+
+        // Select which tonearm stepper motor receives the step pulses. Only one of them is powered at a time, so moving
+        // both at once means selecting each of them in turn before its step.
+        static void selectMotorAxis(MotorAxis axis);
+
+        // Set the coil sequence that the currently-selected tonearm stepper motor is stepped with. A half step is half
+        // the size of a step in the other sequences.
+        static void setTonearmStepSequence(StepSequence sequence);
+
+        // Move the currently-selected tonearm stepper motor by one step of its sequence in the given direction (1 or -1),
+        // right away.
+        static void stepTonearmMotor(int8_t direction);
+
+        // Set all tonearm stepper motor pins LOW, as well as the motor demultiplexer, so neither motor draws current.
+        static void releaseTonearmMotor();
+
+        // Set all tonearm stepper motor pins LOW, but leave the same motor selected, so the next step carries on where
+        // this one left off. This may be called from the step timer handler.
+        static void releaseTonearmCoils();
+
+        // Light or turn off the movement status LED.
+        static void setMovementStatusLed(bool on);
+
+        // Mute or unmute the audio through AUDIO_MUTE_PIN, cancelling any unmute waiting on unmuteAudioAfter(). This
+        // does nothing if no mute pin is assigned.
+        static void setAudioMuted(bool muted);
+
+        // Unmute the audio the given number of milliseconds (up to 7999) from now. The unmute is timed by the RTC, and
+        // happens from its interrupt, so it lands within a fraction of a millisecond of the target no matter what the
+        // main loop is doing. This needs beginTick() to have been called.
+        static void unmuteAudioAfter(uint16_t ms);
+
+        // Start driving the horizontal clutch motor towards the given position. It keeps running until stopClutch().
+        static void startClutch(HorizontalClutchPosition position);
+
+        // Stop the horizontal clutch motor.
+        static void stopClutch();
+
+        // Switch the turntable motor on or off, through the motor controller's Turntable power logic line. This is a
+        // plain logic level, and is never pulsed.
+        static void setTurntableMotorEnabled(bool enabled);
+
+        // Trim the speed of the turntable motor with the given duty cycle, from 0 (slowest) to 255 (the speed set by
+        // the fine-tune pot), on TURNTABLE_MOTOR_TRIM_PIN. This does nothing if no trim pin is assigned.
+        static void setTurntableMotorTrim(uint8_t duty);
+
+        // Whether the main speed switch is in its center "off" position. This is always false if SPEED_SWITCH_OFF_PIN
+        // is not assigned.
+        static bool isSpeedSwitchOff();
+
+        // Call the handler every intervalTicks step timer ticks (see STEP_TIMER_TICKS_PER_MICROSECOND), from an
+        // interrupt, until stopStepTimer() is called.
+        static void startStepTimer(uint16_t intervalTicks, void (*handler)());
+
+        // Change the interval of the running step timer. When called from the step timer handler, the new interval
+        // applies to the very next step.
+        static void setStepTimerInterval(uint16_t intervalTicks);
+
+        // Stop calling the step timer handler.
+        static void stopStepTimer();
+
+        // Call the handler from an interrupt on every rising edge of the turntable speed sensor, passing the time of
+        // the edge in microseconds. The edge is timestamped by hardware input capture, so the time does not depend on
+        // how long the interrupt took to run.
+        static void beginSpeedCapture(void (*handler)(unsigned long timestampMicros));
+
+        // The current state of the pickup encoder, as (PickupEncoderA << 1) | PickupEncoderB.
+        static uint8_t readPickupEncoderState();
+
+        // Call the handler from an interrupt on every edge of either pickup encoder channel, passing the state of both
+        // channels as (PickupEncoderA << 1) | PickupEncoderB.
+        static void beginPickupEncoderCapture(void (*handler)(uint8_t state));
+
+        // Open the serial port on the ReservedSerial pins. Both directions are buffered by interrupts.
+        static void beginSerial(unsigned long baud);
+
+        // The next byte received on the serial port, or -1 if there is none waiting.
+        static int readSerial();
+
+        // Queue bytes to be sent on the serial port. Check getSerialWriteSpace() first, or this waits for room.
+        static void writeSerial(const uint8_t* data, uint8_t length);
+
+        // The number of bytes that can be queued on the serial port without waiting.
+        static uint8_t getSerialWriteSpace();
+
+        // Call the handler from an interrupt once every LOOP_TICK_MICROS, forever. The tick keeps counting while the MCU
+        // is asleep.
+        static void beginTick(void (*handler)());
+
+        // Call the handler from the tick interrupt, once per tick, to multiplex the display. This needs beginTick() to
+        // have been called as well.
+        static void beginDisplayRefresh(void (*handler)());
+
+        // Light one digit (0 being the leftmost) of the seven-segment display with the given segments (see
+        // SevenSegmentDisplay.h), turning the other digits off. This is called from the tick interrupt. It does nothing
+        // on the current main board, which has no pins for a display.
+        static void writeDisplayDigit(uint8_t digit, uint8_t segments);
+
+        // Put the MCU into idle sleep until the next interrupt, unless the wake flags are already nonzero. The flags are
+        // checked with interrupts off, so a flag set by an interrupt just before the sleep can't be missed.
+        static void sleepUntilInterrupt(volatile uint8_t* wakeFlags);
+
+        // Read a byte from the EEPROM.
+        static uint8_t readEeprom(uint16_t address);
+
+        // Write a byte to the EEPROM. The byte is only written if it has changed, to save wear.
+        static void writeEeprom(uint16_t address, uint8_t value);
+};
+
+// The step timer is clocked at F_CPU / 2, which gives us 8 ticks per microsecond on a 16MHz Nano Every.
+#define STEP_TIMER_TICKS_PER_MICROSECOND 8
+
+// The tick is clocked by the 32.768kHz internal oscillator, and fires every 64 of its cycles (~1.95ms, or 512Hz).
+#define LOOP_TICK_MICROS 1953
+
+#endif
@@ -0,0 +1,232 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "TurntableSpeedMonitor.h"
+#include "TurntableHal.h"
+#include "EventTrace.h"
+
+// Microseconds per minute, divided by ten, over which one revolution's period (also divided by ten) gives its speed in
+// hundredths of an RPM. The divide by ten keeps 60,000,000 * 100 within 32 bits.
+#define CENTI_RPM_PERIOD_DIVIDEND 600000000UL
+
+// Period deviations are squared in units of this many microseconds, and limited to this many units, so the sum of the
+// squares over the window can't overflow 32 bits. That still resolves 0.01% at 78 RPM, and saturates at over 30%.
+#define DEVIATION_SHIFT 4
+#define DEVIATION_LIMIT 16383
+
+// The speed, in hundredths of an RPM, of a revolution that took the given number of microseconds, rounded to the
+// nearest. Speeds too fast to fit (i.e. a glitch on the sensor) are limited to the largest value.
+static uint16_t periodToCentiRpm(unsigned long periodMicros) {
+  unsigned long periodTens = (periodMicros + 5) / 10;
+  if(periodTens <= CENTI_RPM_PERIOD_DIVIDEND / 0xFFFF) return 0xFFFF;
+
+  return (CENTI_RPM_PERIOD_DIVIDEND + periodTens / 2) / periodTens;
+}
+
+// The integer square root of a value, rounded to the nearest.
+static uint16_t squareRoot(unsigned long value) {
+  unsigned long root = 0;
+  unsigned long bit = 1UL << 30;
+
+  while(bit > value) bit >>= 2;
+
+  while(bit != 0) {
+    if(value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else {
+      root >>= 1;
+    }
+
+    bit >>= 2;
+  }
+
+  // What is left of the value is how far it is past the square of the root, which is past halfway to the next square
+  // once it is more than the root.
+  return value > root ? root + 1 : root;
+}
+
+TurntableSpeedMonitor::TurntableSpeedMonitor() {
+    this->pulseHead = 0;
+    this->pulseTail = 0;
+    this->pulsesDropped = false;
+    this->stoppedTimeoutMs = 0;
+
+    this->reset();
+}
+
+void TurntableSpeedMonitor::recordPulse(unsigned long timestampMicros) {
+  uint8_t nextHead = (this->pulseHead + 1) & (SPEED_PULSE_BUFFER_SIZE - 1);
+
+  // If update() has fallen this far behind, drop the pulse rather than overwrite one it hasn't read yet.
+  if(nextHead == this->pulseTail) {
+    this->pulsesDropped = true;
+    return;
+  }
+
+  this->pulseTimestamps[this->pulseHead] = timestampMicros;
+  this->pulseHead = nextHead;
+}
+
+void TurntableSpeedMonitor::update() {
+  bool newRevolution = false;
+
+  // Take the head and the dropped flag together. A pulse is only dropped while the buffer is full, so it came after
+  // every pulse that is in the buffer now, and nothing after it has been stored yet.
+  noInterrupts();
+  uint8_t head = this->pulseHead;
+  bool dropped = this->pulsesDropped;
+  this->pulsesDropped = false;
+  interrupts();
+
+  while(this->pulseTail != head) {
+    unsigned long timestampMicros = this->pulseTimestamps[this->pulseTail];
+    this->pulseTail = (this->pulseTail + 1) & (SPEED_PULSE_BUFFER_SIZE - 1);
+
+    if(this->hasLastPulse && !this->skipNextPeriod) {
+      unsigned long period = timestampMicros - this->lastPulseMicros;
+      this->periods[this->periodIndex] = period;
+      this->centiRpms[this->periodIndex] = periodToCentiRpm(period);
+      this->periodIndex = (this->periodIndex + 1) % SPEED_STATISTICS_WINDOW;
+      if(this->periodCount < SPEED_STATISTICS_WINDOW) this->periodCount++;
+
+      this->revolutionCount++;
+      newRevolution = true;
+    }
+
+    this->lastPulseMicros = timestampMicros;
+    this->hasLastPulse = true;
+    this->skipNextPeriod = false;
+  }
+
+  // The period from the last buffered pulse to the next one stored would span the dropped pulse too, so it is skipped,
+  // and the next period starts from that pulse instead.
+  if(dropped) this->skipNextPeriod = true;
+
+  if(newRevolution) {
+    this->calculateStatistics();
+    EventTrace::record(TraceEventType::SpeedSample, 0, this->currentCentiRpm);
+  }
+
+  // If the sensor has been quiet for too long, the platter has stopped.
+  else if(this->hasLastPulse && (TurntableHal::currentMicros() - this->lastPulseMicros) / 1000 > this->stoppedTimeoutMs) {
+    this->reset();
+  }
+}
+
+void TurntableSpeedMonitor::calculateStatistics() {
+  // Without a single period, there is nothing to average.
+  if(this->periodCount == 0) return;
+
+  uint8_t latestIndex = (this->periodIndex + SPEED_STATISTICS_WINDOW - 1) % SPEED_STATISTICS_WINDOW;
+  this->currentCentiRpm = this->centiRpms[latestIndex];
+
+  // Insertion sort the speeds of the window into a scratch array, which gives us the min, max and median.
+  uint16_t sortedCentiRpms[SPEED_STATISTICS_WINDOW] = { 0 };
+  unsigned long sumCentiRpm = 0;
+  unsigned long sumPeriods = 0;
+
+  for(uint8_t i = 0; i < this->periodCount; i++) {
+    uint16_t centiRpm = this->centiRpms[i];
+    sumCentiRpm += centiRpm;
+    sumPeriods += this->periods[i];
+
+    uint8_t j = i;
+    while(j > 0 && sortedCentiRpms[j - 1] > centiRpm) {
+      sortedCentiRpms[j] = sortedCentiRpms[j - 1];
+      j--;
+    }
+    sortedCentiRpms[j] = centiRpm;
+  }
+
+  this->meanCentiRpm = (sumCentiRpm + this->periodCount / 2) / this->periodCount;
+  this->meanPeriodMicros = (sumPeriods + this->periodCount / 2) / this->periodCount;
+  this->minCentiRpm = sortedCentiRpms[0];
+  this->maxCentiRpm = sortedCentiRpms[this->periodCount - 1];
+
+  if(this->periodCount % 2 == 0)
+    this->medianCentiRpm = (sortedCentiRpms[this->periodCount / 2 - 1] + sortedCentiRpms[this->periodCount / 2] + 1) / 2;
+  else
+    this->medianCentiRpm = sortedCentiRpms[this->periodCount / 2];
+
+  // The relative deviation of a period is, to within a fraction of a percent of itself, the same as the relative
+  // deviation of the speed, and periods are known far more precisely than speeds.
+  unsigned long sumSquaredDeviation = 0;
+  for(uint8_t i = 0; i < this->periodCount; i++) {
+    long difference = (long)this->periods[i] - (long)this->meanPeriodMicros;
+    unsigned long deviation = ((difference < 0 ? -difference : difference) + (1 << (DEVIATION_SHIFT - 1))) >> DEVIATION_SHIFT;
+    if(deviation > DEVIATION_LIMIT) deviation = DEVIATION_LIMIT;
+
+    sumSquaredDeviation += deviation * deviation;
+  }
+
+  unsigned long rmsDeviationMicros = (unsigned long)squareRoot(sumSquaredDeviation / this->periodCount) << DEVIATION_SHIFT;
+  unsigned long meanPeriodHundredths = this->meanPeriodMicros / 100;
+  unsigned long wowAndFlutter = meanPeriodHundredths == 0 ? 0xFFFF : (rmsDeviationMicros * 100 + meanPeriodHundredths / 2) / meanPeriodHundredths;
+  this->wowAndFlutterBasisPoints = wowAndFlutter > 0xFFFF ? 0xFFFF : wowAndFlutter;
+}
+
+void TurntableSpeedMonitor::reset() {
+  this->hasLastPulse = false;
+  this->skipNextPeriod = false;
+  this->lastPulseMicros = 0;
+  this->periodCount = 0;
+  this->periodIndex = 0;
+  this->revolutionCount = 0;
+
+  this->currentCentiRpm = 0;
+  this->meanCentiRpm = 0;
+  this->medianCentiRpm = 0;
+  this->minCentiRpm = 0;
+  this->maxCentiRpm = 0;
+  this->meanPeriodMicros = 0;
+  this->wowAndFlutterBasisPoints = 0;
+}
+
+void TurntableSpeedMonitor::setStoppedTimeoutMs(uint16_t ms) {
+  this->stoppedTimeoutMs = ms;
+}
+
+bool TurntableSpeedMonitor::isStopped() {
+  return this->periodCount == 0;
+}
+
+uint16_t TurntableSpeedMonitor::getCurrentCentiRpm() {
+  return this->currentCentiRpm;
+}
+
+uint16_t TurntableSpeedMonitor::getMeanCentiRpm() {
+  return this->meanCentiRpm;
+}
+
+uint16_t TurntableSpeedMonitor::getMedianCentiRpm() {
+  return this->medianCentiRpm;
+}
+
+uint16_t TurntableSpeedMonitor::getMinCentiRpm() {
+  return this->minCentiRpm;
+}
+
+uint16_t TurntableSpeedMonitor::getMaxCentiRpm() {
+  return this->maxCentiRpm;
+}
+
+unsigned long TurntableSpeedMonitor::getCurrentPeriodMicros() {
+  if(this->periodCount == 0) return 0;
+
+  return this->periods[(this->periodIndex + SPEED_STATISTICS_WINDOW - 1) % SPEED_STATISTICS_WINDOW];
+}
+
+unsigned long TurntableSpeedMonitor::getMeanPeriodMicros() {
+  return this->meanPeriodMicros;
+}
+
+uint16_t TurntableSpeedMonitor::getWowAndFlutterBasisPoints() {
+  return this->wowAndFlutterBasisPoints;
+}
+
+unsigned long TurntableSpeedMonitor::getRevolutionCount() {
+  return this->revolutionCount;
+}
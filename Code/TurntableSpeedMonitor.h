@@ -0,0 +1,104 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+
+#ifndef TurntableSpeedMonitor_h
+#define TurntableSpeedMonitor_h
+
+// The number of speed sensor timestamps that can be waiting for update() before new ones are dropped. This is a
+// power of two so the ring buffer indexes wrap with a mask.
+#define SPEED_PULSE_BUFFER_SIZE 16
+
+// The number of most recent revolutions that the speed statistics are calculated over.
+#define SPEED_STATISTICS_WINDOW 8
+
+// Keeps track of how fast the platter is spinning. The speed sensor interrupt only stores a timestamp for each
+// revolution in a lock-free ring buffer; all of the math happens in update(), from the main loop. The AVR has no FPU,
+// so speeds are kept in hundredths of an RPM ("centi-RPM", i.e. 3333 for 33 1/3 RPM), and everything is integer math.
+class TurntableSpeedMonitor {
+    public:
+
+        // Constructor
+        TurntableSpeedMonitor();
+
+        // Store the timestamp, in microseconds, of a speed sensor pulse. This is the only method that may be called
+        // from the speed sensor interrupt.
+        void recordPulse(unsigned long timestampMicros);
+
+        // Process any pulses recorded since the last call and recalculate the statistics. Call this from the main loop.
+        void update();
+
+        // Set how long, in ms, since the last pulse before the turntable is considered stopped.
+        void setStoppedTimeoutMs(uint16_t ms);
+
+        // Whether the platter is currently stopped (or has not completed two revolutions yet).
+        bool isStopped();
+
+        // The speed, in hundredths of an RPM, of the most recent revolution.
+        uint16_t getCurrentCentiRpm();
+
+        // The mean speed, in hundredths of an RPM, over the statistics window.
+        uint16_t getMeanCentiRpm();
+
+        // The median speed, in hundredths of an RPM, over the statistics window.
+        uint16_t getMedianCentiRpm();
+
+        // The slowest and fastest revolutions, in hundredths of an RPM, in the statistics window.
+        uint16_t getMinCentiRpm();
+        uint16_t getMaxCentiRpm();
+
+        // How long, in microseconds, the most recent revolution took, and the mean over the statistics window. These are
+        // what the speeds are calculated from, and they carry more precision than the speeds themselves.
+        unsigned long getCurrentPeriodMicros();
+        unsigned long getMeanPeriodMicros();
+
+        // The RMS deviation of each revolution's period from the mean, in hundredths of a percent of the mean. This is an
+        // unweighted, once-per-revolution wow & flutter figure.
+        uint16_t getWowAndFlutterBasisPoints();
+
+        // The number of complete revolutions measured since the turntable started spinning.
+        unsigned long getRevolutionCount();
+
+    private:
+        // Recalculate all of the statistics from the revolution periods in the window.
+        void calculateStatistics();
+
+        // Forget every measurement, i.e. because the turntable stopped.
+        void reset();
+
+        // Written by the interrupt, read by update().
+        volatile unsigned long pulseTimestamps[SPEED_PULSE_BUFFER_SIZE];
+        volatile uint8_t pulseHead;
+        volatile bool pulsesDropped;
+
+        // Only written by update().
+        volatile uint8_t pulseTail;
+
+        // The timestamp of the last pulse processed, and whether there is one.
+        unsigned long lastPulseMicros;
+        bool hasLastPulse;
+
+        // Set when pulses were dropped after the last one processed, so the period up to the next one isn't a revolution.
+        bool skipNextPeriod;
+
+        // The most recent revolution periods, in microseconds, and the speed of each one in hundredths of an RPM.
+        unsigned long periods[SPEED_STATISTICS_WINDOW];
+        uint16_t centiRpms[SPEED_STATISTICS_WINDOW];
+        uint8_t periodCount;
+        uint8_t periodIndex;
+
+        unsigned long revolutionCount;
+        uint16_t stoppedTimeoutMs;
+
+        // Statistics, recalculated by update().
+        uint16_t currentCentiRpm;
+        uint16_t meanCentiRpm;
+        uint16_t medianCentiRpm;
+        uint16_t minCentiRpm;
+        uint16_t maxCentiRpm;
+        unsigned long meanPeriodMicros;
+        uint16_t wowAndFlutterBasisPoints;
+};
+
+#endif
@@ -0,0 +1,217 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+
+#include "TurntableSpeedRegulator.h"
+#include "TurntableHal.h"
+#include "enums/MultiplexerInput.h"
+
+// The nominal speed, in hundredths of an RPM, of each TurntableSpeed.
+static const uint16_t targetCentiRpms[] = { 3333, 4500, 1667, 7800 };
+
+// How long, in microseconds, one revolution takes at each TurntableSpeed. The error is worked out from these, since
+// the periods are what we actually measure.
+static const unsigned long targetPeriodsMicros[] = { 1800000, 1333333, 3600000, 769231 };
+
+// The PID terms add up in ten-thousandths of a duty cycle step: hundredths of a step per percent of gain, times
+// hundredths of a percent of error.
+#define OUTPUT_SCALE 10000L
+
+// The most, either way, that the integral term can hold, which is the whole output range.
+#define INTEGRAL_TERM_LIMIT (255 * OUTPUT_SCALE)
+
+// How far, in basis points of the target period, the given period is from it. A period longer than the target is a
+// platter that is too slow, which is a positive error. The result is limited to the range of an int16_t.
+static int16_t errorBasisPoints(unsigned long periodMicros, unsigned long targetPeriodMicros) {
+  // Dividing the period by 100 (rather than multiplying the difference by 10000) keeps this within 32 bits, at a
+  // cost of under 0.01% of the error.
+  unsigned long periodHundredths = periodMicros / 100;
+  if(periodHundredths == 0) return -32767;
+
+  long difference = (long)periodMicros - (long)targetPeriodMicros;
+  long error = difference * 100 / (long)periodHundredths;
+
+  if(error > 32767) return 32767;
+  if(error < -32767) return -32767;
+  return error;
+}
+
+TurntableSpeedRegulator::TurntableSpeedRegulator(TurntableSpeedMonitor& speedMonitor) : speedMonitor(speedMonitor) {
+    this->running = false;
+    this->switchedOff = false;
+    this->output = 0;
+    this->lastRevolutionCount = 0;
+    this->stableRevolutionCount = 0;
+
+    this->integralTerm = 0;
+    this->lastError = 0;
+    this->hasLastError = false;
+
+    this->proportionalGain = 0;
+    this->integralGain = 0;
+    this->derivativeGain = 0;
+    this->baseOutput = 255;
+    this->toleranceBasisPoints = 0;
+    this->spinUpThresholdBasisPoints = 0;
+    this->stableRevolutions = 1;
+}
+
+void TurntableSpeedRegulator::start() {
+  this->running = true;
+  this->switchedOff = this->isSwitchedOff();
+  this->resetLoop();
+
+  // Start at the base output; the first measured revolution decides where to go from there.
+  this->setOutput(this->switchedOff ? 0 : this->baseOutput);
+  TurntableHal::setTurntableMotorEnabled(!this->switchedOff);
+}
+
+void TurntableSpeedRegulator::stop() {
+  this->running = false;
+  this->stableRevolutionCount = 0;
+  this->setOutput(0);
+  TurntableHal::setTurntableMotorEnabled(false);
+}
+
+bool TurntableSpeedRegulator::isRunning() {
+  return this->running;
+}
+
+void TurntableSpeedRegulator::update() {
+  if(!this->running) return;
+
+  // The speed switch's center position turns the motor off, whatever the loop would have it do. Switching it back on
+  // starts the loop over, like start() does.
+  bool switchedOff = this->isSwitchedOff();
+
+  if(switchedOff != this->switchedOff) {
+    this->switchedOff = switchedOff;
+    this->resetLoop();
+    this->setOutput(switchedOff ? 0 : this->baseOutput);
+    TurntableHal::setTurntableMotorEnabled(!switchedOff);
+  }
+
+  if(switchedOff) return;
+
+  // Until we have a measurement, there is nothing to regulate against, so hold the base output. Full power would
+  // overshoot: it takes two revolutions to measure one, and at the slower speeds the platter is long since up to
+  // full speed by then.
+  if(this->speedMonitor.isStopped()) {
+    this->stableRevolutionCount = 0;
+    this->integralTerm = 0;
+    this->hasLastError = false;
+    this->lastRevolutionCount = 0;
+    this->setOutput(this->baseOutput);
+    return;
+  }
+
+  unsigned long revolutionCount = this->speedMonitor.getRevolutionCount();
+  if(revolutionCount == this->lastRevolutionCount) return;
+  this->lastRevolutionCount = revolutionCount;
+
+  int16_t error = errorBasisPoints(this->speedMonitor.getCurrentPeriodMicros(), this->getTargetPeriodMicros());
+
+  if(abs(error) > this->toleranceBasisPoints) this->stableRevolutionCount = 0;
+  else if(this->stableRevolutionCount < 255) this->stableRevolutionCount++;
+
+  // Far below the target speed, i.e. just after starting or switching to a faster speed, drive the motor at full
+  // power. The integral is held at zero so it doesn't wind up during the spin-up.
+  if(error > (long)this->spinUpThresholdBasisPoints) {
+    this->integralTerm = 0;
+    this->hasLastError = false;
+    this->setOutput(255);
+    return;
+  }
+
+  int16_t derivative = this->hasLastError ? error - this->lastError : 0;
+  this->lastError = error;
+  this->hasLastError = true;
+
+  long proportionalTerm = (long)this->proportionalGain * error;
+  long derivativeTerm = (long)this->derivativeGain * derivative;
+  long integralStep = (long)this->integralGain * error;
+
+  // Anti-windup: only integrate the error if doing so wouldn't push an output that is already saturated further
+  // past its limit.
+  long candidateOutput = this->baseOutput * OUTPUT_SCALE + proportionalTerm + this->integralTerm + integralStep + derivativeTerm;
+
+  if((candidateOutput < 255 * OUTPUT_SCALE || error < 0) && (candidateOutput > 0 || error > 0)) {
+    this->integralTerm += integralStep;
+
+    if(this->integralTerm > INTEGRAL_TERM_LIMIT) this->integralTerm = INTEGRAL_TERM_LIMIT;
+    else if(this->integralTerm < -INTEGRAL_TERM_LIMIT) this->integralTerm = -INTEGRAL_TERM_LIMIT;
+  }
+
+  long newOutput = this->baseOutput * OUTPUT_SCALE + proportionalTerm + this->integralTerm + derivativeTerm;
+
+  if(newOutput >= 255 * OUTPUT_SCALE) this->setOutput(255);
+  else if(newOutput <= 0) this->setOutput(0);
+  else this->setOutput((newOutput + OUTPUT_SCALE / 2) / OUTPUT_SCALE);
+}
+
+bool TurntableSpeedRegulator::isSwitchedOff() {
+  return TurntableHal::isSpeedSwitchOff();
+}
+
+TurntableSpeed TurntableSpeedRegulator::getTargetSpeed() {
+  uint8_t speed = TurntableHal::readMuxInput(MultiplexerInput::TargetSpeedA) | (TurntableHal::readMuxInput(MultiplexerInput::TargetSpeedB) << 1);
+
+  return (TurntableSpeed)speed;
+}
+
+uint16_t TurntableSpeedRegulator::getTargetCentiRpm() {
+  return targetCentiRpms[this->getTargetSpeed()];
+}
+
+unsigned long TurntableSpeedRegulator::getTargetPeriodMicros() {
+  return targetPeriodsMicros[this->getTargetSpeed()];
+}
+
+bool TurntableSpeedRegulator::isWithinTolerance() {
+  if(this->speedMonitor.isStopped()) return false;
+
+  return abs(errorBasisPoints(this->speedMonitor.getMeanPeriodMicros(), this->getTargetPeriodMicros())) <= this->toleranceBasisPoints;
+}
+
+bool TurntableSpeedRegulator::isStable() {
+  return this->running && !this->switchedOff && !this->speedMonitor.isStopped() && this->stableRevolutionCount >= this->stableRevolutions;
+}
+
+uint8_t TurntableSpeedRegulator::getOutput() {
+  return this->output;
+}
+
+void TurntableSpeedRegulator::setOutput(uint8_t output) {
+  this->output = output;
+  TurntableHal::setTurntableMotorTrim(output);
+}
+
+void TurntableSpeedRegulator::resetLoop() {
+  this->stableRevolutionCount = 0;
+  this->integralTerm = 0;
+  this->hasLastError = false;
+  this->lastRevolutionCount = this->speedMonitor.getRevolutionCount();
+}
+
+void TurntableSpeedRegulator::setGains(uint16_t proportional, uint16_t integral, uint16_t derivative) {
+  this->proportionalGain = proportional;
+  this->integralGain = integral;
+  this->derivativeGain = derivative;
+}
+
+void TurntableSpeedRegulator::setBaseOutput(uint8_t baseOutput) {
+  this->baseOutput = baseOutput;
+}
+
+void TurntableSpeedRegulator::setToleranceBasisPoints(uint16_t toleranceBasisPoints) {
+  this->toleranceBasisPoints = toleranceBasisPoints;
+}
+
+void TurntableSpeedRegulator::setSpinUpThresholdBasisPoints(uint16_t spinUpThresholdBasisPoints) {
+  this->spinUpThresholdBasisPoints = spinUpThresholdBasisPoints;
+}
+
+
+void TurntableSpeedRegulator::setStableRevolutions(uint8_t revolutions) {
+  this->stableRevolutions = revolutions;
+}
\ No newline at end of file
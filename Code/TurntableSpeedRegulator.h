@@ -0,0 +1,112 @@
+// This library is made specifically for automatic turntable firmware/hardware designed by Patrick Nelson.
+// It may have other uses outside of the specific scenarios where it is used here, but that should
+// be investigated on an individual basis by whoever stumbles upon this code.
+#include "arduino.h"
+#include "TurntableSpeedMonitor.h"
+#include "enums/TurntableSpeed.h"
+
+#ifndef TurntableSpeedRegulator_h
+#define TurntableSpeedRegulator_h
+
+// Holds the platter at the speed selected by the speed switches. Once per revolution, the measured speed is compared
+// against the target, and a PID loop adjusts the duty cycle of the turntable motor trim (see TURNTABLE_MOTOR_TRIM_PIN).
+// The error is worked out from the revolution period and a table of target periods, in hundredths of a percent ("basis
+// points"), so the whole loop is integer math. The fine-tune pots on the motor controller set the speed at full duty,
+// so they should be set slightly faster than the target speed to give the regulator room to trim it down. While the
+// main speed switch is in its center "off" position, the motor is switched off and the duty is held at zero.
+class TurntableSpeedRegulator {
+    public:
+
+        // Constructor
+        TurntableSpeedRegulator(TurntableSpeedMonitor& speedMonitor);
+
+        // Start spinning the platter and regulating its speed.
+        void start();
+
+        // Stop the platter.
+        void stop();
+
+        // Whether the platter has been started.
+        bool isRunning();
+
+        // Recalculate the motor output if a new revolution has been measured. Call this from the main loop.
+        void update();
+
+        // Whether the main speed switch is in its center "off" position.
+        bool isSwitchedOff();
+
+        // The speed currently selected by the speed switches.
+        TurntableSpeed getTargetSpeed();
+
+        // The speed, in hundredths of an RPM, currently selected by the speed switches.
+        uint16_t getTargetCentiRpm();
+
+        // How long, in microseconds, a revolution takes at the speed currently selected by the speed switches.
+        unsigned long getTargetPeriodMicros();
+
+        // Whether the mean measured speed is within the tolerance of the target speed.
+        bool isWithinTolerance();
+
+        // Whether the last few measured revolutions (see setStableRevolutions()) have all been within the tolerance of
+        // the target speed. Unlike isWithinTolerance(), this can't be fooled by a mean that passes through the target
+        // while the platter is still overshooting.
+        bool isStable();
+
+        // The duty cycle (0-255) currently being applied to the motor.
+        uint8_t getOutput();
+
+        // Set the PID gains, in hundredths of a duty cycle step (0-255) per percent of error, so the same gains work for
+        // every speed. Gains above 10000 (100 steps per percent) could overflow the loop's arithmetic.
+        void setGains(uint16_t proportional, uint16_t integral, uint16_t derivative);
+
+        // Set the duty cycle that the PID output is added to. This is roughly where the platter should sit at the target speed.
+        void setBaseOutput(uint8_t baseOutput);
+
+        // Set how far, in hundredths of a percent of the target speed, the measured speed can be from the target and
+        // still be considered on speed.
+        void setToleranceBasisPoints(uint16_t toleranceBasisPoints);
+
+        // Set how far below the target speed, in hundredths of a percent, the platter has to be for the motor to be
+        // driven at full power. This gets the platter up to speed as fast as possible before the PID loop takes over.
+        void setSpinUpThresholdBasisPoints(uint16_t spinUpThresholdBasisPoints);
+
+        // Set how many revolutions in a row must be within the tolerance for the platter to be considered stable.
+        void setStableRevolutions(uint8_t revolutions);
+
+    private:
+        // Apply a new duty cycle to the motor.
+        void setOutput(uint8_t output);
+
+        // Forget the revolutions measured so far, so the PID loop starts over from the base output.
+        void resetLoop();
+
+        // Measures the speed of the platter.
+        TurntableSpeedMonitor& speedMonitor;
+
+        bool running;
+        bool switchedOff;
+        uint8_t output;
+
+        // The revolution that the output was last calculated for, so we only run the PID loop once per revolution.
+        unsigned long lastRevolutionCount;
+
+        // How many revolutions in a row have been within the tolerance, up to 255.
+        uint8_t stableRevolutionCount;
+
+        // PID state. The error is in basis points of the target speed, and the integral term is kept already multiplied
+        // by the integral gain, in ten-thousandths of a duty cycle step.
+        long integralTerm;
+        int16_t lastError;
+        bool hasLastError;
+
+        // Calibration values.
+        uint16_t proportionalGain;
+        uint16_t integralGain;
+        uint16_t derivativeGain;
+        uint8_t baseOutput;
+        uint16_t toleranceBasisPoints;
+        uint16_t spinUpThresholdBasisPoints;
+        uint8_t stableRevolutions;
+};
+
+#endif
@@ -4,12 +4,10 @@
 // Each of these values corresponds to a pin on the Arduino Nano Every
 enum ArduinoPin : uint8_t {
 
-    // Currently reserved in the event of serial output being needed. This will also assure that there are no errors
-    // when uploading to the Arduino while it is connected to the rest of the turntable controller board.
+    // Serial receive (RX1), used for the serial command and telemetry protocol. See SerialProtocol.
     ReservedSerial0 = 0,
 
-    // Currently reserved in the event of serial output being needed. This will also assure that there are no errors
-    // when uploading to the Arduino while it is connected to the rest of the turntable controller board.
+    // Serial transmit (TX1), used for the serial command and telemetry protocol. See SerialProtocol.
     ReservedSerial1 = 1,
 
     // This is the pin used to select which motor we are moving, using the demultiplexers.
@@ -0,0 +1,42 @@
+#ifndef CALIBRATIONVALUE_H
+#define CALIBRATIONVALUE_H
+
+// Each value held by the CalibrationStore. These are also the value IDs used by the serial calibration commands.
+enum CalibrationValue : uint8_t {
+    // The number of steps the tonearm moves past the play sensor to reach the edge of a 7" record.
+    RecordEdgeSteps7Inch = 0,
+
+    // The number of steps the tonearm moves past the play sensor to reach the edge of a 10" record.
+    RecordEdgeSteps10Inch = 1,
+
+    // The number of steps the tonearm moves past the play sensor to reach the edge of a 12" record.
+    RecordEdgeSteps12Inch = 2,
+
+    // How long it is expected that the clutch will take to engage or disengage, in milliseconds.
+    ClutchEngagementMs = 3,
+
+    // The max number of steps that the tonearm can travel vertically before being considered in error.
+    VerticalTimeoutSteps = 4,
+
+    // 1 if the pickup encoder counts down as the tonearm moves towards the center of the record, otherwise 0.
+    PickupEncoderReversed = 5,
+
+    // The inward travel per revolution, in encoder counts, at or above which the stylus is in the lead-out groove.
+    PickupLeadOutCountsPerRevolution = 6,
+
+    // The number of revolutions in a row that must reach the lead-out travel to trigger the homing routine.
+    PickupConsecutiveRevolutions = 7,
+
+    // The number of steps in a row the horizontal motor can take without the pickup encoder changing before the
+    // tonearm is considered stalled.
+    HorizontalStallSteps = 8,
+
+    // The number of steps at the start of each horizontal movement that take up the slack in the gears, before stall
+    // detection begins.
+    HorizontalBacklashSteps = 9
+};
+
+// The number of values in the CalibrationStore.
+#define CALIBRATION_VALUE_COUNT 10
+
+#endif
\ No newline at end of file
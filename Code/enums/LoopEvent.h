@@ -0,0 +1,17 @@
+#ifndef LOOPEVENT_H
+#define LOOPEVENT_H
+
+// The events that wake the main loop. Each is a single bit, so several can be waiting at once.
+enum LoopEvent : uint8_t {
+    // The periodic tick (see LOOP_TICK_MICROS). The buttons and switches are behind the multiplexer, which has no
+    // interrupt line, so they are scanned on this tick along with all of the other periodic work.
+    TickEvent = 0x01,
+
+    // A speed sensor pulse was timestamped, so there is a new revolution to measure.
+    SpeedPulseEvent = 0x02,
+
+    // Either pickup encoder channel changed.
+    PickupEdgeEvent = 0x04
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef MOTIONPROFILE_H
+#define MOTIONPROFILE_H
+
+// How a stepper motor speeds up at the start of a movement, and slows down at the end of it.
+enum MotionProfile : uint8_t {
+    // The motor steps at the same speed for the whole movement.
+    Constant = 0,
+
+    // The motor speeds up and slows down at a constant rate.
+    Trapezoidal = 1,
+
+    // The rate that the motor speeds up and slows down at is itself eased in and out, for the smoothest movement.
+    SCurve = 2
+};
+
+#endif
\ No newline at end of file
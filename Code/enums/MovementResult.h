@@ -15,9 +15,16 @@ enum MovementResult : uint8_t {
     // Took too long for the tonearm to move counterclockwise to its destination.
     HorizontalCounterclockwiseDirectionError = 0xD,
 
+    // A routine got stuck with nothing running and none of its remaining stages able to start, i.e. because their
+    // dependencies can never finish.
+    RoutineStalledError = 0xE,
+
     // The movement succeeded.
     Success = 1,
 
+    // The movement was stopped before it finished, i.e. by the user pressing a button mid-movement.
+    Cancelled = 2,
+
     // No status was set yet.
     None = 0
 };
@@ -0,0 +1,16 @@
+#ifndef RECORDSIZE_H
+#define RECORDSIZE_H
+
+// The size of the record on the platter. These are in the same order as the record edge steps in CalibrationValue.
+enum RecordSize : uint8_t {
+    SevenInch = 0,
+
+    TenInch = 1,
+
+    TwelveInch = 2,
+
+    // No record edge has been found since the turntable was powered on.
+    UnknownRecordSize = 0xFF
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef ROUTINESTAGEACTION_H
+#define ROUTINESTAGEACTION_H
+
+// What a single stage of a routine does. Stages that move the tonearm share the stepper, so only one of them can run
+// at a time, but they can run at the same time as a clutch stage.
+enum RoutineStageAction : uint8_t {
+    // Move the tonearm up until it bumps the upper limit.
+    MoveUp = 0,
+
+    // Move the tonearm down until it bumps the lower limit.
+    MoveDown = 1,
+
+    // Move the tonearm down, slowing down to the careful speed just above the lower limit.
+    MoveDownCarefully = 2,
+
+    // Move the tonearm clockwise until it bumps into the record edge.
+    SeekRecordEdge = 3,
+
+    // Move the tonearm counterclockwise until it bumps into the home mount.
+    HorizontalHome = 4,
+
+    // Engage the horizontal clutch.
+    EngageClutch = 5,
+
+    // Disengage the horizontal clutch.
+    DisengageClutch = 6,
+
+    // Call a function, which finishes right away.
+    Call = 7,
+
+    // Move the raised tonearm clockwise from just outside the record edge to over the lead-in groove.
+    MoveToLeadIn = 8,
+
+    // Move the raised tonearm back to the play sensor, then out to over the lead-in groove, without going home.
+    ReturnToRecordEdge = 9,
+
+    // Wait until the stage's condition returns true. This uses neither the stepper nor the clutch.
+    WaitUntil = 10,
+
+    // Move the tonearm up, and home it horizontally as soon as the stylus is clear of the record, without waiting for
+    // the upper limit. The clutch must be engaging, or engaged.
+    LiftAndHome = 11,
+
+    // Move the raised tonearm to over the lead-in groove, then lower it at the stage's speed to just above the record,
+    // where a careful descent slows down. A MoveDownCarefully stage from there is careful the whole way.
+    MoveToLeadInAndHover = 12
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef SERIALFRAMETYPE_H
+#define SERIALFRAMETYPE_H
+
+// The type of each frame sent over the serial protocol. Commands are sent to the turntable, and everything with the
+// high bit set is sent from the turntable. Multi-byte values in a payload are little-endian.
+enum SerialFrameType : uint8_t {
+    // Execute the play routine. No payload. Answered with a CommandResult.
+    PlayCommand = 0x01,
+
+    // Execute the home routine. No payload. Answered with a CommandResult.
+    HomeCommand = 0x02,
+
+    // Pause or unpause, the same as pressing the pause button. No payload. Answered with a CommandResult.
+    PauseCommand = 0x03,
+
+    // Set how often, in milliseconds, the Status and SpeedTelemetry frames are sent (uint16). Zero turns them off.
+    SetTelemetryInterval = 0x04,
+
+    // Send a Status frame right away. No payload.
+    StatusRequest = 0x05,
+
+    // Send a Calibration frame right away. No payload.
+    CalibrationRequest = 0x06,
+
+    // Set a calibration value: the CalibrationValue (uint8), then the new value (uint16). Answered with a Calibration
+    // frame. Changes are saved to the EEPROM once no more have been made for a moment.
+    SetCalibration = 0x07,
+
+    // Add to a calibration value, like pressing the increment or decrement buttons: the CalibrationValue (uint8),
+    // then the amount to add (int16). Answered with a Calibration frame.
+    AdjustCalibration = 0x08,
+
+    // Freeze the event trace and send all of it: every event in TraceEvents frames, oldest first, then a TraceLoopTimes
+    // frame. Recording resumes once the TraceLoopTimes frame is sent. No payload.
+    TraceRequest = 0x09,
+
+    // Start streaming every pickup encoder and speed sensor edge in CaptureEdges frames, until StopCapture. No payload.
+    StartCapture = 0x0A,
+
+    // Stop streaming sensor edges. No payload.
+    StopCapture = 0x0B,
+
+    // Send a LoopStats frame right away, then start measuring the highest latency again. No payload.
+    LoopStatsRequest = 0x0C,
+
+    // The result of a command: the command type (uint8), then the MovementResult (uint8). A routine that could not be
+    // started, i.e. because another routine is running, returns MovementResult::None.
+    CommandResult = 0x81,
+
+    // The status of the turntable: the status flags (uint8, see SerialStatusFlag), the last home, play and repeat
+    // routine times in ms (uint32 each), then the RecordSize (uint8). A repeat that had to home and play first is
+    // timed as a whole.
+    Status = 0x82,
+
+    // The speed of the platter: the target TurntableSpeed (uint8), the current, mean, and target speed in hundredths
+    // of an RPM (uint16 each), the wow and flutter in hundredths of a percent (uint16), then the motor duty (uint8).
+    SpeedTelemetry = 0x83,
+
+    // Every calibration value (uint16 each), in the order of CalibrationValue.
+    Calibration = 0x84,
+
+    // Up to two trace events, each as: the timestamp in microseconds (uint32), the TraceEventType (uint8), the
+    // detail (uint8), then the value (uint16).
+    TraceEvents = 0x85,
+
+    // The loop time histogram (uint16 per bucket, see EVENT_TRACE_LOOP_TIME_BUCKETS). This ends a trace dump.
+    TraceLoopTimes = 0x86,
+
+    // The number of edges dropped since the last CaptureEdges frame because the serial port fell behind (uint8), then
+    // up to three sensor edges, each as: the timestamp in microseconds (uint32), then the source (uint8, see
+    // SENSOR_CAPTURE_SPEED_EDGE).
+    CaptureEdges = 0x87,
+
+    // How the main loop is keeping up: the time spent awake over the last second in tenths of a percent (uint16), the
+    // last and highest wake-to-action latency in microseconds (uint16 each), the number of times the loop has been
+    // woken (uint32), then the number of loop iterations in the last second (uint32).
+    LoopStats = 0x88
+};
+
+#endif
\ No newline at end of file
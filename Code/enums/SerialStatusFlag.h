@@ -0,0 +1,25 @@
+#ifndef SERIALSTATUSFLAG_H
+#define SERIALSTATUSFLAG_H
+
+// The bits of the status flags in a Status frame. These are the same statuses as the outputs of the COM port.
+enum SerialStatusFlag : uint8_t {
+    // The tonearm is paused.
+    PausedFlag = 0x01,
+
+    // A routine is moving the tonearm.
+    MovingFlag = 0x02,
+
+    // The auto/manual switch is set to automatic.
+    AutomaticFlag = 0x04,
+
+    // The repeat switch is on.
+    RepeatFlag = 0x08,
+
+    // The tonearm is over the home position.
+    HomeFlag = 0x10,
+
+    // The platter motor is running.
+    MotorRunningFlag = 0x20
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef STEPSEQUENCE_H
+#define STEPSEQUENCE_H
+
+// The order that the coils of a tonearm stepper motor are energized in.
+enum StepSequence : uint8_t {
+    // Two coils are on at a time. This is the most torque for each step.
+    FullStep = 0,
+
+    // Alternates between one and two coils on, which takes two coil steps for every full step. This is the smoothest
+    // movement, and halves the size of each step.
+    HalfStep = 1,
+
+    // One coil is on at a time. The steps are the same size as a full step, but with less torque and less current.
+    WaveDrive = 2
+};
+
+#endif
\ No newline at end of file
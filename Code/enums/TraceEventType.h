@@ -0,0 +1,38 @@
+#ifndef TRACEEVENTTYPE_H
+#define TRACEEVENTTYPE_H
+
+// Each kind of event recorded by the EventTrace, along with what its detail byte and value mean.
+enum TraceEventType : uint8_t {
+    // A movement started. Detail: the MotorAxis in bit 0, and bit 1 set if the direction is negative. Value: the
+    // maximum number of steps.
+    MoveStart = 0x01,
+
+    // A movement finished. Detail: the MovementResult. Value: the number of steps taken.
+    MoveStop = 0x02,
+
+    // A movement reached its stop input. Detail: the multiplexer input. Value: the number of steps taken.
+    LimitHit = 0x03,
+
+    // The clutch motor started. Detail: the HorizontalClutchPosition. Value: how long it will run, in ms.
+    ClutchStart = 0x04,
+
+    // The clutch motor stopped. Detail: the HorizontalClutchPosition. Value: unused.
+    ClutchStop = 0x05,
+
+    // A multiplexer input changed. Detail: the new snapshot of all inputs. Value: the inputs that changed.
+    MuxChange = 0x06,
+
+    // The pickup encoder changed. Detail: the encoder state. Value: the low 16 bits of the encoder position.
+    PickupEdge = 0x07,
+
+    // A platter revolution was measured. Detail: unused. Value: the speed, in hundredths of an RPM.
+    SpeedSample = 0x08,
+
+    // The lead-out groove was detected. Detail: unused. Value: the inward travel of the last revolution.
+    LeadOutDetected = 0x09,
+
+    // The turntable went into the error state. Detail: the MovementResult. Value: unused.
+    Error = 0x0A
+};
+
+#endif
\ No newline at end of file
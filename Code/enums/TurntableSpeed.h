@@ -0,0 +1,21 @@
+#ifndef TURNTABLESPEED_H
+#define TURNTABLESPEED_H
+
+// Each speed that the turntable can be set to, as selected by the TargetSpeedA and TargetSpeedB multiplexer inputs.
+// Bit 0 is TargetSpeedA (main speed switch in the upper position), and bit 1 is TargetSpeedB (alternate speed button).
+enum TurntableSpeed : uint8_t {
+
+    // Main speed switch down.
+    Speed33 = 0,
+
+    // Main speed switch up.
+    Speed45 = 1,
+
+    // Main speed switch down, with the alternate speed button pressed.
+    Speed16 = 2,
+
+    // Main speed switch up, with the alternate speed button pressed.
+    Speed78 = 3
+};
+
+#endif
\ No newline at end of file
@@ -1,20 +1,49 @@
 #include "../enums/MultiplexerInput.h"
 #include "../enums/MovementResult.h"
+#include "../enums/CalibrationValue.h"
 
 #ifndef AutoTurntable_h
 #define AutoTurntable_h
 
     /* Main loop functions */
+    void countLoopIteration();
     void monitorCommandButtons();
     void monitorPickupSensor();
+    void monitorDuringMovement();
+    void monitorSerial(bool movementInProgress);
+    void finishCommand(MovementResult movementStatus);
+    bool cancelMovementInProgress();
 
     /* Routine commands */
     MovementResult playRoutine();
     MovementResult homeRoutine();
+    MovementResult repeatRoutine();
     MovementResult pauseOrUnpause();
+    void stopTurntableMotor();
+    void startTurntableMotor();
+    bool isPlatterReadyForSetDown();
+    void learnRecordEdge();
+
+    /* Telemetry */
+    void sendStatus();
+    void sendSpeedTelemetry();
+    void sendCalibration();
+    void sendLoopStats();
+    void continueTraceDump();
+    void sendCapturedEdges();
+
+    /* Calibration */
+    void applyCalibration();
+    void showCalibrationValue(CalibrationValue value);
+
+    /* Display */
+    void updateDisplay();
 
     /* Turntable speed */
-    void calculateTurntableSpeed();
+    void calculateTurntableSpeed(unsigned long timestampMicros);
+
+    /* Tonearm position */
+    void decodePickupEncoder(uint8_t state);
 
     /* Error handling */
     void setErrorState(MovementResult errorCode);
@@ -1,31 +1,58 @@
 // See Constants.h file for more details.
 
-// These constants are only to be used by the AutomaticTurntable.ino file.
+// These constants are only to be used by the AutomaticTurntable.ino file and the Arduino implementation of TurntableHal.
+// The values that are kept in the CalibrationStore are only the defaults, used until a calibration is saved.
 
 /********** SETUP */
 
-    //#define SERIAL_SPEED 115200
+    // The baud rate of the serial protocol on the ReservedSerial pins.
+    #define SERIAL_SPEED 115200
+
+    // How often, in milliseconds, status and speed telemetry are sent over the serial port. Zero turns them off until
+    // the interval is set by a serial command.
+    #define TELEMETRY_INTERVAL_MS 250
 
     // The number of steps it takes for either stepper motor to make a full 360-degree rotation.
     #define STEPS_PER_REVOLUTION 2048
 
+    // The Arduino pin that trims the speed of the turntable motor with a PWM duty cycle, for a motor controller with a
+    // speed trim input. The motor controller's Turntable power logic line (ArduinoPin::TurntableMotorEnable) only
+    // switches it on and off, so it is never pulsed. Every pin of the Nano Every is taken, so this is left undefined,
+    // and the motor runs at whatever speed the fine-tune pot of the selected speed sets.
+    // #define TURNTABLE_MOTOR_TRIM_PIN 13
+
+    // The Arduino pin wired to the AudioPassController's Audio off line, which is set HIGH while the audio is muted.
+    // Every pin of the Nano Every is taken, so this is left undefined, and muting the audio does nothing.
+    // #define AUDIO_MUTE_PIN 13
+
+    // The Arduino pin that reads HIGH while the main speed switch is in its center "off" position. The TargetSpeedA
+    // multiplexer input reads the same in the center and lower positions, so without this pin (every pin of the Nano
+    // Every is taken), the firmware can't tell the switch is off.
+    // #define SPEED_SWITCH_OFF_PIN 13
+
 /********** CALIBRATION VALUES */
 
     // The "middle of the road" RPM that a stepper should move.
     #define MOVEMENT_RPM_DEFAULT 10
 
-    // How fast the stepper should move when it is seeking an optical sensor.
-    #define MOVEMENT_RPM_SENSOR_SEEK 5
-
     // The top speed that a stepper will ever move at.
     #define MOVEMENT_RPM_TOP_SPEED 14
 
     // How fast the vertical stepper should move when it is carefully setting down the tonearm.
     #define MOVEMENT_RPM_CAREFUL 4
 
-    // The approximate number of steps between the play sensor, and the homing mount. This value is only used to move
-    // the tonearm counterclockwise, so it accounts for some extra steps to push the tonearm into the mount.
-    #define STEPS_FROM_PLAY_SENSOR_HOME 400
+    // How many steps before the lower limit the vertical stepper slows down to the careful speed when setting down
+    // the tonearm. The rest of the descent is made at the default speed.
+    #define VERTICAL_CAREFUL_DESCENT_STEPS 300
+
+    // How many steps the vertical stepper takes up from the lower limit before the stylus is clear of the record. The
+    // homing routine starts moving the tonearm horizontally from here, while the lift carries on to the upper limit.
+    #define VERTICAL_STYLUS_CLEARANCE_STEPS 400
+
+    // How many steps each stepper takes to speed up from a standstill to its movement speed (and to slow back down,
+    // for movements that end at a known step). See MotionProfile for the shape of each ramp.
+    #define VERTICAL_RAMP_STEPS 100
+    #define HORIZONTAL_RAMP_STEPS 200
 
     // These are timeouts used for error checking, so the hardware doesn't damage itself.
     // Essentially, if the steps exceed this number and the motor has not yet reached its
@@ -33,20 +60,120 @@
     #define VERTICAL_MOVEMENT_TIMEOUT_STEPS 1500
     #define HORIZONTAL_MOVEMENT_TIMEOUT_STEPS 3000
 
+    // If the horizontal motor takes this many steps in a row without the pickup encoder changing, the tonearm has
+    // bumped into something. It has to be more than the most steps the motor ever takes between two encoder counts
+    // while the tonearm is moving freely, or a free movement is taken for a stall. These are only the starting values
+    // of the HorizontalStallSteps and HorizontalBacklashSteps calibration values, and haven't been measured on the
+    // deck: to tune them, dump the event trace of a horizontal home over the serial port, and set the stall steps to half
+    // again the longest gap between PickupEdge events before the bump, counted in steps at the top motor speed.
+    #define HORIZONTAL_STALL_STEPS 24
+
+    // The steps taken at the start of each horizontal movement to take up the slack in the gears, before stall
+    // detection begins. This has to cover the slack, or the first steps of every movement look like a stall. To tune
+    // it, trace a movement that reverses direction, and set it to half again the steps from its MoveStart to its first
+    // PickupEdge.
+    #define HORIZONTAL_BACKLASH_STEPS 32
+
     #define CLUTCH_ENGAGEMENT_MS 100
 
+    // The default number of steps the tonearm moves past the play sensor to reach the edge of each record size.
+    #define RECORD_EDGE_STEPS_7_INCH 700
+    #define RECORD_EDGE_STEPS_10_INCH 450
+    #define RECORD_EDGE_STEPS_12_INCH 200
+
+    // The number of steps the tonearm moves clockwise from the record edge to be over the lead-in groove.
+    #define RECORD_LEAD_IN_STEPS 40
+
+    // Each time the play routine finds the record edge, the record edge steps for that record size move this fraction
+    // (1/n) of the way towards the measurement.
+    #define RECORD_EDGE_LEARNING_DIVISOR 4
+
+    // A measurement of the record edge within this many steps of the record edge steps is put down to noise (the stall
+    // detection only sees the edge to within a couple of encoder counts), and doesn't change them, so a normal play
+    // doesn't cost an EEPROM write.
+    #define RECORD_EDGE_LEARNING_DEADBAND_STEPS 8
+
+    // Where the calibration records start in the EEPROM.
+    #define CALIBRATION_EEPROM_ADDRESS 0
+
+    // How long, in milliseconds, after the last calibration change the values are saved to the EEPROM.
+    #define CALIBRATION_SAVE_DELAY_MS 2000
+
+    // How long, in milliseconds, a calibration value is shown on the display after it has been changed.
+    #define CALIBRATION_DISPLAY_MS 3000
+
+    // How long the clutch is engaged for at startup, when its position is unknown, so that it can home the whole way.
+    #define CLUTCH_STARTUP_MS 900
+
+    // How long, in microseconds, the tonearm motor coils stay on after each step of a slow movement. The rest of the
+    // time between steps, the coils are off and the gearing holds the tonearm. Must be under 8192. The coils are only
+    // switched off when the time to the next coil step is at least twice this. The careful descent, half-stepping at
+    // MOVEMENT_RPM_CAREFUL, has 3662us between coil steps, so it does, while vertical movements at MOVEMENT_RPM_DEFAULT
+    // (1464us half-stepping) and horizontal ones at MOVEMENT_RPM_TOP_SPEED (2092us full-stepping) keep the coils on.
+    #define STEPPER_HOLD_MICROS 1400
+
+    // How long, in milliseconds, the audio is muted before the stylus is lifted off the record, and how long it stays
+    // muted after the stylus leaves or meets the record, so the relay has switched before the thump and the tonearm has
+    // settled before the audio comes back.
+    #define AUDIO_MUTE_LEAD_MS 50
+    #define AUDIO_MUTE_LAG_MS 300
+
+    // How long each multiplexer input is given to settle after the selector pins change.
     #define MULTIPLEXER_DELAY_MICROS 10
 
-    // The amount of time since the last speed sensor interrupt before we consider the turntable "stopped"
-    #define TURNTABLE_STOPPED_MS 2500
+    // How old a snapshot of the multiplexer inputs can be before reading an input scans them all again.
+    #define MULTIPLEXER_MAX_AGE_MICROS 1000
+
+    // The number of scans in a row that a button or switch on the multiplexer must read a new value before it changes.
+    #define MULTIPLEXER_DEBOUNCE_SCANS 3
+
+    // How long one revolution takes at the slowest target speed, 16 2/3 RPM (60000ms * 3 / 50).
+    #define TURNTABLE_SLOWEST_REVOLUTION_MS 3600
+
+    // The amount of time since the last speed sensor interrupt before we consider the turntable "stopped". This has to
+    // be longer than the slowest revolution, with a margin for a platter that is still spinning up to it.
+    #define TURNTABLE_STOPPED_MS (TURNTABLE_SLOWEST_REVOLUTION_MS + 1000)
 
 /********** TONEARM PICKUP CALIBRATION VALUES */
 
-#define TONEARM_PICKUP_DEBOUNCE_MS 20 // Debounce interval to help prevent the tonearm pickup sensor from misfiring.
-#define TONEARM_PICKUP_CONSECUTIVE_SENSOR_CHANGES 3 // The number of sensor changes that must happen within the pickup interval to trigger the homing routine.
+// Which way the pickup encoder counts (1 or -1) when the tonearm moves towards the center of the record.
+#define TONEARM_PICKUP_INWARD_DIRECTION 1
+
+// The tonearm position is sampled once per platter revolution, which cancels out the wobble of off-center records. If
+// it moves inward by at least this many encoder counts in one revolution, the stylus is in the lead-out groove. Normal
+// groove pitch moves it a small fraction of that.
+#define TONEARM_PICKUP_LEADOUT_COUNTS_PER_REVOLUTION 3
+
+// The number of revolutions in a row that must reach the lead-out travel to trigger the homing routine.
+#define TONEARM_PICKUP_CONSECUTIVE_REVOLUTIONS 2
+
+/********** SPEED REGULATION CALIBRATION VALUES */
+
+// The PID gains for the platter speed regulator, in hundredths of a duty cycle step (0-255) of the turntable motor
+// trim per percent of error from the target speed. The regulator only updates once per revolution, and a duty
+// cycle step is already almost half a percent of speed, so the gains are small: anything much larger overshoots and
+// hunts, worst of all at 16 2/3 RPM. These were tuned against the platter model in the host build
+// (platter_settling_test), which settles every speed within 13s of starting, and should be checked on the real platter.
+#define SPEED_REGULATOR_KP 75
+#define SPEED_REGULATOR_KI 125
+#define SPEED_REGULATOR_KD 0
+
+// The duty cycle that the PID output is added to. The fine-tune pots should be set so that the platter spins slightly
+// fast at full duty, which leaves the regulator room to trim the speed both ways around this value.
+#define SPEED_REGULATOR_BASE_OUTPUT 224
+
+// How close, in hundredths of a percent, the measured speed needs to be to the target to be considered on speed.
+#define SPEED_REGULATOR_TOLERANCE_BASIS_POINTS 50
+
+// If the platter is more than this far (in hundredths of a percent) below its target speed, the motor is driven at
+// full power to spin it up.
+#define SPEED_REGULATOR_SPIN_UP_BASIS_POINTS 500
+
+// The number of revolutions in a row that must be within the tolerance before the play routine sets the tonearm down,
+// when the WaitUntilTargetSpeed switch is on.
+#define SPEED_REGULATOR_STABLE_REVOLUTIONS 3
 
-// I've found that sensor trips 700 ms apart at 45.5 RPM will yield positive results; home routine not triggering during
-// record play, but triggering during end deadwax. For this reason, we apply speed ratio to translate 700 ms to an interval
-// that will work with the exact speed the turntable is spinning at.
-#define TONEARM_PICKUP_BASE_SPEED 45.5 // The base speed the turntable was spinning at when the base interval was found through trial and error.
-#define TONEARM_PICKUP_BASE_INTERVAL 700 // The base interval that the pickup sensor must change when the turntable is spinning at TONEARM_PICKUP_BASE_SPEED RPM
\ No newline at end of file
+// The longest, in milliseconds, that the play routine waits for the platter to be stable before setting the tonearm
+// down anyway. At 16 2/3 RPM it takes over 20s from starting the motor for the regulator to see enough revolutions on
+// speed in a row, so this leaves room for that.
+#define SPEED_STABLE_TIMEOUT_MS 30000
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include <math.h>
+#include "PlatterModel.h"
+
+// The nominal speed, in RPM, of each TurntableSpeed.
+static const double nominalRpms[] = { 100.0 / 3, 45, 50.0 / 3, 78 };
+
+// The longest step the model is integrated over at once, in seconds.
+#define PLATTER_MODEL_MAX_STEP_SECONDS 0.001
+
+PlatterModel::PlatterModel() {
+    this->selectedSpeed = TurntableSpeed::Speed33;
+    for(uint8_t i = 0; i < 4; i++) this->fullDutyRatios[i] = 255.0 / 224;
+    this->duty = 0;
+
+    this->stylusDown = false;
+    this->stylusDrag = 0.003;
+    this->wow = 0;
+
+    this->motorTimeConstant = 0.2;
+    this->platterTimeConstant = 1.2;
+
+    this->motorSpeed = 0;
+    this->platterSpeed = 0;
+    this->revolutions = 0;
+}
+
+void PlatterModel::setSelectedSpeed(TurntableSpeed speed) {
+  this->selectedSpeed = speed;
+}
+
+void PlatterModel::setFullDutyRatio(TurntableSpeed speed, double ratio) {
+  this->fullDutyRatios[speed] = ratio;
+}
+
+void PlatterModel::setDuty(uint8_t duty) {
+  this->duty = duty;
+}
+
+void PlatterModel::setStylusDown(bool down) {
+  this->stylusDown = down;
+}
+
+void PlatterModel::setStylusDrag(double fraction) {
+  this->stylusDrag = fraction;
+}
+
+void PlatterModel::setWow(double fraction) {
+  this->wow = fraction;
+}
+
+void PlatterModel::setTimeConstants(double motorSeconds, double platterSeconds) {
+  this->motorTimeConstant = motorSeconds;
+  this->platterTimeConstant = platterSeconds;
+}
+
+bool PlatterModel::advance(double seconds, double& pulseOffsetSeconds) {
+  bool pulsed = false;
+  double elapsed = 0;
+
+  while(elapsed < seconds) {
+    double step = seconds - elapsed > PLATTER_MODEL_MAX_STEP_SECONDS ? PLATTER_MODEL_MAX_STEP_SECONDS : seconds - elapsed;
+
+    double drive = this->duty / 255.0 * this->getNominalRpm() / 60 * this->fullDutyRatios[this->selectedSpeed];
+    this->motorSpeed += (drive - this->motorSpeed) * (1 - exp(-step / this->motorTimeConstant));
+
+    double load = this->stylusDown ? 1 - this->stylusDrag : 1;
+    double lastPlatterSpeed = this->platterSpeed;
+    this->platterSpeed += (this->motorSpeed * load - this->platterSpeed) * (1 - exp(-step / this->platterTimeConstant));
+
+    double wowFactor = 1 + this->wow * sin(2 * M_PI * this->revolutions);
+    double lastRevolutions = this->revolutions;
+    this->revolutions += (lastPlatterSpeed + this->platterSpeed) / 2 * wowFactor * step;
+
+    if(floor(this->revolutions) > floor(lastRevolutions)) {
+      pulseOffsetSeconds = elapsed + step * (ceil(lastRevolutions) - lastRevolutions) / (this->revolutions - lastRevolutions);
+      pulsed = true;
+    }
+
+    elapsed += step;
+  }
+
+  return pulsed;
+}
+
+double PlatterModel::getNominalRpm() {
+  return nominalRpms[this->selectedSpeed];
+}
+
+double PlatterModel::getRpm() {
+  return this->platterSpeed * 60;
+}
+
+double PlatterModel::getRevolutions() {
+  return this->revolutions;
+}
+
+double PlatterModel::getSpeedError() {
+  return this->getRpm() / this->getNominalRpm() - 1;
+}
@@ -0,0 +1,73 @@
+#include "arduino.h"
+#include "enums/TurntableSpeed.h"
+
+#ifndef PlatterModel_h
+#define PlatterModel_h
+
+// The platter, its belt and the turntable motor, as seen by the speed sensor. The motor controller spins the motor at
+// the speed selected by the speed switches (trimmed by that speed's fine-tune pot) times the duty cycle of the motor
+// trim, and the motor speed and the platter speed each follow it with a first-order lag: the motor's own, and the
+// belt's, which has the whole inertia of the platter behind it. The stylus drags the platter down a little while it is
+// on the record, and an eccentric pulley can add wow.
+class PlatterModel {
+    public:
+
+        // Constructor
+        PlatterModel();
+
+        // Set the speed that the motor controller is switched to.
+        void setSelectedSpeed(TurntableSpeed speed);
+
+        // Set the speed that the given speed's fine-tune pot gives at full duty, as a multiple of the nominal speed.
+        // The default is 255/224, which puts the nominal speed at the regulator's base output.
+        void setFullDutyRatio(TurntableSpeed speed, double ratio);
+
+        // Set the duty cycle of the motor trim (0-255), or 0 while the motor is off.
+        void setDuty(uint8_t duty);
+
+        // Set whether the stylus is on the record, and how much it slows the platter down while it is, as a fraction of
+        // its speed.
+        void setStylusDown(bool down);
+        void setStylusDrag(double fraction);
+
+        // Add wow: a variation in the speed of the given fraction, once per revolution of the platter.
+        void setWow(double fraction);
+
+        // Set the time constants, in seconds, of the motor and of the platter on its belt.
+        void setTimeConstants(double motorSeconds, double platterSeconds);
+
+        // Move the model on by the given number of seconds. Returns true if the speed sensor's magnet passed the sensor
+        // in that time, with how far into the step it did.
+        bool advance(double seconds, double& pulseOffsetSeconds);
+
+        // The nominal speed, in RPM, of the selected speed.
+        double getNominalRpm();
+
+        // The speed of the platter, in RPM, and how many revolutions it has made.
+        double getRpm();
+        double getRevolutions();
+
+        // The speed of the platter as a fraction of the nominal speed of the selected speed, less one. Zero is exactly
+        // on speed.
+        double getSpeedError();
+
+    private:
+        TurntableSpeed selectedSpeed;
+        double fullDutyRatios[4];
+        uint8_t duty;
+
+        bool stylusDown;
+        double stylusDrag;
+        double wow;
+
+        double motorTimeConstant;
+        double platterTimeConstant;
+
+        // The speeds, in revolutions per second, of the motor (as the platter speed it would give) and of the platter.
+        double motorSpeed;
+        double platterSpeed;
+
+        double revolutions;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "arduino.h"
+#include "FastPin.h"
+#include "SimulatedTurntable.h"
+
+// The global interrupt flag, in SREG.
+#define SREG_I_BIT 0x80
+
+VPORT_t simulatedVports[6];
+SimulatedStatusRegister SREG;
+
+SimulatedStatusRegister::operator uint8_t() const {
+  return simulator.areInterruptsEnabled() ? SREG_I_BIT : 0;
+}
+
+SimulatedStatusRegister& SimulatedStatusRegister::operator=(uint8_t value) {
+  simulator.setInterruptsEnabled(value & SREG_I_BIT);
+
+  return *this;
+}
+
+void noInterrupts() {
+  simulator.setInterruptsEnabled(false);
+}
+
+void interrupts() {
+  simulator.setInterruptsEnabled(true);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  VPORT_t& port = simulatedVports[fastPinPorts[pin]];
+
+  if(mode == OUTPUT) port.DIR |= digitalPinToBitMask(pin);
+  else port.DIR &= ~digitalPinToBitMask(pin);
+
+  simulator.refreshInputs();
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  VPORT_t& port = simulatedVports[fastPinPorts[pin]];
+
+  if(value) port.OUT |= digitalPinToBitMask(pin);
+  else port.OUT &= ~digitalPinToBitMask(pin);
+
+  simulator.syncOutputs();
+  simulator.refreshInputs();
+}
+
+int digitalRead(uint8_t pin) {
+  return (simulatedVports[fastPinPorts[pin]].IN & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+uint8_t digitalPinToPort(uint8_t pin) {
+  return fastPinPorts[pin];
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin) {
+  return 1 << fastPinBits[pin];
+}
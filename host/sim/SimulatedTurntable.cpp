@@ -0,0 +1,664 @@
+#include <math.h>
+#include "SimulatedTurntable.h"
+#include "FastPin.h"
+#include "enums/ArduinoPin.h"
+#include "enums/AutoManualSwitchPosition.h"
+
+// A tick that is never reached, for things that aren't scheduled.
+#define SIMULATED_NEVER_TICKS 0xFFFFFFFFFFFFFFFFULL
+
+SimulatedTurntable simulator;
+
+// The Arduino core's own interrupts (the millis() timer, and both directions of the serial port) only do their own
+// bookkeeping, but they still take time and wake the MCU.
+static void coreInterrupt() {}
+
+SimulatedTurntable::SimulatedTurntable() {
+    this->ticks = 0;
+    this->timeLimitTicks = SIMULATED_NEVER_TICKS;
+
+    this->interruptsEnabled = true;
+    this->inInterrupt = false;
+    this->pendingInterrupts = 0;
+
+    for(uint8_t source = 0; source < SimulatedInterruptCount; source++) {
+      this->interruptHandlers[source] = NULL;
+      this->interruptCounts[source] = 0;
+      this->interruptTicks[source] = 0;
+    }
+
+    this->interruptHandlers[SimulatedInterrupt::MillisTimerInterrupt] = coreInterrupt;
+    this->interruptHandlers[SimulatedInterrupt::SerialReceiveInterrupt] = coreInterrupt;
+    this->interruptHandlers[SimulatedInterrupt::SerialTransmitInterrupt] = coreInterrupt;
+    this->sleptTicks = 0;
+
+    this->worldStepTicks = 0;
+    this->millisTimerTicks = SIMULATED_TICKS_PER_SECOND / 1000;
+
+    this->stepTimerRunning = false;
+    this->stepTimerCompare = 0;
+    this->stepTimerPeriodStartTicks = 0;
+    this->stepTimerTicks = 0;
+
+    this->rtcRunning = false;
+    this->rtcTickTicks = 0;
+    this->rtcCompareArmed = false;
+    this->rtcCompareTicks = 0;
+
+    this->speedEdgeScheduled = false;
+    this->speedEdgeTicks = 0;
+    this->lastSpeedEdgeTicks = 0;
+
+    this->motorTrim = 0;
+
+    this->serialTransmitting = false;
+    this->serialTransmitByte = 0;
+    this->serialTransmitTicks = 0;
+
+    // A blank EEPROM reads all ones.
+    for(uint16_t address = 0; address < SIMULATED_EEPROM_SIZE; address++) {
+      this->eeprom[address] = 0xFF;
+      this->eepromWriteCounts[address] = 0;
+    }
+
+    this->eepromWritesUntilPowerLoss = 0;
+
+    for(uint8_t port = 0; port < 6; port++) {
+      this->lastOutputs[port] = 0;
+      this->portInputs[port] = 0;
+    }
+
+    // The turntable is switched on in automatic, with the speed switch at 33 1/3 and nothing pressed.
+    for(uint8_t input = 0; input < MULTIPLEXER_INPUT_COUNT; input++) this->muxInputs[input] = false;
+    this->muxInputs[MultiplexerInput::AutoManualSwitch] = AutoManualSwitchPosition::Automatic;
+
+    this->muxSelection = 0;
+    this->lastMuxSelection = 0;
+    this->muxSettledTicks = 0;
+    this->repeatSwitch = false;
+    this->speedSwitchOff = false;
+    for(uint8_t digit = 0; digit < SEVEN_SEGMENT_DIGIT_COUNT; digit++) this->displayDigits[digit] = 0;
+    this->displayRefreshCount = 0;
+    this->audioMuted = false;
+    this->encoderState = this->tonearm.getEncoderState();
+}
+
+unsigned long long SimulatedTurntable::getTicks() {
+  return this->ticks;
+}
+
+unsigned long SimulatedTurntable::getMicros() {
+  return (unsigned long)(this->ticks / SIMULATED_TICKS_PER_MICROSECOND);
+}
+
+unsigned long SimulatedTurntable::getMillis() {
+  return (unsigned long)(this->ticks / (SIMULATED_TICKS_PER_SECOND / 1000));
+}
+
+double SimulatedTurntable::getSeconds() {
+  return (double)this->ticks / SIMULATED_TICKS_PER_SECOND;
+}
+
+void SimulatedTurntable::setTimeLimit(double seconds) {
+  this->timeLimitTicks = (unsigned long long)(seconds * SIMULATED_TICKS_PER_SECOND);
+}
+
+void SimulatedTurntable::runSetup() {
+  setup();
+}
+
+bool SimulatedTurntable::runUntil(double seconds, std::function<bool()> condition) {
+  unsigned long long targetTicks = (unsigned long long)(seconds * SIMULATED_TICKS_PER_SECOND);
+
+  while(this->ticks < targetTicks) {
+    if(condition && condition()) return true;
+    loop();
+  }
+
+  return !condition || condition();
+}
+
+void SimulatedTurntable::runFor(double seconds) {
+  this->runUntil(this->getSeconds() + seconds);
+}
+
+void SimulatedTurntable::enterHal() {
+  if(!this->inInterrupt && this->ticks >= this->timeLimitTicks) throw SimulationStop();
+
+  this->syncOutputs();
+  this->spend(SIMULATED_HAL_CALL_TICKS);
+}
+
+void SimulatedTurntable::spend(unsigned long long ticks) {
+  this->advanceTo(this->ticks + ticks);
+  this->refreshInputs();
+}
+
+void SimulatedTurntable::sleepUntilInterrupt() {
+  unsigned long long startTicks = this->ticks;
+
+  while(this->pendingInterrupts == 0) {
+    if(this->ticks >= this->timeLimitTicks) throw SimulationStop();
+
+    unsigned long long nextTicks = this->getNextEventTicks();
+    if(nextTicks > this->ticks) this->ticks = nextTicks;
+
+    this->processDueEvents();
+  }
+
+  this->sleptTicks += this->ticks - startTicks;
+  this->refreshInputs();
+}
+
+bool SimulatedTurntable::areInterruptsEnabled() {
+  return this->interruptsEnabled;
+}
+
+void SimulatedTurntable::setInterruptsEnabled(bool enabled) {
+  this->interruptsEnabled = enabled;
+
+  while(this->canRunInterrupt()) this->runInterrupt();
+}
+
+bool SimulatedTurntable::isInInterrupt() {
+  return this->inInterrupt;
+}
+
+void SimulatedTurntable::setInterruptHandler(SimulatedInterrupt source, void (*handler)()) {
+  this->interruptHandlers[source] = handler;
+}
+
+unsigned long SimulatedTurntable::getInterruptCount(SimulatedInterrupt source) {
+  return this->interruptCounts[source];
+}
+
+unsigned long long SimulatedTurntable::getInterruptTicks(SimulatedInterrupt source) {
+  return this->interruptTicks[source];
+}
+
+unsigned long long SimulatedTurntable::getSleptTicks() {
+  return this->sleptTicks;
+}
+
+void SimulatedTurntable::startStepTimer(uint16_t compare) {
+  this->stepTimerRunning = true;
+  this->stepTimerCompare = compare;
+  this->stepTimerPeriodStartTicks = this->ticks;
+  this->scheduleStepTimer();
+}
+
+void SimulatedTurntable::setStepTimerCompare(uint16_t compare) {
+  this->stepTimerCompare = compare;
+  if(this->stepTimerRunning) this->scheduleStepTimer();
+}
+
+void SimulatedTurntable::stopStepTimer() {
+  this->stepTimerRunning = false;
+  this->pendingInterrupts &= ~(1 << SimulatedInterrupt::StepTimerInterrupt);
+}
+
+void SimulatedTurntable::startRtc() {
+  this->rtcRunning = true;
+  this->rtcTickTicks = (this->ticks / SIMULATED_RTC_TICK_TICKS + 1) * SIMULATED_RTC_TICK_TICKS;
+}
+
+uint16_t SimulatedTurntable::getRtcCount() {
+  return (uint16_t)(this->ticks * SIMULATED_RTC_COUNT_TICKS_DENOMINATOR / SIMULATED_RTC_COUNT_TICKS_NUMERATOR);
+}
+
+void SimulatedTurntable::setRtcCompare(uint16_t compare) {
+  unsigned long long count = this->ticks * SIMULATED_RTC_COUNT_TICKS_DENOMINATOR / SIMULATED_RTC_COUNT_TICKS_NUMERATOR;
+
+  // The match is on the next time the 16-bit count comes round to the compare value.
+  unsigned long countsUntilMatch = (uint16_t)(compare - (uint16_t)count);
+  if(countsUntilMatch == 0) countsUntilMatch = 0x10000;
+
+  unsigned long long matchCount = count + countsUntilMatch;
+
+  this->rtcCompareArmed = true;
+  this->rtcCompareTicks = (matchCount * SIMULATED_RTC_COUNT_TICKS_NUMERATOR + SIMULATED_RTC_COUNT_TICKS_DENOMINATOR - 1) / SIMULATED_RTC_COUNT_TICKS_DENOMINATOR;
+}
+
+void SimulatedTurntable::cancelRtcCompare() {
+  this->rtcCompareArmed = false;
+  this->pendingInterrupts &= ~(1 << SimulatedInterrupt::RtcCompareInterrupt);
+}
+
+unsigned long long SimulatedTurntable::getSpeedEdgeTicks() {
+  return this->lastSpeedEdgeTicks;
+}
+
+void SimulatedTurntable::setMotorTrim(uint8_t duty) {
+  this->motorTrim = duty;
+}
+
+uint8_t SimulatedTurntable::getMotorTrim() {
+  return this->motorTrim;
+}
+
+int SimulatedTurntable::readSerial() {
+  if(this->serialReceiveBuffer.empty()) return -1;
+
+  uint8_t data = this->serialReceiveBuffer.front();
+  this->serialReceiveBuffer.erase(this->serialReceiveBuffer.begin());
+
+  return data;
+}
+
+void SimulatedTurntable::writeSerial(uint8_t data) {
+  // With the buffer full, the core waits for the byte being sent to finish.
+  while(this->serialTransmitBuffer.size() >= SIMULATED_SERIAL_BUFFER_SIZE) this->advanceTo(this->serialTransmitTicks);
+
+  if(this->serialTransmitting) {
+    this->serialTransmitBuffer.push_back(data);
+    return;
+  }
+
+  this->serialTransmitting = true;
+  this->serialTransmitByte = data;
+  this->serialTransmitTicks = this->ticks + SIMULATED_SERIAL_BYTE_TICKS;
+}
+
+uint8_t SimulatedTurntable::getSerialWriteSpace() {
+  return SIMULATED_SERIAL_BUFFER_SIZE - 1 - this->serialTransmitBuffer.size();
+}
+
+void SimulatedTurntable::sendSerial(const uint8_t* data, size_t length) {
+  unsigned long long arrivalTicks = this->ticks;
+  if(!this->serialIncoming.empty() && this->serialIncoming.back().first > arrivalTicks) arrivalTicks = this->serialIncoming.back().first;
+
+  for(size_t i = 0; i < length; i++) {
+    arrivalTicks += SIMULATED_SERIAL_BYTE_TICKS;
+    this->serialIncoming.push_back(std::make_pair(arrivalTicks, data[i]));
+  }
+}
+
+std::vector<uint8_t>& SimulatedTurntable::getSerialOutput() {
+  return this->serialOutput;
+}
+
+uint8_t SimulatedTurntable::readEeprom(uint16_t address) {
+  return this->eeprom[address % SIMULATED_EEPROM_SIZE];
+}
+
+void SimulatedTurntable::writeEeprom(uint16_t address, uint8_t value) {
+  address %= SIMULATED_EEPROM_SIZE;
+
+  // Only bytes that change are written.
+  if(this->eeprom[address] == value) return;
+
+  this->eepromWriteCounts[address]++;
+
+  if(this->eepromWritesUntilPowerLoss > 0 && --this->eepromWritesUntilPowerLoss == 0) {
+    this->eeprom[address] = 0xFF;
+    throw SimulatedPowerLoss(address);
+  }
+
+  this->spend(SIMULATED_EEPROM_WRITE_TICKS);
+  this->eeprom[address] = value;
+}
+
+uint8_t* SimulatedTurntable::getEeprom() {
+  return this->eeprom;
+}
+
+unsigned long SimulatedTurntable::getEepromWriteCount(uint16_t address) {
+  return this->eepromWriteCounts[address % SIMULATED_EEPROM_SIZE];
+}
+
+unsigned long SimulatedTurntable::getTotalEepromWriteCount() {
+  unsigned long total = 0;
+  for(uint16_t address = 0; address < SIMULATED_EEPROM_SIZE; address++) total += this->eepromWriteCounts[address];
+
+  return total;
+}
+
+void SimulatedTurntable::cutPowerAfterEepromWrites(unsigned long writes) {
+  this->eepromWritesUntilPowerLoss = writes;
+}
+
+void SimulatedTurntable::syncOutputs() {
+  bool coilsChanged = false;
+  bool axisChanged = false;
+  bool clutchChanged = false;
+  bool muxChanged = false;
+
+  for(uint8_t pin = 0; pin < FAST_PIN_COUNT; pin++) {
+    uint8_t port = fastPinPorts[pin];
+    uint8_t mask = 1 << fastPinBits[pin];
+    bool value = simulatedVports[port].OUT & mask;
+
+    if(value == (bool)(this->lastOutputs[port] & mask)) continue;
+
+    OutputEdge edge = { this->ticks, pin, value };
+    this->outputEdges.push_back(edge);
+
+    switch(pin) {
+      case ArduinoPin::StepperPin1:
+      case ArduinoPin::StepperPin2:
+      case ArduinoPin::StepperPin3:
+      case ArduinoPin::StepperPin4:
+        coilsChanged = true;
+        break;
+
+      case ArduinoPin::MotorAxisSelector:
+        axisChanged = true;
+        break;
+
+      case ArduinoPin::HorizontalClutchMotorDir1:
+      case ArduinoPin::HorizontalClutchMotorDir2:
+        clutchChanged = true;
+        break;
+
+      case ArduinoPin::MuxSelectorA:
+      case ArduinoPin::MuxSelectorB:
+      case ArduinoPin::MuxSelectorC:
+        muxChanged = true;
+        break;
+    }
+  }
+
+  for(uint8_t port = 0; port < 6; port++) this->lastOutputs[port] = simulatedVports[port].OUT;
+
+  // The coils are wired in the order they are energized (coil A on StepperPin4), which is the bit order of the patterns.
+  if(coilsChanged) {
+    uint8_t pattern = this->getOutput(ArduinoPin::StepperPin4) | (this->getOutput(ArduinoPin::StepperPin3) << 1) |
+      (this->getOutput(ArduinoPin::StepperPin2) << 2) | (this->getOutput(ArduinoPin::StepperPin1) << 3);
+
+    this->tonearm.setCoilPattern(this->ticks, pattern);
+  }
+
+  if(axisChanged) this->tonearm.selectAxis(this->ticks, (MotorAxis)this->getOutput(ArduinoPin::MotorAxisSelector));
+
+  if(clutchChanged) {
+    bool dir1 = this->getOutput(ArduinoPin::HorizontalClutchMotorDir1);
+    bool dir2 = this->getOutput(ArduinoPin::HorizontalClutchMotorDir2);
+
+    this->tonearm.setClutchDrive(dir1 == dir2 ? 0 : (dir1 ? 1 : -1));
+  }
+
+  // Until the multiplexer has settled, its output still follows the input that was selected before.
+  if(muxChanged) {
+    uint8_t selection = this->getOutput(ArduinoPin::MuxSelectorA) | (this->getOutput(ArduinoPin::MuxSelectorB) << 1) |
+      (this->getOutput(ArduinoPin::MuxSelectorC) << 2);
+
+    if(selection != this->muxSelection) {
+      this->lastMuxSelection = this->ticks >= this->muxSettledTicks ? this->muxSelection : this->lastMuxSelection;
+      this->muxSelection = selection;
+      this->muxSettledTicks = this->ticks + SIMULATED_MUX_SETTLE_TICKS;
+    }
+  }
+}
+
+void SimulatedTurntable::refreshInputs() {
+  this->updateEncoder();
+
+  uint8_t muxInput = this->ticks >= this->muxSettledTicks ? this->muxSelection : this->lastMuxSelection;
+
+  this->setInputPin(ArduinoPin::MuxOutput, this->getMuxInput(muxInput));
+  this->setInputPin(ArduinoPin::RepeatAfterAutoReturn, this->repeatSwitch);
+  this->setInputPin(ArduinoPin::HorizontalHomeOrPlayOpticalSensor, this->tonearm.isPastPlaySensor());
+  this->setInputPin(ArduinoPin::PickupEncoderA, this->encoderState >> 1);
+  this->setInputPin(ArduinoPin::PickupEncoderB, this->encoderState & 1);
+
+  // Output pins read back what they are driven to.
+  for(uint8_t port = 0; port < 6; port++) {
+    VPORT_t& vport = simulatedVports[port];
+    vport.IN = (vport.OUT & vport.DIR) | (this->portInputs[port] & ~vport.DIR);
+  }
+}
+
+void SimulatedTurntable::beginPortToggles() {
+  for(uint8_t port = 0; port < 6; port++) simulatedVports[port].IN = 0;
+}
+
+void SimulatedTurntable::endPortToggles() {
+  for(uint8_t port = 0; port < 6; port++) simulatedVports[port].OUT ^= simulatedVports[port].IN;
+
+  this->refreshInputs();
+}
+
+std::vector<OutputEdge>& SimulatedTurntable::getOutputEdges() {
+  return this->outputEdges;
+}
+
+void SimulatedTurntable::setAudioMuteOutput(bool muted) {
+  if(muted == this->audioMuted) return;
+
+  this->audioMuted = muted;
+  AudioMuteEdge edge = { this->ticks, muted };
+  this->audioMuteEdges.push_back(edge);
+}
+
+bool SimulatedTurntable::isAudioMuted() {
+  return this->audioMuted;
+}
+
+std::vector<AudioMuteEdge>& SimulatedTurntable::getAudioMuteEdges() {
+  return this->audioMuteEdges;
+}
+
+bool SimulatedTurntable::getOutput(uint8_t pin) {
+  return simulatedVports[fastPinPorts[pin]].OUT & (1 << fastPinBits[pin]);
+}
+
+void SimulatedTurntable::setMuxInput(MultiplexerInput input, bool value) {
+  this->muxInputs[input] = value;
+  this->refreshInputs();
+}
+
+bool SimulatedTurntable::getMuxInput(uint8_t input) {
+  if(input == MultiplexerInput::VerticalLowerLimit) return this->tonearm.isLowerLimitReached();
+  if(input == MultiplexerInput::VerticalUpperLimit) return this->tonearm.isUpperLimitReached();
+
+  return this->muxInputs[input];
+}
+
+void SimulatedTurntable::pressButton(MultiplexerInput input, unsigned long ms) {
+  this->setMuxInput(input, true);
+  this->schedule(this->ticks + ms * (SIMULATED_TICKS_PER_SECOND / 1000), [this, input]() { this->setMuxInput(input, false); });
+}
+
+void SimulatedTurntable::setRepeatSwitch(bool on) {
+  this->repeatSwitch = on;
+  this->refreshInputs();
+}
+
+void SimulatedTurntable::setDisplayDigit(uint8_t digit, uint8_t segments) {
+  if(digit < SEVEN_SEGMENT_DIGIT_COUNT) this->displayDigits[digit] = segments;
+  this->displayRefreshCount++;
+}
+
+uint8_t SimulatedTurntable::getDisplayDigit(uint8_t digit) {
+  return this->displayDigits[digit];
+}
+
+unsigned long SimulatedTurntable::getDisplayRefreshCount() {
+  return this->displayRefreshCount;
+}
+
+void SimulatedTurntable::setSpeedSwitchOff(bool off) {
+  this->speedSwitchOff = off;
+}
+
+bool SimulatedTurntable::isSpeedSwitchOff() {
+  return this->speedSwitchOff;
+}
+
+void SimulatedTurntable::schedule(unsigned long long ticks, std::function<void()> event) {
+  this->scheduledEvents.insert(std::make_pair(ticks, event));
+}
+
+PlatterModel& SimulatedTurntable::getPlatter() {
+  return this->platter;
+}
+
+TonearmModel& SimulatedTurntable::getTonearm() {
+  return this->tonearm;
+}
+
+void SimulatedTurntable::advanceTo(unsigned long long targetTicks) {
+  for(;;) {
+    if(this->canRunInterrupt()) {
+      this->runInterrupt();
+      continue;
+    }
+
+    unsigned long long nextTicks = this->getNextEventTicks();
+    if(nextTicks > targetTicks && nextTicks > this->ticks) break;
+
+    if(nextTicks > this->ticks) this->ticks = nextTicks;
+    this->processDueEvents();
+  }
+
+  if(this->ticks < targetTicks) this->ticks = targetTicks;
+}
+
+unsigned long long SimulatedTurntable::getNextEventTicks() {
+  unsigned long long nextTicks = this->worldStepTicks;
+
+  if(this->millisTimerTicks < nextTicks) nextTicks = this->millisTimerTicks;
+  if(this->rtcRunning && this->rtcTickTicks < nextTicks) nextTicks = this->rtcTickTicks;
+  if(this->rtcCompareArmed && this->rtcCompareTicks < nextTicks) nextTicks = this->rtcCompareTicks;
+  if(this->stepTimerRunning && this->stepTimerTicks < nextTicks) nextTicks = this->stepTimerTicks;
+  if(this->speedEdgeScheduled && this->speedEdgeTicks < nextTicks) nextTicks = this->speedEdgeTicks;
+  if(!this->serialIncoming.empty() && this->serialIncoming.front().first < nextTicks) nextTicks = this->serialIncoming.front().first;
+  if(this->serialTransmitting && this->serialTransmitTicks < nextTicks) nextTicks = this->serialTransmitTicks;
+  if(!this->scheduledEvents.empty() && this->scheduledEvents.begin()->first < nextTicks) nextTicks = this->scheduledEvents.begin()->first;
+
+  return nextTicks;
+}
+
+void SimulatedTurntable::processDueEvents() {
+  while(this->worldStepTicks <= this->ticks) this->stepWorld();
+
+  while(this->millisTimerTicks <= this->ticks) {
+    this->raiseInterrupt(SimulatedInterrupt::MillisTimerInterrupt);
+    this->millisTimerTicks += SIMULATED_TICKS_PER_SECOND / 1000;
+  }
+
+  while(this->rtcRunning && this->rtcTickTicks <= this->ticks) {
+    this->raiseInterrupt(SimulatedInterrupt::RtcTickInterrupt);
+    this->rtcTickTicks += SIMULATED_RTC_TICK_TICKS;
+  }
+
+  if(this->rtcCompareArmed && this->rtcCompareTicks <= this->ticks) {
+    this->rtcCompareArmed = false;
+    this->raiseInterrupt(SimulatedInterrupt::RtcCompareInterrupt);
+  }
+
+  // Each period starts where the last one ended, however late its interrupt runs.
+  while(this->stepTimerRunning && this->stepTimerTicks <= this->ticks) {
+    this->raiseInterrupt(SimulatedInterrupt::StepTimerInterrupt);
+    this->stepTimerPeriodStartTicks = this->stepTimerTicks;
+    this->stepTimerTicks += this->stepTimerCompare + 1;
+  }
+
+  if(this->speedEdgeScheduled && this->speedEdgeTicks <= this->ticks) {
+    this->speedEdgeScheduled = false;
+    this->lastSpeedEdgeTicks = this->speedEdgeTicks;
+    this->raiseInterrupt(SimulatedInterrupt::SpeedCaptureInterrupt);
+  }
+
+  // A byte that arrives with the receive buffer full is lost, as it is in the core.
+  while(!this->serialIncoming.empty() && this->serialIncoming.front().first <= this->ticks) {
+    if(this->serialReceiveBuffer.size() < SIMULATED_SERIAL_BUFFER_SIZE - 1) this->serialReceiveBuffer.push_back(this->serialIncoming.front().second);
+
+    this->serialIncoming.erase(this->serialIncoming.begin());
+    this->raiseInterrupt(SimulatedInterrupt::SerialReceiveInterrupt);
+  }
+
+  while(this->serialTransmitting && this->serialTransmitTicks <= this->ticks) {
+    this->serialOutput.push_back(this->serialTransmitByte);
+    this->raiseInterrupt(SimulatedInterrupt::SerialTransmitInterrupt);
+
+    if(this->serialTransmitBuffer.empty()) {
+      this->serialTransmitting = false;
+    }
+    else {
+      this->serialTransmitByte = this->serialTransmitBuffer.front();
+      this->serialTransmitBuffer.erase(this->serialTransmitBuffer.begin());
+      this->serialTransmitTicks += SIMULATED_SERIAL_BYTE_TICKS;
+    }
+  }
+
+  while(!this->scheduledEvents.empty() && this->scheduledEvents.begin()->first <= this->ticks) {
+    std::function<void()> event = this->scheduledEvents.begin()->second;
+    this->scheduledEvents.erase(this->scheduledEvents.begin());
+    event();
+  }
+}
+
+bool SimulatedTurntable::canRunInterrupt() {
+  return this->interruptsEnabled && !this->inInterrupt && this->pendingInterrupts != 0;
+}
+
+void SimulatedTurntable::runInterrupt() {
+  uint8_t source = 0;
+  while(!(this->pendingInterrupts & (1 << source))) source++;
+
+  this->pendingInterrupts &= ~(1 << source);
+
+  unsigned long long startTicks = this->ticks;
+  this->inInterrupt = true;
+
+  this->spend(SIMULATED_INTERRUPT_ENTRY_TICKS);
+  this->interruptHandlers[source]();
+  this->syncOutputs();
+
+  this->inInterrupt = false;
+  this->interruptCounts[source]++;
+  this->interruptTicks[source] += this->ticks - startTicks;
+}
+
+void SimulatedTurntable::raiseInterrupt(SimulatedInterrupt source) {
+  if(this->interruptHandlers[source] != NULL) this->pendingInterrupts |= (1 << source);
+}
+
+void SimulatedTurntable::stepWorld() {
+  unsigned long long stepTicks = this->worldStepTicks;
+  this->worldStepTicks += SIMULATED_WORLD_STEP_TICKS;
+
+  this->tonearm.advance(stepTicks, this->platter.getRevolutions());
+
+  // The motor controller is switched between the speeds by the speed switches themselves, and stopped by the main
+  // speed switch's center position as well as by the enable line.
+  bool motorOn = this->getOutput(ArduinoPin::TurntableMotorEnable) && !this->speedSwitchOff;
+  this->platter.setSelectedSpeed((TurntableSpeed)(this->muxInputs[MultiplexerInput::TargetSpeedA] | (this->muxInputs[MultiplexerInput::TargetSpeedB] << 1)));
+  this->platter.setDuty(motorOn ? this->motorTrim : 0);
+  this->platter.setStylusDown(this->tonearm.isStylusDown());
+
+  // The platter is moved on over the step that starts now, so the sensor edge can be raised at the exact tick it
+  // happens.
+  double pulseOffsetSeconds;
+
+  if(this->platter.advance((double)SIMULATED_WORLD_STEP_TICKS / SIMULATED_TICKS_PER_SECOND, pulseOffsetSeconds)) {
+    this->speedEdgeScheduled = true;
+    this->speedEdgeTicks = stepTicks + (unsigned long long)llround(pulseOffsetSeconds * SIMULATED_TICKS_PER_SECOND);
+  }
+
+  this->updateEncoder();
+}
+
+void SimulatedTurntable::updateEncoder() {
+  uint8_t state = this->tonearm.getEncoderState();
+  if(state == this->encoderState) return;
+
+  this->encoderState = state;
+  this->raiseInterrupt(SimulatedInterrupt::PickupEncoderInterrupt);
+}
+
+void SimulatedTurntable::scheduleStepTimer() {
+  unsigned long long count = this->ticks - this->stepTimerPeriodStartTicks;
+
+  // A compare value that the count has already passed isn't matched until the count wraps round to it.
+  if(count <= this->stepTimerCompare) this->stepTimerTicks = this->stepTimerPeriodStartTicks + this->stepTimerCompare + 1;
+  else this->stepTimerTicks = this->stepTimerPeriodStartTicks + 0x10000 + this->stepTimerCompare + 1;
+}
+
+void SimulatedTurntable::setInputPin(uint8_t pin, bool value) {
+  uint8_t mask = 1 << fastPinBits[pin];
+
+  if(value) this->portInputs[fastPinPorts[pin]] |= mask;
+  else this->portInputs[fastPinPorts[pin]] &= ~mask;
+}
@@ -0,0 +1,319 @@
+#include "arduino.h"
+#include <functional>
+#include <map>
+#include <vector>
+#include "PlatterModel.h"
+#include "TonearmModel.h"
+#include "MultiplexerScanner.h"
+#include "SevenSegmentDisplay.h"
+#include "enums/MultiplexerInput.h"
+
+#ifndef SimulatedTurntable_h
+#define SimulatedTurntable_h
+
+// The simulated clock runs at the step timer's rate, so timer counts and simulated ticks are the same thing.
+#define SIMULATED_TICKS_PER_MICROSECOND 8
+#define SIMULATED_TICKS_PER_SECOND 8000000ULL
+
+// How long the firmware spends in each call into the HAL, and entering each interrupt handler, in simulated ticks. The
+// firmware's own code runs in no time at all in between, so these stand in for all of it.
+#define SIMULATED_HAL_CALL_TICKS 16
+#define SIMULATED_INTERRUPT_ENTRY_TICKS 24
+
+// How often the platter and the tonearm are moved on (1ms).
+#define SIMULATED_WORLD_STEP_TICKS 8000
+
+// How long the multiplexer output takes to follow a change of the selector pins (2us).
+#define SIMULATED_MUX_SETTLE_TICKS 16
+
+// The RTC PIT period (64 cycles of the 32.768kHz oscillator), and the RTC counter's prescaled rate of 8.192kHz, as a
+// ratio of simulated ticks to counts.
+#define SIMULATED_RTC_TICK_TICKS 15625
+#define SIMULATED_RTC_COUNT_TICKS_NUMERATOR 15625
+#define SIMULATED_RTC_COUNT_TICKS_DENOMINATOR 16
+
+// One byte at 115200 baud, with a start and a stop bit, and the size of each direction's buffer in the Arduino core.
+#define SIMULATED_SERIAL_BYTE_TICKS 694
+#define SIMULATED_SERIAL_BUFFER_SIZE 64
+
+// The size of the ATmega4809's EEPROM, and how long each byte that changes takes to erase and write (4ms).
+#define SIMULATED_EEPROM_SIZE 256
+#define SIMULATED_EEPROM_WRITE_TICKS 32000
+
+// The interrupt sources of the simulated MCU, in priority order (the lowest vector first, as on the real chip).
+enum SimulatedInterrupt : uint8_t {
+    RtcCompareInterrupt = 0,
+    RtcTickInterrupt = 1,
+    PickupEncoderInterrupt = 2,
+    SpeedCaptureInterrupt = 3,
+    StepTimerInterrupt = 4,
+    MillisTimerInterrupt = 5,
+    SerialReceiveInterrupt = 6,
+    SerialTransmitInterrupt = 7,
+    SimulatedInterruptCount = 8
+};
+
+// A change of an output pin, and when it happened.
+struct OutputEdge {
+    unsigned long long ticks;
+    uint8_t pin;
+    bool value;
+};
+
+// A change of the Audio off line, and when it happened.
+struct AudioMuteEdge {
+    unsigned long long ticks;
+    bool muted;
+};
+
+// Thrown out of the firmware once the simulation has run for as long as it was allowed to (see setTimeLimit()).
+class SimulationStop {};
+
+// Thrown out of the firmware when the power is cut in the middle of an EEPROM write (see cutPowerAfterEepromWrites()).
+class SimulatedPowerLoss {
+    public:
+        SimulatedPowerLoss(uint16_t address) : address(address) {}
+
+        uint16_t address;
+};
+
+// The Nano Every and everything attached to it, for running the firmware on the host. Time only passes when the
+// firmware calls into the HAL (see SIMULATED_HAL_CALL_TICKS), sleeps, or runs an interrupt handler, and the interrupts
+// are run the way the chip runs them: when they are enabled, one at a time, and as soon as they are pending. The
+// platter and the tonearm are moved on every SIMULATED_WORLD_STEP_TICKS, and everything they do comes back through the
+// same pins and interrupts that the real sensors use.
+//
+// The firmware's globals can't be reset, so each process simulates a single power-on. There is a single instance,
+// simulator, which the simulated HAL and the Arduino stubs drive.
+class SimulatedTurntable {
+    public:
+
+        // Constructor
+        SimulatedTurntable();
+
+        // The simulated time, since power-on.
+        unsigned long long getTicks();
+        unsigned long getMicros();
+        unsigned long getMillis();
+        double getSeconds();
+
+        // Throw SimulationStop from the next call into the HAL from the main program once the simulated time reaches the
+        // given number of seconds.
+        void setTimeLimit(double seconds);
+
+        // Run the firmware's setup(), and then its loop() until the given time (in seconds since power-on), or until
+        // the condition is true, checking it between iterations of the loop. A routine that is still running at that
+        // time is left to finish. Returns false if the time ran out before the condition came true.
+        void runSetup();
+        bool runUntil(double seconds, std::function<bool()> condition = std::function<bool()>());
+        void runFor(double seconds);
+
+        // Called at the start of every simulated HAL method. Spends the time of the call, running any interrupts that
+        // come due, and checks the time limit.
+        void enterHal();
+
+        // Spend the given number of ticks in the firmware.
+        void spend(unsigned long long ticks);
+
+        // Sleep until an interrupt is pending. This is called with interrupts disabled, and leaves them to be run when
+        // the caller enables them again.
+        void sleepUntilInterrupt();
+
+        // The global interrupt flag, and whether an interrupt handler is running.
+        bool areInterruptsEnabled();
+        void setInterruptsEnabled(bool enabled);
+        bool isInInterrupt();
+
+        // Set the function that runs for an interrupt source. A source without one is never raised.
+        void setInterruptHandler(SimulatedInterrupt source, void (*handler)());
+
+        // How many times each interrupt has run, and how long it spent in its handler, in ticks.
+        unsigned long getInterruptCount(SimulatedInterrupt source);
+        unsigned long long getInterruptTicks(SimulatedInterrupt source);
+
+        // How long the MCU has spent asleep.
+        unsigned long long getSleptTicks();
+
+        // TCB2 in periodic interrupt mode: the interrupt fires every compare + 1 ticks.
+        void startStepTimer(uint16_t compare);
+        void setStepTimerCompare(uint16_t compare);
+        void stopStepTimer();
+
+        // The RTC: its PIT tick, and its counter's compare match, used as a one-shot timer.
+        void startRtc();
+        uint16_t getRtcCount();
+        void setRtcCompare(uint16_t compare);
+        void cancelRtcCompare();
+
+        // When the speed sensor's last rising edge was, for the input capture.
+        unsigned long long getSpeedEdgeTicks();
+
+        // The duty cycle of the turntable motor trim. The simulated motor controller takes a speed trim input, as if
+        // TURNTABLE_MOTOR_TRIM_PIN were assigned.
+        void setMotorTrim(uint8_t duty);
+        uint8_t getMotorTrim();
+
+        // The hardware serial port, from the firmware's side.
+        int readSerial();
+        void writeSerial(uint8_t data);
+        uint8_t getSerialWriteSpace();
+
+        // The other end of the serial port: queue bytes to arrive one after the other from now, and everything the
+        // firmware has sent.
+        void sendSerial(const uint8_t* data, size_t length);
+        std::vector<uint8_t>& getSerialOutput();
+
+        // The EEPROM, and how many times each byte has been written.
+        uint8_t readEeprom(uint16_t address);
+        void writeEeprom(uint16_t address, uint8_t value);
+        uint8_t* getEeprom();
+        unsigned long getEepromWriteCount(uint16_t address);
+        unsigned long getTotalEepromWriteCount();
+
+        // Cut the power in the middle of the given number of EEPROM byte writes from now (1 is the next one). The byte
+        // being written is left erased, and SimulatedPowerLoss is thrown out of the firmware. Zero never cuts it.
+        void cutPowerAfterEepromWrites(unsigned long writes);
+
+        // Record the changes to the output pins since this was last called, and pass them on to the models.
+        void syncOutputs();
+
+        // Bring the input bits of the VPORT registers up to date with the models.
+        void refreshInputs();
+
+        // Toggle the outputs from writes made to the VPORT IN registers between these two calls, which is what the real
+        // chip does with them.
+        void beginPortToggles();
+        void endPortToggles();
+
+        // Every output pin change so far, and the current value of an output pin.
+        std::vector<OutputEdge>& getOutputEdges();
+        bool getOutput(uint8_t pin);
+
+        // The AudioPassController's Audio off line, as if AUDIO_MUTE_PIN were assigned, and every change of it so far.
+        void setAudioMuteOutput(bool muted);
+        bool isAudioMuted();
+        std::vector<AudioMuteEdge>& getAudioMuteEdges();
+
+        // The buttons and switches on the multiplexer. The limit switches come from the tonearm model, and can't be set.
+        void setMuxInput(MultiplexerInput input, bool value);
+        bool getMuxInput(uint8_t input);
+
+        // Press a button on the multiplexer for the given number of milliseconds, from now.
+        void pressButton(MultiplexerInput input, unsigned long ms = 100);
+
+        // The repeat switch.
+        void setRepeatSwitch(bool on);
+
+        // The seven-segment display: the segments last lit on each digit (see SevenSegmentDisplay.h), and how many
+        // times a digit has been lit.
+        void setDisplayDigit(uint8_t digit, uint8_t segments);
+        uint8_t getDisplayDigit(uint8_t digit);
+        unsigned long getDisplayRefreshCount();
+
+        // Put the main speed switch in its center "off" position, which stops the motor controller, or back. The
+        // firmware reads it as if SPEED_SWITCH_OFF_PIN were assigned.
+        void setSpeedSwitchOff(bool off);
+        bool isSpeedSwitchOff();
+
+        // Call the function once the simulated time reaches the given tick, from outside the firmware.
+        void schedule(unsigned long long ticks, std::function<void()> event);
+
+        // The turntable's mechanics.
+        PlatterModel& getPlatter();
+        TonearmModel& getTonearm();
+
+    private:
+        // Move the clock on to the given tick, running any interrupts that come due, if they can be.
+        void advanceTo(unsigned long long targetTicks);
+
+        // The tick of the next thing that happens by itself, i.e. a timer firing or the world being moved on.
+        unsigned long long getNextEventTicks();
+
+        // Handle everything that is due by now.
+        void processDueEvents();
+
+        // Run the highest priority pending interrupt.
+        void runInterrupt();
+        bool canRunInterrupt();
+
+        void raiseInterrupt(SimulatedInterrupt source);
+
+        // Move the platter and the tonearm on by one world step.
+        void stepWorld();
+
+        // Raise the encoder interrupt if the tonearm has moved the encoder.
+        void updateEncoder();
+
+        // Where the step timer next fires, from its compare value and where its count is.
+        void scheduleStepTimer();
+
+        // Set or clear a bit of an input pin.
+        void setInputPin(uint8_t pin, bool value);
+
+        unsigned long long ticks;
+        unsigned long long timeLimitTicks;
+
+        bool interruptsEnabled;
+        bool inInterrupt;
+        uint8_t pendingInterrupts;
+        void (*interruptHandlers[SimulatedInterruptCount])();
+        unsigned long interruptCounts[SimulatedInterruptCount];
+        unsigned long long interruptTicks[SimulatedInterruptCount];
+        unsigned long long sleptTicks;
+
+        unsigned long long worldStepTicks;
+        unsigned long long millisTimerTicks;
+
+        bool stepTimerRunning;
+        uint16_t stepTimerCompare;
+        unsigned long long stepTimerPeriodStartTicks;
+        unsigned long long stepTimerTicks;
+
+        bool rtcRunning;
+        unsigned long long rtcTickTicks;
+        bool rtcCompareArmed;
+        unsigned long long rtcCompareTicks;
+
+        bool speedEdgeScheduled;
+        unsigned long long speedEdgeTicks;
+        unsigned long long lastSpeedEdgeTicks;
+
+        uint8_t motorTrim;
+
+        std::vector<uint8_t> serialReceiveBuffer;
+        std::vector<std::pair<unsigned long long, uint8_t> > serialIncoming;
+        std::vector<uint8_t> serialTransmitBuffer;
+        bool serialTransmitting;
+        uint8_t serialTransmitByte;
+        unsigned long long serialTransmitTicks;
+        std::vector<uint8_t> serialOutput;
+
+        uint8_t eeprom[SIMULATED_EEPROM_SIZE];
+        unsigned long eepromWriteCounts[SIMULATED_EEPROM_SIZE];
+        unsigned long eepromWritesUntilPowerLoss;
+
+        uint8_t lastOutputs[6];
+        uint8_t portInputs[6];
+        std::vector<OutputEdge> outputEdges;
+        bool audioMuted;
+        std::vector<AudioMuteEdge> audioMuteEdges;
+
+        bool muxInputs[MULTIPLEXER_INPUT_COUNT];
+        uint8_t muxSelection;
+        uint8_t lastMuxSelection;
+        unsigned long long muxSettledTicks;
+        bool repeatSwitch;
+        bool speedSwitchOff;
+        uint8_t displayDigits[SEVEN_SEGMENT_DIGIT_COUNT];
+        unsigned long displayRefreshCount;
+        uint8_t encoderState;
+
+        std::multimap<unsigned long long, std::function<void()> > scheduledEvents;
+
+        PlatterModel platter;
+        TonearmModel tonearm;
+};
+
+extern SimulatedTurntable simulator;
+
+#endif
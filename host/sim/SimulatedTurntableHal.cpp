@@ -0,0 +1,366 @@
+#include "TurntableHal.h"
+#include "MultiplexerScanner.h"
+#include "StepperCoilDriver.h"
+#include "SimulatedTurntable.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+#include "enums/MultiplexerInput.h"
+
+// The implementation of TurntableHal for the host, against the SimulatedTurntable. It is TurntableHal.cpp with each
+// peripheral register swapped for the simulator's model of it: the coil driver, the multiplexer scanner and the
+// movement status output are exactly the same, so the pins change in the same order as they do on the Nano Every.
+
+static StepperCoilDriver tonearmMotor = StepperCoilDriver(
+  ArduinoPin::StepperPin4,
+  ArduinoPin::StepperPin3,
+  ArduinoPin::StepperPin2,
+  ArduinoPin::StepperPin1
+);
+
+static MultiplexerScanner<
+  ArduinoPin::MuxOutput,
+  ArduinoPin::MuxSelectorA,
+  ArduinoPin::MuxSelectorB,
+  ArduinoPin::MuxSelectorC
+> mux;
+
+static void (*stepTimerHandler)() = NULL;
+static void (*tickHandler)() = NULL;
+static void (*displayRefreshHandler)() = NULL;
+static void (*speedCaptureHandler)(unsigned long timestampMicros) = NULL;
+static void (*pickupEncoderHandler)(uint8_t state) = NULL;
+
+// The coil driver toggles its pins through the VPORT IN registers, which the simulator has to apply itself.
+static void writeCoils(void (*write)()) {
+  simulator.beginPortToggles();
+  write();
+  simulator.endPortToggles();
+  simulator.syncOutputs();
+}
+
+static int8_t stepDirection = 0;
+
+static void stepCoils() {
+  tonearmMotor.step(stepDirection);
+}
+
+static void releaseCoils() {
+  tonearmMotor.release();
+}
+
+static void beginCoils() {
+  tonearmMotor.begin();
+}
+
+// The interrupt handlers, as in TurntableHal.cpp.
+
+static void onSpeedCapture() {
+  uint16_t ticksSinceEdge = (uint16_t)(simulator.getTicks() - simulator.getSpeedEdgeTicks());
+  unsigned long nowMicros = simulator.getMicros();
+
+  if(speedCaptureHandler != NULL) speedCaptureHandler(nowMicros - ticksSinceEdge / STEP_TIMER_TICKS_PER_MICROSECOND);
+}
+
+static void onTick() {
+  if(displayRefreshHandler != NULL) displayRefreshHandler();
+  if(tickHandler != NULL) tickHandler();
+}
+
+static void onRtcCompare() {
+  simulator.setAudioMuteOutput(false);
+}
+
+static void onStepTimer() {
+  if(stepTimerHandler != NULL) stepTimerHandler();
+}
+
+static void onPickupEncoderChange() {
+  if(pickupEncoderHandler != NULL) pickupEncoderHandler(TurntableHal::readPickupEncoderState());
+}
+
+void TurntableHal::begin() {
+  simulator.enterHal();
+
+  pinMode(ArduinoPin::MotorAxisSelector, OUTPUT);
+  pinMode(ArduinoPin::MovementStatusLed, OUTPUT);
+  pinMode(ArduinoPin::PauseStatusLed, OUTPUT);
+  pinMode(ArduinoPin::SpeedSensor, INPUT);
+  pinMode(ArduinoPin::TurntableMotorEnable, OUTPUT);
+  pinMode(ArduinoPin::HorizontalClutchMotorDir1, OUTPUT);
+  pinMode(ArduinoPin::HorizontalClutchMotorDir2, OUTPUT);
+
+  mux.setSettleMicros(MULTIPLEXER_DELAY_MICROS);
+  mux.setMaxAgeMicros(MULTIPLEXER_MAX_AGE_MICROS);
+  mux.setDebounce(
+    (1 << MultiplexerInput::PlayHomeButton) | (1 << MultiplexerInput::PauseButton) | (1 << MultiplexerInput::AutoManualSwitch) |
+    (1 << MultiplexerInput::TargetSpeedA) | (1 << MultiplexerInput::TargetSpeedB) | (1 << MultiplexerInput::WaitUntilTargetSpeed),
+    MULTIPLEXER_DEBOUNCE_SCANS
+  );
+  mux.begin();
+  writeCoils(beginCoils);
+
+  simulator.setInterruptHandler(SimulatedInterrupt::RtcCompareInterrupt, onRtcCompare);
+}
+
+bool TurntableHal::readPin(uint8_t pin) {
+  simulator.enterHal();
+
+  return digitalRead(pin);
+}
+
+void TurntableHal::writePin(uint8_t pin, bool value) {
+  simulator.enterHal();
+
+  digitalWrite(pin, value);
+}
+
+bool TurntableHal::readMuxInput(uint8_t input) {
+  simulator.enterHal();
+
+  return mux.read(input);
+}
+
+unsigned long TurntableHal::getMuxScanCount() {
+  return mux.getScanCount();
+}
+
+unsigned long TurntableHal::currentMillis() {
+  simulator.enterHal();
+
+  return simulator.getMillis();
+}
+
+unsigned long TurntableHal::currentMicros() {
+  simulator.enterHal();
+
+  return simulator.getMicros();
+}
+
+void TurntableHal::waitMs(unsigned long ms) {
+  simulator.enterHal();
+  simulator.spend((unsigned long long)ms * 1000 * SIMULATED_TICKS_PER_MICROSECOND);
+}
+
+void TurntableHal::waitMicros(unsigned int us) {
+  simulator.enterHal();
+  simulator.spend((unsigned long long)us * SIMULATED_TICKS_PER_MICROSECOND);
+}
+
+void TurntableHal::selectMotorAxis(MotorAxis axis) {
+  simulator.enterHal();
+
+  if(axis != tonearmMotor.getAxis()) writeCoils(releaseCoils);
+
+  FastPin<ArduinoPin::MotorAxisSelector>::write(axis);
+  tonearmMotor.selectAxis(axis);
+  simulator.syncOutputs();
+}
+
+void TurntableHal::setTonearmStepSequence(StepSequence sequence) {
+  tonearmMotor.setSequence(sequence);
+}
+
+void TurntableHal::stepTonearmMotor(int8_t direction) {
+  simulator.enterHal();
+
+  stepDirection = direction;
+  writeCoils(stepCoils);
+}
+
+void TurntableHal::releaseTonearmMotor() {
+  simulator.enterHal();
+
+  writeCoils(releaseCoils);
+  FastPin<ArduinoPin::MotorAxisSelector>::write(LOW);
+  simulator.syncOutputs();
+}
+
+void TurntableHal::releaseTonearmCoils() {
+  simulator.enterHal();
+
+  writeCoils(releaseCoils);
+}
+
+void TurntableHal::setMovementStatusLed(bool on) {
+  simulator.enterHal();
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  FastPin<ArduinoPin::MovementStatusLed>::write(on);
+  simulator.syncOutputs();
+
+  SREG = oldSREG;
+}
+
+void TurntableHal::setAudioMuted(bool muted) {
+  simulator.enterHal();
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  simulator.cancelRtcCompare();
+  simulator.setAudioMuteOutput(muted);
+
+  SREG = oldSREG;
+}
+
+void TurntableHal::unmuteAudioAfter(uint16_t ms) {
+  if(ms == 0) {
+    TurntableHal::setAudioMuted(false);
+    return;
+  }
+
+  simulator.enterHal();
+
+  if(ms > 7999) ms = 7999;
+
+  uint16_t counts = ((unsigned long)ms * 1024 + 62) / 125;
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  simulator.setRtcCompare(simulator.getRtcCount() + counts);
+
+  SREG = oldSREG;
+}
+
+// The clutch motor's H-bridge is driven the way the DcMotor library drives it: Dir1 HIGH to engage, Dir2 HIGH to
+// disengage.
+void TurntableHal::startClutch(HorizontalClutchPosition position) {
+  simulator.enterHal();
+
+  FastPin<ArduinoPin::HorizontalClutchMotorDir1>::write(position == HorizontalClutchPosition::Engage);
+  FastPin<ArduinoPin::HorizontalClutchMotorDir2>::write(position == HorizontalClutchPosition::Disengage);
+  simulator.syncOutputs();
+}
+
+void TurntableHal::stopClutch() {
+  simulator.enterHal();
+
+  FastPin<ArduinoPin::HorizontalClutchMotorDir1>::write(LOW);
+  FastPin<ArduinoPin::HorizontalClutchMotorDir2>::write(LOW);
+  simulator.syncOutputs();
+}
+
+void TurntableHal::setTurntableMotorEnabled(bool enabled) {
+  simulator.enterHal();
+
+  FastPin<ArduinoPin::TurntableMotorEnable>::write(enabled);
+  simulator.syncOutputs();
+}
+
+// The trim PWM isn't simulated edge by edge. The platter model takes the duty cycle.
+void TurntableHal::setTurntableMotorTrim(uint8_t duty) {
+  simulator.enterHal();
+
+  simulator.setMotorTrim(duty);
+}
+
+bool TurntableHal::isSpeedSwitchOff() {
+  simulator.enterHal();
+
+  return simulator.isSpeedSwitchOff();
+}
+
+void TurntableHal::startStepTimer(uint16_t intervalTicks, void (*handler)()) {
+  simulator.enterHal();
+
+  stepTimerHandler = handler;
+  simulator.setInterruptHandler(SimulatedInterrupt::StepTimerInterrupt, onStepTimer);
+  simulator.startStepTimer(intervalTicks);
+}
+
+void TurntableHal::setStepTimerInterval(uint16_t intervalTicks) {
+  simulator.setStepTimerCompare(intervalTicks);
+}
+
+void TurntableHal::stopStepTimer() {
+  simulator.enterHal();
+
+  simulator.stopStepTimer();
+}
+
+void TurntableHal::beginSpeedCapture(void (*handler)(unsigned long timestampMicros)) {
+  simulator.enterHal();
+
+  speedCaptureHandler = handler;
+  simulator.setInterruptHandler(SimulatedInterrupt::SpeedCaptureInterrupt, onSpeedCapture);
+}
+
+uint8_t TurntableHal::readPickupEncoderState() {
+  return (FastPin<ArduinoPin::PickupEncoderA>::read() << 1) | FastPin<ArduinoPin::PickupEncoderB>::read();
+}
+
+void TurntableHal::beginPickupEncoderCapture(void (*handler)(uint8_t state)) {
+  simulator.enterHal();
+
+  pickupEncoderHandler = handler;
+
+  pinMode(ArduinoPin::PickupEncoderA, INPUT);
+  pinMode(ArduinoPin::PickupEncoderB, INPUT);
+  simulator.setInterruptHandler(SimulatedInterrupt::PickupEncoderInterrupt, onPickupEncoderChange);
+}
+
+void TurntableHal::beginSerial(unsigned long baud) {
+  simulator.enterHal();
+}
+
+int TurntableHal::readSerial() {
+  simulator.enterHal();
+
+  return simulator.readSerial();
+}
+
+void TurntableHal::writeSerial(const uint8_t* data, uint8_t length) {
+  simulator.enterHal();
+
+  for(uint8_t i = 0; i < length; i++) simulator.writeSerial(data[i]);
+}
+
+uint8_t TurntableHal::getSerialWriteSpace() {
+  simulator.enterHal();
+
+  return simulator.getSerialWriteSpace();
+}
+
+void TurntableHal::beginTick(void (*handler)()) {
+  simulator.enterHal();
+
+  tickHandler = handler;
+  simulator.setInterruptHandler(SimulatedInterrupt::RtcTickInterrupt, onTick);
+  simulator.startRtc();
+}
+
+void TurntableHal::beginDisplayRefresh(void (*handler)()) {
+  simulator.enterHal();
+
+  displayRefreshHandler = handler;
+}
+
+// The simulator has a display, as if the main board had pins for one.
+void TurntableHal::writeDisplayDigit(uint8_t digit, uint8_t segments) {
+  simulator.setDisplayDigit(digit, segments);
+}
+
+void TurntableHal::sleepUntilInterrupt(volatile uint8_t* wakeFlags) {
+  simulator.enterHal();
+
+  noInterrupts();
+
+  if(*wakeFlags == 0) simulator.sleepUntilInterrupt();
+
+  interrupts();
+}
+
+uint8_t TurntableHal::readEeprom(uint16_t address) {
+  simulator.enterHal();
+
+  return simulator.readEeprom(address);
+}
+
+void TurntableHal::writeEeprom(uint16_t address, uint8_t value) {
+  simulator.enterHal();
+
+  simulator.writeEeprom(address, value);
+}
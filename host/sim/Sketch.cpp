@@ -0,0 +1,4 @@
+// The sketch itself, built as an ordinary translation unit. The Arduino IDE includes the core before anything else in
+// the sketch, so this does too.
+#include "arduino.h"
+#include "AutomaticTurntable.ino"
@@ -0,0 +1,35 @@
+#include "arduino.h"
+#include "proto/AutomaticTurntable.h"
+#include "TurntableSpeedMonitor.h"
+#include "TurntableSpeedRegulator.h"
+#include "QuadratureEncoder.h"
+#include "LeadOutDetector.h"
+#include "TonearmMovementController.h"
+#include "RoutineExecutor.h"
+#include "SerialProtocol.h"
+#include "CalibrationStore.h"
+#include "SensorCapture.h"
+#include "enums/RecordSize.h"
+
+#ifndef Sketch_h
+#define Sketch_h
+
+// The sketch's globals, for the host programs that run it (see Sketch.cpp). The functions are declared in
+// proto/AutomaticTurntable.h.
+extern TurntableTonearmController tonearmController;
+extern TurntableSpeedMonitor speedMonitor;
+extern TurntableSpeedRegulator speedRegulator;
+extern RoutineExecutor routineExecutor;
+extern QuadratureEncoder pickupEncoder;
+extern LeadOutDetector leadOutDetector;
+extern SerialProtocol serialProtocol;
+extern CalibrationStore calibrationStore;
+extern SensorCapture sensorCapture;
+
+extern unsigned long homeRoutineMs;
+extern unsigned long playRoutineMs;
+extern unsigned long repeatRoutineMs;
+extern RecordSize recordSize;
+extern bool paused;
+
+#endif
@@ -0,0 +1,341 @@
+#include <math.h>
+#include "TonearmModel.h"
+#include "SimulatedTurntable.h"
+
+// The half-step phase of each coil pattern (coil A in bit 0), or -1 for a pattern that no sequence outputs. This is the
+// same table that the StepperCoilDriver steps through.
+static const int8_t coilPatternPhases[16] = {
+  -1, 7, 1, 0, 3, -1, 2, -1, 5, 6, -1, -1, 4, -1, -1, -1
+};
+
+// The pickup encoder state, as (A << 1) | B, for each count modulo four. Counting up goes 00, 10, 11, 01.
+static const uint8_t encoderStates[4] = { 0b00, 0b10, 0b11, 0b01 };
+
+// The record edge positions of each RecordSize, a few steps from the calibration defaults.
+static const double defaultRecordEdgeSteps[3] = { 705, 455, 205 };
+
+TonearmModel::TonearmModel() {
+    for(uint8_t axis = 0; axis < 2; axis++) {
+      Motor& motor = this->motors[axis];
+      motor.pattern = 0;
+      motor.phase = 0;
+      motor.lastChange = 0;
+      motor.position = 0;
+      motor.lastMoveTicks = 0;
+      motor.halfStepTicks = 0;
+      motor.hasMoved = false;
+      motor.blockedSteps = 0;
+    }
+
+    this->selectedAxis = MotorAxis::Vertical;
+    this->coilPattern = 0;
+
+    this->liftSteps = 0;
+    this->armSteps = 0;
+    this->gearSteps = 0;
+
+    this->clutchPosition = 0;
+    this->clutchDrive = 0;
+    this->lastAdvanceTicks = 0;
+
+    this->record = defaultRecord(RecordSize::TwelveInch);
+    this->obstructionSteps = -1;
+    this->platterRevolutions = 0;
+    this->lastPlatterRevolutions = 0;
+    this->stylusDown = false;
+}
+
+SimulatedRecord TonearmModel::defaultRecord(RecordSize size) {
+  SimulatedRecord record;
+  record.present = true;
+  record.edgeSteps = defaultRecordEdgeSteps[size];
+  record.musicSteps = record.edgeSteps + 60;
+  record.leadOutSteps = 920;
+  record.lockedGrooveSteps = 976;
+  record.leadInPitchSteps = 16;
+  record.musicPitchSteps = 1;
+  record.leadOutPitchSteps = 16;
+  record.eccentricitySteps = 3;
+
+  return record;
+}
+
+void TonearmModel::setRecord(const SimulatedRecord& record) {
+  this->record = record;
+}
+
+void TonearmModel::setLiftSteps(double steps) {
+  this->liftSteps = steps;
+  this->motors[MotorAxis::Vertical].position = -lround(steps * 2);
+}
+
+void TonearmModel::setArmSteps(double steps) {
+  this->armSteps = steps;
+  this->gearSteps = steps;
+}
+
+void TonearmModel::setObstructionSteps(double steps) {
+  this->obstructionSteps = steps;
+}
+
+void TonearmModel::setCoilPattern(unsigned long long ticks, uint8_t pattern) {
+  this->coilPattern = pattern;
+  this->driveMotor(ticks, this->selectedAxis, pattern);
+}
+
+void TonearmModel::selectAxis(unsigned long long ticks, MotorAxis axis) {
+  if(axis == this->selectedAxis) return;
+
+  // The motor that is switched away from loses its pattern, and the one that is switched to gets whatever is on the pins.
+  this->driveMotor(ticks, this->selectedAxis, 0);
+  this->selectedAxis = axis;
+
+  if(this->coilPattern != 0) this->addAnomaly(ticks, axis, TonearmAnomalyType::DemuxGlitchAnomaly);
+  this->driveMotor(ticks, axis, this->coilPattern);
+}
+
+void TonearmModel::setClutchDrive(int8_t direction) {
+  this->clutchDrive = direction;
+}
+
+void TonearmModel::advance(unsigned long long ticks, double platterRevolutions) {
+  double seconds = (ticks - this->lastAdvanceTicks) / (double)SIMULATED_TICKS_PER_SECOND;
+  this->lastAdvanceTicks = ticks;
+
+  // The gears only mesh again once the clutch is all the way in, and wherever they happen to land is in the middle of
+  // the slack.
+  bool wasEngaged = this->isClutchEngaged();
+  this->clutchPosition += this->clutchDrive * seconds * 1000 / TONEARM_MODEL_CLUTCH_TRAVEL_MS;
+  if(this->clutchPosition < 0) this->clutchPosition = 0;
+  else if(this->clutchPosition > 1) this->clutchPosition = 1;
+
+  if(!wasEngaged && this->isClutchEngaged()) this->gearSteps = this->armSteps + TONEARM_MODEL_GEAR_SLACK_STEPS / 2.0;
+
+  this->lastPlatterRevolutions = this->platterRevolutions;
+  this->platterRevolutions = platterRevolutions;
+
+  // The groove pulls the tonearm inwards, unless the gears are holding it.
+  if(this->stylusDown && !this->isClutchEngaged()) {
+    double lockedGroove = TONEARM_MODEL_PLAY_SENSOR_STEPS + this->record.lockedGrooveSteps;
+
+    if(this->armSteps < lockedGroove) {
+      this->armSteps += this->getGroovePitch() * (this->platterRevolutions - this->lastPlatterRevolutions);
+      if(this->armSteps > lockedGroove) this->armSteps = lockedGroove;
+    }
+  }
+
+  this->updateStylus(ticks);
+}
+
+bool TonearmModel::isLowerLimitReached() {
+  return this->liftSteps <= 0;
+}
+
+bool TonearmModel::isUpperLimitReached() {
+  return this->liftSteps >= TONEARM_MODEL_LIFT_TRAVEL_STEPS;
+}
+
+bool TonearmModel::isPastPlaySensor() {
+  return this->armSteps >= TONEARM_MODEL_PLAY_SENSOR_STEPS;
+}
+
+uint8_t TonearmModel::getEncoderState() {
+  double position = this->armSteps;
+
+  if(this->stylusDown) position += this->record.eccentricitySteps * sin(2 * M_PI * this->platterRevolutions);
+
+  long count = (long)floor(position / TONEARM_MODEL_STEPS_PER_ENCODER_COUNT);
+
+  return encoderStates[count & 3];
+}
+
+double TonearmModel::getLiftSteps() {
+  return this->liftSteps;
+}
+
+double TonearmModel::getArmSteps() {
+  return this->armSteps;
+}
+
+long TonearmModel::getMotorPosition(MotorAxis axis) {
+  return this->motors[axis].position;
+}
+
+bool TonearmModel::isClutchEngaged() {
+  return this->clutchPosition >= 1;
+}
+
+bool TonearmModel::isStylusDown() {
+  return this->stylusDown;
+}
+
+const SimulatedRecord& TonearmModel::getRecord() {
+  return this->record;
+}
+
+double TonearmModel::getRecordEdgeArmSteps() {
+  return TONEARM_MODEL_PLAY_SENSOR_STEPS + this->record.edgeSteps;
+}
+
+const std::vector<TonearmAnomaly>& TonearmModel::getAnomalies() {
+  return this->anomalies;
+}
+
+const std::vector<TonearmStep>& TonearmModel::getSteps() {
+  return this->steps;
+}
+
+const std::vector<StylusEvent>& TonearmModel::getStylusEvents() {
+  return this->stylusEvents;
+}
+
+void TonearmModel::clearLogs() {
+  this->anomalies.clear();
+  this->steps.clear();
+  this->stylusEvents.clear();
+}
+
+unsigned long TonearmModel::getBlockedStepCount(MotorAxis axis) {
+  return this->motors[axis].blockedSteps;
+}
+
+void TonearmModel::driveMotor(unsigned long long ticks, MotorAxis axis, uint8_t pattern) {
+  Motor& motor = this->motors[axis];
+  if(pattern == motor.pattern) return;
+
+  motor.pattern = pattern;
+
+  // With the coils off, the gearing holds the rotor where it is, as long as it was left on a full step.
+  if(pattern == 0) {
+    if((motor.phase & 1) && (motor.lastChange == 1 || motor.lastChange == -1)) {
+      this->addAnomaly(ticks, axis, TonearmAnomalyType::HalfStepReleaseAnomaly);
+    }
+    return;
+  }
+
+  int8_t phase = coilPatternPhases[pattern & 0xF];
+
+  if(phase < 0) {
+    this->addAnomaly(ticks, axis, TonearmAnomalyType::InvalidCoilPatternAnomaly);
+    return;
+  }
+
+  // The rotor turns the short way round to the new pattern. Four half steps either way is a tie, and the rotor may go
+  // either way (or nowhere).
+  int8_t change = ((phase - motor.phase + 4) & 7) - 4;
+  if(change == 0) return;
+
+  // The rotor can only start at its pull-in rate, and only speed up a little with each half step, up to its top speed.
+  unsigned long long halfStepTicks = (ticks - motor.lastMoveTicks) / (change < 0 ? -change : change);
+  unsigned long long followableTicks = TONEARM_MODEL_PULL_IN_HALF_STEP_MICROS * SIMULATED_TICKS_PER_MICROSECOND;
+  if(motor.halfStepTicks < followableTicks) followableTicks = motor.halfStepTicks;
+
+  followableTicks = followableTicks * (100 - TONEARM_MODEL_MAX_SPEEDUP_PERCENT) / 100;
+  if(followableTicks < TONEARM_MODEL_MIN_HALF_STEP_MICROS * SIMULATED_TICKS_PER_MICROSECOND) {
+    followableTicks = TONEARM_MODEL_MIN_HALF_STEP_MICROS * SIMULATED_TICKS_PER_MICROSECOND;
+  }
+
+  if(change < -2 || change > 2) {
+    this->addAnomaly(ticks, axis, TonearmAnomalyType::SkippedStepAnomaly);
+  }
+  else if(motor.hasMoved && halfStepTicks < followableTicks) {
+    this->addAnomaly(ticks, axis, TonearmAnomalyType::StepTooFastAnomaly);
+  }
+
+  motor.halfStepTicks = halfStepTicks;
+  motor.phase = phase;
+  motor.lastChange = change;
+  motor.lastMoveTicks = ticks;
+  motor.hasMoved = true;
+
+  if(axis == MotorAxis::Vertical) this->moveLift(ticks, change);
+  else this->moveArm(ticks, change);
+
+  TonearmStep step = { ticks, axis, motor.position };
+  this->steps.push_back(step);
+}
+
+void TonearmModel::moveLift(unsigned long long ticks, int8_t halfSteps) {
+  Motor& motor = this->motors[MotorAxis::Vertical];
+
+  // Stepping backwards raises the lift. Past either hard stop, the motor slips instead.
+  double lift = this->liftSteps - halfSteps / 2.0;
+
+  if(lift < -TONEARM_MODEL_LIFT_OVERTRAVEL_STEPS || lift > TONEARM_MODEL_LIFT_TRAVEL_STEPS + TONEARM_MODEL_LIFT_OVERTRAVEL_STEPS) {
+    motor.blockedSteps++;
+    return;
+  }
+
+  motor.position += halfSteps;
+  this->liftSteps = lift;
+  this->updateStylus(ticks);
+}
+
+void TonearmModel::moveArm(unsigned long long ticks, int8_t halfSteps) {
+  Motor& motor = this->motors[MotorAxis::Horizontal];
+  motor.position += halfSteps;
+
+  // With the clutch out, the motor turns nothing.
+  if(!this->isClutchEngaged()) return;
+
+  double lastArm = this->armSteps;
+  this->gearSteps += halfSteps / 2.0;
+
+  // The tonearm only moves once the gear has taken up the slack in the direction it is turning.
+  double arm = this->armSteps;
+  if(this->gearSteps - arm > TONEARM_MODEL_GEAR_SLACK_STEPS) arm = this->gearSteps - TONEARM_MODEL_GEAR_SLACK_STEPS;
+  else if(this->gearSteps < arm) arm = this->gearSteps;
+
+  // A lowered tonearm outside the record bumps into its edge. The clutch slips against it, and against the hard stops.
+  double stop = TONEARM_MODEL_INNER_STOP_STEPS;
+  double edge = this->getRecordEdgeArmSteps();
+
+  if(this->record.present && this->liftSteps < TONEARM_MODEL_STYLUS_CONTACT_STEPS && lastArm <= edge && edge < stop) {
+    stop = edge;
+  }
+
+  if(arm > stop) {
+    arm = stop;
+    this->gearSteps = stop + TONEARM_MODEL_GEAR_SLACK_STEPS;
+    motor.blockedSteps++;
+  }
+  else if(arm < 0) {
+    arm = 0;
+    this->gearSteps = 0;
+    motor.blockedSteps++;
+  }
+  else if(this->obstructionSteps >= 0 && lastArm >= this->obstructionSteps && arm < this->obstructionSteps) {
+    arm = this->obstructionSteps;
+    this->gearSteps = arm;
+    motor.blockedSteps++;
+  }
+
+  if(arm != lastArm && this->stylusDown) this->addAnomaly(ticks, MotorAxis::Horizontal, TonearmAnomalyType::RecordDragAnomaly);
+
+  this->armSteps = arm;
+  this->updateStylus(ticks);
+}
+
+void TonearmModel::addAnomaly(unsigned long long ticks, MotorAxis axis, TonearmAnomalyType type) {
+  TonearmAnomaly anomaly = { ticks, axis, type };
+  this->anomalies.push_back(anomaly);
+}
+
+void TonearmModel::updateStylus(unsigned long long ticks) {
+  bool down = this->record.present && this->armSteps > this->getRecordEdgeArmSteps() && this->liftSteps <= TONEARM_MODEL_STYLUS_CONTACT_STEPS;
+  if(down == this->stylusDown) return;
+
+  this->stylusDown = down;
+
+  StylusEvent event = { ticks, down, this->armSteps };
+  this->stylusEvents.push_back(event);
+}
+
+double TonearmModel::getGroovePitch() {
+  double position = this->armSteps - TONEARM_MODEL_PLAY_SENSOR_STEPS;
+
+  if(position < this->record.musicSteps) return this->record.leadInPitchSteps;
+  if(position < this->record.leadOutSteps) return this->record.musicPitchSteps;
+
+  return this->record.leadOutPitchSteps;
+}
@@ -0,0 +1,233 @@
+#include "arduino.h"
+#include <vector>
+#include "enums/MotorAxis.h"
+#include "enums/RecordSize.h"
+
+#ifndef TonearmModel_h
+#define TonearmModel_h
+
+// How far the lift travels from the lower limit switch to the upper one, in full steps of the vertical motor (two half
+// steps each), and how far past either limit it can go before it hits a hard stop.
+#define TONEARM_MODEL_LIFT_TRAVEL_STEPS 600
+#define TONEARM_MODEL_LIFT_OVERTRAVEL_STEPS 20
+
+// How far above the lower limit, in full steps of the vertical motor, the stylus meets the surface of a record. This is
+// inside both the careful descent and the stylus clearance steps of the firmware, which count half steps.
+#define TONEARM_MODEL_STYLUS_CONTACT_STEPS 120
+
+// Where the play sensor is tripped, and where the inner hard stop is, in horizontal steps clockwise from the home mount.
+#define TONEARM_MODEL_PLAY_SENSOR_STEPS 60
+#define TONEARM_MODEL_INNER_STOP_STEPS 1100
+
+// How far, in horizontal steps, the motor turns without moving the tonearm when it changes direction.
+#define TONEARM_MODEL_GEAR_SLACK_STEPS 24
+
+// How far, in horizontal steps, the tonearm moves for each count of the pickup encoder.
+#define TONEARM_MODEL_STEPS_PER_ENCODER_COUNT 4
+
+// How long the clutch motor takes to move the clutch all the way from disengaged to engaged, or back.
+#define TONEARM_MODEL_CLUTCH_TRAVEL_MS 80
+
+// The shortest time, in microseconds, that the rotor needs to follow each half step of the coil patterns. A coil
+// pattern that changes sooner than that leaves the rotor behind.
+#define TONEARM_MODEL_MIN_HALF_STEP_MICROS 500
+
+// The shortest time, in microseconds, that a rotor at a standstill needs to follow its first half step (its pull-in
+// rate), and how much faster, in percent, each half step after that can be than the one before it. A motor has to be
+// sped up to anything faster than its pull-in rate.
+#define TONEARM_MODEL_PULL_IN_HALF_STEP_MICROS 1000
+#define TONEARM_MODEL_MAX_SPEEDUP_PERCENT 15
+
+// A record on the platter, in horizontal steps. Positions are measured clockwise from the play sensor, like the record
+// edge steps calibration values.
+struct SimulatedRecord {
+    // Whether there is a record on the platter at all.
+    bool present;
+
+    // Where the edge of the record is.
+    double edgeSteps;
+
+    // Where the lead-in spiral ends and the music starts, where the lead-out spiral starts, and where it ends in the
+    // locked groove.
+    double musicSteps;
+    double leadOutSteps;
+    double lockedGrooveSteps;
+
+    // How far inwards the groove moves the tonearm in each revolution of the lead-in spiral, the music, and the lead-out
+    // spiral.
+    double leadInPitchSteps;
+    double musicPitchSteps;
+    double leadOutPitchSteps;
+
+    // How far the groove swings in and out over each revolution, because the record is off-centre.
+    double eccentricitySteps;
+};
+
+// Things the tonearm did that the firmware should never make it do.
+enum TonearmAnomalyType : uint8_t {
+    // The coil pattern jumped by more than one full step, so the rotor can't tell which way to turn.
+    SkippedStepAnomaly = 0,
+
+    // The coil pattern changed faster than the rotor can follow, at its top speed or while it speeds up.
+    StepTooFastAnomaly = 1,
+
+    // A coil pattern that isn't part of any step sequence was output.
+    InvalidCoilPatternAnomaly = 2,
+
+    // The axis demultiplexer was switched over while the coils were on, so the other motor was given a coil pattern.
+    DemuxGlitchAnomaly = 3,
+
+    // The coils were switched off between two full steps of a half-step sequence, which loses the half step.
+    HalfStepReleaseAnomaly = 4,
+
+    // The horizontal motor moved the tonearm while the stylus was on the record.
+    RecordDragAnomaly = 5
+};
+
+// An anomaly, and when it happened, in simulated ticks.
+struct TonearmAnomaly {
+    unsigned long long ticks;
+    MotorAxis axis;
+    TonearmAnomalyType type;
+};
+
+// A change of coil pattern that moved one of the motors, and the motor's position after it, in half steps.
+struct TonearmStep {
+    unsigned long long ticks;
+    MotorAxis axis;
+    long position;
+};
+
+// A change in whether the stylus is on the record.
+struct StylusEvent {
+    unsigned long long ticks;
+    bool down;
+    double armSteps;
+};
+
+// The mechanics of the tonearm, driven by the coil patterns that reach each stepper motor through the axis
+// demultiplexer. Each rotor follows its coil pattern a half step at a time, and anything that a real motor would lose
+// steps over is logged as an anomaly. The lift raises the tonearm between the lower and upper limit switches. The
+// horizontal motor turns the tonearm through the clutch and a little slack in the gears; while the stylus is in the
+// groove, the record turns it instead.
+class TonearmModel {
+    public:
+
+        // Constructor
+        TonearmModel();
+
+        // Put a record on the platter (or take it off, with present set to false).
+        void setRecord(const SimulatedRecord& record);
+
+        // The record of the given size that the models use unless told otherwise. Its edge is a few steps from the
+        // default record edge calibration, and the music is pressed as densely as a real record.
+        static SimulatedRecord defaultRecord(RecordSize size);
+
+        // Move the tonearm, without going through the motors, i.e. by hand while the turntable was off.
+        void setLiftSteps(double steps);
+        void setArmSteps(double steps);
+
+        // Put something in the tonearm's way, between it and the home mount, that stops it moving counterclockwise past
+        // the given horizontal step (i.e. something left on the deck). A negative value takes it away.
+        void setObstructionSteps(double steps);
+
+        // The coil pattern on the stepper pins (coil A in bit 0), and the motor that the demultiplexer sends it to.
+        void setCoilPattern(unsigned long long ticks, uint8_t pattern);
+        void selectAxis(unsigned long long ticks, MotorAxis axis);
+
+        // Drive the clutch motor towards engaged (1) or disengaged (-1), or stop it (0).
+        void setClutchDrive(int8_t direction);
+
+        // Move the clutch and the groove on to the given time, with the platter having turned to the given number of
+        // revolutions.
+        void advance(unsigned long long ticks, double platterRevolutions);
+
+        // The sensors.
+        bool isLowerLimitReached();
+        bool isUpperLimitReached();
+        bool isPastPlaySensor();
+        uint8_t getEncoderState();
+
+        // Where the lift is, in vertical steps above the lower limit, and where the tonearm is, in horizontal steps
+        // clockwise from the home mount.
+        double getLiftSteps();
+        double getArmSteps();
+
+        // Each motor's position, in half steps, as the rotor has followed it.
+        long getMotorPosition(MotorAxis axis);
+
+        bool isClutchEngaged();
+        bool isStylusDown();
+
+        // The record currently on the platter.
+        const SimulatedRecord& getRecord();
+
+        // Where the edge of the record is, in horizontal steps from the home mount.
+        double getRecordEdgeArmSteps();
+
+        // Everything that has happened since the logs were last cleared.
+        const std::vector<TonearmAnomaly>& getAnomalies();
+        const std::vector<TonearmStep>& getSteps();
+        const std::vector<StylusEvent>& getStylusEvents();
+        void clearLogs();
+
+        // How many steps the motors have taken against a hard stop or the record edge, where the motor (or the clutch)
+        // slips instead of moving anything.
+        unsigned long getBlockedStepCount(MotorAxis axis);
+
+    private:
+        // A stepper motor: the coil pattern it is being given, and the rotor.
+        struct Motor {
+            uint8_t pattern;
+            uint8_t phase;
+            int8_t lastChange;
+            long position;
+            unsigned long long lastMoveTicks;
+            unsigned long long halfStepTicks;
+            bool hasMoved;
+            unsigned long blockedSteps;
+        };
+
+        // Give the motor a new coil pattern.
+        void driveMotor(unsigned long long ticks, MotorAxis axis, uint8_t pattern);
+
+        // Move what the motor drives by the given number of half steps.
+        void moveLift(unsigned long long ticks, int8_t halfSteps);
+        void moveArm(unsigned long long ticks, int8_t halfSteps);
+
+        // Log an anomaly.
+        void addAnomaly(unsigned long long ticks, MotorAxis axis, TonearmAnomalyType type);
+
+        // Log a change in whether the stylus is on the record.
+        void updateStylus(unsigned long long ticks);
+
+        // How far inwards the groove under the stylus moves the tonearm per revolution.
+        double getGroovePitch();
+
+        Motor motors[2];
+        MotorAxis selectedAxis;
+        uint8_t coilPattern;
+
+        // The lift height, in vertical steps, and the tonearm and the gear that drives it through the slack, in
+        // horizontal steps.
+        double liftSteps;
+        double armSteps;
+        double gearSteps;
+
+        // How far the clutch is engaged, from 0 (disengaged) to 1 (engaged).
+        double clutchPosition;
+        int8_t clutchDrive;
+        unsigned long long lastAdvanceTicks;
+
+        SimulatedRecord record;
+        double obstructionSteps;
+        double platterRevolutions;
+        double lastPlatterRevolutions;
+        bool stylusDown;
+
+        std::vector<TonearmAnomaly> anomalies;
+        std::vector<TonearmStep> steps;
+        std::vector<StylusEvent> stylusEvents;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef HostArduino_h
+#define HostArduino_h
+
+// The parts of the Arduino core (and avr-libc) that the firmware uses outside of TurntableHal.cpp, for building it on
+// the host. The registers and the interrupt flag are backed by the SimulatedTurntable, so the firmware's direct port
+// access and critical sections behave the way they do on the Nano Every.
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define F_CPU 16000000L
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+void setup();
+void loop();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+
+// Clear and set the global interrupt flag. Setting it runs any interrupt that became pending while it was clear.
+void noInterrupts();
+void interrupts();
+
+// The status register. Only the global interrupt flag (bit 7) is kept, which is all the firmware saves and restores.
+class SimulatedStatusRegister {
+    public:
+        operator uint8_t() const;
+        SimulatedStatusRegister& operator=(uint8_t value);
+};
+
+extern SimulatedStatusRegister SREG;
+
+// The virtual port registers. Writing a 1 to a bit of IN toggles that output on the real chip; the simulated HAL
+// applies those writes itself, since a plain byte can't react to being written.
+struct VPORT_t {
+    volatile uint8_t DIR;
+    volatile uint8_t OUT;
+    volatile uint8_t IN;
+    volatile uint8_t INTFLAGS;
+};
+
+extern VPORT_t simulatedVports[6];
+
+#define VPORTA (simulatedVports[0])
+#define VPORTB (simulatedVports[1])
+#define VPORTC (simulatedVports[2])
+#define VPORTD (simulatedVports[3])
+#define VPORTE (simulatedVports[4])
+#define VPORTF (simulatedVports[5])
+
+#endif
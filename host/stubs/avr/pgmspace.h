@@ -0,0 +1,11 @@
+#include <stdint.h>
+
+#ifndef HostPgmspace_h
+#define HostPgmspace_h
+
+// The host has a single address space, so program memory is ordinary constant data.
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+
+#endif
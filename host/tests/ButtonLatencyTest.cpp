@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+
+// The longest the firmware may take to stop the tonearm once the pause button is pressed while it is moving. The button
+// is debounced over a few scans of the main loop's tick, so this is a few ticks.
+#define MAX_PAUSE_STOP_MS 20
+
+// The longest it may take for the pause to take over and light the pause LED, which waits for the clutch to disengage.
+#define MAX_PAUSE_LED_MS (CLUTCH_ENGAGEMENT_MS + MAX_PAUSE_STOP_MS)
+
+// A quick tap of the button, which is let go before the routine has finished stopping.
+#define PAUSE_PRESS_MS 40
+
+static unsigned long long pressTicks = 0;
+
+// When the pause LED first lit after the button was pressed, or 0.
+static unsigned long long findPauseLedTicks() {
+  std::vector<OutputEdge>& edges = simulator.getOutputEdges();
+
+  for(size_t i = 0; i < edges.size(); i++) {
+    if(edges[i].pin == ArduinoPin::PauseStatusLed && edges[i].value && edges[i].ticks >= pressTicks) return edges[i].ticks;
+  }
+
+  return 0;
+}
+
+// Presses the pause button partway through a routine, and checks how long the firmware takes to react, with the
+// simulator's clock. Run as `button_latency_test play|home <seconds>`: the button is pressed that many seconds after
+// the Play/Home button starts the play routine, or the home routine from a record that is playing.
+int main(int argc, char** argv) {
+  if(argc != 3 || (strcmp(argv[1], "play") != 0 && strcmp(argv[1], "home") != 0)) {
+    fprintf(stderr, "Usage: %s play|home <seconds>\n", argv[0]);
+    return 2;
+  }
+
+  bool home = strcmp(argv[1], "home") == 0;
+  double delaySeconds = atof(argv[2]);
+
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+
+  if(home) {
+    CHECK(simulator.runUntil(40, []() { return playRoutineMs > 0; }));
+    simulator.runFor(2);
+    simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  }
+
+  // The routine blocks the main loop, so from here on the simulation only stops once it has finished.
+  pressTicks = simulator.getTicks() + (unsigned long long)(delaySeconds * SIMULATED_TICKS_PER_SECOND);
+  simulator.schedule(pressTicks, []() { simulator.pressButton(MultiplexerInput::PauseButton, PAUSE_PRESS_MS); });
+  CHECK(simulator.runUntil(simulator.getSeconds() + 40, []() { return findPauseLedTicks() != 0; }));
+
+  // The pause LED lights once the routine has been cancelled, and the pause has taken over.
+  unsigned long long ledTicks = findPauseLedTicks();
+  CHECK(ledTicks != 0);
+
+  // The last step of the routine is the last one before the pause LED lights, since the pause itself moves the lift.
+  unsigned long long lastStepTicks = pressTicks;
+  const std::vector<TonearmStep>& steps = tonearm.getSteps();
+
+  for(size_t i = 0; i < steps.size(); i++) {
+    if(steps[i].ticks >= pressTicks && steps[i].ticks < ledTicks) lastStepTicks = steps[i].ticks;
+  }
+
+  double ledLatencyMs = (double)(ledTicks - pressTicks) / (SIMULATED_TICKS_PER_MICROSECOND * 1000);
+  double stopLatencyMs = (double)(lastStepTicks - pressTicks) / (SIMULATED_TICKS_PER_MICROSECOND * 1000);
+
+  printf("Pause pressed %.2fs into the %s routine: tonearm stopped after %.2fms, pause LED lit after %.2fms\n",
+    delaySeconds, home ? "home" : "play", stopLatencyMs, ledLatencyMs);
+
+  CHECK(stopLatencyMs <= MAX_PAUSE_STOP_MS);
+  CHECK(ledLatencyMs <= MAX_PAUSE_LED_MS);
+
+  // The pause lifts the tonearm off the record, or sets it down if it was already lifted.
+  simulator.runFor(5);
+  CHECK(!tonearm.isStylusDown() || !tonearm.isClutchEngaged());
+
+  return TEST_RESULT();
+}
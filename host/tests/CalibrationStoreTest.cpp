@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "TurntableHal.h"
+#include "CalibrationStore.h"
+#include "proto/Constants.h"
+
+// How many presses of a calibration button are made in a burst, and how far apart, in milliseconds.
+#define BURST_PRESSES 50
+#define BURST_PRESS_MS 100
+
+// How many saves the wear test makes: enough for the sequence number to wrap around.
+#define WEAR_SAVES 70000
+
+// How many saves are interrupted by the power being cut, each at a random byte of the record.
+#define POWER_LOSS_TRIALS 2000
+
+static const uint16_t defaults[CALIBRATION_VALUE_COUNT] = { 100, 200, 300, 150, 1500, 0, 8, 3, 24, 32 };
+
+static bool valuesEqual(CalibrationStore& store, const uint16_t values[CALIBRATION_VALUE_COUNT]) {
+  for(uint8_t i = 0; i < CALIBRATION_VALUE_COUNT; i++) {
+    if(store.get((CalibrationValue)i) != values[i]) return false;
+  }
+
+  return true;
+}
+
+static void readValues(CalibrationStore& store, uint16_t values[CALIBRATION_VALUE_COUNT]) {
+  for(uint8_t i = 0; i < CALIBRATION_VALUE_COUNT; i++) values[i] = store.get((CalibrationValue)i);
+}
+
+// The same EEPROM, read back by a store that has just been powered on.
+static void powerOn(CalibrationStore& store) {
+  store = CalibrationStore(CALIBRATION_EEPROM_ADDRESS);
+  store.setSaveDelayMs(CALIBRATION_SAVE_DELAY_MS);
+  store.begin(defaults);
+}
+
+static unsigned long maxEepromWrites() {
+  unsigned long most = 0;
+
+  for(uint16_t address = 0; address < SIMULATED_EEPROM_SIZE; address++) {
+    if(simulator.getEepromWriteCount(address) > most) most = simulator.getEepromWriteCount(address);
+  }
+
+  return most;
+}
+
+// Runs a CalibrationStore against the simulated EEPROM: a blank EEPROM gives the defaults, a burst of button presses
+// is saved once, the records rotate through every slot with the sequence number wrapping around, and a save that is
+// cut off at any byte leaves either the old values or the new ones, never a mix.
+int main() {
+  simulator.setTimeLimit(1e9);
+  TurntableHal::begin();
+
+  CalibrationStore store = CalibrationStore(CALIBRATION_EEPROM_ADDRESS);
+
+  // Blank, so the defaults are used, and nothing is written until something changes.
+  powerOn(store);
+  CHECK(valuesEqual(store, defaults));
+  CHECK(!store.hasUnsavedChanges());
+  CHECK(simulator.getTotalEepromWriteCount() == 0);
+
+  // A burst of presses only costs a single save, once the presses have stopped for the save delay.
+  for(uint8_t i = 0; i < BURST_PRESSES; i++) {
+    store.adjust(CalibrationValue::RecordEdgeSteps12Inch, i % 3 == 0 ? -1 : 1);
+
+    for(uint8_t ms = 0; ms < BURST_PRESS_MS; ms++) {
+      TurntableHal::waitMs(1);
+      store.update();
+    }
+  }
+
+  CHECK(store.getSaveCount() == 0);
+  CHECK(store.hasUnsavedChanges());
+
+  for(uint16_t ms = 0; ms < CALIBRATION_SAVE_DELAY_MS; ms++) {
+    TurntableHal::waitMs(1);
+    store.update();
+  }
+
+  CHECK(store.getSaveCount() == 1);
+  // Every byte of the record, and its commit byte twice.
+  CHECK(simulator.getTotalEepromWriteCount() <= sizeof(CalibrationRecord) + 1);
+
+  uint16_t saved[CALIBRATION_VALUE_COUNT];
+  readValues(store, saved);
+  CHECK(saved[CalibrationValue::RecordEdgeSteps12Inch] == defaults[CalibrationValue::RecordEdgeSteps12Inch] + BURST_PRESSES / 3);
+
+  powerOn(store);
+  CHECK(valuesEqual(store, saved));
+
+  // Wear: every save goes to the next slot, so no byte is written more than once per trip around the slots (the commit
+  // byte twice), and the newest record is still found after the sequence number wraps around.
+  for(unsigned long i = 0; i < WEAR_SAVES; i++) {
+    store.set(CalibrationValue::ClutchEngagementMs, 100 + i % 50);
+    store.flush();
+
+    if(i % 10007 == 0 || i == WEAR_SAVES - 1) {
+      readValues(store, saved);
+      powerOn(store);
+      CHECK(valuesEqual(store, saved));
+    }
+  }
+
+  unsigned long mostWrites = maxEepromWrites();
+  printf("%lu saves: at most %lu writes to any EEPROM byte (%lu without rotating the slots)\n", (unsigned long)WEAR_SAVES + 1,
+    mostWrites, (unsigned long)WEAR_SAVES + 1);
+
+  CHECK(mostWrites <= 2 * ((WEAR_SAVES + 1) / CALIBRATION_STORE_SLOTS + 1));
+
+  // Power loss: cut off each save at a random byte of the ones it changes. The next power-on finds either every old
+  // value or every new one.
+  srand(1);
+  unsigned long oldLoads = 0;
+  unsigned long newLoads = 0;
+
+  for(unsigned long trial = 0; trial < POWER_LOSS_TRIALS; trial++) {
+    uint16_t before[CALIBRATION_VALUE_COUNT];
+    uint16_t after[CALIBRATION_VALUE_COUNT];
+    readValues(store, before);
+
+    for(uint8_t i = 0; i < CALIBRATION_VALUE_COUNT; i++) {
+      after[i] = rand() % 4 == 0 ? rand() & 0xFFFF : before[i];
+      store.set((CalibrationValue)i, after[i]);
+    }
+
+    simulator.cutPowerAfterEepromWrites(1 + rand() % (sizeof(CalibrationRecord) + 1));
+
+    bool cut = false;
+
+    try {
+      store.flush();
+    }
+    catch(SimulatedPowerLoss&) {
+      cut = true;
+    }
+
+    simulator.cutPowerAfterEepromWrites(0);
+    powerOn(store);
+
+    bool loadedOld = valuesEqual(store, before);
+    bool loadedNew = valuesEqual(store, after);
+
+    CHECK(loadedOld || loadedNew);
+    CHECK(cut || loadedNew);
+
+    if(loadedNew) newLoads++;
+    else if(loadedOld) oldLoads++;
+  }
+
+  printf("%u saves cut off by a power loss: %lu kept the old values, %lu the new ones\n", POWER_LOSS_TRIALS, oldLoads, newLoads);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,148 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+
+// How many play and home cycles each power-on runs.
+#define CYCLES 3
+
+// The homing routine with the lift and the traverse one after the other, and everything else as the sketch's own
+// routine does it, so the only difference is whether the two motors are interleaved.
+static const RoutineStage sequentialHomeStages[] = {
+  /* 0 */ { RoutineStageAction::EngageClutch, 0, 0, 0, NULL, NULL },
+  /* 1 */ { RoutineStageAction::MoveUp, MOVEMENT_RPM_DEFAULT, 0, 0, NULL, NULL },
+  /* 2 */ { RoutineStageAction::HorizontalHome, 0, 0, ROUTINE_STAGE(0) | ROUTINE_STAGE(1), NULL, NULL },
+  /* 3 */ { RoutineStageAction::Call, 0, 0, ROUTINE_STAGE(2), stopTurntableMotor, NULL },
+  /* 4 */ { RoutineStageAction::DisengageClutch, 0, 0, ROUTINE_STAGE(2), NULL, NULL },
+  /* 5 */ { RoutineStageAction::MoveDown, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(2), NULL, NULL }
+};
+
+// What each homing took, and what the motors did during it.
+struct HomeResult {
+    unsigned long homeMs[CYCLES];
+    double traverseStartSeconds[CYCLES];
+    long liftHalfSteps[CYCLES];
+    uint16_t measuredLiftSteps[CYCLES];
+    unsigned long overlappedSteps[CYCLES];
+    unsigned long axisSwitches[CYCLES];
+    bool homeAfterHome[CYCLES];
+    unsigned long anomalies;
+};
+
+// Goes through the motor steps of a homing that started at the given time: how far the lift's rotor went up, in half
+// steps, when the traverse started, how many horizontal steps were taken while the lift was still going up, and how
+// many times the steps went from one motor to the other.
+static void followHoming(unsigned long long startTicks, long liftStartPosition, HomeResult& result, uint8_t cycle) {
+  const std::vector<TonearmStep>& steps = simulator.getTonearm().getSteps();
+  long highestPosition = liftStartPosition;
+  unsigned long long liftEndTicks = 0;
+  unsigned long long traverseStartTicks = 0;
+  MotorAxis lastAxis = MotorAxis::Vertical;
+
+  // Raising the lift turns the motor backwards, so the lift is over once the position starts going up.
+  for(size_t i = 0; i < steps.size(); i++) {
+    if(steps[i].axis != MotorAxis::Vertical) continue;
+    if(steps[i].position > highestPosition) break;
+
+    highestPosition = steps[i].position;
+    liftEndTicks = steps[i].ticks;
+  }
+
+  for(size_t i = 0; i < steps.size(); i++) {
+    if(steps[i].axis != lastAxis) result.axisSwitches[cycle]++;
+    lastAxis = steps[i].axis;
+
+    if(steps[i].axis == MotorAxis::Horizontal) {
+      if(traverseStartTicks == 0) traverseStartTicks = steps[i].ticks;
+      if(steps[i].ticks < liftEndTicks) result.overlappedSteps[cycle]++;
+    }
+  }
+
+  result.liftHalfSteps[cycle] = liftStartPosition - highestPosition;
+  result.traverseStartSeconds[cycle] = (double)(traverseStartTicks - startTicks) / SIMULATED_TICKS_PER_SECOND;
+}
+
+// Plays the record and homes the tonearm a few times in one power-on, with the sketch's homing routine or the
+// sequential one, logging every motor step of each homing.
+static HomeResult runCycles(bool coordinated) {
+  HomeResult result = HomeResult();
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(300);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  for(uint8_t cycle = 0; cycle < CYCLES; cycle++) {
+    CHECK(playRoutine() == MovementResult::Success);
+    CHECK(tonearm.isStylusDown());
+    simulator.runFor(1);
+
+    long liftStartPosition = tonearm.getMotorPosition(MotorAxis::Vertical);
+    unsigned long long startTicks = simulator.getTicks();
+    tonearm.clearLogs();
+
+    if(coordinated) {
+      CHECK(homeRoutine() == MovementResult::Success);
+      result.homeMs[cycle] = homeRoutineMs;
+    }
+    else {
+      CHECK(routineExecutor.run(sequentialHomeStages, sizeof(sequentialHomeStages) / sizeof(sequentialHomeStages[0])) == MovementResult::Success);
+      result.homeMs[cycle] = routineExecutor.getLastRunMs();
+    }
+
+    followHoming(startTicks, liftStartPosition, result, cycle);
+    result.measuredLiftSteps[cycle] = tonearmController.getVerticalTravelSteps();
+    result.homeAfterHome[cycle] = tonearm.getArmSteps() == 0 && tonearm.isLowerLimitReached() && !tonearm.isClutchEngaged();
+    result.anomalies += tonearm.getAnomalies().size();
+  }
+
+  return result;
+}
+
+static HomeResult runCoordinated() {
+  return runCycles(true);
+}
+
+static HomeResult runSequential() {
+  return runCycles(false);
+}
+
+// Homes the tonearm from a record that is playing, with the lift and the traverse interleaved at step granularity
+// through the axis demultiplexer, and with one after the other, each from its own power-on. The simulated motors only
+// follow the coil patterns that reach them, so a step lost to an axis switch shows up as an anomaly, and as a lift
+// whose rotor went a different distance from the steps the firmware counted to the upper limit. Prints the homing time
+// of each, and checks that interleaving saves time without losing a step.
+int main() {
+  HomeResult coordinated = runPowerOn<HomeResult>(runCoordinated);
+  HomeResult sequential = runPowerOn<HomeResult>(runSequential);
+
+  printf("Homing      | time    | traverse starts | lift (half steps / counted) | overlapped steps | axis switches\n");
+
+  for(uint8_t cycle = 0; cycle < CYCLES; cycle++) {
+    printf("Sequential  | %5.2fs  | %6.2fs         | %5ld / %4u                 | %5lu            | %5lu\n",
+      sequential.homeMs[cycle] / 1000.0, sequential.traverseStartSeconds[cycle], sequential.liftHalfSteps[cycle],
+      sequential.measuredLiftSteps[cycle], sequential.overlappedSteps[cycle], sequential.axisSwitches[cycle]);
+    printf("Coordinated | %5.2fs  | %6.2fs         | %5ld / %4u                 | %5lu            | %5lu\n",
+      coordinated.homeMs[cycle] / 1000.0, coordinated.traverseStartSeconds[cycle], coordinated.liftHalfSteps[cycle],
+      coordinated.measuredLiftSteps[cycle], coordinated.overlappedSteps[cycle], coordinated.axisSwitches[cycle]);
+
+    // The traverse started while the lift was still going, and the whole homing took less time for it.
+    CHECK(coordinated.overlappedSteps[cycle] > 0);
+    CHECK(sequential.overlappedSteps[cycle] == 0);
+    CHECK(coordinated.traverseStartSeconds[cycle] < sequential.traverseStartSeconds[cycle]);
+    CHECK(coordinated.homeMs[cycle] < sequential.homeMs[cycle]);
+
+    // The lift is half-stepped, and its rotor followed every step the firmware counted, through every axis switch.
+    CHECK(coordinated.measuredLiftSteps[cycle] > VERTICAL_STYLUS_CLEARANCE_STEPS);
+    CHECK(coordinated.liftHalfSteps[cycle] == 2L * coordinated.measuredLiftSteps[cycle]);
+    CHECK(sequential.liftHalfSteps[cycle] == 2L * sequential.measuredLiftSteps[cycle]);
+
+    CHECK(coordinated.homeAfterHome[cycle] && sequential.homeAfterHome[cycle]);
+  }
+
+  CHECK(coordinated.anomalies == 0);
+  CHECK(sequential.anomalies == 0);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,157 @@
+#include <string>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "SevenSegmentDisplay.h"
+#include "TurntableHal.h"
+#include "proto/Constants.h"
+#include "enums/CalibrationValue.h"
+
+// How long it takes the tick to light every digit once, with a tick to spare, in milliseconds.
+#define DISPLAY_REFRESH_MS ((SEVEN_SEGMENT_DIGIT_COUNT + 1) * LOOP_TICK_MICROS / 1000 + 1)
+
+// The segments of each decimal digit, by name, written out from a drawing of the digits rather than taken from the
+// driver's table.
+static const char* digitSegmentNames[10] = {
+  "ABCDEF", "BC", "ABDEG", "ABCDG", "BCFG", "ACDFG", "ACDEFG", "ABC", "ABCDEFG", "ABCDFG"
+};
+
+static uint8_t segmentsOf(const char* names) {
+  uint8_t segments = 0;
+
+  for(const char* name = names; *name != '\0'; name++) segments |= 1 << (*name - 'A');
+
+  return segments;
+}
+
+// What the display shows, as text: a space for a blank digit, a dash, or a digit followed by a decimal point if it has
+// one. A digit that is none of those shows as '?'.
+static std::string shownText() {
+  std::string text;
+
+  for(uint8_t i = 0; i < SEVEN_SEGMENT_DIGIT_COUNT; i++) {
+    uint8_t segments = simulator.getDisplayDigit(i);
+    uint8_t withoutPoint = segments & ~SEVEN_SEGMENT_DECIMAL_POINT;
+    char shown = '?';
+
+    if(withoutPoint == 0) shown = ' ';
+    else if(withoutPoint == segmentsOf("G")) shown = '-';
+
+    for(uint8_t digit = 0; digit < 10; digit++) {
+      if(withoutPoint == segmentsOf(digitSegmentNames[digit])) shown = '0' + digit;
+    }
+
+    text += shown;
+    if(segments & SEVEN_SEGMENT_DECIMAL_POINT) text += '.';
+  }
+
+  return text;
+}
+
+// Shows the number, lets the tick go round every digit, and checks what ended up on the display.
+static void checkNumber(uint16_t value, uint8_t decimals, const char* expected) {
+  SevenSegmentDisplay::showNumber(value, decimals);
+  TurntableHal::waitMs(DISPLAY_REFRESH_MS);
+
+  std::string shown = shownText();
+  if(shown != expected) fprintf(stderr, "%u with %u decimals shows \"%s\", not \"%s\"\n", value, decimals, shown.c_str(), expected);
+  CHECK(shown == expected);
+}
+
+static void doNothing() {
+}
+
+// The driver on its own, refreshed from the tick: every digit of the segment table, and the formatting of whole
+// numbers into digits, blanked leading zeros and a decimal point.
+static bool runDriver() {
+  simulator.setTimeLimit(10);
+  TurntableHal::beginTick(doNothing);
+  SevenSegmentDisplay::begin();
+
+  TurntableHal::waitMs(DISPLAY_REFRESH_MS);
+  CHECK(shownText() == "    ");
+
+  unsigned long refreshCount = simulator.getDisplayRefreshCount();
+  TurntableHal::waitMs(100);
+  CHECK_NEAR(simulator.getDisplayRefreshCount() - refreshCount, 100000.0 / LOOP_TICK_MICROS, 1);
+
+  const char* singleDigits[10] = { "   0", "   1", "   2", "   3", "   4", "   5", "   6", "   7", "   8", "   9" };
+  for(uint8_t digit = 0; digit < 10; digit++) checkNumber(digit, 0, singleDigits[digit]);
+
+  checkNumber(3333, 2, "33.33");
+  checkNumber(4500, 2, "45.00");
+  checkNumber(1667, 2, "16.67");
+  checkNumber(7800, 2, "78.00");
+  checkNumber(5, 2, " 0.05");
+  checkNumber(123, 1, " 12.3");
+  checkNumber(5, 3, "0.005");
+  checkNumber(5, 7, "0.005");
+  checkNumber(42, 0, "  42");
+  checkNumber(1000, 0, "1000");
+  checkNumber(9999, 0, "9999");
+  checkNumber(10000, 0, "----");
+  checkNumber(65535, 2, "----");
+
+  SevenSegmentDisplay::clear();
+  TurntableHal::waitMs(DISPLAY_REFRESH_MS);
+  CHECK(shownText() == "    ");
+
+  return true;
+}
+
+// What the display shows as a number, ignoring the decimal point, or -1 if it isn't one.
+static long shownNumber() {
+  std::string text = shownText();
+  long number = 0;
+  bool anyDigit = false;
+
+  for(size_t i = 0; i < text.size(); i++) {
+    if(text[i] == ' ' || text[i] == '.') continue;
+    if(text[i] < '0' || text[i] > '9') return -1;
+
+    number = number * 10 + (text[i] - '0');
+    anyDigit = true;
+  }
+
+  return anyDigit ? number : -1;
+}
+
+// The sketch's use of the display: blank while the platter is stopped, the measured speed to two decimal places while
+// it spins, and a calibration value for a while after it has been changed.
+static bool runSketch() {
+  simulator.getTonearm().setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+  simulator.setTimeLimit(60);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  CHECK(shownText() == "    ");
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(40, []() { return playRoutineMs > 0; }));
+  CHECK(simulator.runUntil(50, []() { return !speedMonitor.isStopped(); }));
+  simulator.runFor(5);
+
+  std::string speedText = shownText();
+  printf("Playing at %.2f RPM: the display shows \"%s\"\n", speedMonitor.getMeanCentiRpm() / 100.0, speedText.c_str());
+  CHECK(speedText.size() == SEVEN_SEGMENT_DIGIT_COUNT + 1 && speedText[2] == '.');
+  CHECK(shownNumber() == speedMonitor.getMeanCentiRpm());
+
+  showCalibrationValue(CalibrationValue::ClutchEngagementMs);
+  simulator.runFor(0.1);
+  CHECK(shownNumber() == calibrationStore.get(CalibrationValue::ClutchEngagementMs));
+  CHECK(shownText().find('.') == std::string::npos);
+
+  simulator.runFor(CALIBRATION_DISPLAY_MS / 1000.0);
+  CHECK(shownNumber() == speedMonitor.getMeanCentiRpm());
+
+  return true;
+}
+
+// Runs the seven-segment display driver against the simulator's display, first on its own and then from the sketch.
+// The main board has no display yet, so TurntableHal::writeDisplayDigit() does nothing on the turntable itself.
+int main() {
+  CHECK(runPowerOn<bool>(runDriver));
+  CHECK(runPowerOn<bool>(runSketch));
+
+  return TEST_RESULT();
+}
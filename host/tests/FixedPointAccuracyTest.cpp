@@ -0,0 +1,229 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "TurntableHal.h"
+#include "TurntableSpeedMonitor.h"
+#include "TurntableSpeedRegulator.h"
+#include "enums/TurntableSpeed.h"
+#include "proto/Constants.h"
+
+// How far either side of each nominal speed the periods are swept, as a fraction, and in how many steps.
+#define SWEEP_FRACTION 0.10
+#define SWEEP_STEPS 2000
+
+// How far each revolution of the window with wow is from the swept period, as a fraction.
+#define WOW_FRACTION 0.02
+
+// How far, in basis points, the error can be from the tolerance before the integer and double paths have to agree on
+// whether the platter is on speed. The integer error is truncated to a whole basis point.
+#define TOLERANCE_BOUNDARY_BASIS_POINTS 1.0
+
+static const char* speedNames[] = { "33 1/3", "45", "16 2/3", "78" };
+static const double nominalRpms[] = { 100.0 / 3, 45, 50.0 / 3, 78 };
+
+// The PID gains that are checked: the firmware's own, and ones large enough to use most of the arithmetic's range.
+static const uint16_t gainSets[][3] = {
+  { SPEED_REGULATOR_KP, SPEED_REGULATOR_KI, SPEED_REGULATOR_KD },
+  { 2000, 1000, 4000 },
+  { 10000, 10000, 10000 }
+};
+
+// How far the integer path got from the double reference, at worst. The output is with the firmware's gains, and the
+// excess is how far past its allowance (see checkRegulator) the output got with any of the gains.
+struct WorstError {
+    double centiRpm;
+    double meanCentiRpm;
+    double wowAndFlutterBasisPoints;
+    double outputSteps;
+    double outputExcessSteps;
+    unsigned long toleranceMismatches;
+    unsigned long antiWindupEdges;
+};
+
+static void selectSpeed(TurntableSpeed speed) {
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, speed & 1);
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, speed >> 1);
+
+  // The speed switches are debounced, so they take a few scans of the multiplexer to change.
+  TurntableSpeedMonitor monitor;
+  TurntableSpeedRegulator regulator = TurntableSpeedRegulator(monitor);
+
+  for(uint8_t i = 0; i < 100 && regulator.getTargetSpeed() != speed; i++) TurntableHal::waitMs(1);
+
+  CHECK(regulator.getTargetSpeed() == speed);
+}
+
+static TurntableSpeedMonitor* newMonitor() {
+  TurntableSpeedMonitor* monitor = new TurntableSpeedMonitor();
+  monitor->setStoppedTimeoutMs(TURNTABLE_STOPPED_MS);
+
+  return monitor;
+}
+
+// Record pulses with the given periods between them, the last of them the given time before now.
+static void recordPulses(TurntableSpeedMonitor& monitor, const unsigned long* periods, uint8_t count, unsigned long beforeNowMicros) {
+  unsigned long timestamp = TurntableHal::currentMicros() - beforeNowMicros;
+  for(uint8_t i = 0; i < count; i++) timestamp -= periods[i];
+
+  monitor.recordPulse(timestamp);
+
+  for(uint8_t i = 0; i < count; i++) {
+    timestamp += periods[i];
+    monitor.recordPulse(timestamp);
+  }
+
+  monitor.update();
+}
+
+static void keepWorst(double& worst, double error) {
+  if(fabs(error) > worst) worst = fabs(error);
+}
+
+// The speed error, in percent, of a revolution that took the given time at the given speed. Positive is too slow.
+static double errorPercent(unsigned long periodMicros, TurntableSpeed speed) {
+  return (1 - 60e6 / nominalRpms[speed] / periodMicros) * 100;
+}
+
+// The PID output after the given errors, in percent, one per revolution, worked out in double. Sets nearEdge if the
+// anti-windup was ever within the given margin, in duty cycle steps, of deciding the other way.
+static double referenceOutput(const uint16_t* gains, const double* errorPercents, uint8_t count, double margin, bool& nearEdge) {
+  double integral = 0;
+  double output = SPEED_REGULATOR_BASE_OUTPUT;
+
+  for(uint8_t i = 0; i < count; i++) {
+    double proportional = gains[0] / 100.0 * errorPercents[i];
+    double derivative = i > 0 ? gains[2] / 100.0 * (errorPercents[i] - errorPercents[i - 1]) : 0;
+    double integralStep = gains[1] / 100.0 * errorPercents[i];
+
+    // The same anti-windup as the regulator.
+    double candidate = SPEED_REGULATOR_BASE_OUTPUT + proportional + integral + integralStep + derivative;
+    if((candidate < 255 || errorPercents[i] < 0) && (candidate > 0 || errorPercents[i] > 0)) integral += integralStep;
+    if(fabs(candidate - 255) < margin || fabs(candidate) < margin) nearEdge = true;
+
+    if(integral > 255) integral = 255;
+    else if(integral < -255) integral = -255;
+
+    output = SPEED_REGULATOR_BASE_OUTPUT + proportional + integral + derivative;
+  }
+
+  if(output >= 255) return 255;
+  if(output <= 0) return 0;
+  return floor(output + 0.5);
+}
+
+// A single revolution's speed, and the statistics of a window of revolutions with wow, against the double math.
+static void checkMonitor(unsigned long period, int step, WorstError& worst) {
+  TurntableSpeedMonitor* monitor = newMonitor();
+  unsigned long periods[SPEED_STATISTICS_WINDOW] = { period, period };
+
+  recordPulses(*monitor, periods, 2, 0);
+  keepWorst(worst.centiRpm, monitor->getCurrentCentiRpm() - 6e9 / period);
+  delete monitor;
+
+  double meanCentiRpm = 0;
+  double meanPeriod = 0;
+
+  for(uint8_t i = 0; i < SPEED_STATISTICS_WINDOW; i++) {
+    periods[i] = period * (1 + WOW_FRACTION * sin(step * 0.7 + i * 1.3));
+    meanCentiRpm += 6e9 / periods[i] / SPEED_STATISTICS_WINDOW;
+    meanPeriod += (double)periods[i] / SPEED_STATISTICS_WINDOW;
+  }
+
+  double squares = 0;
+  for(uint8_t i = 0; i < SPEED_STATISTICS_WINDOW; i++) squares += (periods[i] - meanPeriod) * (periods[i] - meanPeriod);
+
+  monitor = newMonitor();
+  recordPulses(*monitor, periods, SPEED_STATISTICS_WINDOW, 0);
+  keepWorst(worst.meanCentiRpm, monitor->getMeanCentiRpm() - meanCentiRpm);
+  keepWorst(worst.wowAndFlutterBasisPoints, monitor->getWowAndFlutterBasisPoints() - sqrt(squares / SPEED_STATISTICS_WINDOW) / meanPeriod * 10000);
+  delete monitor;
+}
+
+// The regulator's output after two revolutions at the period, and then one 1% faster, with each set of gains. The
+// first update is all proportional and integral, and the second brings in the derivative.
+//
+// The regulator's error is in whole basis points, from a period rounded to hundreds of microseconds, so it can be up to
+// two basis points from the double one. The output is allowed that much error through each term, and a step for the
+// rounding of both outputs. Where the anti-windup was within that of its edge, a fraction of a basis point decides
+// whether the integral moves at all, so those cases are only counted.
+static void checkRegulator(unsigned long period, TurntableSpeed speed, WorstError& worst) {
+  unsigned long fasterPeriod = period * 0.99;
+  double errorPercents[2] = { errorPercent(period, speed), errorPercent(fasterPeriod, speed) };
+
+  for(uint8_t gains = 0; gains < sizeof(gainSets) / sizeof(gainSets[0]); gains++) {
+    TurntableSpeedMonitor* monitor = newMonitor();
+    TurntableSpeedRegulator regulator = TurntableSpeedRegulator(*monitor);
+    regulator.setGains(gainSets[gains][0], gainSets[gains][1], gainSets[gains][2]);
+    regulator.setBaseOutput(SPEED_REGULATOR_BASE_OUTPUT);
+    regulator.setToleranceBasisPoints(SPEED_REGULATOR_TOLERANCE_BASIS_POINTS);
+
+    // No spin-up, so every error goes through the PID loop.
+    regulator.setSpinUpThresholdBasisPoints(0x7FFF);
+    regulator.start();
+
+    unsigned long periods[2] = { period, period };
+    recordPulses(*monitor, periods, 2, fasterPeriod);
+    regulator.update();
+
+    double errorBasisPoints = fabs(10000 - 6e11 / nominalRpms[speed] / period);
+
+    if(gains == 0 && fabs(errorBasisPoints - SPEED_REGULATOR_TOLERANCE_BASIS_POINTS) > TOLERANCE_BOUNDARY_BASIS_POINTS &&
+      regulator.isWithinTolerance() != (errorBasisPoints <= SPEED_REGULATOR_TOLERANCE_BASIS_POINTS)) {
+      worst.toleranceMismatches++;
+    }
+
+    monitor->recordPulse(TurntableHal::currentMicros());
+    monitor->update();
+    regulator.update();
+
+    const uint16_t* gainSet = gainSets[gains];
+    double allowance = 1 + 0.02 * (gainSet[0] + gainSet[1] + 2 * gainSet[2]) / 100.0;
+    bool nearEdge = false;
+    double difference = fabs(regulator.getOutput() - referenceOutput(gainSet, errorPercents, 2, allowance, nearEdge));
+
+    if(nearEdge) worst.antiWindupEdges++;
+    else keepWorst(worst.outputExcessSteps, difference > allowance ? difference - allowance : 0);
+
+    if(gains == 0 && !nearEdge) keepWorst(worst.outputSteps, difference);
+    delete monitor;
+  }
+}
+
+// Sweeps the period of a revolution across 10% either side of every speed, and checks the integer speeds, statistics,
+// on-speed decision and PID output against the same worked out in double.
+int main() {
+  simulator.setTimeLimit(600);
+  TurntableHal::begin();
+
+  // Leave room before now for the slowest window of revolutions.
+  TurntableHal::waitMs(60000);
+
+  for(uint8_t speed = 0; speed < 4; speed++) {
+    WorstError worst = WorstError();
+    selectSpeed((TurntableSpeed)speed);
+
+    double nominalPeriod = 60e6 / nominalRpms[speed];
+
+    for(int step = -SWEEP_STEPS / 2; step <= SWEEP_STEPS / 2; step++) {
+      unsigned long period = nominalPeriod * (1 + SWEEP_FRACTION * step / (SWEEP_STEPS / 2));
+
+      checkMonitor(period, step, worst);
+      checkRegulator(period, (TurntableSpeed)speed, worst);
+    }
+
+    printf("%s RPM, worst against double: speed %.2f, mean %.2f centi-RPM; wow & flutter %.2fbp; output %.0f steps, "
+      "%.2f past the allowance (%lu at the anti-windup edge); %lu on-speed mismatches\n", speedNames[speed], worst.centiRpm,
+      worst.meanCentiRpm, worst.wowAndFlutterBasisPoints, worst.outputSteps, worst.outputExcessSteps, worst.antiWindupEdges,
+      worst.toleranceMismatches);
+
+    // Within a rounding of the units: half a hundredth of an RPM for a speed, and a basis point for the wow & flutter.
+    // The output is within a duty cycle step with the firmware's gains.
+    CHECK(worst.centiRpm <= 0.6);
+    CHECK(worst.meanCentiRpm <= 1);
+    CHECK(worst.wowAndFlutterBasisPoints <= 1);
+    CHECK(worst.outputSteps <= 1);
+    CHECK(worst.outputExcessSteps == 0);
+    CHECK(worst.toleranceMismatches == 0);
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <functional>
+
+#ifndef HostTest_h
+#define HostTest_h
+
+// Just enough of a test harness for the host tests: each check prints what failed and where, and the test's exit status
+// is the number of failed checks, which is what CTest looks at.
+
+static int hostTestFailures = 0;
+
+#define CHECK(condition) do { \
+    if(!(condition)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      hostTestFailures++; \
+    } \
+  } while(0)
+
+#define CHECK_NEAR(actual, expected, tolerance) do { \
+    double checkActual = (actual); \
+    double checkExpected = (expected); \
+    if(!(fabs(checkActual - checkExpected) <= (tolerance))) { \
+      fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s, %s) failed: %g is not within %g of %g\n", __FILE__, __LINE__, \
+        #actual, #expected, #tolerance, checkActual, (double)(tolerance), checkExpected); \
+      hostTestFailures++; \
+    } \
+  } while(0)
+
+#define TEST_RESULT() (hostTestFailures == 0 ? 0 : 1)
+
+// Runs the function in a child process, which starts from a copy of this one, and returns what it returned. The
+// firmware's globals can't be reset, so this is how a test compares separate power-ons of the simulated turntable: each
+// run forks before runSetup(). The result is copied back byte for byte, so it must be a plain struct. Checks that fail
+// in the child count against the test, and so does a child that doesn't finish.
+template<typename T> T runPowerOn(std::function<T()> run) {
+  T result = T();
+  int fds[2];
+
+  fflush(stdout);
+  fflush(stderr);
+
+  if(pipe(fds) != 0) {
+    hostTestFailures++;
+    return result;
+  }
+
+  pid_t pid = fork();
+
+  if(pid == 0) {
+    close(fds[0]);
+    hostTestFailures = 0;
+    result = run();
+
+    fflush(stdout);
+    fflush(stderr);
+
+    bool written = write(fds[1], &result, sizeof(T)) == sizeof(T) &&
+      write(fds[1], &hostTestFailures, sizeof(hostTestFailures)) == sizeof(hostTestFailures);
+    _exit(written ? 0 : 1);
+  }
+
+  close(fds[1]);
+
+  int childFailures = 0;
+  bool complete = pid > 0 && read(fds[0], &result, sizeof(T)) == sizeof(T) &&
+    read(fds[0], &childFailures, sizeof(childFailures)) == sizeof(childFailures);
+
+  close(fds[0]);
+  if(pid > 0) waitpid(pid, NULL, 0);
+
+  if(!complete) {
+    fprintf(stderr, "A simulated power-on didn't finish\n");
+    hostTestFailures++;
+  }
+
+  hostTestFailures += childFailures;
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+
+// The longest the lead-out groove may take to be detected, in revolutions after the stylus enters it: the revolutions
+// that have to be seen in a row, plus the one that the stylus entered the lead-out partway through, plus one for the
+// revolution that the sample before it straddles.
+#define MAX_LATENCY_REVOLUTIONS (TONEARM_PICKUP_CONSECUTIVE_REVOLUTIONS + 2)
+
+// The three-edge heuristic that the firmware used before the pickup encoder was decoded: three changes of the
+// PickupEncoderA channel in a row, each less than an interval apart that was found by trial and error at 45.5 RPM and
+// scaled to the current speed, and more than a debounce interval apart.
+#define LEGACY_PICKUP_DEBOUNCE_MS 20
+#define LEGACY_PICKUP_CONSECUTIVE_SENSOR_CHANGES 3
+#define LEGACY_PICKUP_BASE_SPEED 45.5
+#define LEGACY_PICKUP_BASE_INTERVAL 700
+
+static const char* speedNames[] = { "33", "45", "16", "78" };
+static const char* sizeNames[] = { "7", "10", "12" };
+
+// The old heuristic, polled from the main loop the way it used to be, which only notes when it would have sent the
+// tonearm home rather than doing it.
+class LegacyPickupMonitor {
+    public:
+        LegacyPickupMonitor() {
+            this->consecutiveChanges = 0;
+            this->lastStatus = false;
+            this->lastMillis = __LONG_MAX__;
+        }
+
+        // Returns true when the homing routine would have run.
+        bool update(bool status, unsigned long currMillis, double rpm) {
+          if(status != this->lastStatus) {
+            double pickupInterval = (LEGACY_PICKUP_BASE_INTERVAL - (LEGACY_PICKUP_BASE_INTERVAL * rpm / LEGACY_PICKUP_BASE_SPEED)) + LEGACY_PICKUP_BASE_INTERVAL;
+
+            if((currMillis - this->lastMillis) > LEGACY_PICKUP_DEBOUNCE_MS && (currMillis - this->lastMillis) < pickupInterval) {
+              this->consecutiveChanges++;
+            }
+            else {
+              this->consecutiveChanges = 0;
+            }
+
+            this->lastMillis = currMillis;
+            this->lastStatus = status;
+          }
+
+          if(this->consecutiveChanges == LEGACY_PICKUP_CONSECUTIVE_SENSOR_CHANGES) {
+            this->consecutiveChanges = 0;
+            return true;
+          }
+
+          return false;
+        }
+
+    private:
+        uint8_t consecutiveChanges;
+        bool lastStatus;
+        unsigned long lastMillis;
+};
+
+static LegacyPickupMonitor legacyMonitor;
+
+// When the stylus entered the lead-out spiral, and when the old heuristic would first have gone home before and after
+// that, in ticks (0 if it never did).
+static unsigned long long leadOutTicks = 0;
+static unsigned long long legacyFalseTriggerTicks = 0;
+static unsigned long long legacyTriggerTicks = 0;
+static unsigned long legacyFalseTriggers = 0;
+
+// Checked between iterations of the main loop, while the record plays.
+static bool watchRecord() {
+  TonearmModel& tonearm = simulator.getTonearm();
+
+  if(leadOutTicks == 0 && tonearm.getArmSteps() - TONEARM_MODEL_PLAY_SENSOR_STEPS >= tonearm.getRecord().leadOutSteps) {
+    leadOutTicks = simulator.getTicks();
+  }
+
+  bool encoderA = tonearm.getEncoderState() >> 1;
+
+  if(legacyMonitor.update(encoderA, simulator.getMillis(), speedMonitor.getCurrentCentiRpm() / 100.0)) {
+    if(leadOutTicks == 0) {
+      if(legacyFalseTriggerTicks == 0) legacyFalseTriggerTicks = simulator.getTicks();
+      legacyFalseTriggers++;
+    }
+    else if(legacyTriggerTicks == 0) {
+      legacyTriggerTicks = simulator.getTicks();
+    }
+  }
+
+  return !tonearm.isStylusDown();
+}
+
+static double ticksToRevolutions(unsigned long long ticks) {
+  return (double)ticks / SIMULATED_TICKS_PER_SECOND * simulator.getPlatter().getNominalRpm() / 60;
+}
+
+// Plays a whole side of a record with the sketch, at the given speed and size of record, with the record off-center by
+// the given number of horizontal steps. Checks that the lead-out groove is detected within a few revolutions of the
+// stylus entering it, and never before, and prints how the three-edge heuristic would have done on the same record.
+// Run as `lead_out_test 33|45|16|78 7|10|12 [eccentricity]`.
+int main(int argc, char** argv) {
+  int8_t speed = -1;
+  int8_t size = -1;
+
+  for(uint8_t i = 0; argc >= 3 && i < 4; i++) {
+    if(strcmp(argv[1], speedNames[i]) == 0) speed = i;
+    if(i < 3 && strcmp(argv[2], sizeNames[i]) == 0) size = i;
+  }
+
+  if(argc < 3 || argc > 4 || speed < 0 || size < 0) {
+    fprintf(stderr, "Usage: %s 33|45|16|78 7|10|12 [eccentricity]\n", argv[0]);
+    return 2;
+  }
+
+  // The quadrature decoding alone: turning back and forth over a single edge leaves the position where it was, and
+  // each channel's changes count one way or the other depending on which channel leads.
+  QuadratureEncoder encoder;
+  encoder.begin(0b00);
+
+  for(uint8_t i = 0; i < 10; i++) {
+    encoder.onStateChange(0b01);
+    encoder.onStateChange(0b00);
+  }
+
+  CHECK(encoder.getPosition() == 0);
+
+  const uint8_t forward[] = { 0b01, 0b11, 0b10, 0b00 };
+  for(uint8_t i = 0; i < 8; i++) encoder.onStateChange(forward[i % 4]);
+  CHECK(labs(encoder.getPosition()) == 8);
+
+  long forwardPosition = encoder.getPosition();
+  for(int8_t i = 6; i >= 0; i--) encoder.onStateChange(forward[i % 4]);
+  CHECK(encoder.getPosition() == forwardPosition - (forwardPosition > 0 ? 7 : -7));
+  CHECK(encoder.getInvalidTransitionCount() == 0);
+
+  encoder.onStateChange(0b10);
+  CHECK(encoder.getInvalidTransitionCount() == 1);
+
+  // A whole side of the record.
+  TonearmModel& tonearm = simulator.getTonearm();
+  SimulatedRecord record = TonearmModel::defaultRecord((RecordSize)size);
+  if(argc == 4) record.eccentricitySteps = atof(argv[3]);
+  tonearm.setRecord(record);
+
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, speed & 1);
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, speed & 2);
+
+  simulator.setTimeLimit(60);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  double sideSeconds = (record.lockedGrooveSteps - record.edgeSteps) / record.musicPitchSteps * 60 / simulator.getPlatter().getNominalRpm();
+  simulator.setTimeLimit(sideSeconds + 120);
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(40, []() { return playRoutineMs > 0; }));
+  CHECK(tonearm.isStylusDown());
+
+  // Play until the tonearm is lifted off the record, which should be for the homing routine.
+  unsigned long long playStartTicks = simulator.getTicks();
+  CHECK(simulator.runUntil(simulator.getSeconds() + sideSeconds, watchRecord));
+
+  unsigned long long liftTicks = simulator.getTicks();
+  const std::vector<StylusEvent>& stylusEvents = tonearm.getStylusEvents();
+
+  for(size_t i = 0; i < stylusEvents.size(); i++) {
+    if(!stylusEvents[i].down && stylusEvents[i].ticks >= playStartTicks) {
+      liftTicks = stylusEvents[i].ticks;
+      break;
+    }
+  }
+
+  // The homing routine takes the tonearm home, and nothing is lifted before the lead-out groove.
+  CHECK(leadOutTicks != 0);
+  CHECK(liftTicks >= leadOutTicks);
+  CHECK(simulator.runUntil(simulator.getSeconds() + 30, []() { return homeRoutineMs > 0; }));
+  CHECK(!simulator.getTonearm().isPastPlaySensor());
+
+  double latencyRevolutions = ticksToRevolutions(liftTicks - leadOutTicks);
+
+  printf("%s RPM, %s\", eccentricity %.1f steps: lead-out detected %.2f revolutions (%.2fs) after the stylus entered it\n",
+    speedNames[speed], sizeNames[size], record.eccentricitySteps, latencyRevolutions, (double)(liftTicks - leadOutTicks) / SIMULATED_TICKS_PER_SECOND);
+
+  if(legacyFalseTriggers > 0) {
+    printf("Three-edge heuristic: %lu false auto-returns, the first %.1fs into the side\n", legacyFalseTriggers,
+      (double)(legacyFalseTriggerTicks - playStartTicks) / SIMULATED_TICKS_PER_SECOND);
+  }
+  else if(legacyTriggerTicks != 0) {
+    printf("Three-edge heuristic: detected after %.2f revolutions\n", ticksToRevolutions(legacyTriggerTicks - leadOutTicks));
+  }
+  else {
+    printf("Three-edge heuristic: not detected before the tonearm went home\n");
+  }
+
+  CHECK(latencyRevolutions <= MAX_LATENCY_REVOLUTIONS);
+
+  return TEST_RESULT();
+}
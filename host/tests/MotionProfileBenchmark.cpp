@@ -0,0 +1,140 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+
+// A horizontal top speed that the motor can only reach by speeding up to it.
+#define FAST_TOP_SPEED 24
+
+// How each power-on moves the tonearm.
+struct MotionSettings {
+    const char* name;
+    bool profiled;
+    uint8_t topSpeed;
+};
+
+// What a play and home cycle took.
+struct CycleResult {
+    unsigned long playMs;
+    unsigned long homeMs;
+    double descentSeconds;
+    double setDownRpm;
+    unsigned long anomalies;
+};
+
+static const MotionSettings settings[] = {
+  // Every movement at a constant speed, and the whole descent at the careful speed, as before the motion profiles.
+  { "Constant, 14 RPM top", false, MOVEMENT_RPM_TOP_SPEED },
+  { "Profiled, 14 RPM top", true, MOVEMENT_RPM_TOP_SPEED },
+  { "Profiled, 24 RPM top", true, FAST_TOP_SPEED },
+  { "Constant, 24 RPM top", false, FAST_TOP_SPEED }
+};
+
+// How long the descent that set the stylus down took, from the top of the lift, and how fast the lift was going when
+// the stylus met the record, in RPM of the vertical motor.
+static void findSetDown(unsigned long long afterTicks, CycleResult& result) {
+  TonearmModel& tonearm = simulator.getTonearm();
+  const std::vector<StylusEvent>& stylusEvents = tonearm.getStylusEvents();
+  const std::vector<TonearmStep>& steps = tonearm.getSteps();
+  unsigned long long setDownTicks = 0;
+
+  for(size_t i = 0; i < stylusEvents.size() && setDownTicks == 0; i++) {
+    if(stylusEvents[i].down && stylusEvents[i].ticks >= afterTicks) setDownTicks = stylusEvents[i].ticks;
+  }
+
+  // The descent starts at the last vertical step that went the other way.
+  unsigned long long descentStartTicks = 0;
+  unsigned long long lastStepTicks = 0;
+  unsigned long long stepTicks = 0;
+  long lastPosition = 0;
+  long direction = 0;
+
+  for(size_t i = 0; i < steps.size() && steps[i].ticks <= setDownTicks; i++) {
+    if(steps[i].axis != MotorAxis::Vertical) continue;
+
+    long stepDirection = steps[i].position - lastPosition;
+    if(lastStepTicks == 0 || stepDirection * direction < 0) descentStartTicks = lastStepTicks;
+
+    stepTicks = steps[i].ticks - lastStepTicks;
+    lastStepTicks = steps[i].ticks;
+    lastPosition = steps[i].position;
+    direction = stepDirection;
+  }
+
+  result.descentSeconds = (double)(setDownTicks - descentStartTicks) / SIMULATED_TICKS_PER_SECOND;
+
+  // The lift is half-stepped.
+  result.setDownRpm = stepTicks == 0 ? 0 : 60.0 * SIMULATED_TICKS_PER_SECOND / (stepTicks * 2.0 * STEPS_PER_REVOLUTION);
+}
+
+static CycleResult runCycle(const MotionSettings& motion) {
+  CycleResult result = { 0, 0, 0, 0, 0 };
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+
+  if(!motion.profiled) {
+    tonearmController.setMotionProfile(MotorAxis::Vertical, MotionProfile::Constant, 0);
+    tonearmController.setMotionProfile(MotorAxis::Horizontal, MotionProfile::Constant, 0);
+    tonearmController.setCarefulDescentSteps(VERTICAL_MOVEMENT_TIMEOUT_STEPS);
+  }
+
+  tonearmController.setTopMotorSpeed(motion.topSpeed);
+  simulator.runFor(0.5);
+  tonearm.clearLogs();
+
+  unsigned long long playTicks = simulator.getTicks();
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(40, []() { return playRoutineMs > 0; }));
+
+  simulator.runFor(2);
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(simulator.getSeconds() + 40, []() { return homeRoutineMs > 0; }));
+
+  result.playMs = playRoutineMs;
+  result.homeMs = homeRoutineMs;
+  findSetDown(playTicks, result);
+  result.anomalies = tonearm.getAnomalies().size();
+
+  return result;
+}
+
+// Runs a play and home cycle with the tonearm moved at a constant speed, the way it was before the motion profiles,
+// and then with them, at the current top speed and at one that the motor has to be sped up to. Each is its own
+// power-on. Prints the routine times and how long the set-down took, and checks that the profiled movements never lose
+// a step.
+int main() {
+  CycleResult results[sizeof(settings) / sizeof(settings[0])];
+
+  printf("Motion                | play     | home     | cycle    | descent  | set-down | lost steps\n");
+
+  for(uint8_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+    const MotionSettings& motion = settings[i];
+    results[i] = runPowerOn<CycleResult>([&motion]() { return runCycle(motion); });
+
+    printf("%-21s | %6.2fs | %6.2fs | %6.2fs | %6.2fs | %4.1f RPM | %lu\n", motion.name, results[i].playMs / 1000.0,
+      results[i].homeMs / 1000.0, (results[i].playMs + results[i].homeMs) / 1000.0, results[i].descentSeconds,
+      results[i].setDownRpm, results[i].anomalies);
+  }
+
+  // Ramping lets the horizontal motor run at a top speed that a constant speed can't reach without losing steps, which
+  // is where the time is saved. At the same top speed, the ramps cost more than the shorter careful descent saves.
+  CHECK(results[0].anomalies == 0);
+  CHECK(results[1].anomalies == 0);
+  CHECK(results[2].anomalies == 0);
+  CHECK(results[3].anomalies > 0);
+
+  CHECK(results[2].playMs + results[2].homeMs < results[0].playMs + results[0].homeMs);
+  CHECK(results[2].playMs + results[2].homeMs < results[1].playMs + results[1].homeMs);
+
+  // Only the end of the descent is careful, and the stylus is still set down at the careful speed.
+  CHECK(results[1].descentSeconds < results[0].descentSeconds);
+
+  for(uint8_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+    CHECK_NEAR(results[i].setDownRpm, MOVEMENT_RPM_CAREFUL, 0.5);
+  }
+
+  return TEST_RESULT();
+}
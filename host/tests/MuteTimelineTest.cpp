@@ -0,0 +1,185 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+
+// How many times the record is paused and unpaused.
+#define PAUSE_CYCLES 3
+
+// How far, in milliseconds, each mute edge may be from where it is timed from.
+#define MAX_EDGE_ERROR_MS 1.0
+
+// How long to let the lag run out after each movement, in seconds.
+#define SETTLE_SECONDS 1.0
+
+// The mute and unmute edges of one lift or set-down, and what they are timed from, in simulated ticks.
+struct MuteTimeline {
+    unsigned long long muteTicks;
+    unsigned long long unmuteTicks;
+    unsigned long long firstStepTicks;
+    unsigned long long stylusTicks;
+    unsigned long long unmuteFromTicks;
+    unsigned long mutes;
+    unsigned long unmutes;
+    unsigned long statusLedEdges;
+};
+
+static double ticksToMs(long long ticks) {
+  return (double)ticks * 1000 / SIMULATED_TICKS_PER_SECOND;
+}
+
+// The simulator has a pin for the Audio off line, as if AUDIO_MUTE_PIN were assigned. The movement status LED is a
+// separate output, which the mute must leave alone.
+static void findMuteEdges(size_t firstMuteEdge, size_t firstOutputEdge, MuteTimeline& timeline) {
+  std::vector<AudioMuteEdge>& muteEdges = simulator.getAudioMuteEdges();
+  std::vector<OutputEdge>& outputEdges = simulator.getOutputEdges();
+
+  for(size_t i = firstMuteEdge; i < muteEdges.size(); i++) {
+    if(muteEdges[i].muted) {
+      timeline.muteTicks = muteEdges[i].ticks;
+      timeline.mutes++;
+    }
+    else {
+      timeline.unmuteTicks = muteEdges[i].ticks;
+      timeline.unmutes++;
+    }
+  }
+
+  for(size_t i = firstOutputEdge; i < outputEdges.size(); i++) {
+    if(outputEdges[i].pin == ArduinoPin::MovementStatusLed) timeline.statusLedEdges++;
+  }
+}
+
+static void findStylusEvent(bool down, MuteTimeline& timeline) {
+  const std::vector<StylusEvent>& stylusEvents = simulator.getTonearm().getStylusEvents();
+
+  for(size_t i = 0; i < stylusEvents.size(); i++) {
+    if(stylusEvents[i].down == down) timeline.stylusTicks = stylusEvents[i].ticks;
+  }
+}
+
+// Pauses the record, which lifts the stylus off it. The unmute is timed from the step that takes the stylus clear of
+// the record, VERTICAL_STYLUS_CLEARANCE_STEPS full steps (two half steps each) into the lift.
+static MuteTimeline liftOff() {
+  MuteTimeline timeline = MuteTimeline();
+  TonearmModel& tonearm = simulator.getTonearm();
+  size_t firstMuteEdge = simulator.getAudioMuteEdges().size();
+  size_t firstOutputEdge = simulator.getOutputEdges().size();
+  long startPosition = tonearm.getMotorPosition(MotorAxis::Vertical);
+
+  tonearm.clearLogs();
+  simulator.pressButton(MultiplexerInput::PauseButton);
+  CHECK(simulator.runUntil(simulator.getSeconds() + 30, []() { return paused && simulator.getTonearm().isUpperLimitReached(); }));
+  simulator.runFor(SETTLE_SECONDS);
+
+  const std::vector<TonearmStep>& steps = tonearm.getSteps();
+
+  for(size_t i = 0; i < steps.size(); i++) {
+    if(steps[i].axis != MotorAxis::Vertical) continue;
+    if(timeline.firstStepTicks == 0) timeline.firstStepTicks = steps[i].ticks;
+
+    if(labs(steps[i].position - startPosition) >= 2 * VERTICAL_STYLUS_CLEARANCE_STEPS) {
+      timeline.unmuteFromTicks = steps[i].ticks;
+      break;
+    }
+  }
+
+  findMuteEdges(firstMuteEdge, firstOutputEdge, timeline);
+  findStylusEvent(false, timeline);
+
+  return timeline;
+}
+
+// Unpauses the record, which sets the stylus down on it carefully. The unmute is timed from the step that reaches the
+// lower limit switch, which is as soon as the firmware can know that the stylus is down.
+static MuteTimeline setDown() {
+  MuteTimeline timeline = MuteTimeline();
+  TonearmModel& tonearm = simulator.getTonearm();
+  size_t firstMuteEdge = simulator.getAudioMuteEdges().size();
+  size_t firstOutputEdge = simulator.getOutputEdges().size();
+
+  tonearm.clearLogs();
+  simulator.pressButton(MultiplexerInput::PauseButton);
+  CHECK(simulator.runUntil(simulator.getSeconds() + 30, []() { return !paused && simulator.getTonearm().isLowerLimitReached(); }));
+  simulator.runFor(SETTLE_SECONDS);
+
+  // Lowering the lift turns the motor forwards, so where the lift was at each step follows from where it ended up.
+  const std::vector<TonearmStep>& steps = tonearm.getSteps();
+  long endPosition = tonearm.getMotorPosition(MotorAxis::Vertical);
+  double endLiftSteps = tonearm.getLiftSteps();
+
+  for(size_t i = 0; i < steps.size(); i++) {
+    if(steps[i].axis != MotorAxis::Vertical) continue;
+    if(timeline.firstStepTicks == 0) timeline.firstStepTicks = steps[i].ticks;
+
+    if(endLiftSteps + (endPosition - steps[i].position) / 2.0 <= 0) {
+      timeline.unmuteFromTicks = steps[i].ticks;
+      break;
+    }
+  }
+
+  findMuteEdges(firstMuteEdge, firstOutputEdge, timeline);
+  findStylusEvent(true, timeline);
+
+  return timeline;
+}
+
+// Checks one lift or set-down: the audio is muted once, at least the lead time before the stylus leaves or meets the
+// record, and unmuted once, the lag after the step it is timed from, and so at least the lag after the stylus did. The
+// movement status LED doesn't change.
+static void checkTimeline(const char* movement, uint8_t cycle, const MuteTimeline& timeline, bool lift) {
+  double muteLeadMs = ticksToMs((long long)timeline.stylusTicks - (long long)timeline.muteTicks);
+  double firstStepMs = ticksToMs((long long)timeline.firstStepTicks - (long long)timeline.muteTicks);
+  double unmuteLagMs = ticksToMs((long long)timeline.unmuteTicks - (long long)timeline.unmuteFromTicks);
+  double stylusLagMs = ticksToMs((long long)timeline.unmuteTicks - (long long)timeline.stylusTicks);
+
+  printf("%s %u: muted %.3fms before the first step and %.1fms before the stylus %s, unmuted %.3fms after the %s "
+    "and %.1fms after the stylus\n", movement, cycle + 1, firstStepMs, muteLeadMs, lift ? "left" : "landed",
+    unmuteLagMs, lift ? "clearance step" : "lower limit", stylusLagMs);
+
+  CHECK(timeline.mutes == 1);
+  CHECK(timeline.unmutes == 1);
+  CHECK(timeline.statusLedEdges == 0);
+  CHECK(timeline.stylusTicks != 0 && timeline.unmuteFromTicks != 0);
+
+  // A lift is held back by the lead time, to the millisecond. A set-down mutes as it starts, far more than the lead
+  // time before the stylus lands.
+  if(lift) CHECK(fabs(firstStepMs - AUDIO_MUTE_LEAD_MS) <= MAX_EDGE_ERROR_MS);
+  else CHECK(firstStepMs >= 0);
+
+  CHECK(muteLeadMs >= AUDIO_MUTE_LEAD_MS - MAX_EDGE_ERROR_MS);
+  CHECK(fabs(unmuteLagMs - AUDIO_MUTE_LAG_MS) <= MAX_EDGE_ERROR_MS);
+  CHECK(stylusLagMs >= AUDIO_MUTE_LAG_MS - MAX_EDGE_ERROR_MS);
+}
+
+// Plays a record, then pauses and unpauses it a few times, and checks the Audio off line against the stylus leaving and
+// meeting the record. The lift's unmute comes from the step interrupt while the lift is still stepping, and every edge
+// is timed by the RTC, so each one has to land within a millisecond of its target every time.
+int main() {
+  simulator.getTonearm().setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(60, []() { return playRoutineMs > 0; }));
+  simulator.runFor(SETTLE_SECONDS);
+  CHECK(!simulator.isAudioMuted());
+  CHECK(!simulator.getOutput(ArduinoPin::MovementStatusLed));
+
+  for(uint8_t cycle = 0; cycle < PAUSE_CYCLES; cycle++) {
+    checkTimeline("Lift", cycle, liftOff(), true);
+    checkTimeline("Set-down", cycle, setDown(), false);
+
+    // The audio is back on, with the stylus in the groove.
+    CHECK(simulator.getTonearm().isStylusDown());
+    CHECK(!simulator.isAudioMuted());
+    CHECK(!simulator.getOutput(ArduinoPin::MovementStatusLed));
+  }
+
+  CHECK(simulator.getTonearm().getAnomalies().empty());
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,167 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "TurntableHal.h"
+#include "MultiplexerScanner.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+
+// Scans the simulated multiplexer: the selector pins only ever change one at a time, snapshots are reused until they
+// are too old, and debounced inputs ignore glitches. Also compares how long a main loop's worth of reads takes from
+// the snapshots against selecting and settling each input on its own, the way the firmware used to.
+
+static MultiplexerScanner<
+  ArduinoPin::MuxOutput,
+  ArduinoPin::MuxSelectorA,
+  ArduinoPin::MuxSelectorB,
+  ArduinoPin::MuxSelectorC
+> scanner;
+
+// The inputs the main loop reads every tick.
+static const uint8_t buttonMask = (1 << MultiplexerInput::PlayHomeButton) | (1 << MultiplexerInput::PauseButton);
+
+// The inputs that a tick of the main loop reads, as the firmware did before the scanner.
+static const uint8_t loopInputs[] = {
+  MultiplexerInput::PlayHomeButton,
+  MultiplexerInput::PauseButton,
+  MultiplexerInput::TargetSpeedA,
+  MultiplexerInput::TargetSpeedB,
+  MultiplexerInput::WaitUntilTargetSpeed,
+  MultiplexerInput::VerticalUpperLimit
+};
+
+// How many loop iterations the benchmark runs, enough for many snapshots to go stale.
+#define BENCHMARK_ITERATIONS 5000
+
+// Read one input by selecting it and waiting for it to settle, with no snapshot.
+static bool readInputDirectly(uint8_t input) {
+  TurntableHal::writePin<ArduinoPin::MuxSelectorA>(input & 0x1);
+  TurntableHal::writePin<ArduinoPin::MuxSelectorB>(input & 0x2);
+  TurntableHal::writePin<ArduinoPin::MuxSelectorC>(input & 0x4);
+  TurntableHal::waitMicros(MULTIPLEXER_DELAY_MICROS);
+
+  return TurntableHal::readPin<ArduinoPin::MuxOutput>();
+}
+
+static uint8_t expectedSnapshot() {
+  uint8_t snapshot = 0;
+
+  for(uint8_t input = 0; input < MULTIPLEXER_INPUT_COUNT; input++) {
+    if(simulator.getMuxInput(input)) snapshot |= (1 << input);
+  }
+
+  return snapshot;
+}
+
+static bool isSelectorPin(uint8_t pin) {
+  return pin == ArduinoPin::MuxSelectorA || pin == ArduinoPin::MuxSelectorB || pin == ArduinoPin::MuxSelectorC;
+}
+
+int main() {
+  simulator.setTimeLimit(60);
+
+  scanner.setSettleMicros(MULTIPLEXER_DELAY_MICROS);
+  scanner.setMaxAgeMicros(MULTIPLEXER_MAX_AGE_MICROS);
+  scanner.setDebounce(buttonMask, MULTIPLEXER_DEBOUNCE_SCANS);
+  scanner.begin();
+
+  // A scan reads every input, with the selector pins changing one at a time, seven times in all.
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, true);
+  simulator.setMuxInput(MultiplexerInput::WaitUntilTargetSpeed, true);
+
+  for(uint8_t i = 0; i < 4; i++) {
+    size_t firstEdge = simulator.getOutputEdges().size();
+    scanner.scan();
+
+    CHECK(scanner.getSnapshot() == expectedSnapshot());
+
+    std::vector<OutputEdge>& edges = simulator.getOutputEdges();
+    unsigned long selectorEdges = 0;
+    unsigned long long lastEdgeTicks = 0;
+
+    for(size_t j = firstEdge; j < edges.size(); j++) {
+      if(!isSelectorPin(edges[j].pin)) continue;
+
+      CHECK(selectorEdges == 0 || edges[j].ticks != lastEdgeTicks);
+      lastEdgeTicks = edges[j].ticks;
+      selectorEdges++;
+    }
+
+    CHECK(selectorEdges == MULTIPLEXER_INPUT_COUNT - 1);
+  }
+
+  // Reads are answered from the snapshot until it is older than the max age.
+  unsigned long scans = scanner.getScanCount();
+  unsigned long long readStartTicks = simulator.getTicks();
+
+  for(uint8_t input = 0; input < MULTIPLEXER_INPUT_COUNT; input++) scanner.read(input);
+
+  CHECK(scanner.getScanCount() == scans);
+  double cachedReadMicros = (double)(simulator.getTicks() - readStartTicks) / SIMULATED_TICKS_PER_MICROSECOND / MULTIPLEXER_INPUT_COUNT;
+
+  TurntableHal::waitMicros(MULTIPLEXER_MAX_AGE_MICROS + 1);
+  scanner.read(MultiplexerInput::TargetSpeedA);
+  CHECK(scanner.getScanCount() == scans + 1);
+
+  // A debounced input only changes once it has read the same new value for enough scans in a row, so a glitch that
+  // lasts fewer scans than that is never seen.
+  simulator.setMuxInput(MultiplexerInput::PauseButton, true);
+
+  for(uint8_t i = 0; i < MULTIPLEXER_DEBOUNCE_SCANS - 1; i++) {
+    scanner.scan();
+    CHECK(!scanner.read(MultiplexerInput::PauseButton));
+  }
+
+  simulator.setMuxInput(MultiplexerInput::PauseButton, false);
+  scanner.scan();
+  CHECK(!scanner.read(MultiplexerInput::PauseButton));
+
+  simulator.setMuxInput(MultiplexerInput::PauseButton, true);
+
+  for(uint8_t i = 0; i < MULTIPLEXER_DEBOUNCE_SCANS - 1; i++) {
+    scanner.scan();
+    CHECK(!scanner.read(MultiplexerInput::PauseButton));
+  }
+
+  scanner.scan();
+  CHECK(scanner.read(MultiplexerInput::PauseButton));
+
+  // Inputs that aren't debounced follow every scan.
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, true);
+  scanner.scan();
+  CHECK(scanner.read(MultiplexerInput::TargetSpeedB));
+
+  // How fast a main loop that reads the buttons and switches can go: reading each input from the snapshot, against
+  // selecting and settling each input on its own for every read, the way the firmware used to.
+  unsigned long long scanStartTicks = simulator.getTicks();
+
+  for(uint16_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    for(uint8_t j = 0; j < sizeof(loopInputs); j++) scanner.read(loopInputs[j]);
+  }
+
+  double scanMicros = (double)(simulator.getTicks() - scanStartTicks) / SIMULATED_TICKS_PER_MICROSECOND / BENCHMARK_ITERATIONS;
+
+  unsigned long long directStartTicks = simulator.getTicks();
+
+  for(uint16_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    for(uint8_t j = 0; j < sizeof(loopInputs); j++) readInputDirectly(loopInputs[j]);
+  }
+
+  double directMicros = (double)(simulator.getTicks() - directStartTicks) / SIMULATED_TICKS_PER_MICROSECOND / BENCHMARK_ITERATIONS;
+
+  // Reading every input directly still gives the same values as the scan.
+  uint8_t directSnapshot = 0;
+
+  for(uint8_t input = 0; input < MULTIPLEXER_INPUT_COUNT; input++) {
+    if(readInputDirectly(input)) directSnapshot |= (1 << input);
+  }
+
+  CHECK(directSnapshot == expectedSnapshot());
+
+  printf("Reading %u inputs per loop: %.1fus (%.0f loops/s) from snapshots, %.1fus (%.0f loops/s) one input at a time; "
+    "%.1fus per read from a fresh snapshot\n", (unsigned)sizeof(loopInputs), scanMicros, 1000000 / scanMicros,
+    directMicros, 1000000 / directMicros, cachedReadMicros);
+
+  CHECK(scanMicros * 2 < directMicros);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,216 @@
+#include <time.h>
+#include "HostTest.h"
+#include "Sketch.h"
+#include "FastPin.h"
+#include "MultiplexerScanner.h"
+#include "enums/ArduinoPin.h"
+
+// How many times each operation is timed, and how many runs of that, keeping the fastest.
+#define BENCHMARK_OPERATIONS 2000000
+#define BENCHMARK_RUNS 5
+
+typedef MultiplexerScanner<ArduinoPin::MuxOutput, ArduinoPin::MuxSelectorA, ArduinoPin::MuxSelectorB, ArduinoPin::MuxSelectorC> TurntableMultiplexerScanner;
+
+// The core's way of reaching a pin from before the pins were template parameters: the pin is a runtime value, so
+// every call looks up its port and bit, and a write is a read-modify-write of the port (without the interrupt guard,
+// to be fair to it). Kept out of line, like the core's functions are.
+__attribute__((noinline)) static bool legacyDigitalRead(uint8_t pin) {
+  return (&VPORTA)[digitalPinToPort(pin)].IN & digitalPinToBitMask(pin);
+}
+
+__attribute__((noinline)) static void legacyDigitalWrite(uint8_t pin, uint8_t value) {
+  VPORT_t& port = (&VPORTA)[digitalPinToPort(pin)];
+
+  if(value) port.OUT |= digitalPinToBitMask(pin);
+  else port.OUT &= ~digitalPinToBitMask(pin);
+}
+
+// The pins, as the classes that were given them at runtime stored them.
+static volatile uint8_t sensorPin = ArduinoPin::HorizontalHomeOrPlayOpticalSensor;
+static volatile uint8_t selectorPins[3] = { ArduinoPin::MuxSelectorA, ArduinoPin::MuxSelectorB, ArduinoPin::MuxSelectorC };
+static volatile uint8_t axisPin = ArduinoPin::MotorAxisSelector;
+
+// The Nano Every's pinout, written out from its datasheet: the port and bit of each Arduino pin, from D0 to D21 (A7).
+static const char* pinoutPortBits[FAST_PIN_COUNT] = {
+  "C5", "C4", "A0", "F5", "C6", "B2", "F4", "A1", "E3", "B0", "B1", "E0", "E1", "E2", "D3", "D2", "D1", "D0", "F2",
+  "F3", "D4", "D5"
+};
+
+// Every register of every port, to compare before and after an access.
+struct PortRegisters {
+    uint8_t values[6][3];
+};
+
+static PortRegisters readRegisters() {
+  PortRegisters registers;
+
+  for(uint8_t port = 0; port < 6; port++) {
+    registers.values[port][0] = simulatedVports[port].DIR;
+    registers.values[port][1] = simulatedVports[port].OUT;
+    registers.values[port][2] = simulatedVports[port].IN;
+  }
+
+  return registers;
+}
+
+// Fill every register with a pattern, so an access that clobbers the other bits of a port can't go unnoticed.
+static void fillRegisters(uint8_t seed) {
+  for(uint8_t port = 0; port < 6; port++) {
+    simulatedVports[port].DIR = seed * 37 + port * 11;
+    simulatedVports[port].OUT = seed * 53 + port * 13;
+    simulatedVports[port].IN = seed * 71 + port * 17;
+  }
+}
+
+// Whether the only bits that changed since before are the given ones, in the given register (0 for DIR, 1 for OUT, 2
+// for IN) of the given port.
+static bool onlyChanged(const PortRegisters& before, uint8_t port, uint8_t reg, uint8_t changedBits) {
+  PortRegisters after = readRegisters();
+
+  for(uint8_t p = 0; p < 6; p++) {
+    for(uint8_t r = 0; r < 3; r++) {
+      uint8_t expected = (p == port && r == reg) ? changedBits : 0;
+      if((before.values[p][r] ^ after.values[p][r]) != expected) return false;
+    }
+  }
+
+  return true;
+}
+
+// Every FastPin access of the pin goes to the port and bit that the datasheet gives it, and touches nothing else: a
+// write changes only its bit of OUT, a direction change only its bit of DIR, a read only looks at its bit of IN, and a
+// toggle writes the IN register with that bit alone (which is what toggles an output on the chip, where any other bit
+// written as one would toggle that output too).
+template<uint8_t pin>
+static unsigned long checkPinAccess() {
+  unsigned long failures = 0;
+  uint8_t port = pinoutPortBits[pin][0] - 'A';
+  uint8_t mask = 1 << (pinoutPortBits[pin][1] - '0');
+
+  for(uint8_t seed = 0; seed < 8; seed++) {
+    fillRegisters(seed);
+    PortRegisters before = readRegisters();
+    bool wasHigh = before.values[port][1] & mask;
+
+    FastPin<pin>::write(!wasHigh);
+    if(!onlyChanged(before, port, 1, mask)) failures++;
+
+    before = readRegisters();
+    FastPin<pin>::write(!wasHigh);
+    if(!onlyChanged(before, port, 1, 0)) failures++;
+
+    fillRegisters(seed);
+    before = readRegisters();
+    if(before.values[port][0] & mask) FastPin<pin>::setInput();
+    else FastPin<pin>::setOutput();
+    if(!onlyChanged(before, port, 0, mask)) failures++;
+
+    fillRegisters(seed);
+    before = readRegisters();
+    if(FastPin<pin>::read() != (bool)(before.values[port][2] & mask)) failures++;
+    if(!onlyChanged(before, port, 0, 0)) failures++;
+
+    fillRegisters(seed);
+    FastPin<pin>::toggle();
+    if(simulatedVports[port].IN != mask) failures++;
+  }
+
+  return failures;
+}
+
+// Checks the pins from the given one up, one instantiation of checkPinAccess() each.
+template<uint8_t pin>
+struct PinAccessCheck {
+    static unsigned long run() {
+      unsigned long failures = checkPinAccess<pin>();
+      if(failures != 0) fprintf(stderr, "Pin %u: %lu accesses went to the wrong registers\n", pin, failures);
+
+      return failures + PinAccessCheck<pin + 1>::run();
+    }
+};
+
+template<>
+struct PinAccessCheck<FAST_PIN_COUNT> {
+    static unsigned long run() { return 0; }
+};
+
+static double nanosecondsSince(const struct timespec& start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start.tv_sec) * 1e9 + (now.tv_nsec - start.tv_nsec);
+}
+
+// The fastest time of the given operation, in nanoseconds.
+template<typename Operation>
+static double timeOperation(Operation operation) {
+  double best = 1e12;
+
+  for(uint8_t run = 0; run < BENCHMARK_RUNS; run++) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(unsigned long i = 0; i < BENCHMARK_OPERATIONS; i++) operation(i);
+
+    double ns = nanosecondsSince(start) / BENCHMARK_OPERATIONS;
+    if(ns < best) best = ns;
+  }
+
+  return best;
+}
+
+static void printComparison(const char* operation, double fastNs, double legacyNs) {
+  printf("%-28s FastPin %6.2fns, runtime pin %6.2fns (%.1fx)\n", operation, fastNs, legacyNs, legacyNs / fastNs);
+}
+
+// Checks that every FastPin access reaches the right bit of the right VPORT register and leaves the rest of the port
+// alone, which is what lets each one compile to a single sbis/sbi/cbi instruction on the chip. Then times the pin
+// accesses the sketch makes most, through FastPin, against the same access with the pin as a runtime value, the way
+// the classes did it before the pins were template parameters. The times are host times, not AVR cycles, so they
+// are only printed. The flash and RAM of the whole sketch are compared on the real build by host/tools/size_report.sh.
+// The size of each of the sketch's globals is printed too, though those are host sizes, with 8-byte pointers.
+int main() {
+  volatile bool sink = false;
+
+  CHECK(PinAccessCheck<0>::run() == 0);
+
+  // A read of the home/play sensor, as the tonearm controller does every loop.
+  double fastReadNs = timeOperation([&](unsigned long) { sink = FastPin<ArduinoPin::HorizontalHomeOrPlayOpticalSensor>::read(); });
+  double legacyReadNs = timeOperation([&](unsigned long) { sink = legacyDigitalRead(sensorPin); });
+
+  // A write of the axis selector, as every move does.
+  double fastWriteNs = timeOperation([](unsigned long i) { FastPin<ArduinoPin::MotorAxisSelector>::write(i & 1); });
+  double legacyWriteNs = timeOperation([](unsigned long i) { legacyDigitalWrite(axisPin, i & 1); });
+
+  // All three multiplexer selector pins written for the next input, as a scan did before it only wrote the pin that
+  // changed.
+  double fastSelectNs = timeOperation([](unsigned long i) {
+    FastPin<ArduinoPin::MuxSelectorA>::write(i & 1);
+    FastPin<ArduinoPin::MuxSelectorB>::write(i & 2);
+    FastPin<ArduinoPin::MuxSelectorC>::write(i & 4);
+  });
+  double legacySelectNs = timeOperation([](unsigned long i) {
+    for(uint8_t bit = 0; bit < 3; bit++) legacyDigitalWrite(selectorPins[bit], (i >> bit) & 1);
+  });
+
+  printComparison("Sensor read:", fastReadNs, legacyReadNs);
+  printComparison("Axis selector write:", fastWriteNs, legacyWriteNs);
+  printComparison("Multiplexer input select:", fastSelectNs, legacySelectNs);
+
+  // A pin that is a template parameter takes no room in the object that uses it.
+  CHECK(sizeof(FastPin<ArduinoPin::MotorAxisSelector>) == 1);
+
+  printf("\nHost sizes of the sketch's globals, in bytes:\n");
+  printf("  tonearmController  %4u\n", (unsigned)sizeof(tonearmController));
+  printf("  multiplexer        %4u\n", (unsigned)sizeof(TurntableMultiplexerScanner));
+  printf("  speedMonitor       %4u\n", (unsigned)sizeof(speedMonitor));
+  printf("  speedRegulator     %4u\n", (unsigned)sizeof(speedRegulator));
+  printf("  routineExecutor    %4u\n", (unsigned)sizeof(routineExecutor));
+  printf("  pickupEncoder      %4u\n", (unsigned)sizeof(pickupEncoder));
+  printf("  leadOutDetector    %4u\n", (unsigned)sizeof(leadOutDetector));
+  printf("  serialProtocol     %4u\n", (unsigned)sizeof(serialProtocol));
+  printf("  calibrationStore   %4u\n", (unsigned)sizeof(calibrationStore));
+  printf("  sensorCapture      %4u\n", (unsigned)sizeof(sensorCapture));
+
+  return TEST_RESULT();
+}
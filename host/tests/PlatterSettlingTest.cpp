@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "TurntableHal.h"
+#include "TurntableSpeedMonitor.h"
+#include "TurntableSpeedRegulator.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+
+// How long each speed is given to settle from a standstill with the stylus up, and how long it then runs with the
+// stylus on the record, in milliseconds.
+#define SPIN_UP_MS 30000
+#define PLAYING_MS 30000
+
+// How much of the end of each phase the steady-state error is averaged over.
+#define STEADY_STATE_MS 10000
+
+// The longest any speed may take to settle within the regulator's tolerance, and stay there.
+#define MAX_SETTLING_MS 15000
+
+// How far each speed's fine-tune pot is from where the base output would give the nominal speed: the regulator has to
+// find the right output for itself.
+static const double fullDutyRatios[] = { 1.12, 1.16, 1.10, 1.18 };
+
+static const char* speedNames[] = { "33 1/3", "45", "16 2/3", "78" };
+
+static TurntableSpeedMonitor monitor;
+static TurntableSpeedRegulator regulator = TurntableSpeedRegulator(monitor);
+
+static void recordPulse(unsigned long timestampMicros) {
+  monitor.recordPulse(timestampMicros);
+}
+
+// The platter's true speed error, sampled every millisecond over a phase.
+struct PhaseResult {
+    // When the error last came into the tolerance and stayed there, in ms from the start of the phase, or -1 if it
+    // never did.
+    long settledMs;
+
+    // When the regulator first reported the platter stable, in ms from the start of the phase, or -1.
+    long stableMs;
+
+    // The mean and the worst error over the end of the phase, as fractions of the nominal speed.
+    double meanError;
+    double worstError;
+};
+
+static PhaseResult runPhase(unsigned long ms) {
+  PhaseResult result = { -1, -1, 0, 0 };
+  double tolerance = SPEED_REGULATOR_TOLERANCE_BASIS_POINTS / 10000.0;
+  double errorSum = 0;
+
+  for(unsigned long i = 0; i < ms; i++) {
+    TurntableHal::waitMs(1);
+    monitor.update();
+    regulator.update();
+
+    // The main loop reads the buttons and switches every tick, which is what keeps the debounced speed switches up
+    // to date.
+    regulator.getTargetSpeed();
+
+    double error = simulator.getPlatter().getSpeedError();
+
+    if(fabs(error) > tolerance) result.settledMs = -1;
+    else if(result.settledMs < 0) result.settledMs = i;
+
+    if(result.stableMs < 0 && regulator.isStable()) result.stableMs = i;
+
+    if(i >= ms - STEADY_STATE_MS) {
+      errorSum += error;
+      if(fabs(error) > fabs(result.worstError)) result.worstError = error;
+    }
+  }
+
+  result.meanError = errorSum / STEADY_STATE_MS;
+
+  return result;
+}
+
+// Spins the platter up from a standstill at each speed under the speed regulator, with the pots a little off, and
+// then puts the stylus on the record. Prints how long each speed takes to settle and its steady-state error, and checks
+// them against the regulator's tolerance, then switches the motor off and back on at the speed switch. The gains can
+// be overridden to compare tunings: `platter_settling_test [kp ki kd]`.
+int main(int argc, char** argv) {
+  uint16_t kp = SPEED_REGULATOR_KP;
+  uint16_t ki = SPEED_REGULATOR_KI;
+  uint16_t kd = SPEED_REGULATOR_KD;
+
+  if(argc == 4) {
+    kp = atoi(argv[1]);
+    ki = atoi(argv[2]);
+    kd = atoi(argv[3]);
+  }
+
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit((4 * (SPIN_UP_MS + PLAYING_MS + TURNTABLE_STOPPED_MS * 4) + 3 * SPIN_UP_MS) / 1000.0);
+
+  TurntableHal::begin();
+  TurntableHal::beginSpeedCapture(recordPulse);
+
+  monitor.setStoppedTimeoutMs(TURNTABLE_STOPPED_MS);
+  regulator.setGains(kp, ki, kd);
+  regulator.setBaseOutput(SPEED_REGULATOR_BASE_OUTPUT);
+  regulator.setToleranceBasisPoints(SPEED_REGULATOR_TOLERANCE_BASIS_POINTS);
+  regulator.setSpinUpThresholdBasisPoints(SPEED_REGULATOR_SPIN_UP_BASIS_POINTS);
+  regulator.setStableRevolutions(SPEED_REGULATOR_STABLE_REVOLUTIONS);
+
+  printf("Gains %u/%u/%u, tolerance %.2f%%\n", kp, ki, kd, SPEED_REGULATOR_TOLERANCE_BASIS_POINTS / 100.0);
+  printf("Speed   | settled  | stable   | spin-up error      | playing error\n");
+
+  for(uint8_t speed = 0; speed < 4; speed++) {
+    simulator.setMuxInput(MultiplexerInput::TargetSpeedA, speed & 1);
+    simulator.setMuxInput(MultiplexerInput::TargetSpeedB, speed & 2);
+    simulator.getPlatter().setFullDutyRatio((TurntableSpeed)speed, fullDutyRatios[speed]);
+
+    // Lift the stylus off the record, and start from a standstill.
+    tonearm.setLiftSteps(TONEARM_MODEL_LIFT_TRAVEL_STEPS);
+    tonearm.setArmSteps(tonearm.getRecordEdgeArmSteps() + 100);
+
+    regulator.start();
+    PhaseResult spinUp = runPhase(SPIN_UP_MS);
+
+    tonearm.setLiftSteps(0);
+    PhaseResult playing = runPhase(PLAYING_MS);
+
+    regulator.stop();
+    while(!monitor.isStopped()) runPhase(TURNTABLE_STOPPED_MS);
+
+    printf("%-7s | %6.2fs | %6.2fs | %+.3f%% (%+.3f%%) | %+.3f%% (%+.3f%%)\n", speedNames[speed],
+      spinUp.settledMs / 1000.0, spinUp.stableMs / 1000.0, spinUp.meanError * 100, spinUp.worstError * 100,
+      playing.meanError * 100, playing.worstError * 100);
+
+    CHECK(spinUp.settledMs >= 0 && spinUp.settledMs <= MAX_SETTLING_MS);
+    CHECK(spinUp.stableMs >= 0 && spinUp.stableMs <= MAX_SETTLING_MS + TURNTABLE_SLOWEST_REVOLUTION_MS * SPEED_REGULATOR_STABLE_REVOLUTIONS);
+    CHECK(playing.settledMs >= 0);
+    CHECK(fabs(spinUp.meanError) * 10000 <= SPEED_REGULATOR_TOLERANCE_BASIS_POINTS / 2);
+    CHECK(fabs(playing.meanError) * 10000 <= SPEED_REGULATOR_TOLERANCE_BASIS_POINTS / 2);
+  }
+
+  // The speed switch's center position turns the motor off while the regulator is running, however slow the platter
+  // gets, and the regulator spins it back up once the switch is moved back to a speed.
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, false);
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, false);
+  regulator.start();
+  runPhase(SPIN_UP_MS);
+  CHECK(regulator.isStable());
+
+  simulator.setSpeedSwitchOff(true);
+  PhaseResult switchedOff = runPhase(SPIN_UP_MS);
+  printf("Switched off: %+.3f%% after %.0fs\n", simulator.getPlatter().getSpeedError() * 100, SPIN_UP_MS / 1000.0);
+
+  CHECK(regulator.isSwitchedOff());
+  CHECK(regulator.getOutput() == 0);
+  CHECK(simulator.getMotorTrim() == 0);
+  CHECK(!simulator.getOutput(ArduinoPin::TurntableMotorEnable));
+  CHECK(switchedOff.stableMs < 0);
+  CHECK(monitor.isStopped() && !regulator.isStable());
+
+  simulator.setSpeedSwitchOff(false);
+  PhaseResult switchedOn = runPhase(SPIN_UP_MS);
+
+  CHECK(simulator.getOutput(ArduinoPin::TurntableMotorEnable));
+  CHECK(switchedOn.settledMs >= 0 && switchedOn.settledMs <= MAX_SETTLING_MS);
+  CHECK(regulator.isStable());
+
+  regulator.stop();
+  CHECK(!simulator.getOutput(ArduinoPin::TurntableMotorEnable));
+
+  return TEST_RESULT();
+}
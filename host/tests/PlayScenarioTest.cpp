@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+
+// How often the platter and tonearm are sampled, in ticks. The play routine runs inside a single loop(), so they are
+// sampled from the simulator's own events rather than between iterations of the loop.
+#define SAMPLE_TICKS (SIMULATED_TICKS_PER_SECOND / 1000)
+
+// The longest the careful set-down from hovering over the record may take once the platter is stable, in seconds.
+#define MAX_SET_DOWN_SECONDS 1.5
+
+static const char* speedNames[] = { "33", "45", "16", "78" };
+
+// When things happened, in seconds from the press of the play button (or -1 if they never did).
+static double pressSeconds = 0;
+static double motorOnSeconds = -1;
+static double traverseSeconds = -1;
+static double overLeadInSeconds = -1;
+static double stableSeconds = -1;
+static double setDownSeconds = -1;
+
+// The platter's speed error when the tonearm started across, and when the stylus reached the record.
+static double traverseSpeedError = 0;
+static double setDownSpeedError = 0;
+
+// Whether the tonearm was already lowered to hover just above the record when the platter became stable.
+static bool hoveringWhenStable = false;
+
+static void sample() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  double seconds = simulator.getSeconds() - pressSeconds;
+
+  if(motorOnSeconds < 0 && simulator.getOutput(ArduinoPin::TurntableMotorEnable)) motorOnSeconds = seconds;
+
+  if(traverseSeconds < 0 && tonearm.isPastPlaySensor()) {
+    traverseSeconds = seconds;
+    traverseSpeedError = simulator.getPlatter().getSpeedError();
+  }
+
+  if(overLeadInSeconds < 0 && tonearm.getArmSteps() >= tonearm.getRecordEdgeArmSteps() + RECORD_LEAD_IN_STEPS / 2 &&
+    tonearm.isUpperLimitReached()) {
+    overLeadInSeconds = seconds;
+  }
+
+  if(stableSeconds < 0 && speedRegulator.isStable()) {
+    stableSeconds = seconds;
+    hoveringWhenStable = !tonearm.isUpperLimitReached() && !tonearm.isStylusDown();
+  }
+
+  if(setDownSeconds < 0 && tonearm.isStylusDown()) {
+    setDownSeconds = seconds;
+    setDownSpeedError = simulator.getPlatter().getSpeedError();
+  }
+
+  if(setDownSeconds < 0) simulator.schedule(simulator.getTicks() + SAMPLE_TICKS, sample);
+}
+
+// Presses play at the given speed, with the WaitUntilTargetSpeed switch on, and follows the platter and the tonearm
+// from the press to the stylus reaching the record. The platter is started at the press, and the tonearm crosses to the
+// lead-in and lowers it to hover just above the record while it spins up. The stylus is only set down once the regulator
+// has seen the speed inside its tolerance for SPEED_REGULATOR_STABLE_REVOLUTIONS revolutions in a row, and then
+// straight away, so the platter is on speed when the stylus lands, and the whole play takes about as long as the slower
+// of the spin-up and the traverse, plus the careful part of the set-down.
+int main(int argc, char** argv) {
+  TurntableSpeed speed = TurntableSpeed::Speed33;
+
+  for(uint8_t i = 0; i < 4; i++) {
+    if(argc > 1 && !strcmp(argv[1], speedNames[i])) speed = (TurntableSpeed)i;
+  }
+
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, speed & 1);
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, speed >> 1);
+  simulator.setMuxInput(MultiplexerInput::WaitUntilTargetSpeed, true);
+  simulator.getTonearm().setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  pressSeconds = simulator.getSeconds();
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  sample();
+
+  CHECK(simulator.runUntil(pressSeconds + 60, []() { return playRoutineMs > 0; }));
+
+  printf("%s RPM: motor on at %.3fs, tonearm past the play sensor at %.2fs (speed error %+.1f%%), over the lead-in at "
+    "%.2fs, platter stable at %.2fs, stylus down at %.2fs (speed error %+.2f%%)\n", speedNames[speed], motorOnSeconds,
+    traverseSeconds, traverseSpeedError * 100, overLeadInSeconds, stableSeconds, setDownSeconds, setDownSpeedError * 100);
+
+  // The platter starts with the press, and the tonearm sets off before it is up to speed.
+  CHECK(motorOnSeconds >= 0 && motorOnSeconds < 0.1);
+  CHECK(traverseSeconds >= 0 && traverseSeconds < stableSeconds);
+
+  // The stylus only lands once the platter is stable, and on speed.
+  CHECK(stableSeconds >= 0 && setDownSeconds >= stableSeconds);
+  CHECK(fabs(setDownSpeedError) <= SPEED_REGULATOR_TOLERANCE_BASIS_POINTS / 10000.0);
+
+  // And as soon as both the platter and the tonearm are ready, with only the careful part of the set-down left.
+  CHECK(overLeadInSeconds >= 0);
+  CHECK(hoveringWhenStable);
+  CHECK(setDownSeconds - (stableSeconds > overLeadInSeconds ? stableSeconds : overLeadInSeconds) <= MAX_SET_DOWN_SECONDS);
+
+  CHECK(simulator.getTonearm().getAnomalies().empty());
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,152 @@
+#include <signal.h>
+#include <string.h>
+#include "HostTest.h"
+#include "SerialPort.h"
+#include "enums/SerialFrameType.h"
+#include "enums/SerialStatusFlag.h"
+#include "enums/MovementResult.h"
+
+// How many times real time the simulator runs at. Fast enough for a whole play and home, and slow enough for the
+// host to keep up with every frame.
+#define LOOPBACK_RATE "20"
+
+// The longest to wait for an answer, in real milliseconds.
+#define LOOPBACK_TIMEOUT_MS 30000
+
+// How often the turntable is asked to send its status and speed while the routine runs, in milliseconds.
+#define LOOPBACK_TELEMETRY_MS 250
+
+// Starts the program with its output on a pipe, and returns its pid.
+static pid_t startProgram(char* const* argv, FILE** output) {
+  int fds[2];
+  if(pipe(fds) != 0) return -1;
+
+  pid_t pid = fork();
+
+  if(pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv(argv[0], argv);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  *output = fdopen(fds[0], "r");
+
+  return pid;
+}
+
+// Waits for a frame of the given type, counting the status and speed frames that come first.
+static bool waitForFrame(SerialPort& port, uint8_t type, SerialFrame& frame, unsigned long& movingStatuses, unsigned long& speeds) {
+  while(port.receive(frame, LOOPBACK_TIMEOUT_MS)) {
+    if(frame.type == SerialFrameType::Status && (frame.payload[0] & SerialStatusFlag::MovingFlag)) movingStatuses++;
+    if(frame.type == SerialFrameType::SpeedTelemetry) speeds++;
+    if(frame.type == type) return true;
+  }
+
+  return false;
+}
+
+static bool requestStatus(SerialPort& port, uint8_t& flags) {
+  SerialFrame frame;
+  unsigned long movingStatuses = 0;
+  unsigned long speeds = 0;
+
+  if(!port.send(SerialFrameType::StatusRequest) || !waitForFrame(port, SerialFrameType::Status, frame, movingStatuses, speeds)) return false;
+
+  flags = frame.payload[0];
+  return true;
+}
+
+// Runs `turntable_sim --pty` and talks to the firmware through the pty with the host's frame codec, the way
+// turntable_client talks to the turntable: a corrupt command is ignored, a play command is answered once the routine
+// has finished, with status and speed telemetry streamed while it runs, and turntable_client itself sends it home.
+// Run as `pty_loopback_test <turntable_sim> <turntable_client>`.
+int main(int argc, char** argv) {
+  if(argc != 3) {
+    fprintf(stderr, "Usage: %s <turntable_sim> <turntable_client>\n", argv[0]);
+    return 2;
+  }
+
+  char rate[] = LOOPBACK_RATE;
+  char seconds[] = "3600";
+  char ptyFlag[] = "--pty";
+  char rateFlag[] = "--rate";
+  char secondsFlag[] = "--seconds";
+  char* simArgv[] = { argv[1], ptyFlag, rateFlag, rate, secondsFlag, seconds, NULL };
+
+  FILE* simOutput = NULL;
+  pid_t simPid = startProgram(simArgv, &simOutput);
+  CHECK(simPid > 0 && simOutput != NULL);
+  if(simPid <= 0 || simOutput == NULL) return TEST_RESULT();
+
+  char line[256];
+  char path[200] = "";
+  if(fgets(line, sizeof(line), simOutput) != NULL) sscanf(line, "pty %199s", path);
+
+  SerialPort port;
+  CHECK(port.open(path));
+
+  // At power-on, the tonearm is home and still.
+  uint8_t flags = 0;
+  CHECK(requestStatus(port, flags));
+  CHECK((flags & SerialStatusFlag::HomeFlag) && !(flags & SerialStatusFlag::MovingFlag));
+
+  // A play command with a bad CRC is thrown away, and the next frame is still found.
+  std::vector<uint8_t> corrupt = FrameCodec::encode(SerialFrameType::PlayCommand, NULL, 0);
+  corrupt.back() ^= 0xFF;
+  CHECK(port.sendBytes(corrupt));
+
+  CHECK(requestStatus(port, flags));
+  CHECK((flags & SerialStatusFlag::HomeFlag) && !(flags & SerialStatusFlag::MovingFlag));
+
+  // Play, with telemetry streaming the whole time: the answer only comes once the routine has finished.
+  uint8_t interval[2];
+  FrameCodec::writeUint16(interval, LOOPBACK_TELEMETRY_MS);
+  CHECK(port.send(SerialFrameType::SetTelemetryInterval, interval, sizeof(interval)));
+  CHECK(port.send(SerialFrameType::PlayCommand));
+
+  SerialFrame result;
+  unsigned long movingStatuses = 0;
+  unsigned long speeds = 0;
+
+  CHECK(waitForFrame(port, SerialFrameType::CommandResult, result, movingStatuses, speeds));
+  CHECK(result.payload[0] == SerialFrameType::PlayCommand && result.payload[1] == MovementResult::Success);
+
+  printf("Play answered with %u after %lu status frames while moving and %lu speed frames\n", result.payload[1], movingStatuses, speeds);
+
+  CHECK(movingStatuses > 0);
+  CHECK(speeds > 0);
+
+  uint8_t off[2] = { 0, 0 };
+  CHECK(port.send(SerialFrameType::SetTelemetryInterval, off, sizeof(off)));
+  CHECK(requestStatus(port, flags));
+  CHECK(!(flags & SerialStatusFlag::HomeFlag) && (flags & SerialStatusFlag::MotorRunningFlag));
+
+  // The client sends the tonearm home, and exits successfully once it is.
+  port.close();
+
+  char home[] = "home";
+  char* clientArgv[] = { argv[2], path, home, NULL };
+  FILE* clientOutput = NULL;
+  pid_t clientPid = startProgram(clientArgv, &clientOutput);
+  CHECK(clientPid > 0 && clientOutput != NULL);
+
+  while(clientOutput != NULL && fgets(line, sizeof(line), clientOutput) != NULL) printf("turntable_client: %s", line);
+
+  int clientStatus = -1;
+  if(clientPid > 0) waitpid(clientPid, &clientStatus, 0);
+  CHECK(WIFEXITED(clientStatus) && WEXITSTATUS(clientStatus) == 0);
+
+  CHECK(port.open(path));
+  CHECK(requestStatus(port, flags));
+  CHECK((flags & SerialStatusFlag::HomeFlag) && !(flags & SerialStatusFlag::MotorRunningFlag));
+  CHECK(port.getCodec().getCrcErrorCount() == 0);
+
+  port.close();
+  kill(simPid, SIGTERM);
+  waitpid(simPid, NULL, 0);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,163 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+
+// How many revolutions of music the record has, so a side takes under a minute at 33 RPM.
+#define MUSIC_REVOLUTIONS 30
+
+// How many times the side is repeated.
+#define REPEATS 3
+
+// How far, in steps, a repeat may set the stylus down from where the play routine did.
+#define MAX_LANDING_DIFFERENCE_STEPS 8
+
+// How much further in than usual the record edge is for the repeats, so that it is outside the learning deadband and
+// the record edge steps are learned.
+#define RECORD_EDGE_OFFSET_STEPS 24
+
+// What a power-on took to get from the end of the side back to the start of it, and where it set the stylus down.
+struct TurnaroundResult {
+    unsigned long repeatMs[REPEATS];
+    unsigned long homeMs;
+    unsigned long playMs;
+    double playLandingSteps;
+    double repeatLandingSteps[REPEATS];
+    double closestToHomeSteps;
+    uint16_t learnedEdgeSteps;
+    unsigned long eepromWrites;
+    unsigned long anomalies;
+};
+
+// A 12" record with a short side, so it reaches the lead-out quickly, and its edge the given number of steps further
+// in than the default record's.
+static SimulatedRecord shortRecord(double edgeOffsetSteps) {
+  SimulatedRecord record = TonearmModel::defaultRecord(RecordSize::TwelveInch);
+  double leadOutLength = record.lockedGrooveSteps - record.leadOutSteps;
+
+  record.edgeSteps += edgeOffsetSteps;
+  record.musicSteps += edgeOffsetSteps;
+
+  record.leadOutSteps = record.musicSteps + MUSIC_REVOLUTIONS * record.musicPitchSteps;
+  record.lockedGrooveSteps = record.leadOutSteps + leadOutLength;
+
+  return record;
+}
+
+static void startPowerOn(bool repeat, double edgeOffsetSteps) {
+  simulator.getTonearm().setRecord(shortRecord(edgeOffsetSteps));
+  simulator.setRepeatSwitch(repeat);
+  simulator.setTimeLimit(600);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(60, []() { return playRoutineMs > 0; }));
+  CHECK(simulator.getTonearm().isStylusDown());
+}
+
+// How often the tonearm's position is sampled, in ticks. The routines run inside a single loop(), so it is sampled from
+// the simulator's own events rather than between iterations of the loop.
+#define SAMPLE_TICKS (SIMULATED_TICKS_PER_SECOND / 1000)
+
+static double closestToHomeSteps = 1e9;
+
+static void sampleArm() {
+  if(simulator.getTonearm().getArmSteps() < closestToHomeSteps) closestToHomeSteps = simulator.getTonearm().getArmSteps();
+  simulator.schedule(simulator.getTicks() + SAMPLE_TICKS, sampleArm);
+}
+
+// Plays the side over and over with repeat on, noting how close to home the tonearm ever gets once it has played.
+static TurnaroundResult runRepeats() {
+  TurnaroundResult result = TurnaroundResult();
+  TonearmModel& tonearm = simulator.getTonearm();
+
+  startPowerOn(true, RECORD_EDGE_OFFSET_STEPS);
+  result.playLandingSteps = tonearm.getArmSteps();
+  result.playMs = playRoutineMs;
+  sampleArm();
+
+  for(uint8_t i = 0; i < REPEATS; i++) {
+    repeatRoutineMs = 0;
+
+    CHECK(simulator.runUntil(simulator.getSeconds() + 180, []() { return repeatRoutineMs > 0; }));
+
+    CHECK(tonearm.isStylusDown());
+    CHECK(!tonearm.isClutchEngaged());
+
+    result.repeatMs[i] = repeatRoutineMs;
+    result.repeatLandingSteps[i] = tonearm.getArmSteps();
+  }
+
+  result.closestToHomeSteps = closestToHomeSteps;
+  result.learnedEdgeSteps = calibrationStore.get(CalibrationValue::RecordEdgeSteps12Inch);
+  result.anomalies = tonearm.getAnomalies().size();
+
+  return result;
+}
+
+// Plays the side with repeat off, so the tonearm goes home at the end of it, then plays it again. The record edge is
+// where the default calibration expects it, give or take the noise of the measurement, so neither play changes the
+// calibration, or writes to the EEPROM.
+static TurnaroundResult runHomeAndPlay() {
+  TurnaroundResult result = TurnaroundResult();
+
+  startPowerOn(false, 0);
+
+  CHECK(simulator.runUntil(simulator.getSeconds() + 180, []() { return homeRoutineMs > 0; }));
+  result.homeMs = homeRoutineMs;
+
+  playRoutineMs = 0;
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(simulator.getSeconds() + 60, []() { return playRoutineMs > 0; }));
+
+  result.playMs = playRoutineMs;
+  result.playLandingSteps = simulator.getTonearm().getArmSteps();
+  result.learnedEdgeSteps = calibrationStore.get(CalibrationValue::RecordEdgeSteps12Inch);
+  result.eepromWrites = simulator.getTotalEepromWriteCount();
+  result.anomalies = simulator.getTonearm().getAnomalies().size();
+
+  return result;
+}
+
+// Plays a short side of a 12" record with repeat on. At each lead-out, the repeat routine turns the tonearm around at
+// the play sensor without ever reaching home, and sets the stylus down where the play routine did, from the record
+// edge that the play routine found. The turnaround is compared against going home at the end of the side and pressing
+// play again.
+int main() {
+  TurnaroundResult repeats = runPowerOn<TurnaroundResult>(runRepeats);
+  TurnaroundResult homeAndPlay = runPowerOn<TurnaroundResult>(runHomeAndPlay);
+
+  unsigned long homeAndPlayMs = homeAndPlay.homeMs + homeAndPlay.playMs;
+
+  printf("Play routine set the stylus down at %.1f steps, and learned a 12\" record edge of %u steps\n",
+    repeats.playLandingSteps, repeats.learnedEdgeSteps);
+
+  for(uint8_t i = 0; i < REPEATS; i++) {
+    printf("Repeat %u: %lums, set down at %.1f steps\n", i + 1, repeats.repeatMs[i], repeats.repeatLandingSteps[i]);
+
+    CHECK(repeats.repeatMs[i] > 0 && repeats.repeatMs[i] < homeAndPlayMs);
+    CHECK(fabs(repeats.repeatLandingSteps[i] - repeats.playLandingSteps) <= MAX_LANDING_DIFFERENCE_STEPS);
+  }
+
+  printf("Home then play: %lums + %lums = %lums, set down at %.1f steps\n", homeAndPlay.homeMs, homeAndPlay.playMs,
+    homeAndPlayMs, homeAndPlay.playLandingSteps);
+
+  // The tonearm never went further home than the play sensor, give or take the steps it took to stop.
+  printf("Closest the tonearm came to home: %.1f steps (the play sensor is at %d)\n", repeats.closestToHomeSteps,
+    TONEARM_MODEL_PLAY_SENSOR_STEPS);
+  CHECK(repeats.closestToHomeSteps >= TONEARM_MODEL_PLAY_SENSOR_STEPS - MAX_LANDING_DIFFERENCE_STEPS);
+
+  // The learned edge moved from the default towards where the play routine found it.
+  CHECK(repeats.learnedEdgeSteps > RECORD_EDGE_STEPS_12_INCH);
+
+  // A measurement inside the deadband left the calibration, and the EEPROM, alone.
+  printf("Home then play with the record edge where it is expected: %lu EEPROM writes\n", homeAndPlay.eepromWrites);
+  CHECK(homeAndPlay.learnedEdgeSteps == RECORD_EDGE_STEPS_12_INCH);
+  CHECK(homeAndPlay.eepromWrites == 0);
+
+  CHECK(repeats.anomalies == 0);
+  CHECK(homeAndPlay.anomalies == 0);
+
+  return TEST_RESULT();
+}
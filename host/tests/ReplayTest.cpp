@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "FrameCodec.h"
+#include "SensorTrace.h"
+#include "LeadOutReplay.h"
+#include "enums/SerialFrameType.h"
+
+static void sendCommand(uint8_t type) {
+  std::vector<uint8_t> frame = FrameCodec::encode(type, NULL, 0);
+  simulator.sendSerial(frame.data(), frame.size());
+}
+
+// The timestamp of the speed edge on which the replay detects the lead-out, found by replaying the trace up to each
+// speed edge in turn.
+static unsigned long findReplayDetection(SensorTrace& trace, const LeadOutConstants& constants, size_t& edgeIndex) {
+  SensorTrace partial;
+  partial.setLeadOutMicros(trace.getLeadOutMicros());
+
+  for(edgeIndex = 0; edgeIndex < trace.getEdges().size(); edgeIndex++) {
+    partial.addEdge(trace.getEdges()[edgeIndex]);
+
+    if(trace.getEdges()[edgeIndex].source == SENSOR_CAPTURE_SPEED_EDGE && LeadOutReplay::replay(partial, constants).detected) {
+      return trace.getEdges()[edgeIndex].timestampMicros;
+    }
+  }
+
+  return 0;
+}
+
+// Captures a side of a 12" record at 45 RPM from the sketch, with automatic return on, so the firmware detects the
+// lead-out itself and lifts the tonearm. Replaying the captured edges through LeadOutReplay with the same constants
+// detects it on the same revolution, and a trace survives being saved and loaded again. Constants below the groove
+// pitch of the lead-out spiral are caught false-triggering during the music.
+int main() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  SimulatedRecord record = TonearmModel::defaultRecord(RecordSize::TwelveInch);
+  tonearm.setRecord(record);
+
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, TurntableSpeed::Speed45 & 1);
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, TurntableSpeed::Speed45 >> 1);
+
+  simulator.setTimeLimit(1200);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(60, []() { return playRoutineMs > 0; }));
+  CHECK(tonearm.isStylusDown());
+
+  size_t from = simulator.getSerialOutput().size();
+  sendCommand(SerialFrameType::StartCapture);
+
+  // Play until the firmware sends the tonearm home.
+  SensorTrace trace;
+
+  CHECK(simulator.runUntil(1000, [&]() {
+    if(!trace.hasLeadOut() && tonearm.getArmSteps() - TONEARM_MODEL_PLAY_SENSOR_STEPS >= record.leadOutSteps) {
+      trace.setLeadOutMicros(simulator.getMicros());
+    }
+
+    return homeRoutineMs > 0;
+  }));
+
+  sendCommand(SerialFrameType::StopCapture);
+  simulator.runFor(0.5);
+
+  std::vector<uint8_t>& output = simulator.getSerialOutput();
+  FrameCodec codec;
+  SerialFrame frame;
+
+  for(size_t i = from; i < output.size(); i++) {
+    if(codec.decode(output[i], frame) && frame.type == SerialFrameType::CaptureEdges) trace.addCaptureFrame(frame.payload, frame.length);
+  }
+
+  unsigned long liftMicros = 0;
+  const std::vector<StylusEvent>& stylusEvents = tonearm.getStylusEvents();
+
+  for(size_t i = 0; i < stylusEvents.size(); i++) {
+    if(!stylusEvents[i].down) liftMicros = stylusEvents[i].ticks / (SIMULATED_TICKS_PER_SECOND / 1000000);
+  }
+
+  // The replay detects the lead-out on the last speed edge before the firmware lifted the tonearm.
+  LeadOutReplayResult result = LeadOutReplay::replay(trace, LeadOutReplay::defaultConstants());
+  size_t edgeIndex = 0;
+  unsigned long detectionMicros = findReplayDetection(trace, LeadOutReplay::defaultConstants(), edgeIndex);
+
+  printf("Captured %u edges over %lu revolutions; the replay detected the lead-out after %lu revolutions, %.1fms before the "
+    "firmware lifted the tonearm\n", (unsigned)trace.getEdges().size(), result.revolutions, result.latencyRevolutions,
+    ((long)liftMicros - (long)detectionMicros) / 1000.0);
+
+  CHECK(trace.getDroppedCount() == 0);
+  CHECK(result.detected);
+  CHECK(result.falseTriggers == 0);
+  CHECK(detectionMicros != 0 && detectionMicros <= liftMicros);
+
+  for(size_t i = edgeIndex + 1; i < trace.getEdges().size(); i++) {
+    if(trace.getEdges()[i].source == SENSOR_CAPTURE_SPEED_EDGE) {
+      CHECK(trace.getEdges()[i].timestampMicros > liftMicros);
+      break;
+    }
+  }
+
+  // The same trace, saved and loaded again.
+  char path[] = "/tmp/replay_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  if(fd >= 0) close(fd);
+
+  SensorTrace loaded;
+  CHECK(trace.save(path));
+  CHECK(loaded.load(path));
+  unlink(path);
+
+  CHECK(loaded.getEdges().size() == trace.getEdges().size());
+  CHECK(loaded.hasLeadOut() && loaded.getLeadOutMicros() == trace.getLeadOutMicros());
+
+  LeadOutReplayResult loadedResult = LeadOutReplay::replay(loaded, LeadOutReplay::defaultConstants());
+  CHECK(loadedResult.detected && loadedResult.latencyRevolutions == result.latencyRevolutions);
+
+  // A single count per revolution is reached whenever the groove of the music moves the tonearm over an encoder edge.
+  LeadOutConstants sensitive = LeadOutReplay::defaultConstants();
+  sensitive.leadOutCountsPerRevolution = 1;
+  sensitive.consecutiveRevolutions = 1;
+
+  LeadOutReplayResult sensitiveResult = LeadOutReplay::replay(trace, sensitive);
+  printf("With 1 count in 1 revolution: %lu false triggers, the first at %.1fs\n", sensitiveResult.falseTriggers,
+    sensitiveResult.firstFalseTriggerSeconds);
+
+  CHECK(sensitiveResult.falseTriggers > 0);
+
+  return TEST_RESULT();
+}
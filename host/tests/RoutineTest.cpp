@@ -0,0 +1,193 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+#include "enums/ArduinoPin.h"
+
+// When the pause button is pressed while the play routine waits for the platter, in seconds from the start of the
+// routine: long after the tonearm is over the lead-in, and long before the platter is stable.
+#define CANCEL_PRESS_SECONDS 5.0
+
+// The longest a cancelled routine may take to return after the press, in seconds.
+#define MAX_CANCEL_SECONDS 0.5
+
+// The play routine as it used to run, one movement after the other, with each stage depending on the one before it.
+static const RoutineStage sequentialPlayStages[] = {
+  /* 0 */ { RoutineStageAction::MoveDown, MOVEMENT_RPM_DEFAULT, 0, 0, NULL, NULL },
+  /* 1 */ { RoutineStageAction::EngageClutch, 0, 0, ROUTINE_STAGE(0), NULL, NULL },
+  /* 2 */ { RoutineStageAction::SeekRecordEdge, 0, 0, ROUTINE_STAGE(1), NULL, NULL },
+  /* 3 */ { RoutineStageAction::MoveUp, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(2), NULL, NULL },
+  /* 4 */ { RoutineStageAction::MoveToLeadIn, 0, 0, ROUTINE_STAGE(3), NULL, NULL },
+  /* 5 */ { RoutineStageAction::WaitUntil, 0, 0, ROUTINE_STAGE(4), NULL, isPlatterReadyForSetDown },
+  /* 6 */ { RoutineStageAction::DisengageClutch, 0, 0, ROUTINE_STAGE(5), NULL, NULL },
+  /* 7 */ { RoutineStageAction::MoveDownCarefully, MOVEMENT_RPM_DEFAULT, MOVEMENT_RPM_CAREFUL, ROUTINE_STAGE(6), NULL, NULL }
+};
+
+// The homing routine as it used to run: lift, then clutch, then traverse, then lower.
+static const RoutineStage sequentialHomeStages[] = {
+  /* 0 */ { RoutineStageAction::MoveUp, MOVEMENT_RPM_DEFAULT, 0, 0, NULL, NULL },
+  /* 1 */ { RoutineStageAction::EngageClutch, 0, 0, ROUTINE_STAGE(0), NULL, NULL },
+  /* 2 */ { RoutineStageAction::HorizontalHome, 0, 0, ROUTINE_STAGE(1), NULL, NULL },
+  /* 3 */ { RoutineStageAction::Call, 0, 0, ROUTINE_STAGE(2), stopTurntableMotor, NULL },
+  /* 4 */ { RoutineStageAction::DisengageClutch, 0, 0, ROUTINE_STAGE(3), NULL, NULL },
+  /* 5 */ { RoutineStageAction::MoveDown, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(4), NULL, NULL }
+};
+
+// A routine that can't finish: once the clutch is engaged, the lift waits on the lowering, and the lowering on the lift.
+static const RoutineStage deadlockedStages[] = {
+  /* 0 */ { RoutineStageAction::EngageClutch, 0, 0, 0, NULL, NULL },
+  /* 1 */ { RoutineStageAction::MoveUp, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(0) | ROUTINE_STAGE(2), NULL, NULL },
+  /* 2 */ { RoutineStageAction::MoveDown, MOVEMENT_RPM_DEFAULT, 0, ROUTINE_STAGE(1), NULL, NULL }
+};
+
+// How long after a routine stalls the Play/Home button is pressed to leave the error state, in seconds.
+#define ERROR_STATE_SECONDS 1.0
+
+// What a play and home cycle took, and where it left the tonearm.
+struct CycleResult {
+    unsigned long playMs;
+    unsigned long homeMs;
+    double leadInArmSteps;
+    bool stylusDownAfterPlay;
+    bool homeAfterHome;
+    unsigned long anomalies;
+};
+
+static void startPowerOn() {
+  simulator.getTonearm().setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+}
+
+static void finishCycle(CycleResult& result) {
+  TonearmModel& tonearm = simulator.getTonearm();
+
+  result.homeAfterHome = tonearm.getArmSteps() == 0 && tonearm.isLowerLimitReached() && !tonearm.isClutchEngaged();
+  result.anomalies = tonearm.getAnomalies().size();
+}
+
+// The sketch's own routines, which overlap the clutch with the lift.
+static CycleResult runPipelined() {
+  CycleResult result = CycleResult();
+  TonearmModel& tonearm = simulator.getTonearm();
+  startPowerOn();
+
+  CHECK(playRoutine() == MovementResult::Success);
+  result.playMs = playRoutineMs;
+  result.leadInArmSteps = tonearm.getArmSteps();
+  result.stylusDownAfterPlay = tonearm.isStylusDown() && !tonearm.isClutchEngaged();
+
+  CHECK(homeRoutine() == MovementResult::Success);
+  result.homeMs = homeRoutineMs;
+
+  finishCycle(result);
+  return result;
+}
+
+// The same movements, one at a time, through the same executor.
+static CycleResult runSequential() {
+  CycleResult result = CycleResult();
+  TonearmModel& tonearm = simulator.getTonearm();
+  startPowerOn();
+
+  startTurntableMotor();
+  CHECK(routineExecutor.run(sequentialPlayStages, sizeof(sequentialPlayStages) / sizeof(sequentialPlayStages[0])) == MovementResult::Success);
+  result.playMs = routineExecutor.getLastRunMs();
+  result.leadInArmSteps = tonearm.getArmSteps();
+  result.stylusDownAfterPlay = tonearm.isStylusDown() && !tonearm.isClutchEngaged();
+
+  CHECK(routineExecutor.run(sequentialHomeStages, sizeof(sequentialHomeStages) / sizeof(sequentialHomeStages[0])) == MovementResult::Success);
+  result.homeMs = routineExecutor.getLastRunMs();
+
+  finishCycle(result);
+  return result;
+}
+
+// Waits for a platter that is slow to come up to speed, and presses pause while the play routine waits on it with the
+// tonearm hovering over the lead-in: the routine stops right away, even though nothing is moving.
+static bool runCancelWhileWaiting() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  simulator.setMuxInput(MultiplexerInput::WaitUntilTargetSpeed, true);
+  simulator.getPlatter().setTimeConstants(5, 20);
+  startPowerOn();
+
+  unsigned long long pressTicks = simulator.getTicks() + CANCEL_PRESS_SECONDS * SIMULATED_TICKS_PER_SECOND;
+  simulator.schedule(pressTicks, []() { simulator.pressButton(MultiplexerInput::PauseButton); });
+
+  MovementResult result = playRoutine();
+  double cancelSeconds = (double)(simulator.getTicks() - pressTicks) / SIMULATED_TICKS_PER_SECOND;
+
+  printf("Pause while waiting for the platter: result %d, %.3fs after the press\n", result, cancelSeconds);
+
+  CHECK(result == MovementResult::Cancelled);
+  CHECK(cancelSeconds >= 0 && cancelSeconds <= MAX_CANCEL_SECONDS);
+  CHECK(!speedRegulator.isStable());
+
+  // The tonearm is left hovering over the lead-in, free to be moved by hand.
+  CHECK(!tonearm.isStylusDown());
+  CHECK(!tonearm.isLowerLimitReached());
+  CHECK(tonearm.isPastPlaySensor());
+  CHECK(!tonearm.isClutchEngaged());
+
+  return true;
+}
+
+// Runs a routine whose stages depend on each other: it stops with an error as soon as it is stuck, rather than returning
+// as if it had finished, frees the clutch, and the sketch goes into its error state for it.
+static bool runDeadlocked() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  startPowerOn();
+
+  MovementResult result = routineExecutor.run(deadlockedStages, sizeof(deadlockedStages) / sizeof(deadlockedStages[0]));
+
+  printf("Deadlocked routine: result %d after %lums\n", result, routineExecutor.getLastRunMs());
+
+  CHECK(result == MovementResult::RoutineStalledError);
+  CHECK(!tonearm.isClutchEngaged());
+  CHECK(tonearm.isLowerLimitReached());
+
+  // The error state lights both status LEDs until a button is pressed.
+  simulator.schedule(simulator.getTicks() + ERROR_STATE_SECONDS * SIMULATED_TICKS_PER_SECOND,
+    []() { simulator.pressButton(MultiplexerInput::PlayHomeButton); });
+
+  bool pauseLedLit = false;
+  size_t firstEdge = simulator.getOutputEdges().size();
+  finishCommand(result);
+
+  std::vector<OutputEdge>& edges = simulator.getOutputEdges();
+  for(size_t i = firstEdge; i < edges.size(); i++) {
+    if(edges[i].pin == ArduinoPin::PauseStatusLed && edges[i].value) pauseLedLit = true;
+  }
+
+  CHECK(pauseLedLit);
+
+  return true;
+}
+
+// Runs a play and home cycle with the sketch's routines, and with the same stages run one after the other, each from
+// its own power-on. Prints each routine's wall time, and checks that overlapping the clutch with the lift saves time
+// without changing where the tonearm ends up.
+int main() {
+  CycleResult pipelined = runPowerOn<CycleResult>(runPipelined);
+  CycleResult sequential = runPowerOn<CycleResult>(runSequential);
+
+  printf("Routines   | play     | home     | cycle\n");
+  printf("Sequential | %6.2fs | %6.2fs | %6.2fs\n", sequential.playMs / 1000.0, sequential.homeMs / 1000.0,
+    (sequential.playMs + sequential.homeMs) / 1000.0);
+  printf("Pipelined  | %6.2fs | %6.2fs | %6.2fs\n", pipelined.playMs / 1000.0, pipelined.homeMs / 1000.0,
+    (pipelined.playMs + pipelined.homeMs) / 1000.0);
+
+  CHECK(pipelined.playMs < sequential.playMs);
+  CHECK(pipelined.homeMs < sequential.homeMs);
+
+  CHECK(pipelined.stylusDownAfterPlay && sequential.stylusDownAfterPlay);
+  CHECK_NEAR(pipelined.leadInArmSteps, sequential.leadInArmSteps, TONEARM_MODEL_STEPS_PER_ENCODER_COUNT);
+  CHECK(pipelined.homeAfterHome && sequential.homeAfterHome);
+  CHECK(pipelined.anomalies == 0 && sequential.anomalies == 0);
+
+  CHECK(runPowerOn<bool>(runCancelWhileWaiting));
+  CHECK(runPowerOn<bool>(runDeadlocked));
+
+  return TEST_RESULT();
+}
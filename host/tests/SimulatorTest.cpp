@@ -0,0 +1,49 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "enums/ArduinoPin.h"
+
+// Powers the simulated turntable on with a 12" record on the platter, plays it from the Play/Home button, and sends the
+// tonearm home again. Everything the firmware does goes through the simulated HAL, so this is the whole firmware
+// running against the models.
+int main() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+
+  // With the tonearm at rest at home, setup() only moves the clutch.
+  CHECK(tonearm.getLiftSteps() == 0);
+  CHECK(tonearm.getArmSteps() == 0);
+  CHECK(!tonearm.isClutchEngaged());
+
+  simulator.runFor(0.5);
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(40, []() { return playRoutineMs > 0; }));
+
+  // The stylus is set down just inside the record edge, over the lead-in groove.
+  CHECK(tonearm.isStylusDown());
+  CHECK(tonearm.getArmSteps() > tonearm.getRecordEdgeArmSteps());
+  CHECK(tonearm.getArmSteps() < tonearm.getRecordEdgeArmSteps() + 60);
+  CHECK(!tonearm.isClutchEngaged());
+  CHECK(recordSize == RecordSize::TwelveInch);
+  CHECK(simulator.getPlatter().getRpm() > simulator.getPlatter().getNominalRpm() / 2);
+
+  printf("Play routine: %lums, stylus down at %.1f steps (record edge at %.1f)\n", playRoutineMs, tonearm.getArmSteps(), tonearm.getRecordEdgeArmSteps());
+
+  simulator.runFor(5);
+  CHECK(tonearm.isStylusDown());
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(simulator.getSeconds() + 30, []() { return homeRoutineMs > 0; }));
+
+  CHECK(!tonearm.isStylusDown());
+  CHECK(!tonearm.isPastPlaySensor());
+  CHECK(tonearm.isLowerLimitReached());
+  CHECK(!speedRegulator.isRunning());
+
+  printf("Home routine: %lums\n", homeRoutineMs);
+
+  return TEST_RESULT();
+}
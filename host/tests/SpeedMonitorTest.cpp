@@ -0,0 +1,137 @@
+#include <vector>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "TurntableHal.h"
+#include "TurntableSpeedMonitor.h"
+#include "proto/Constants.h"
+
+// Measures the simulated platter at 16 2/3 RPM, the slowest speed, through the speed capture interrupt, and then feeds
+// a TurntableSpeedMonitor pulses with known periods to check its statistics, dropped pulses, and the stopped timeout.
+
+static TurntableSpeedMonitor platterMonitor;
+static TurntableSpeedMonitor monitor;
+
+// Each captured timestamp, and the tick of the edge that the platter model actually made.
+static std::vector<unsigned long> capturedMicros;
+static std::vector<unsigned long long> edgeTicks;
+
+static void capturePulse(unsigned long timestampMicros) {
+  platterMonitor.recordPulse(timestampMicros);
+  capturedMicros.push_back(timestampMicros);
+  edgeTicks.push_back(simulator.getSpeedEdgeTicks());
+}
+
+// Run the main loop's side of the monitors for the given number of milliseconds.
+static void runMonitors(unsigned long ms) {
+  for(unsigned long i = 0; i < ms; i++) {
+    TurntableHal::waitMs(1);
+    platterMonitor.update();
+    monitor.update();
+  }
+}
+
+// Record a pulse the given number of microseconds after the last one, once that time comes.
+static unsigned long lastPulseMicros = 0;
+
+static void feedPulse(unsigned long periodMicros) {
+  lastPulseMicros += periodMicros;
+
+  while(TurntableHal::currentMicros() < lastPulseMicros) runMonitors(1);
+
+  monitor.recordPulse(lastPulseMicros);
+  monitor.update();
+}
+
+int main() {
+  simulator.setTimeLimit(600);
+
+  TurntableHal::begin();
+  platterMonitor.setStoppedTimeoutMs(TURNTABLE_STOPPED_MS);
+  monitor.setStoppedTimeoutMs(TURNTABLE_STOPPED_MS);
+
+  // Spin the platter at 16 2/3 RPM, at the duty that holds the nominal speed, and let it settle.
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, true);
+  TurntableHal::beginSpeedCapture(capturePulse);
+  TurntableHal::setTurntableMotorTrim(SPEED_REGULATOR_BASE_OUTPUT);
+  TurntableHal::setTurntableMotorEnabled(true);
+
+  runMonitors(30000);
+  CHECK(!platterMonitor.isStopped());
+
+  // From here on, the monitor must never decide that the platter has stopped, even though a revolution takes longer
+  // than it would at any other speed.
+  unsigned long revolutions = platterMonitor.getRevolutionCount();
+
+  for(uint8_t i = 0; i < 40; i++) {
+    runMonitors(1000);
+    CHECK(!platterMonitor.isStopped());
+  }
+
+  CHECK(platterMonitor.getRevolutionCount() > revolutions);
+  CHECK_NEAR(platterMonitor.getCurrentCentiRpm(), 1667, 1);
+  CHECK_NEAR(platterMonitor.getMeanCentiRpm(), 1667, 1);
+  CHECK_NEAR(platterMonitor.getMedianCentiRpm(), 1667, 1);
+  CHECK(platterMonitor.getWowAndFlutterBasisPoints() <= 1);
+
+  // Every timestamp is within a microsecond of the edge it was captured from, however long the main loop took to
+  // get to it.
+  double worstErrorMicros = 0;
+
+  for(size_t i = 0; i < capturedMicros.size(); i++) {
+    double error = fabs((double)capturedMicros[i] - (double)edgeTicks[i] / SIMULATED_TICKS_PER_MICROSECOND);
+    if(error > worstErrorMicros) worstErrorMicros = error;
+  }
+
+  printf("%u revolutions at 16 2/3 RPM captured, worst timestamp error %.3fus\n", (unsigned)capturedMicros.size(), worstErrorMicros);
+  CHECK(capturedMicros.size() >= 8);
+  CHECK(worstErrorMicros <= 1);
+
+  // The statistics of a platter with 0.5% of wow: the periods alternate between 0.5% long and 0.5% short.
+  TurntableHal::setTurntableMotorEnabled(false);
+  lastPulseMicros = TurntableHal::currentMicros();
+  monitor.recordPulse(lastPulseMicros);
+
+  for(uint8_t i = 0; i < SPEED_STATISTICS_WINDOW; i++) feedPulse(i % 2 == 0 ? 1809000 : 1791000);
+
+  CHECK(monitor.getRevolutionCount() == SPEED_STATISTICS_WINDOW);
+  CHECK(monitor.getMeanPeriodMicros() == 1800000);
+  CHECK_NEAR(monitor.getMeanCentiRpm(), 3333, 1);
+  CHECK_NEAR(monitor.getMinCentiRpm(), 3317, 1);
+  CHECK_NEAR(monitor.getMaxCentiRpm(), 3350, 1);
+  CHECK_NEAR(monitor.getMedianCentiRpm(), 3333, 1);
+  CHECK_NEAR(monitor.getWowAndFlutterBasisPoints(), 50, 1);
+
+  // If the main loop falls so far behind that pulses are dropped, the period across them is never counted as a
+  // revolution, whether the dropped pulse is the last one before update() or not.
+  unsigned long revolutionCount = monitor.getRevolutionCount();
+  TurntableHal::waitMs((SPEED_PULSE_BUFFER_SIZE + 2) * 1800UL);
+
+  for(uint8_t i = 0; i < SPEED_PULSE_BUFFER_SIZE + 2; i++) {
+    lastPulseMicros += 1800000;
+    monitor.recordPulse(lastPulseMicros);
+  }
+
+  monitor.update();
+  CHECK(monitor.getRevolutionCount() == revolutionCount + SPEED_PULSE_BUFFER_SIZE - 1);
+
+  // The pulses after the dropped ones are a revolution apart again, but the first of them is two revolutions after
+  // the last one that was kept.
+  lastPulseMicros += 1800000;
+  monitor.recordPulse(lastPulseMicros);
+  monitor.update();
+
+  for(uint8_t i = 0; i < 3; i++) feedPulse(1800000);
+
+  CHECK_NEAR(monitor.getMinCentiRpm(), 3333, 1);
+  CHECK_NEAR(monitor.getMaxCentiRpm(), 3333, 1);
+
+  // Once the sensor has been quiet for longer than the slowest revolution, the platter has stopped.
+  runMonitors(TURNTABLE_SLOWEST_REVOLUTION_MS);
+  CHECK(!monitor.isStopped());
+
+  runMonitors(TURNTABLE_STOPPED_MS - TURNTABLE_SLOWEST_REVOLUTION_MS + 10);
+  CHECK(monitor.isStopped());
+  CHECK(monitor.getCurrentCentiRpm() == 0);
+
+  return TEST_RESULT();
+}
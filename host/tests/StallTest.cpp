@@ -0,0 +1,103 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "proto/Constants.h"
+
+// The most steps the horizontal motor may take against whatever the tonearm bumped into before the stall is caught:
+// the stall steps, counted from the last encoder change, which can be up to a count before the bump.
+#define MAX_BLOCKED_STEPS (HORIZONTAL_STALL_STEPS + TONEARM_MODEL_STEPS_PER_ENCODER_COUNT)
+
+// A horizontal movement of the sketch's tonearm controller, and what it cost.
+struct HorizontalMove {
+    MovementResult result;
+    unsigned long blockedSteps;
+    double seconds;
+};
+
+static HorizontalMove runMove(MovementResult (TurntableTonearmController::*move)()) {
+  TonearmModel& tonearm = simulator.getTonearm();
+  unsigned long blockedSteps = tonearm.getBlockedStepCount(MotorAxis::Horizontal);
+  unsigned long long startTicks = simulator.getTicks();
+
+  HorizontalMove result;
+  result.result = (tonearmController.*move)();
+  result.blockedSteps = tonearm.getBlockedStepCount(MotorAxis::Horizontal) - blockedSteps;
+  result.seconds = (double)(simulator.getTicks() - startTicks) / SIMULATED_TICKS_PER_SECOND;
+
+  return result;
+}
+
+static void printMove(const char* name, HorizontalMove& move) {
+  printf("%-36s result %d, %.2fs, %lu steps against the stop\n", name, move.result, move.seconds, move.blockedSteps);
+}
+
+// Drives the sketch's tonearm controller straight from the test, once setup() has homed it: the record edge and the
+// home mount are found by the encoder stalling, at the top motor speed, within a few steps of the bump. A bump into
+// anything but the home mount is an error, caught just as quickly, rather than after the horizontal timeout.
+int main() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(120);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  CHECK(tonearm.getArmSteps() == 0);
+  CHECK(tonearm.isLowerLimitReached());
+
+  // From home, lowered, the tonearm traverses to the record edge and stops against it. The steps from the play sensor
+  // to the edge are measured on the way.
+  HorizontalMove seek = runMove(&TurntableTonearmController::seekRecordEdge);
+  printMove("Seek the 12\" record edge:", seek);
+
+  CHECK(seek.result == MovementResult::Success);
+  CHECK(seek.blockedSteps > 0 && seek.blockedSteps <= MAX_BLOCKED_STEPS);
+  CHECK_NEAR(tonearm.getArmSteps(), tonearm.getRecordEdgeArmSteps(), 0.01);
+  CHECK_NEAR(tonearmController.getMeasuredRecordEdgeSteps(), tonearm.getRecord().edgeSteps, TONEARM_MODEL_STEPS_PER_ENCODER_COUNT);
+  CHECK(!tonearm.isClutchEngaged());
+
+  // Raised, it goes home and stops against the home mount, which zeroes the encoder.
+  CHECK(tonearmController.moveUp(MOVEMENT_RPM_DEFAULT) == MovementResult::Success);
+
+  HorizontalMove home = runMove(&TurntableTonearmController::horizontalHome);
+  printMove("Home from the record edge:", home);
+
+  CHECK(home.result == MovementResult::Success);
+  CHECK(home.blockedSteps > 0 && home.blockedSteps <= MAX_BLOCKED_STEPS);
+  CHECK(tonearm.getArmSteps() == 0);
+  CHECK(pickupEncoder.getPosition() == 0);
+
+  // Something in the way between the record and the home mount: the bump isn't the home mount, so it is an error.
+  tonearm.setArmSteps(600);
+  tonearm.setObstructionSteps(300);
+
+  HorizontalMove blocked = runMove(&TurntableTonearmController::horizontalHome);
+  printMove("Home into an obstruction:", blocked);
+
+  CHECK(blocked.result == MovementResult::HorizontalCounterclockwiseDirectionError);
+  CHECK(blocked.blockedSteps > 0 && blocked.blockedSteps <= MAX_BLOCKED_STEPS);
+  CHECK_NEAR(tonearm.getArmSteps(), 300, 0.01);
+
+  tonearm.setObstructionSteps(-1);
+  home = runMove(&TurntableTonearmController::horizontalHome);
+  CHECK(home.result == MovementResult::Success);
+
+  // Without a record, the seek ends against the inner hard stop instead, just as quickly.
+  CHECK(tonearmController.moveDown(MOVEMENT_RPM_DEFAULT) == MovementResult::Success);
+
+  SimulatedRecord noRecord = tonearm.getRecord();
+  noRecord.present = false;
+  tonearm.setRecord(noRecord);
+
+  HorizontalMove empty = runMove(&TurntableTonearmController::seekRecordEdge);
+  printMove("Seek with no record on the platter:", empty);
+
+  CHECK(empty.result == MovementResult::Success);
+  CHECK(empty.blockedSteps > 0 && empty.blockedSteps <= MAX_BLOCKED_STEPS);
+  CHECK_NEAR(tonearm.getArmSteps(), TONEARM_MODEL_INNER_STOP_STEPS, 0.01);
+
+  // None of it at the top motor speed lost a step.
+  CHECK(tonearm.getAnomalies().empty());
+
+  return TEST_RESULT();
+}
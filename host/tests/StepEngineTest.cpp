@@ -0,0 +1,135 @@
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "StepEngine.h"
+#include "proto/Constants.h"
+#include "enums/MultiplexerInput.h"
+#include "enums/VerticalMovementDirection.h"
+
+// Drives a StepEngine of its own against the simulated tonearm, without the sketch: movements are queued and return
+// right away, run to completion from the step timer, chain in order, and can be cancelled.
+
+static StepEngine engine = StepEngine(STEPS_PER_REVOLUTION);
+
+// A blind movement of the lift at the default speed.
+static StepCommand liftCommand(int8_t direction, uint16_t steps) {
+  StepCommand command;
+  command.axis = MotorAxis::Vertical;
+  command.direction = direction;
+  command.steps = steps;
+  command.stepIntervalTicks = engine.rpmToStepInterval(MOVEMENT_RPM_DEFAULT);
+  command.sequence = StepSequence::FullStep;
+  command.profile = MotionProfile::Constant;
+  command.accelerationSteps = 0;
+  command.decelerationSteps = 0;
+  command.stopInput = STEP_COMMAND_NO_STOP_INPUT;
+  command.stopLevel = HIGH;
+  command.timeoutResult = MovementResult::Success;
+  command.stallSteps = 0;
+  command.stallResult = MovementResult::Success;
+  command.dwellMs = 0;
+  command.overlapSteps = STEP_COMMAND_NO_OVERLAP;
+  command.unmuteStep = STEP_COMMAND_NO_UNMUTE;
+  command.unmuteLagMs = 0;
+
+  return command;
+}
+
+// Poll the engine the way the main loop does, until the movement has finished.
+static MovementResult waitForEngine() {
+  MovementResult result;
+
+  while((result = engine.poll()) == MovementResult::None) TurntableHal::waitMicros(100);
+
+  return result;
+}
+
+static void waitUntilTicks(unsigned long long ticks) {
+  while(simulator.getTicks() < ticks) TurntableHal::waitMicros(1);
+}
+
+int main() {
+  TonearmModel& tonearm = simulator.getTonearm();
+  simulator.setTimeLimit(60);
+
+  TurntableHal::begin();
+  TurntableHal::setTonearmStepSequence(StepSequence::FullStep);
+
+  uint16_t interval = engine.rpmToStepInterval(MOVEMENT_RPM_DEFAULT);
+
+  // Queueing a movement returns straight away, and the movement runs from the step timer.
+  long startPosition = tonearm.getMotorPosition(MotorAxis::Vertical);
+  unsigned long long startTicks = simulator.getTicks();
+
+  CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Up, 100)));
+  CHECK(simulator.getTicks() - startTicks < 100 * SIMULATED_TICKS_PER_MICROSECOND);
+  CHECK(engine.isBusy());
+  CHECK(engine.poll() == MovementResult::None);
+
+  CHECK(waitForEngine() == MovementResult::Success);
+  CHECK(!engine.isBusy());
+  CHECK(engine.getStepsTaken() == 100);
+  CHECK(labs(tonearm.getMotorPosition(MotorAxis::Vertical) - startPosition) == 200);
+  CHECK_NEAR(tonearm.getLiftSteps(), 100, 0.01);
+
+  // The last step lands 100 intervals after the movement was queued.
+  unsigned long long lastStepTicks = tonearm.getSteps().back().ticks;
+  CHECK_NEAR((double)(lastStepTicks - startTicks), 100.0 * (interval + 1), interval / 2);
+
+  // Movements queued behind one another run in order, with nothing in between.
+  tonearm.clearLogs();
+  CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Up, 50)));
+  CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Down, 120)));
+  CHECK(waitForEngine() == MovementResult::Success);
+  CHECK(engine.getStepsTaken() == 120);
+  CHECK_NEAR(tonearm.getLiftSteps(), 30, 0.01);
+  CHECK(tonearm.getSteps().size() == 170);
+
+  // The queue holds STEP_ENGINE_QUEUE_SIZE movements behind the one that is running, and a cancel discards all of them.
+  CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Up, 200)));
+
+  for(uint8_t i = 0; i < STEP_ENGINE_QUEUE_SIZE; i++) CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Up, 10)));
+
+  CHECK(!engine.queueMove(liftCommand(VerticalMovementDirection::Up, 10)));
+
+  TurntableHal::waitMs(100);
+  engine.cancel();
+  CHECK(!engine.isBusy());
+  CHECK(engine.poll() == MovementResult::Cancelled);
+  CHECK(engine.getStepsTaken() > 0 && engine.getStepsTaken() < 200);
+
+  double cancelledLiftSteps = tonearm.getLiftSteps();
+  TurntableHal::waitMs(500);
+  CHECK(tonearm.getLiftSteps() == cancelledLiftSteps);
+
+  // A movement with a stop input ends as soon as the main loop sees it, however many steps it had left.
+  StepCommand lower = liftCommand(VerticalMovementDirection::Down, 1000);
+  lower.stopInput = MultiplexerInput::VerticalLowerLimit;
+  lower.stopLevel = HIGH;
+  lower.timeoutResult = MovementResult::VerticalNegativeDirectionError;
+
+  CHECK(engine.queueMove(lower));
+  CHECK(waitForEngine() == MovementResult::Success);
+  CHECK(tonearm.isLowerLimitReached());
+  CHECK(engine.getStepsTaken() < 200);
+
+  // A movement queued just as the one before it finishes from the interrupt must still run, wherever in the last
+  // step interval it is queued.
+  for(uint16_t offset = 0; offset < interval * 2; offset += interval / 16) {
+    double liftSteps = tonearm.getLiftSteps();
+
+    CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Up, 2)));
+    waitUntilTicks(simulator.getTicks() + interval + offset);
+
+    CHECK(engine.queueMove(liftCommand(VerticalMovementDirection::Down, 1)));
+    CHECK(waitForEngine() == MovementResult::Success);
+    CHECK(engine.getStepsTaken() == 1);
+
+    TurntableHal::waitMs(10);
+    CHECK(!engine.isBusy());
+    CHECK_NEAR(tonearm.getLiftSteps(), liftSteps + 1, 0.01);
+  }
+
+  CHECK(tonearm.getAnomalies().empty());
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,152 @@
+#include <time.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "StepperCoilDriver.h"
+#include "enums/ArduinoPin.h"
+
+// How many steps each way of stepping is timed over, and how many times, keeping the fastest.
+#define BENCHMARK_STEPS 2000000
+#define BENCHMARK_RUNS 5
+
+// The coil pins in the order the sketch gives them to the driver: coil A first.
+static const uint8_t coilPins[4] = { ArduinoPin::StepperPin4, ArduinoPin::StepperPin3, ArduinoPin::StepperPin2, ArduinoPin::StepperPin1 };
+
+static StepperCoilDriver driver = StepperCoilDriver(coilPins[0], coilPins[1], coilPins[2], coilPins[3]);
+
+// The coil pattern on the pins, with coil A as bit 0.
+static uint8_t readCoils() {
+  uint8_t pattern = 0;
+  for(uint8_t coil = 0; coil < 4; coil++) pattern |= simulator.getOutput(coilPins[coil]) << coil;
+
+  return pattern;
+}
+
+// A step, applied to the emulated ports the way the chip applies writes to VPORT IN. Only the last write to each IN
+// register is applied, so a step that took more than one store on a port would leave the wrong pattern.
+static uint8_t step(int8_t direction) {
+  simulator.beginPortToggles();
+  driver.step(direction);
+  simulator.endPortToggles();
+
+  return readCoils();
+}
+
+static uint8_t release() {
+  simulator.beginPortToggles();
+  driver.release();
+  simulator.endPortToggles();
+
+  return readCoils();
+}
+
+// Steps the driver forwards through a whole cycle of the sequence and back again, checking every pattern.
+static void checkSequence(StepSequence sequence, const uint8_t* patterns, uint8_t count) {
+  driver.setSequence(sequence);
+
+  for(uint8_t i = 1; i <= count * 2; i++) CHECK(step(1) == patterns[i % count]);
+  for(int8_t i = count * 2 - 1; i >= 0; i--) CHECK(step(-1) == patterns[i % count]);
+}
+
+// The Stepper library's way of changing the coils: a digitalWrite() of each pin, each looking up its port and bit and
+// changing the output with a read-modify-write (without the interrupt guard, to be fair to it).
+static void legacyDigitalWrite(uint8_t pin, uint8_t value) {
+  VPORT_t& port = (&VPORTA)[digitalPinToPort(pin)];
+
+  if(value) port.OUT |= digitalPinToBitMask(pin);
+  else port.OUT &= ~digitalPinToBitMask(pin);
+}
+
+static void legacyStep(uint8_t pattern) {
+  for(uint8_t coil = 0; coil < 4; coil++) legacyDigitalWrite(coilPins[coil], (pattern >> coil) & 1);
+}
+
+static double nanosecondsSince(const struct timespec& start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start.tv_sec) * 1e9 + (now.tv_nsec - start.tv_nsec);
+}
+
+// Drives a StepperCoilDriver of its own on the stepper pins of the emulated ports: the full-step, half-step and
+// wave-drive sequences come out in order both ways, each motor carries on from its own place in the sequence, a
+// release keeps it, and the other pins on the coil ports are left alone. Then times a step against the four
+// digitalWrite() calls of the Stepper library it replaced.
+int main() {
+  static const uint8_t fullSteps[4] = { 0b0011, 0b0110, 0b1100, 0b1001 };
+  static const uint8_t halfSteps[8] = { 0b0011, 0b0010, 0b0110, 0b0100, 0b1100, 0b1000, 0b1001, 0b0001 };
+  static const uint8_t waveSteps[4] = { 0b0010, 0b0100, 0b1000, 0b0001 };
+
+  // Every other output on the coil ports is set, and must stay set.
+  uint8_t otherBits[6] = { 0, 0, 0, 0, 0, 0 };
+
+  for(uint8_t coil = 0; coil < 4; coil++) otherBits[digitalPinToPort(coilPins[coil])] = 0xFF;
+  for(uint8_t coil = 0; coil < 4; coil++) otherBits[digitalPinToPort(coilPins[coil])] &= ~digitalPinToBitMask(coilPins[coil]);
+  for(uint8_t port = 0; port < 6; port++) simulatedVports[port].OUT = 0;
+
+  driver.begin();
+  CHECK(readCoils() == 0);
+
+  for(uint8_t port = 0; port < 6; port++) simulatedVports[port].OUT |= otherBits[port];
+
+  // Each sequence from the first full step.
+  driver.selectAxis(MotorAxis::Vertical);
+  checkSequence(StepSequence::FullStep, fullSteps, 4);
+  checkSequence(StepSequence::HalfStep, halfSteps, 8);
+
+  // Wave drive uses the odd phases, so from a full step it takes a half step onto one first.
+  driver.setSequence(StepSequence::WaveDrive);
+  CHECK(step(1) == 0b0010);
+  CHECK(step(-1) == 0b0001);
+  CHECK(step(1) == 0b0010);
+  checkSequence(StepSequence::WaveDrive, waveSteps, 4);
+
+  // And from a wave-drive phase, a full step takes a half step back onto the full steps.
+  driver.setSequence(StepSequence::FullStep);
+  CHECK(step(1) == 0b0110);
+
+  // Each motor carries on from where it was left, and a release doesn't lose it.
+  driver.setSequence(StepSequence::HalfStep);
+  driver.selectAxis(MotorAxis::Horizontal);
+  CHECK(release() == 0);
+  CHECK(step(1) == 0b0010);
+  CHECK(step(1) == 0b0110);
+
+  driver.selectAxis(MotorAxis::Vertical);
+  CHECK(release() == 0);
+  CHECK(step(1) == 0b0100);
+
+  driver.selectAxis(MotorAxis::Horizontal);
+  CHECK(step(-1) == 0b0010);
+
+  for(uint8_t port = 0; port < 6; port++) CHECK((simulatedVports[port].OUT & otherBits[port]) == otherBits[port]);
+
+  // The time of a step, against four digitalWrite() calls. These are host times, not AVR cycles, but the difference in
+  // work per step is the same: a table lookup and one store per port, against a lookup and a read-modify-write per pin.
+  driver.setSequence(StepSequence::HalfStep);
+  double driverNs = 1e12;
+  double legacyNs = 1e12;
+
+  for(uint8_t run = 0; run < BENCHMARK_RUNS; run++) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(unsigned long i = 0; i < BENCHMARK_STEPS; i++) driver.step(1);
+
+    double ns = nanosecondsSince(start) / BENCHMARK_STEPS;
+    if(ns < driverNs) driverNs = ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(unsigned long i = 0; i < BENCHMARK_STEPS; i++) legacyStep(halfSteps[i & 7]);
+
+    ns = nanosecondsSince(start) / BENCHMARK_STEPS;
+    if(ns < legacyNs) legacyNs = ns;
+  }
+
+  printf("StepperCoilDriver: %.2fns per step; four digitalWrite() calls: %.2fns per step (%.1fx)\n", driverNs, legacyNs,
+    legacyNs / driverNs);
+
+  CHECK(driverNs < legacyNs);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include "HostTest.h"
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "FrameCodec.h"
+#include "TraceDecoder.h"
+#include "enums/SerialFrameType.h"
+#include "enums/TraceEventType.h"
+#include "proto/Constants.h"
+
+// How long the trace takes to be sent, in seconds. 64 events in 32 frames is well under 1000 bytes.
+#define TRACE_DUMP_SECONDS 0.5
+
+static void requestTrace() {
+  std::vector<uint8_t> request = FrameCodec::encode(SerialFrameType::TraceRequest, NULL, 0);
+  simulator.sendSerial(request.data(), request.size());
+}
+
+// Decodes everything the firmware has sent from the given byte of its output on.
+static void decodeOutput(size_t from, TraceDecoder& decoder) {
+  std::vector<uint8_t>& output = simulator.getSerialOutput();
+  FrameCodec codec;
+  SerialFrame frame;
+
+  decoder.clear();
+
+  for(size_t i = from; i < output.size(); i++) {
+    if(codec.decode(output[i], frame)) decoder.take(frame);
+  }
+}
+
+static unsigned long countEvents(TraceDecoder& decoder, uint8_t type) {
+  unsigned long count = 0;
+
+  for(size_t i = 0; i < decoder.getEvents().size(); i++) {
+    if(decoder.getEvents()[i].type == type) count++;
+  }
+
+  return count;
+}
+
+// The events are in order, and none of them are from the future.
+static bool isInOrder(TraceDecoder& decoder) {
+  std::vector<TraceEvent>& events = decoder.getEvents();
+
+  for(size_t i = 0; i < events.size(); i++) {
+    if(events[i].timestampMicros > simulator.getMicros()) return false;
+    if(i > 0 && events[i].timestampMicros < events[i - 1].timestampMicros) return false;
+  }
+
+  return true;
+}
+
+static unsigned long countLoops(TraceDecoder& decoder) {
+  unsigned long loops = 0;
+  for(uint8_t i = 0; i < EVENT_TRACE_LOOP_TIME_BUCKETS; i++) loops += decoder.getLoopTimeCount(i);
+
+  return loops;
+}
+
+// Reads the trace out of the sketch over the serial port and decodes it with the host's TraceDecoder: once the play
+// routine has put the stylus down, and once a home routine has run into something and left the turntable in its error
+// state. The error's trace is frozen, so it ends with the failed movement and the error, and trace_decoder turns the
+// same bytes into a timeline. Run as `trace_decoder_test <trace_decoder>`.
+int main(int argc, char** argv) {
+  if(argc != 2) {
+    fprintf(stderr, "Usage: %s <trace_decoder>\n", argv[0]);
+    return 2;
+  }
+
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(RecordSize::TwelveInch));
+
+  simulator.setTimeLimit(200);
+  simulator.runSetup();
+  simulator.runFor(0.5);
+
+  // Play, and read the trace once the stylus is down and the record has been playing for a few revolutions.
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  CHECK(simulator.runUntil(60, [&]() { return tonearm.isStylusDown(); }));
+  simulator.runFor(5);
+
+  size_t from = simulator.getSerialOutput().size();
+  requestTrace();
+  simulator.runFor(TRACE_DUMP_SECONDS);
+
+  TraceDecoder decoder;
+  decodeOutput(from, decoder);
+
+  printf("After play: %u events, %lu loop iterations\n", (unsigned)decoder.getEvents().size(), countLoops(decoder));
+
+  CHECK(decoder.isComplete());
+  CHECK(decoder.getEvents().size() == EVENT_TRACE_SIZE);
+  CHECK(isInOrder(decoder));
+  CHECK(countEvents(decoder, TraceEventType::SpeedSample) > 0);
+  CHECK(countEvents(decoder, TraceEventType::Error) == 0);
+  CHECK(countLoops(decoder) > 0);
+
+  // Something on the deck between the tonearm and the home mount, so going home fails. The trace is read while the
+  // turntable waits in its error state, and the pause button gets it out of it.
+  tonearm.setObstructionSteps(tonearm.getArmSteps() / 2);
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+
+  double errorSeconds = simulator.getSeconds() + 30;
+  from = simulator.getSerialOutput().size();
+
+  simulator.schedule(errorSeconds * SIMULATED_TICKS_PER_SECOND, requestTrace);
+  simulator.schedule((errorSeconds + 5) * SIMULATED_TICKS_PER_SECOND, []() {
+    simulator.pressButton(MultiplexerInput::PauseButton);
+  });
+  simulator.runUntil(errorSeconds + 6);
+
+  decodeOutput(from, decoder);
+  printf("After the error:\n%s", decoder.describeTimeline().c_str());
+
+  std::vector<TraceEvent>& events = decoder.getEvents();
+  CHECK(decoder.isComplete());
+  CHECK(events.size() == EVENT_TRACE_SIZE);
+  CHECK(isInOrder(decoder));
+
+  // Nothing after the error was kept. The traverse home stopped when the encoder stalled, as it does at the home mount,
+  // so the engine saw it finish, and the error came from the home sensor not being reached.
+  CHECK(!events.empty() && events.back().type == TraceEventType::Error);
+  CHECK(!events.empty() && events.back().detail == MovementResult::HorizontalCounterclockwiseDirectionError);
+  CHECK(!events.empty() && events.back().timestampMicros < errorSeconds * 1000000);
+
+  long homeMoveStart = -1;
+  long homeMoveStop = -1;
+
+  for(size_t i = 0; i < events.size(); i++) {
+    if(events[i].type == TraceEventType::MoveStart && events[i].detail == (MotorAxis::Horizontal | 2)) homeMoveStart = i;
+    if(events[i].type == TraceEventType::MoveStop && homeMoveStart >= 0) homeMoveStop = i;
+  }
+
+  CHECK(homeMoveStart >= 0 && homeMoveStop > homeMoveStart);
+  CHECK(countEvents(decoder, TraceEventType::PickupEdge) > 0);
+  CHECK(countEvents(decoder, TraceEventType::ClutchStart) > 0);
+
+  // trace_decoder prints the same dump from the bytes the turntable sent: a line per event, then the loop times.
+  char path[] = "/tmp/trace_decoder_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+
+  std::vector<uint8_t>& output = simulator.getSerialOutput();
+  CHECK(fd >= 0 && write(fd, output.data() + from, output.size() - from) == (ssize_t)(output.size() - from));
+  if(fd >= 0) close(fd);
+
+  std::string command = std::string(argv[1]) + " --bytes " + path;
+  FILE* tool = popen(command.c_str(), "r");
+  CHECK(tool != NULL);
+
+  char line[256];
+  unsigned long lines = 0;
+  std::string lastEventLine;
+
+  while(tool != NULL && fgets(line, sizeof(line), tool) != NULL) {
+    if(lines == events.size() - 1) lastEventLine = line;
+    lines++;
+  }
+
+  CHECK(tool != NULL && pclose(tool) == 0);
+  unlink(path);
+
+  CHECK(lines == events.size() + 1);
+  CHECK(lastEventLine.find("error: horizontal counterclockwise error") != std::string::npos);
+
+  return TEST_RESULT();
+}
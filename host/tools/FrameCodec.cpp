@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include "FrameCodec.h"
+#include "Crc8.h"
+#include "enums/SerialFrameType.h"
+#include "enums/SerialStatusFlag.h"
+
+FrameCodec::FrameCodec() {
+    this->state = WaitingForSync;
+    this->decodingFrame.type = 0;
+    this->decodingFrame.length = 0;
+    this->payloadBytesDecoded = 0;
+    this->crc = 0;
+
+    this->crcErrorCount = 0;
+}
+
+std::vector<uint8_t> FrameCodec::encode(uint8_t type, const uint8_t* payload, uint8_t length) {
+  std::vector<uint8_t> bytes;
+  uint8_t crc = Crc8::update(Crc8::update(0, length), type);
+
+  bytes.push_back(SERIAL_FRAME_SYNC);
+  bytes.push_back(length);
+  bytes.push_back(type);
+
+  for(uint8_t i = 0; i < length; i++) {
+    bytes.push_back(payload[i]);
+    crc = Crc8::update(crc, payload[i]);
+  }
+
+  bytes.push_back(crc);
+
+  return bytes;
+}
+
+// The same state machine as SerialProtocol::receive(), one byte at a time.
+bool FrameCodec::decode(uint8_t data, SerialFrame& frame) {
+  switch(this->state) {
+    case WaitingForSync:
+      if(data == SERIAL_FRAME_SYNC) this->state = WaitingForLength;
+      break;
+
+    case WaitingForLength:
+      if(data > SERIAL_FRAME_MAX_PAYLOAD) {
+        this->state = WaitingForSync;
+        break;
+      }
+
+      this->decodingFrame.length = data;
+      this->crc = Crc8::update(0, data);
+      this->state = WaitingForType;
+      break;
+
+    case WaitingForType:
+      this->decodingFrame.type = data;
+      this->crc = Crc8::update(this->crc, data);
+      this->payloadBytesDecoded = 0;
+      this->state = this->decodingFrame.length > 0 ? WaitingForPayload : WaitingForCrc;
+      break;
+
+    case WaitingForPayload:
+      this->decodingFrame.payload[this->payloadBytesDecoded++] = data;
+      this->crc = Crc8::update(this->crc, data);
+      if(this->payloadBytesDecoded >= this->decodingFrame.length) this->state = WaitingForCrc;
+      break;
+
+    case WaitingForCrc:
+      this->state = WaitingForSync;
+
+      if(data != this->crc) {
+        this->crcErrorCount++;
+        break;
+      }
+
+      frame = this->decodingFrame;
+      return true;
+  }
+
+  return false;
+}
+
+unsigned long FrameCodec::getCrcErrorCount() {
+  return this->crcErrorCount;
+}
+
+std::string FrameCodec::describe(const SerialFrame& frame) {
+  char text[160];
+  const uint8_t* payload = frame.payload;
+
+  if(frame.type == SerialFrameType::CommandResult && frame.length >= 2) {
+    snprintf(text, sizeof(text), "result of command 0x%02X: %u", payload[0], payload[1]);
+  }
+  else if(frame.type == SerialFrameType::Status && frame.length >= 14) {
+    snprintf(text, sizeof(text), "status%s%s%s%s%s%s, home %lums, play %lums, repeat %lums, record size %u",
+      (payload[0] & SerialStatusFlag::PausedFlag) ? " paused" : "",
+      (payload[0] & SerialStatusFlag::MovingFlag) ? " moving" : "",
+      (payload[0] & SerialStatusFlag::AutomaticFlag) ? " automatic" : "",
+      (payload[0] & SerialStatusFlag::RepeatFlag) ? " repeat" : "",
+      (payload[0] & SerialStatusFlag::HomeFlag) ? " home" : "",
+      (payload[0] & SerialStatusFlag::MotorRunningFlag) ? " motor-running" : "",
+      readUint32(payload + 1), readUint32(payload + 5), readUint32(payload + 9),
+      payload[13]);
+  }
+  else if(frame.type == SerialFrameType::SpeedTelemetry && frame.length >= 10) {
+    snprintf(text, sizeof(text), "speed %u: %.2f RPM (mean %.2f, target %.2f), wow and flutter %.2f%%, duty %u", payload[0],
+      readUint16(payload + 1) / 100.0, readUint16(payload + 3) / 100.0,
+      readUint16(payload + 5) / 100.0, readUint16(payload + 7) / 100.0, payload[9]);
+  }
+  else {
+    int used = snprintf(text, sizeof(text), "frame 0x%02X:", frame.type);
+
+    for(uint8_t i = 0; i < frame.length && used < (int)sizeof(text) - 4; i++) {
+      used += snprintf(text + used, sizeof(text) - used, " %02X", payload[i]);
+    }
+  }
+
+  return std::string(text);
+}
+
+void FrameCodec::writeUint16(uint8_t* buffer, uint16_t value) {
+  buffer[0] = value & 0xFF;
+  buffer[1] = value >> 8;
+}
+
+uint16_t FrameCodec::readUint16(const uint8_t* buffer) {
+  return buffer[0] | ((uint16_t)buffer[1] << 8);
+}
+
+unsigned long FrameCodec::readUint32(const uint8_t* buffer) {
+  return readUint16(buffer) | ((unsigned long)readUint16(buffer + 2) << 16);
+}
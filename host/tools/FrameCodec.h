@@ -0,0 +1,53 @@
+#include "arduino.h"
+#include <string>
+#include <vector>
+#include "SerialProtocol.h"
+
+#ifndef FrameCodec_h
+#define FrameCodec_h
+
+// The host's side of the serial protocol (see SerialProtocol.h): builds frames to send to the turntable, and finds the
+// frames in whatever bytes come back from it, skipping anything corrupt.
+class FrameCodec {
+    public:
+
+        // Constructor
+        FrameCodec();
+
+        // The bytes of a frame with the given type and payload, sync and CRC included.
+        static std::vector<uint8_t> encode(uint8_t type, const uint8_t* payload, uint8_t length);
+
+        // Take the next received byte. Returns true, with the frame filled in, when the byte completes a frame with a
+        // valid CRC.
+        bool decode(uint8_t data, SerialFrame& frame);
+
+        // The number of frames that were thrown away because their CRC didn't match.
+        unsigned long getCrcErrorCount();
+
+        // A line of text describing a frame from the turntable, for printing.
+        static std::string describe(const SerialFrame& frame);
+
+        // Little-endian helpers for building and reading payloads, as in SerialProtocol, which needs the HAL.
+        static void writeUint16(uint8_t* buffer, uint16_t value);
+        static uint16_t readUint16(const uint8_t* buffer);
+        static unsigned long readUint32(const uint8_t* buffer);
+
+    private:
+        // Where the decoder is within the current frame.
+        enum DecodeState : uint8_t {
+            WaitingForSync,
+            WaitingForLength,
+            WaitingForType,
+            WaitingForPayload,
+            WaitingForCrc
+        };
+
+        DecodeState state;
+        SerialFrame decodingFrame;
+        uint8_t payloadBytesDecoded;
+        uint8_t crc;
+
+        unsigned long crcErrorCount;
+};
+
+#endif
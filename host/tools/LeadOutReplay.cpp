@@ -0,0 +1,72 @@
+#include "LeadOutReplay.h"
+#include "QuadratureEncoder.h"
+#include "LeadOutDetector.h"
+#include "proto/Constants.h"
+
+LeadOutConstants LeadOutReplay::defaultConstants() {
+  LeadOutConstants constants;
+  constants.inwardDirection = TONEARM_PICKUP_INWARD_DIRECTION;
+  constants.leadOutCountsPerRevolution = TONEARM_PICKUP_LEADOUT_COUNTS_PER_REVOLUTION;
+  constants.consecutiveRevolutions = TONEARM_PICKUP_CONSECUTIVE_REVOLUTIONS;
+
+  return constants;
+}
+
+LeadOutReplayResult LeadOutReplay::replay(SensorTrace& trace, const LeadOutConstants& constants) {
+  LeadOutReplayResult result;
+  result.revolutions = 0;
+  result.falseTriggers = 0;
+  result.firstFalseTriggerSeconds = 0;
+  result.detected = false;
+  result.latencyRevolutions = 0;
+  result.latencySeconds = 0;
+
+  std::vector<SensorEdge>& edges = trace.getEdges();
+  if(edges.empty()) return result;
+
+  QuadratureEncoder encoder = QuadratureEncoder();
+  LeadOutDetector detector = LeadOutDetector(encoder);
+  detector.setInwardDirection(constants.inwardDirection);
+  detector.setLeadOutTravelPerRevolution(constants.leadOutCountsPerRevolution);
+  detector.setConsecutiveRevolutions(constants.consecutiveRevolutions);
+
+  // Times are kept relative to the first edge, so a trace can run across the microsecond counter wrapping around. A
+  // trace without a lead-out is all music.
+  unsigned long startMicros = edges[0].timestampMicros;
+  unsigned long leadOutMicros = trace.hasLeadOut() ? trace.getLeadOutMicros() - startMicros : 0xFFFFFFFF;
+  unsigned long leadOutRevolution = 0;
+  bool encoderStarted = false;
+
+  for(size_t i = 0; i < edges.size() && !result.detected; i++) {
+    const SensorEdge& edge = edges[i];
+    unsigned long micros = edge.timestampMicros - startMicros;
+
+    if(edge.source != SENSOR_CAPTURE_SPEED_EDGE) {
+      // The state before the first captured edge isn't known, so decoding starts from it.
+      if(encoderStarted) encoder.onStateChange(edge.source);
+      else encoder.begin(edge.source);
+
+      encoderStarted = true;
+      continue;
+    }
+
+    if(micros < leadOutMicros) leadOutRevolution = result.revolutions + 1;
+
+    result.revolutions++;
+    detector.recordRevolution();
+    if(!detector.update()) continue;
+
+    if(micros < leadOutMicros) {
+      if(result.falseTriggers == 0) result.firstFalseTriggerSeconds = micros / 1000000.0;
+      result.falseTriggers++;
+      detector.reset();
+    }
+    else {
+      result.detected = true;
+      result.latencyRevolutions = result.revolutions - leadOutRevolution;
+      result.latencySeconds = (micros - leadOutMicros) / 1000000.0;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,44 @@
+#include "arduino.h"
+#include "SensorTrace.h"
+
+#ifndef LeadOutReplay_h
+#define LeadOutReplay_h
+
+// The lead-out calibration values (see CalibrationValue::PickupLeadOutCountsPerRevolution).
+struct LeadOutConstants {
+    int8_t inwardDirection;
+    uint8_t leadOutCountsPerRevolution;
+    uint8_t consecutiveRevolutions;
+};
+
+// How the lead-out detection did on a trace.
+struct LeadOutReplayResult {
+    // The number of platter revolutions in the trace.
+    unsigned long revolutions;
+
+    // The number of times the lead-out was detected before the stylus entered it, each of which would have sent the
+    // tonearm home in the middle of the record, and when the first one was, in seconds from the start of the trace.
+    unsigned long falseTriggers;
+    double firstFalseTriggerSeconds;
+
+    // Whether the lead-out was detected once the stylus was in it, and how long after it entered, in revolutions (the
+    // speed sensor edges in between) and seconds.
+    bool detected;
+    unsigned long latencyRevolutions;
+    double latencySeconds;
+};
+
+// Replays the sensor edges of a trace through the firmware's own QuadratureEncoder and LeadOutDetector, in the order
+// the interrupts and the main loop see them in monitorPickupSensor(): each pickup edge is decoded, and each speed edge
+// samples the position for a revolution, which is processed right away. As in the firmware, the detector starts over
+// after each detection, since the tonearm would have been sent home.
+class LeadOutReplay {
+    public:
+
+        // The firmware's default constants.
+        static LeadOutConstants defaultConstants();
+
+        static LeadOutReplayResult replay(SensorTrace& trace, const LeadOutConstants& constants);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeadOutReplay.h"
+
+// Replays captured record sides (see SensorTrace.h) through the firmware's lead-out detection, and reports how long
+// after the stylus entered the lead-out groove it was detected, and how many times it would have sent the tonearm home
+// during the music. Exits with 1 if any side had a false trigger, or a lead-out that was never detected.
+//
+// With --sweep, every combination of the lead-out constants is tried on all of the sides instead, and the one that
+// never false-triggers and detects every lead-out soonest is printed.
+//
+//   replay_evaluator [--counts n] [--revolutions n] [--reversed] <trace>...
+//   replay_evaluator --sweep [--reversed] <trace>...
+
+// The range of constants tried by --sweep.
+#define SWEEP_MAX_COUNTS_PER_REVOLUTION 8
+#define SWEEP_MAX_CONSECUTIVE_REVOLUTIONS 6
+
+static void printUsage() {
+  fprintf(stderr, "usage: replay_evaluator [--counts n] [--revolutions n] [--reversed] <trace>...\n"
+    "       replay_evaluator --sweep [--reversed] <trace>...\n");
+}
+
+// How a set of constants did over every trace.
+struct SweepResult {
+    LeadOutConstants constants;
+    unsigned long falseTriggers;
+    unsigned long missed;
+    unsigned long worstLatencyRevolutions;
+    double meanLatencySeconds;
+};
+
+static SweepResult evaluate(std::vector<SensorTrace>& traces, const LeadOutConstants& constants, bool print) {
+  SweepResult total;
+  total.constants = constants;
+  total.falseTriggers = 0;
+  total.missed = 0;
+  total.worstLatencyRevolutions = 0;
+  total.meanLatencySeconds = 0;
+
+  unsigned long detected = 0;
+
+  for(size_t i = 0; i < traces.size(); i++) {
+    LeadOutReplayResult result = LeadOutReplay::replay(traces[i], constants);
+
+    total.falseTriggers += result.falseTriggers;
+    if(traces[i].hasLeadOut() && !result.detected) total.missed++;
+
+    if(result.detected) {
+      detected++;
+      total.meanLatencySeconds += result.latencySeconds;
+      if(result.latencyRevolutions > total.worstLatencyRevolutions) total.worstLatencyRevolutions = result.latencyRevolutions;
+    }
+
+    if(!print) continue;
+
+    printf("%s: %lu revolutions, %lu edges dropped, ", traces[i].getName().c_str(), result.revolutions, traces[i].getDroppedCount());
+
+    if(result.falseTriggers > 0) printf("%lu false triggers (the first at %.1fs), ", result.falseTriggers, result.firstFalseTriggerSeconds);
+    else printf("no false triggers, ");
+
+    if(result.detected) printf("lead-out detected after %lu revolutions (%.2fs)\n", result.latencyRevolutions, result.latencySeconds);
+    else if(traces[i].hasLeadOut()) printf("lead-out never detected\n");
+    else printf("no lead-out in the trace\n");
+  }
+
+  if(detected > 0) total.meanLatencySeconds /= detected;
+
+  return total;
+}
+
+// Fewer false triggers and missed lead-outs, then the lowest worst-case latency, then the lowest mean latency, and then
+// the most margin above the groove pitch of the music.
+static bool isBetter(const SweepResult& a, const SweepResult& b) {
+  if(a.falseTriggers + a.missed != b.falseTriggers + b.missed) return a.falseTriggers + a.missed < b.falseTriggers + b.missed;
+  if(a.worstLatencyRevolutions != b.worstLatencyRevolutions) return a.worstLatencyRevolutions < b.worstLatencyRevolutions;
+  if(a.meanLatencySeconds != b.meanLatencySeconds) return a.meanLatencySeconds < b.meanLatencySeconds;
+
+  return a.constants.leadOutCountsPerRevolution > b.constants.leadOutCountsPerRevolution;
+}
+
+static void printSweepResult(const SweepResult& result) {
+  printf("counts %u, revolutions %u: %lu false triggers, %lu missed, worst latency %lu revolutions, mean %.2fs\n",
+    result.constants.leadOutCountsPerRevolution, result.constants.consecutiveRevolutions, result.falseTriggers, result.missed,
+    result.worstLatencyRevolutions, result.meanLatencySeconds);
+}
+
+int main(int argc, char** argv) {
+  LeadOutConstants constants = LeadOutReplay::defaultConstants();
+  bool sweep = false;
+  std::vector<SensorTrace> traces;
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "--counts") && i + 1 < argc) {
+      constants.leadOutCountsPerRevolution = atoi(argv[++i]);
+    }
+    else if(!strcmp(argv[i], "--revolutions") && i + 1 < argc) {
+      constants.consecutiveRevolutions = atoi(argv[++i]);
+    }
+    else if(!strcmp(argv[i], "--reversed")) {
+      constants.inwardDirection = -1;
+    }
+    else if(!strcmp(argv[i], "--sweep")) {
+      sweep = true;
+    }
+    else if(argv[i][0] == '-') {
+      printUsage();
+      return 2;
+    }
+    else {
+      traces.push_back(SensorTrace());
+
+      if(!traces.back().load(argv[i])) {
+        fprintf(stderr, "replay_evaluator: can't read the trace %s\n", argv[i]);
+        return 2;
+      }
+    }
+  }
+
+  if(traces.empty()) {
+    printUsage();
+    return 2;
+  }
+
+  if(!sweep) {
+    SweepResult result = evaluate(traces, constants, true);
+    return result.falseTriggers + result.missed == 0 ? 0 : 1;
+  }
+
+  SweepResult best;
+  bool found = false;
+
+  for(uint8_t counts = 1; counts <= SWEEP_MAX_COUNTS_PER_REVOLUTION; counts++) {
+    for(uint8_t revolutions = 1; revolutions <= SWEEP_MAX_CONSECUTIVE_REVOLUTIONS; revolutions++) {
+      constants.leadOutCountsPerRevolution = counts;
+      constants.consecutiveRevolutions = revolutions;
+
+      SweepResult result = evaluate(traces, constants, false);
+      printSweepResult(result);
+
+      if(!found || isBetter(result, best)) best = result;
+      found = true;
+    }
+  }
+
+  LeadOutConstants defaults = LeadOutReplay::defaultConstants();
+  defaults.inwardDirection = constants.inwardDirection;
+
+  printf("\nThe firmware's defaults on %u traces:\n", (unsigned)traces.size());
+  printSweepResult(evaluate(traces, defaults, false));
+  printf("The best:\n");
+  printSweepResult(best);
+
+  return best.falseTriggers + best.missed == 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include "SensorTrace.h"
+#include "FrameCodec.h"
+
+// The size of an edge in a CaptureEdges frame, after the dropped count.
+#define SENSOR_TRACE_FRAME_EDGE_BYTES 5
+
+SensorTrace::SensorTrace() {
+    this->leadOutKnown = false;
+    this->leadOutMicros = 0;
+    this->droppedCount = 0;
+}
+
+bool SensorTrace::load(const char* path) {
+  FILE* file = fopen(path, "r");
+  if(file == NULL) return false;
+
+  *this = SensorTrace();
+  this->name = path;
+
+  char line[128];
+  bool valid = true;
+
+  while(valid && fgets(line, sizeof(line), file) != NULL) {
+    unsigned long number;
+    char source[4];
+
+    if(line[0] == '#' || line[0] == '\n') continue;
+
+    if(sscanf(line, "lead-out %lu", &number) == 1) {
+      this->setLeadOutMicros(number);
+    }
+    else if(sscanf(line, "dropped %lu", &number) == 1) {
+      this->addDropped(number);
+    }
+    else if(sscanf(line, "%lu %3s", &number, source) == 2) {
+      SensorEdge edge;
+      edge.timestampMicros = number;
+
+      if(!strcmp(source, "S")) edge.source = SENSOR_CAPTURE_SPEED_EDGE;
+      else if(source[0] >= '0' && source[0] <= '3' && source[1] == 0) edge.source = source[0] - '0';
+      else valid = false;
+
+      this->addEdge(edge);
+    }
+    else {
+      valid = false;
+    }
+  }
+
+  fclose(file);
+
+  return valid;
+}
+
+bool SensorTrace::save(const char* path) {
+  FILE* file = fopen(path, "w");
+  if(file == NULL) return false;
+
+  fprintf(file, "# Sensor edges: <microseconds> <pickup encoder state (A << 1) | B, or S for the speed sensor>\n");
+  if(this->leadOutKnown) fprintf(file, "lead-out %lu\n", this->leadOutMicros);
+
+  if(this->droppedCount > 0) fprintf(file, "dropped %lu\n", this->droppedCount);
+
+  for(size_t i = 0; i < this->edges.size(); i++) {
+    const SensorEdge& edge = this->edges[i];
+
+    if(edge.source == SENSOR_CAPTURE_SPEED_EDGE) fprintf(file, "%lu S\n", edge.timestampMicros);
+    else fprintf(file, "%lu %u\n", edge.timestampMicros, edge.source);
+  }
+
+  return fclose(file) == 0;
+}
+
+void SensorTrace::addEdge(const SensorEdge& edge) {
+  this->edges.push_back(edge);
+}
+
+void SensorTrace::addDropped(unsigned long count) {
+  this->droppedCount += count;
+}
+
+void SensorTrace::addCaptureFrame(const uint8_t* payload, uint8_t length) {
+  if(length < 1) return;
+
+  this->addDropped(payload[0]);
+
+  for(uint8_t offset = 1; offset + SENSOR_TRACE_FRAME_EDGE_BYTES <= length; offset += SENSOR_TRACE_FRAME_EDGE_BYTES) {
+    SensorEdge edge;
+    edge.timestampMicros = FrameCodec::readUint32(payload + offset);
+    edge.source = payload[offset + 4];
+    this->addEdge(edge);
+  }
+}
+
+void SensorTrace::setLeadOutMicros(unsigned long timestampMicros) {
+  this->leadOutKnown = true;
+  this->leadOutMicros = timestampMicros;
+}
+
+std::vector<SensorEdge>& SensorTrace::getEdges() {
+  return this->edges;
+}
+
+bool SensorTrace::hasLeadOut() {
+  return this->leadOutKnown;
+}
+
+unsigned long SensorTrace::getLeadOutMicros() {
+  return this->leadOutMicros;
+}
+
+unsigned long SensorTrace::getDroppedCount() {
+  return this->droppedCount;
+}
+
+std::string& SensorTrace::getName() {
+  return this->name;
+}
@@ -0,0 +1,52 @@
+#include "arduino.h"
+#include <string>
+#include <vector>
+#include "SensorCapture.h"
+
+#ifndef SensorTrace_h
+#define SensorTrace_h
+
+// The sensor edges of a record side, as captured by the turntable (see SerialFrameType::StartCapture), kept in a text
+// file so that a corpus of sides can be replayed later. Each line is an edge, as `<microseconds> <source>`, where the
+// source is the new pickup encoder state (0-3, as (A << 1) | B), or S for the speed sensor. A `lead-out <microseconds>`
+// line marks when the stylus entered the lead-out groove, if it is known, and `dropped <count>` counts edges that the
+// turntable couldn't send, which leave a gap somewhere in the trace. Lines starting with # are comments.
+class SensorTrace {
+    public:
+
+        // Constructor
+        SensorTrace();
+
+        // Read a trace from a file, replacing this one. Returns false if the file can't be read or has a bad line.
+        bool load(const char* path);
+
+        // Write the trace to a file.
+        bool save(const char* path);
+
+        // Add the next edge, or count edges that were dropped.
+        void addEdge(const SensorEdge& edge);
+        void addDropped(unsigned long count);
+
+        // Take the edges out of a CaptureEdges frame payload.
+        void addCaptureFrame(const uint8_t* payload, uint8_t length);
+
+        // Mark when the stylus entered the lead-out groove.
+        void setLeadOutMicros(unsigned long timestampMicros);
+
+        std::vector<SensorEdge>& getEdges();
+        bool hasLeadOut();
+        unsigned long getLeadOutMicros();
+        unsigned long getDroppedCount();
+
+        // A name for the trace in reports, i.e. the file it was loaded from.
+        std::string& getName();
+
+    private:
+        std::vector<SensorEdge> edges;
+        bool leadOutKnown;
+        unsigned long leadOutMicros;
+        unsigned long droppedCount;
+        std::string name;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "SerialPort.h"
+
+// The baud rate of the firmware's serial port (see SERIAL_SPEED).
+#define SERIAL_PORT_BAUD B115200
+
+static unsigned long long monotonicMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+SerialPort::SerialPort() {
+    this->fd = -1;
+}
+
+SerialPort::~SerialPort() {
+    this->close();
+}
+
+bool SerialPort::open(const char* path) {
+  this->close();
+  this->fd = ::open(path, O_RDWR | O_NOCTTY);
+  if(this->fd < 0) return false;
+
+  struct termios settings;
+
+  if(tcgetattr(this->fd, &settings) == 0) {
+    cfmakeraw(&settings);
+    cfsetispeed(&settings, SERIAL_PORT_BAUD);
+    cfsetospeed(&settings, SERIAL_PORT_BAUD);
+    tcsetattr(this->fd, TCSANOW, &settings);
+  }
+
+  return true;
+}
+
+void SerialPort::close() {
+  if(this->fd >= 0) ::close(this->fd);
+  this->fd = -1;
+}
+
+bool SerialPort::isOpen() {
+  return this->fd >= 0;
+}
+
+bool SerialPort::send(uint8_t type, const uint8_t* payload, uint8_t length) {
+  return this->sendBytes(FrameCodec::encode(type, payload, length));
+}
+
+bool SerialPort::sendBytes(const std::vector<uint8_t>& bytes) {
+  size_t written = 0;
+
+  while(this->fd >= 0 && written < bytes.size()) {
+    ssize_t count = write(this->fd, bytes.data() + written, bytes.size() - written);
+    if(count <= 0) return false;
+
+    written += count;
+  }
+
+  return this->fd >= 0;
+}
+
+bool SerialPort::receive(SerialFrame& frame, unsigned long timeoutMs) {
+  unsigned long long deadline = monotonicMs() + timeoutMs;
+
+  while(this->fd >= 0) {
+    unsigned long long now = monotonicMs();
+    if(now >= deadline) return false;
+
+    struct pollfd readable = { this->fd, POLLIN, 0 };
+    if(poll(&readable, 1, deadline - now) <= 0) return false;
+
+    // Only one byte at a time, so nothing after the frame is taken out of the device.
+    uint8_t data;
+
+    if(read(this->fd, &data, 1) != 1) {
+      this->close();
+      return false;
+    }
+
+    if(this->codec.decode(data, frame)) return true;
+  }
+
+  return false;
+}
+
+FrameCodec& SerialPort::getCodec() {
+  return this->codec;
+}
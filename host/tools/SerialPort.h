@@ -0,0 +1,38 @@
+#include "FrameCodec.h"
+
+#ifndef SerialPort_h
+#define SerialPort_h
+
+// A serial device on the host, i.e. the turntable's USB serial port or the pty of `turntable_sim --pty`, in raw mode,
+// with frames sent and received through a FrameCodec.
+class SerialPort {
+    public:
+
+        // Constructor
+        SerialPort();
+        ~SerialPort();
+
+        // Open the device, and set it to raw mode at SERIAL_SPEED. Returns false if it couldn't be opened.
+        bool open(const char* path);
+        void close();
+
+        // Whether the device is open. It is closed if the other end hangs up.
+        bool isOpen();
+
+        // Send a frame. Returns false if it couldn't all be written.
+        bool send(uint8_t type, const uint8_t* payload = NULL, uint8_t length = 0);
+
+        // Send bytes exactly as given, i.e. a corrupt frame.
+        bool sendBytes(const std::vector<uint8_t>& bytes);
+
+        // Wait up to the given number of milliseconds for the next valid frame. Returns false if none arrived.
+        bool receive(SerialFrame& frame, unsigned long timeoutMs);
+
+        FrameCodec& getCodec();
+
+    private:
+        int fd;
+        FrameCodec codec;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include "TraceDecoder.h"
+#include "FrameCodec.h"
+#include "enums/SerialFrameType.h"
+#include "enums/TraceEventType.h"
+#include "enums/MovementResult.h"
+#include "enums/MotorAxis.h"
+
+// The size of an event in a TraceEvents frame.
+#define TRACE_DECODER_EVENT_BYTES 8
+
+static const char* movementResultName(uint8_t result) {
+  switch(result) {
+    case MovementResult::None: return "none";
+    case MovementResult::Success: return "success";
+    case MovementResult::Cancelled: return "cancelled";
+    case MovementResult::VerticalPositiveDirectionError: return "vertical up error";
+    case MovementResult::VerticalNegativeDirectionError: return "vertical down error";
+    case MovementResult::HorizontalClockwiseDirectionError: return "horizontal clockwise error";
+    case MovementResult::HorizontalCounterclockwiseDirectionError: return "horizontal counterclockwise error";
+    case MovementResult::RoutineStalledError: return "routine stalled";
+    default: return "unknown";
+  }
+}
+
+TraceDecoder::TraceDecoder() {
+    this->clear();
+}
+
+bool TraceDecoder::take(const SerialFrame& frame) {
+  // A dump that was already taken is replaced by the next one.
+  if(this->complete && frame.type == SerialFrameType::TraceEvents) this->clear();
+
+  if(frame.type == SerialFrameType::TraceEvents) {
+    for(uint8_t offset = 0; offset + TRACE_DECODER_EVENT_BYTES <= frame.length; offset += TRACE_DECODER_EVENT_BYTES) {
+      TraceEvent event;
+      event.timestampMicros = FrameCodec::readUint32(frame.payload + offset);
+      event.type = frame.payload[offset + 4];
+      event.detail = frame.payload[offset + 5];
+      event.value = FrameCodec::readUint16(frame.payload + offset + 6);
+      this->events.push_back(event);
+    }
+  }
+  else if(frame.type == SerialFrameType::TraceLoopTimes && frame.length >= EVENT_TRACE_LOOP_TIME_BUCKETS * 2) {
+    for(uint8_t i = 0; i < EVENT_TRACE_LOOP_TIME_BUCKETS; i++) {
+      this->loopTimeCounts[i] = FrameCodec::readUint16(frame.payload + i * 2);
+    }
+
+    this->complete = true;
+    return true;
+  }
+
+  return false;
+}
+
+bool TraceDecoder::isComplete() {
+  return this->complete;
+}
+
+void TraceDecoder::clear() {
+  this->events.clear();
+  this->complete = false;
+
+  for(uint8_t i = 0; i < EVENT_TRACE_LOOP_TIME_BUCKETS; i++) this->loopTimeCounts[i] = 0;
+}
+
+std::vector<TraceEvent>& TraceDecoder::getEvents() {
+  return this->events;
+}
+
+uint16_t TraceDecoder::getLoopTimeCount(uint8_t bucket) {
+  return this->loopTimeCounts[bucket];
+}
+
+std::string TraceDecoder::describe(const TraceEvent& event, unsigned long startMicros) {
+  char text[160];
+
+  // The timestamps wrap around after about 71 minutes, which the unsigned subtraction takes care of.
+  int used = snprintf(text, sizeof(text), "%12.3fms  ", (uint32_t)(event.timestampMicros - startMicros) / 1000.0);
+  char* line = text + used;
+  size_t space = sizeof(text) - used;
+
+  bool vertical = (event.detail & 1) == MotorAxis::Vertical;
+  bool negative = event.detail & 2;
+
+  switch(event.type) {
+    case TraceEventType::MoveStart:
+      snprintf(line, space, "move start: %s, at most %u steps",
+        vertical ? (negative ? "down" : "up") : (negative ? "counterclockwise" : "clockwise"), event.value);
+      break;
+
+    case TraceEventType::MoveStop:
+      snprintf(line, space, "move stop: %s after %u steps", movementResultName(event.detail), event.value);
+      break;
+
+    case TraceEventType::LimitHit:
+      snprintf(line, space, "limit hit: input %u after %u steps", event.detail, event.value);
+      break;
+
+    case TraceEventType::ClutchStart:
+      snprintf(line, space, "clutch start: %s for %ums", event.detail ? "engage" : "disengage", event.value);
+      break;
+
+    case TraceEventType::ClutchStop:
+      snprintf(line, space, "clutch stop: %s", event.detail ? "engaged" : "disengaged");
+      break;
+
+    case TraceEventType::MuxChange:
+      snprintf(line, space, "inputs: 0x%02X, changed 0x%02X", event.detail, event.value);
+      break;
+
+    case TraceEventType::PickupEdge:
+      snprintf(line, space, "pickup: A %u B %u, position %d", (event.detail >> 1) & 1, event.detail & 1, (int16_t)event.value);
+      break;
+
+    case TraceEventType::SpeedSample:
+      snprintf(line, space, "speed: %.2f RPM", event.value / 100.0);
+      break;
+
+    case TraceEventType::LeadOutDetected:
+      snprintf(line, space, "lead-out detected: %u counts inward in the last revolution", event.value);
+      break;
+
+    case TraceEventType::Error:
+      snprintf(line, space, "error: %s", movementResultName(event.detail));
+      break;
+
+    default:
+      snprintf(line, space, "event 0x%02X: detail 0x%02X, value %u", event.type, event.detail, event.value);
+      break;
+  }
+
+  return std::string(text);
+}
+
+std::string TraceDecoder::describeTimeline() {
+  std::string timeline;
+  unsigned long startMicros = this->events.empty() ? 0 : this->events[0].timestampMicros;
+
+  for(size_t i = 0; i < this->events.size(); i++) {
+    timeline += describe(this->events[i], startMicros) + "\n";
+  }
+
+  timeline += "loop times:";
+
+  for(uint8_t i = 0; i < EVENT_TRACE_LOOP_TIME_BUCKETS; i++) {
+    char bucket[48];
+
+    if(i == 0) snprintf(bucket, sizeof(bucket), " <128us %u", this->loopTimeCounts[i]);
+    else if(i == EVENT_TRACE_LOOP_TIME_BUCKETS - 1) snprintf(bucket, sizeof(bucket), ", >=%luus %u", 64UL << i, this->loopTimeCounts[i]);
+    else snprintf(bucket, sizeof(bucket), ", %lu-%luus %u", 64UL << i, 128UL << i, this->loopTimeCounts[i]);
+
+    timeline += bucket;
+  }
+
+  return timeline + "\n";
+}
@@ -0,0 +1,44 @@
+#include "arduino.h"
+#include <string>
+#include <vector>
+#include "SerialProtocol.h"
+#include "EventTrace.h"
+
+#ifndef TraceDecoder_h
+#define TraceDecoder_h
+
+// Puts an event trace dump (see SerialFrameType::TraceRequest) back together from the TraceEvents and TraceLoopTimes
+// frames, and turns it into a timeline that can be read.
+class TraceDecoder {
+    public:
+
+        // Constructor
+        TraceDecoder();
+
+        // Take the next frame from the turntable. Frames that aren't part of a trace dump are ignored. Returns true once
+        // the TraceLoopTimes frame has ended the dump.
+        bool take(const SerialFrame& frame);
+
+        // Whether a whole dump has been taken.
+        bool isComplete();
+
+        // Forget the dump, to take another one.
+        void clear();
+
+        // The events of the dump, oldest first, and the loop time histogram.
+        std::vector<TraceEvent>& getEvents();
+        uint16_t getLoopTimeCount(uint8_t bucket);
+
+        // A line of text for an event, with its time relative to the given timestamp, in microseconds.
+        static std::string describe(const TraceEvent& event, unsigned long startMicros);
+
+        // The whole dump as a timeline, one line per event starting from the oldest one, then the loop time histogram.
+        std::string describeTimeline();
+
+    private:
+        std::vector<TraceEvent> events;
+        uint16_t loopTimeCounts[EVENT_TRACE_LOOP_TIME_BUCKETS];
+        bool complete;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+#include "SerialPort.h"
+#include "TraceDecoder.h"
+#include "enums/SerialFrameType.h"
+
+// Prints the turntable's event trace as a timeline. Given the serial port (or the pty of `turntable_sim --pty`), it
+// asks for the trace, which also works while the turntable is in its error state. With --bytes, it decodes a file of
+// bytes that were read from the serial port instead, i.e. after a TraceRequest was sent by something else.
+//
+//   trace_decoder <device>
+//   trace_decoder --bytes <file>
+
+// How long the turntable may take to send the whole trace, in milliseconds.
+#define TRACE_DECODER_TIMEOUT_MS 5000
+
+static void printUsage() {
+  fprintf(stderr, "usage: trace_decoder <device>\n       trace_decoder --bytes <file>\n");
+}
+
+int main(int argc, char** argv) {
+  TraceDecoder decoder;
+
+  if(argc == 3 && !strcmp(argv[1], "--bytes")) {
+    FILE* file = fopen(argv[2], "rb");
+
+    if(file == NULL) {
+      perror(argv[2]);
+      return 1;
+    }
+
+    FrameCodec codec;
+    SerialFrame frame;
+    int data;
+
+    while((data = fgetc(file)) != EOF) {
+      if(codec.decode(data, frame)) decoder.take(frame);
+    }
+
+    fclose(file);
+  }
+  else if(argc == 2) {
+    SerialPort port;
+
+    if(!port.open(argv[1])) {
+      perror(argv[1]);
+      return 1;
+    }
+
+    port.send(SerialFrameType::TraceRequest);
+
+    SerialFrame frame;
+    while(!decoder.isComplete() && port.receive(frame, TRACE_DECODER_TIMEOUT_MS)) decoder.take(frame);
+  }
+  else {
+    printUsage();
+    return 2;
+  }
+
+  if(!decoder.isComplete()) {
+    fprintf(stderr, "trace_decoder: no complete trace (%u events)\n", (unsigned)decoder.getEvents().size());
+    return 1;
+  }
+
+  printf("%s", decoder.describeTimeline().c_str());
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "SerialPort.h"
+#include "SensorTrace.h"
+#include "enums/SerialFrameType.h"
+#include "enums/MovementResult.h"
+
+// Sends a command to the turntable over its serial port, or the pty of `turntable_sim --pty`, and prints every frame
+// that comes back until the command is answered, or until --seconds have passed. `watch` just prints the status and
+// speed telemetry for that long.
+//
+// `capture` writes the raw pickup encoder and speed sensor edges to a trace file for replay_evaluator, for --seconds.
+// To capture a whole side, start it with the stylus on the record and the Auto/Manual switch on Manual, so the record
+// plays on into the locked groove, and add a `lead-out <microseconds>` line for when the stylus entered the lead-out.
+//
+//   turntable_client <device> play|home|pause|status|calibration|watch [--telemetry ms] [--seconds n]
+//   turntable_client <device> capture <file> [--seconds n]
+
+// How long a routine may take to be answered, in seconds.
+#define CLIENT_DEFAULT_TIMEOUT_SECONDS 120
+
+static void printUsage() {
+  fprintf(stderr, "usage: turntable_client <device> play|home|pause|status|calibration|watch [--telemetry ms] [--seconds n]\n"
+    "       turntable_client <device> capture <file> [--seconds n]\n");
+}
+
+// Captures sensor edges until the time is up, then writes them to the file.
+static int capture(SerialPort& port, const char* path, double seconds) {
+  SensorTrace trace;
+  SerialFrame frame;
+  time_t deadline = time(NULL) + (time_t)seconds;
+
+  port.send(SerialFrameType::StartCapture);
+
+  while(port.isOpen() && time(NULL) < deadline) {
+    if(port.receive(frame, (deadline - time(NULL)) * 1000) && frame.type == SerialFrameType::CaptureEdges) {
+      trace.addCaptureFrame(frame.payload, frame.length);
+    }
+  }
+
+  port.send(SerialFrameType::StopCapture);
+
+  // Whatever was still waiting in the turntable's buffer.
+  while(port.receive(frame, 500)) {
+    if(frame.type == SerialFrameType::CaptureEdges) trace.addCaptureFrame(frame.payload, frame.length);
+  }
+
+  if(!trace.save(path)) {
+    perror(path);
+    return 1;
+  }
+
+  printf("captured %u edges, %lu dropped\n", (unsigned)trace.getEdges().size(), trace.getDroppedCount());
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if(argc < 3) {
+    printUsage();
+    return 2;
+  }
+
+  const char* command = argv[2];
+  const char* capturePath = NULL;
+  long telemetryMs = -1;
+  double seconds = CLIENT_DEFAULT_TIMEOUT_SECONDS;
+  int firstOption = 3;
+
+  if(!strcmp(command, "capture")) {
+    if(argc < 4) {
+      printUsage();
+      return 2;
+    }
+
+    capturePath = argv[3];
+    firstOption = 4;
+  }
+
+  for(int i = firstOption; i < argc; i++) {
+    if(!strcmp(argv[i], "--telemetry") && i + 1 < argc) {
+      telemetryMs = atol(argv[++i]);
+    }
+    else if(!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+    else {
+      printUsage();
+      return 2;
+    }
+  }
+
+  uint8_t requestType;
+  uint8_t answerType;
+
+  if(!strcmp(command, "play")) requestType = SerialFrameType::PlayCommand;
+  else if(!strcmp(command, "home")) requestType = SerialFrameType::HomeCommand;
+  else if(!strcmp(command, "pause")) requestType = SerialFrameType::PauseCommand;
+  else if(!strcmp(command, "status")) requestType = SerialFrameType::StatusRequest;
+  else if(!strcmp(command, "calibration")) requestType = SerialFrameType::CalibrationRequest;
+  else if(!strcmp(command, "watch") || capturePath != NULL) requestType = 0;
+  else {
+    printUsage();
+    return 2;
+  }
+
+  answerType = requestType == SerialFrameType::StatusRequest ? SerialFrameType::Status :
+    requestType == SerialFrameType::CalibrationRequest ? SerialFrameType::Calibration : SerialFrameType::CommandResult;
+
+  SerialPort port;
+
+  if(!port.open(argv[1])) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  if(capturePath != NULL) return capture(port, capturePath, seconds);
+
+  if(requestType == 0 && telemetryMs < 0) telemetryMs = 500;
+
+  if(telemetryMs >= 0) {
+    uint8_t payload[2];
+    FrameCodec::writeUint16(payload, telemetryMs);
+    port.send(SerialFrameType::SetTelemetryInterval, payload, sizeof(payload));
+  }
+
+  if(requestType != 0) port.send(requestType);
+
+  SerialFrame frame;
+  time_t deadline = time(NULL) + (time_t)seconds;
+
+  while(port.isOpen() && time(NULL) < deadline) {
+    if(!port.receive(frame, (deadline - time(NULL)) * 1000)) continue;
+
+    printf("%s\n", FrameCodec::describe(frame).c_str());
+    fflush(stdout);
+
+    if(requestType == 0 || frame.type != answerType) continue;
+    if(answerType != SerialFrameType::CommandResult) return 0;
+    if(frame.length >= 2 && frame.payload[0] == requestType) return frame.payload[1] == MovementResult::Success ? 0 : 1;
+  }
+
+  if(requestType == 0 && port.isOpen()) return 0;
+
+  fprintf(stderr, port.isOpen() ? "%s: no answer within %.0fs\n" : "%s: the turntable hung up\n", command, seconds);
+  return 1;
+}
@@ -0,0 +1,229 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "SimulatedTurntable.h"
+#include "Sketch.h"
+#include "FrameCodec.h"
+#include "SensorTrace.h"
+#include "enums/TurntableSpeed.h"
+#include "enums/SerialFrameType.h"
+#include "enums/AutoManualSwitchPosition.h"
+
+// Runs the firmware against the simulated turntable: powers it on, optionally presses Play/Home, and prints what the
+// tonearm did for the given number of simulated seconds.
+//
+// With --pty, the firmware's serial port is connected to a new pseudo-terminal, whose path is printed first as
+// `pty <path>`, so turntable_client (or anything else) can talk to it like the real turntable. The simulation is then
+// held to real time, or to --rate times real time.
+//
+// With --capture, it plays a whole side of the record instead, with the Auto/Manual switch on Manual once the stylus is
+// down so that it plays on into the locked groove, and writes the sensor edges the firmware captures (see
+// SerialFrameType::StartCapture) to a trace file for replay_evaluator, with the lead-out marked.
+//
+//   turntable_sim [--speed 33|45|16|78] [--size 7|10|12] [--seconds n] [--play] [--pty [--rate n]] [--capture <file>]
+
+// How often the pty is checked for bytes in each direction, in simulated ticks.
+#define PTY_PUMP_TICKS (SIMULATED_TICKS_PER_SECOND / 1000)
+
+// How many revolutions of the locked groove are captured after the lead-out spiral, so that constants needing more
+// revolutions than the spiral has are seen to miss it.
+#define CAPTURE_LOCKED_GROOVE_REVOLUTIONS 8
+
+static void printUsage() {
+  fprintf(stderr, "usage: turntable_sim [--speed 33|45|16|78] [--size 7|10|12] [--seconds n] [--play] [--pty [--rate n]] [--capture <file>]\n");
+}
+
+// The pty's master side, and how much of the firmware's serial output has been passed on to it.
+static int ptyFd = -1;
+static size_t ptyOutputSent = 0;
+
+// Simulated seconds per real second, and when the simulation started in real time.
+static double ptyRate = 1;
+static struct timespec ptyStartTime;
+
+// Opens a pty in raw mode, keeping its slave side open as well, so the master can be read before anyone else opens it.
+static bool openPty() {
+  ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if(ptyFd < 0 || grantpt(ptyFd) != 0 || unlockpt(ptyFd) != 0) return false;
+
+  const char* path = ptsname(ptyFd);
+  int slaveFd = path == NULL ? -1 : open(path, O_RDWR | O_NOCTTY);
+  if(slaveFd < 0) return false;
+
+  struct termios settings;
+
+  if(tcgetattr(slaveFd, &settings) == 0) {
+    cfmakeraw(&settings);
+    tcsetattr(slaveFd, TCSANOW, &settings);
+  }
+
+  fcntl(ptyFd, F_SETFL, fcntl(ptyFd, F_GETFL) | O_NONBLOCK);
+
+  printf("pty %s\n", path);
+  fflush(stdout);
+
+  return true;
+}
+
+// Passes bytes between the pty and the simulated serial port, and waits for real time to catch up with the simulation.
+static void pumpPty() {
+  uint8_t buffer[256];
+  ssize_t count;
+
+  while((count = read(ptyFd, buffer, sizeof(buffer))) > 0) simulator.sendSerial(buffer, count);
+
+  std::vector<uint8_t>& output = simulator.getSerialOutput();
+
+  while(ptyOutputSent < output.size()) {
+    count = write(ptyFd, output.data() + ptyOutputSent, output.size() - ptyOutputSent);
+    if(count <= 0) break;
+
+    ptyOutputSent += count;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  double realSeconds = (now.tv_sec - ptyStartTime.tv_sec) + (now.tv_nsec - ptyStartTime.tv_nsec) / 1e9;
+  double aheadSeconds = simulator.getSeconds() / ptyRate - realSeconds;
+  if(aheadSeconds > 0) usleep(aheadSeconds * 1000000);
+
+  simulator.schedule(simulator.getTicks() + PTY_PUMP_TICKS, pumpPty);
+}
+
+static void sendCommand(uint8_t type) {
+  std::vector<uint8_t> frame = FrameCodec::encode(type, NULL, 0);
+  simulator.sendSerial(frame.data(), frame.size());
+}
+
+// Plays the side and captures it, as described above.
+static bool captureSide(const char* path) {
+  TonearmModel& tonearm = simulator.getTonearm();
+  const SimulatedRecord& record = tonearm.getRecord();
+  double lockedGrooveArmSteps = TONEARM_MODEL_PLAY_SENSOR_STEPS + record.lockedGrooveSteps;
+
+  simulator.pressButton(MultiplexerInput::PlayHomeButton);
+  if(!simulator.runUntil(60, []() { return playRoutineMs > 0; })) return false;
+
+  double revolutionSeconds = 60 / simulator.getPlatter().getNominalRpm();
+  double sideSeconds = (record.lockedGrooveSteps - record.edgeSteps) / record.musicPitchSteps * revolutionSeconds;
+
+  simulator.setMuxInput(MultiplexerInput::AutoManualSwitch, AutoManualSwitchPosition::Manual);
+
+  size_t from = simulator.getSerialOutput().size();
+  sendCommand(SerialFrameType::StartCapture);
+
+  SensorTrace trace;
+
+  simulator.runUntil(simulator.getSeconds() + sideSeconds, [&]() {
+    if(!trace.hasLeadOut() && tonearm.getArmSteps() - TONEARM_MODEL_PLAY_SENSOR_STEPS >= record.leadOutSteps) {
+      trace.setLeadOutMicros(simulator.getMicros());
+    }
+
+    return tonearm.getArmSteps() >= lockedGrooveArmSteps;
+  });
+
+  simulator.runFor(CAPTURE_LOCKED_GROOVE_REVOLUTIONS * revolutionSeconds);
+  sendCommand(SerialFrameType::StopCapture);
+  simulator.runFor(0.5);
+
+  std::vector<uint8_t>& output = simulator.getSerialOutput();
+  FrameCodec codec;
+  SerialFrame frame;
+
+  for(size_t i = from; i < output.size(); i++) {
+    if(codec.decode(output[i], frame) && frame.type == SerialFrameType::CaptureEdges) trace.addCaptureFrame(frame.payload, frame.length);
+  }
+
+  printf("captured %u edges, %lu dropped, lead-out at %.3fs\n", (unsigned)trace.getEdges().size(), trace.getDroppedCount(),
+    trace.getLeadOutMicros() / 1000000.0);
+
+  return trace.hasLeadOut() && trace.save(path);
+}
+
+int main(int argc, char** argv) {
+  TurntableSpeed speed = TurntableSpeed::Speed33;
+  RecordSize size = RecordSize::TwelveInch;
+  double seconds = 30;
+  bool play = false;
+  bool pty = false;
+  const char* capturePath = NULL;
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      int rpm = atoi(argv[++i]);
+      speed = rpm == 45 ? TurntableSpeed::Speed45 : rpm == 16 ? TurntableSpeed::Speed16 : rpm == 78 ? TurntableSpeed::Speed78 : TurntableSpeed::Speed33;
+    }
+    else if(!strcmp(argv[i], "--size") && i + 1 < argc) {
+      int inches = atoi(argv[++i]);
+      size = inches == 7 ? RecordSize::SevenInch : inches == 10 ? RecordSize::TenInch : RecordSize::TwelveInch;
+    }
+    else if(!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+    else if(!strcmp(argv[i], "--play")) {
+      play = true;
+    }
+    else if(!strcmp(argv[i], "--pty")) {
+      pty = true;
+    }
+    else if(!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      ptyRate = atof(argv[++i]);
+    }
+    else if(!strcmp(argv[i], "--capture") && i + 1 < argc) {
+      capturePath = argv[++i];
+    }
+    else {
+      printUsage();
+      return 2;
+    }
+  }
+
+  TonearmModel& tonearm = simulator.getTonearm();
+  tonearm.setRecord(TonearmModel::defaultRecord(size));
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedA, speed & 1);
+  simulator.setMuxInput(MultiplexerInput::TargetSpeedB, speed >> 1);
+  simulator.setMuxInput(MultiplexerInput::WaitUntilTargetSpeed, true);
+
+  if(pty) {
+    if(!openPty()) {
+      perror("pty");
+      return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ptyStartTime);
+    simulator.schedule(0, pumpPty);
+  }
+
+  simulator.runSetup();
+
+  if(capturePath != NULL) {
+    if(!captureSide(capturePath)) {
+      fprintf(stderr, "turntable_sim: the side couldn't be captured to %s\n", capturePath);
+      return 1;
+    }
+  }
+  else {
+    if(play) simulator.pressButton(MultiplexerInput::PlayHomeButton);
+    simulator.runUntil(seconds);
+  }
+
+  for(size_t i = 0; i < tonearm.getStylusEvents().size(); i++) {
+    const StylusEvent& event = tonearm.getStylusEvents()[i];
+    printf("%10.6f stylus %s at %.1f steps\n", (double)event.ticks / SIMULATED_TICKS_PER_SECOND, event.down ? "down" : "up", event.armSteps);
+  }
+
+  for(size_t i = 0; i < tonearm.getAnomalies().size(); i++) {
+    const TonearmAnomaly& anomaly = tonearm.getAnomalies()[i];
+    printf("%10.6f anomaly %u on axis %u\n", (double)anomaly.ticks / SIMULATED_TICKS_PER_SECOND, anomaly.type, anomaly.axis);
+  }
+
+  printf("%10.6f platter %.3f RPM (%+.2f%%), tonearm at %.1f steps, lift at %.1f steps\n", simulator.getSeconds(),
+    simulator.getPlatter().getRpm(), simulator.getPlatter().getSpeedError() * 100, tonearm.getArmSteps(), tonearm.getLiftSteps());
+  printf("routines: play %lums, home %lums, repeat %lums\n", playRoutineMs, homeRoutineMs, repeatRoutineMs);
+
+  return 0;
+}
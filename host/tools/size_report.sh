@@ -0,0 +1,44 @@
+#!/bin/sh
+# Builds the sketch for the Arduino Nano Every with arduino-cli and prints how much flash and RAM it uses. Given a git
+# revision, that revision is built the same way from a temporary worktree, and the difference is printed too, e.g.
+# `host/tools/size_report.sh d328ed2~1` for the build from before the pins were made template parameters.
+#
+#   host/tools/size_report.sh [<revision>]
+
+set -e
+
+FQBN=arduino:megaavr:nona4809
+REPO=$(git -C "$(dirname "$0")" rev-parse --show-toplevel)
+
+# Prints "<flash bytes> <RAM bytes>" for the sketch in the given directory.
+sketch_size() {
+  BUILD=$(mktemp -d)
+  # The sketch has to be in a directory named after it.
+  mkdir "$BUILD/AutomaticTurntable"
+  cp -R "$1"/. "$BUILD/AutomaticTurntable"
+
+  arduino-cli compile --fqbn "$FQBN" "$BUILD/AutomaticTurntable" 2>&1 |
+    sed -n -e 's/^Sketch uses \([0-9]*\) bytes.*/\1/p' -e 's/^Global variables use \([0-9]*\) bytes.*/\1/p' | tr '\n' ' '
+
+  rm -rf "$BUILD"
+}
+
+if ! command -v arduino-cli > /dev/null; then
+  echo "size_report.sh needs arduino-cli, with the arduino:megaavr core installed" >&2
+  exit 1
+fi
+
+CURRENT=$(sketch_size "$REPO/Code")
+printf "%-12s flash %6s bytes, RAM %5s bytes\n" "working tree" $CURRENT
+
+if [ $# -eq 1 ]; then
+  WORKTREE=$(mktemp -d)
+  git -C "$REPO" worktree add --detach "$WORKTREE" "$1" > /dev/null 2>&1
+  BASELINE=$(sketch_size "$WORKTREE/Code")
+  git -C "$REPO" worktree remove --force "$WORKTREE"
+
+  printf "%-12s flash %6s bytes, RAM %5s bytes\n" "$1" $BASELINE
+
+  set -- $CURRENT $BASELINE
+  printf "%-12s flash %+6d bytes, RAM %+5d bytes\n" "difference" $(($1 - $3)) $(($2 - $4))
+fi